@@ -1,9 +1,9 @@
 #include <NMEA2000.h>
-#include <NMEA2000_SocketCAN.h> // For Raspberry Pi CAN
+#include "socketcan_node.h" // For Raspberry Pi CAN
 
-// Create an instance of the NMEA2000_SocketCAN class
+// Create a blocking SocketCAN node
 const char* can_interface = "can0";
-tNMEA2000_SocketCAN NMEA2000((char*)can_interface);
+SocketCanNode NMEA2000(can_interface);
 
 // Setup function
 void setup() {
@@ -25,12 +25,14 @@ void setup() {
     // Set mode and open the connection
     NMEA2000.SetMode(tNMEA2000::N2km_ListenAndNode, 25); // Node mode
     NMEA2000.EnableForward(false); // Disable forwarding
+    NMEA2000.setReceivePgns({}); // Address claim only: network management PGNs
     NMEA2000.Open();
 }
 
-// Loop function
+// Loop function: sleep until frames arrive, ticking for the library's timers
 void loop() {
     NMEA2000.ParseMessages();
+    NMEA2000.waitForFrames(100);
 }
 
 // Main function
@@ -0,0 +1,98 @@
+#include "bus_load.h"
+#include <algorithm>
+#include <cmath>
+
+void BusLoadMonitor::update(const BusCounters &counters, uint64_t nowMs) {
+    failuresSinceUpdate = 0;
+    if (!hasBaseline || counters.frames < previous.frames || counters.dataBytes < previous.dataBytes ||
+        counters.sendFailures < previous.sendFailures) {
+        hasBaseline = true;
+        previous = counters;
+        previousMs = nowMs;
+        return;
+    }
+    if (nowMs <= previousMs) {
+        return;
+    }
+
+    double elapsedMs = static_cast<double>(nowMs - previousMs);
+    double bits = static_cast<double>(counters.frames - previous.frames) * canFrameBits(0) +
+                  static_cast<double>(counters.dataBytes - previous.dataBytes) * 8.0;
+    double sample = std::min(1.0, bits / (bitRate * elapsedMs / 1000.0));
+    smoothed += (1.0 - std::exp(-elapsedMs / smoothingMs)) * (sample - smoothed);
+    failuresSinceUpdate = counters.sendFailures - previous.sendFailures;
+
+    previous = counters;
+    previousMs = nowMs;
+}
+
+TransmitRateController::TransmitRateController(const TransmitRateSettings &settings) : settings(settings) {
+}
+
+void TransmitRateController::setSettings(const TransmitRateSettings &newSettings) {
+    settings = newSettings;
+    rate = std::min(rate, maxFramesPerSecond());
+}
+
+double TransmitRateController::maxFramesPerSecond() const {
+    return std::max(minRate, settings.maxBusShare * settings.bitRate / canFrameBits(8));
+}
+
+void TransmitRateController::update(double utilisation, uint64_t nowMs) {
+    if (utilisation > settings.busLoadCeiling) {
+        decrease(nowMs);
+        return;
+    }
+    settle(nowMs);
+    rate = std::min(maxFramesPerSecond(), rate + increaseShare * maxFramesPerSecond());
+}
+
+void TransmitRateController::onBackpressure(uint64_t nowMs) {
+    decrease(nowMs);
+}
+
+// A burst of failures from one full tx queue counts as one signal.
+void TransmitRateController::decrease(uint64_t nowMs) {
+    if (decreased && nowMs - lastDecreaseMs < decreaseIntervalMs) {
+        return;
+    }
+    settle(nowMs);
+    rate = std::max(minRate, rate / 2);
+    lastDecreaseMs = nowMs;
+    decreased = true;
+}
+
+void TransmitRateController::settle(uint64_t nowMs) {
+    if (started) {
+        tokens = tokensAt(nowMs);
+        tokensMs = std::max(tokensMs, nowMs);
+    }
+}
+
+double TransmitRateController::tokensAt(uint64_t nowMs) const {
+    double burst = std::max(1.0, rate * burstSeconds);
+    if (!started) {
+        return burst;
+    }
+    double elapsedMs = nowMs > tokensMs ? static_cast<double>(nowMs - tokensMs) : 0.0;
+    return std::min(burst, tokens + rate * elapsedMs / 1000.0);
+}
+
+bool TransmitRateController::tryAcquire(size_t frames, uint64_t nowMs) {
+    tokens = tokensAt(nowMs);
+    tokensMs = started ? std::max(tokensMs, nowMs) : nowMs;
+    started = true;
+    if (tokens <= 0.0) {
+        return false;
+    }
+    tokens -= static_cast<double>(frames);
+    return true;
+}
+
+uint64_t TransmitRateController::msUntilAvailable(uint64_t nowMs) const {
+    double available = tokensAt(nowMs);
+    if (available > 0.0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(-available * 1000.0 / rate) + 1;
+}
@@ -0,0 +1,107 @@
+#ifndef BUS_LOAD_H
+#define BUS_LOAD_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Cumulative counts of what crossed the wire, our own frames included.
+struct BusCounters {
+    uint64_t frames = 0;
+    uint64_t dataBytes = 0;
+    uint64_t sendFailures = 0;  // Our frames the driver refused (tx queue full)
+};
+
+// Implemented by CAN drivers that can report whole-bus counters, so the
+// handler can measure load even when kernel filters hide most frames.
+class BusCounterSource {
+public:
+    virtual ~BusCounterSource() = default;
+    virtual bool readBusCounters(BusCounters &counters) = 0;
+};
+
+// Extended data frame on the wire without stuffing: 67 bits of framing and
+// inter-frame space plus the data.
+inline uint32_t canFrameBits(unsigned char len) {
+    return 67 + 8u * len;
+}
+
+// Frames one NMEA 2000 message takes: single frame up to 8 bytes, then
+// fast-packet with 6 bytes in the first frame and 7 in each after it.
+inline size_t framesForPayload(int dataLen) {
+    return dataLen <= 8 ? 1 : 1 + (dataLen - 6 + 7 - 1) / 7;
+}
+
+// Share of the bus in use, from successive counter readings, smoothed over
+// about half a second. A counter that goes backwards (interface restart)
+// just starts a new baseline.
+class BusLoadMonitor {
+public:
+    explicit BusLoadMonitor(unsigned long bitRate = 250000) : bitRate(bitRate) {}
+
+    void update(const BusCounters &counters, uint64_t nowMs);
+    double utilisation() const { return smoothed; }
+    // Refused sends since the previous update.
+    uint64_t newSendFailures() const { return failuresSinceUpdate; }
+
+private:
+    static constexpr double smoothingMs = 500.0;
+
+    unsigned long bitRate;
+    bool hasBaseline = false;
+    BusCounters previous;
+    uint64_t previousMs = 0;
+    double smoothed = 0.0;
+    uint64_t failuresSinceUpdate = 0;
+};
+
+struct TransmitRateSettings {
+    double maxBusShare = 0.3;     // Most of the wire our own sends may take
+    double busLoadCeiling = 0.8;  // Total load above which we back off
+    unsigned long bitRate = 250000;
+};
+
+// Paces our transmissions in frames per second. Additive increase while
+// the bus stays under the ceiling, halved when it goes over or the driver
+// pushes back; a token bucket turns the rate into send permission.
+class TransmitRateController {
+public:
+    explicit TransmitRateController(const TransmitRateSettings &settings = TransmitRateSettings());
+
+    void setSettings(const TransmitRateSettings &settings);
+    const TransmitRateSettings &getSettings() const { return settings; }
+
+    // Called once per load sample.
+    void update(double utilisation, uint64_t nowMs);
+    void onBackpressure(uint64_t nowMs);
+
+    // Takes permission for a message of this many frames. A message may
+    // overdraw the bucket; the next one then waits for it to refill.
+    bool tryAcquire(size_t frames, uint64_t nowMs);
+    uint64_t msUntilAvailable(uint64_t nowMs) const;
+
+    double framesPerSecond() const { return rate; }
+    double maxFramesPerSecond() const;
+
+private:
+    // About the old fixed pace of one small message per 100 ms, and never
+    // less, so waypoint sync still crawls along on a saturated bus.
+    static constexpr double minRate = 30.0;
+    static constexpr double increaseShare = 0.05;  // Of the maximum, per update
+    static constexpr uint64_t decreaseIntervalMs = 100;
+    static constexpr double burstSeconds = 0.1;
+
+    void decrease(uint64_t nowMs);
+    // Brings the bucket up to nowMs at the current rate, before the rate changes.
+    void settle(uint64_t nowMs);
+    double tokensAt(uint64_t nowMs) const;
+
+    TransmitRateSettings settings;
+    double rate = minRate;
+    double tokens = 0.0;
+    uint64_t tokensMs = 0;
+    bool started = false;
+    uint64_t lastDecreaseMs = 0;
+    bool decreased = false;
+};
+
+#endif // BUS_LOAD_H
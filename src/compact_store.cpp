@@ -0,0 +1,172 @@
+#include "compact_store.h"
+#include "geo_kernels.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <malloc.h>
+
+namespace {
+
+uint64_t hashText(std::string_view text) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+double fromFixed(int32_t fixed) {
+    double degrees;
+    geo::fixedToDegrees(&fixed, &degrees, 1, std::numeric_limits<double>::quiet_NaN());
+    return degrees;
+}
+
+int32_t toFixed(double degrees) {
+    int32_t fixed;
+    geo::degreesToFixed(&degrees, &fixed, 1);
+    return fixed;
+}
+
+} // namespace
+
+StringPool::StringPool() : blocks(1), spans{Span{0, 0, 0}}, slots(64, 0) {
+}
+
+size_t StringPool::slotFor(std::string_view text) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = hashText(text) & mask;
+    while (slots[slot] != 0 && view(slots[slot]) != text) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void StringPool::rehash(size_t slotCount) {
+    slots.assign(slotCount, 0);
+    for (Handle handle = 1; handle < spans.size(); ++handle) {
+        slots[slotFor(view(handle))] = handle;
+    }
+}
+
+StringPool::Handle StringPool::intern(std::string_view text) {
+    if (text.empty()) {
+        return 0;
+    }
+    size_t slot = slotFor(text);
+    if (slots[slot] != 0) {
+        return slots[slot];
+    }
+
+    // Rare long strings get a block of their own rather than wasting the
+    // tail of the current one.
+    size_t block;
+    size_t offset = 0;
+    if (text.size() > blockSize / 4) {
+        blocks.emplace_back(new char[text.size()]);
+        blockBytes += text.size();
+        block = blocks.size() - 1;
+    } else {
+        if (blockSize - blockUsed < text.size()) {
+            blocks.emplace_back(new char[blockSize]);
+            blockBytes += blockSize;
+            currentBlock = blocks.size() - 1;
+            blockUsed = 0;
+        }
+        block = currentBlock;
+        offset = blockUsed;
+        blockUsed += text.size();
+    }
+    std::memcpy(blocks[block].get() + offset, text.data(), text.size());
+
+    Handle handle = static_cast<Handle>(spans.size());
+    spans.push_back(Span{block, offset, text.size()});
+    slots[slot] = handle;
+    if (spans.size() * 4 > slots.size() * 3) {
+        rehash(slots.size() * 2);
+    }
+    return handle;
+}
+
+StringPool::Handle StringPool::find(std::string_view text) const {
+    if (text.empty()) {
+        return 0;
+    }
+    Handle handle = slots[slotFor(text)];
+    return handle != 0 ? handle : npos;
+}
+
+PackedWaypoint packWaypoint(const Waypoint &waypoint, StringPool &pool) {
+    PackedWaypoint packed;
+    packed.latitude = toFixed(waypoint.latitude);
+    packed.longitude = toFixed(waypoint.longitude);
+    packed.name = pool.intern(waypoint.name);
+    packed.symbol = pool.intern(waypoint.symbol);
+    packed.id = waypoint.id;
+    packed.source = waypoint.source;
+    return packed;
+}
+
+Waypoint unpackWaypoint(const PackedWaypoint &packed, const StringPool &pool) {
+    Waypoint waypoint;
+    waypoint.id = packed.id;
+    waypoint.name = std::string(pool.view(packed.name));
+    waypoint.latitude = fromFixed(packed.latitude);
+    waypoint.longitude = fromFixed(packed.longitude);
+    waypoint.symbol = std::string(pool.view(packed.symbol));
+    waypoint.source = packed.source;
+    return waypoint;
+}
+
+void WaypointTable::resize(size_t count) {
+    if (pool) {
+        packed.resize(count);
+    } else {
+        plain.resize(count);
+    }
+}
+
+void WaypointTable::set(size_t index, const Waypoint &waypoint) {
+    if (pool) {
+        packed[index] = packWaypoint(waypoint, *pool);
+    } else {
+        plain[index] = waypoint;
+    }
+}
+
+void WaypointTable::copy(size_t index, const WaypointTable &from, size_t fromIndex) {
+    if (pool && pool == from.pool) {
+        packed[index] = from.packed[fromIndex];
+    } else if (!pool && !from.pool) {
+        plain[index] = from.plain[fromIndex];
+    } else {
+        set(index, from.get(fromIndex));
+    }
+}
+
+Waypoint WaypointTable::get(size_t index) const {
+    return pool ? unpackWaypoint(packed[index], *pool) : plain[index];
+}
+
+double WaypointTable::latitude(size_t index) const {
+    return pool ? fromFixed(packed[index].latitude) : plain[index].latitude;
+}
+
+double WaypointTable::longitude(size_t index) const {
+    return pool ? fromFixed(packed[index].longitude) : plain[index].longitude;
+}
+
+ScratchArena::ScratchArena(size_t chunkBytes) : arena(chunkBytes) {
+}
+
+void useCompactAllocator() {
+#ifdef __GLIBC__
+    mallopt(M_MMAP_THRESHOLD, 128 * 1024);
+    mallopt(M_TRIM_THRESHOLD, 256 * 1024);
+#endif
+}
+
+void releaseFreeMemory() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+}
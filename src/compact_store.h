@@ -0,0 +1,112 @@
+#ifndef COMPACT_STORE_H
+#define COMPACT_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+#include "waypoint.h"
+
+// Storage for the compact memory mode (512 MB installs), where a 50k
+// waypoint library has to fit next to everything else on the Pi.
+
+// Interns strings into large shared blocks. Handles are indices handed
+// out in order, so a pool holding only keys can index plain vectors.
+// Nothing is freed before the pool is; a renamed waypoint leaves its old
+// name behind, which is a few bytes per edit.
+class StringPool {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle npos = UINT32_MAX;
+
+    StringPool();  // Handle 0 is always ""
+
+    Handle intern(std::string_view text);
+    Handle find(std::string_view text) const;
+    std::string_view view(Handle handle) const {
+        return std::string_view(blocks[spans[handle].block].get() + spans[handle].offset, spans[handle].length);
+    }
+    size_t size() const { return spans.size(); }
+
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+
+    size_t slotFor(std::string_view text) const;
+    void rehash(size_t slotCount);
+
+    // Where each string is, in half the space of a string_view.
+    struct Span {
+        uint64_t block : 20;
+        uint64_t offset : 16;  // Long strings have a block of their own
+        uint64_t length : 28;
+    };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t currentBlock = 0;
+    size_t blockUsed = blockSize;
+    size_t blockBytes = 0;
+    std::vector<Span> spans;
+    std::vector<Handle> slots;  // Open addressing; 0 is empty since "" is never hashed
+};
+
+// A waypoint in 20 bytes: position at NMEA 2000 wire resolution (1e-7
+// degrees, about a centimetre) and strings as pool handles.
+struct PackedWaypoint {
+    int32_t latitude = 0;
+    int32_t longitude = 0;
+    StringPool::Handle name = 0;
+    StringPool::Handle symbol = 0;
+    uint16_t id = 0;
+    uint8_t source = 255;
+};
+
+PackedWaypoint packWaypoint(const Waypoint &waypoint, StringPool &pool);
+Waypoint unpackWaypoint(const PackedWaypoint &packed, const StringPool &pool);
+
+// Waypoints by index, held as given or, with a pool, packed into it.
+class WaypointTable {
+public:
+    explicit WaypointTable(StringPool *pool = nullptr) : pool(pool) {}
+
+    bool isPacked() const { return pool != nullptr; }
+    size_t size() const { return pool ? packed.size() : plain.size(); }
+    void resize(size_t count);
+
+    void set(size_t index, const Waypoint &waypoint);
+    // Cheap when both tables share a pool: no strings are touched.
+    void copy(size_t index, const WaypointTable &from, size_t fromIndex);
+    Waypoint get(size_t index) const;
+    double latitude(size_t index) const;
+    double longitude(size_t index) const;
+
+private:
+    StringPool *pool;
+    std::vector<Waypoint> plain;
+    std::vector<PackedWaypoint> packed;
+};
+
+// Scratch memory for one sync cycle. Everything the cycle allocates comes
+// from a few large chunks that reset() hands back at once, so a merge of
+// a big library does not leave the heap fragmented between cycles. Not
+// thread safe: the owner resets it at the end of each of its cycles.
+class ScratchArena {
+public:
+    explicit ScratchArena(size_t chunkBytes = 256 * 1024);
+
+    std::pmr::memory_resource *resource() { return &arena; }
+    void reset() { arena.release(); }
+
+private:
+    std::pmr::monotonic_buffer_resource arena;
+};
+
+// glibc raises its mmap threshold the first time a large block is freed,
+// after which big per-cycle buffers come from the heap and stay resident.
+// Compact mode pins the threshold so they are always mapped and unmapped.
+void useCompactAllocator();
+// Hands free pages in the middle of the heap back to the kernel.
+void releaseFreeMemory();
+
+#endif // COMPACT_STORE_H
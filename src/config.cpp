@@ -0,0 +1,266 @@
+#include "config.h"
+#include "nlohmann/json.hpp"
+#include <fstream>
+#include <iostream>
+#include <malloc.h>
+#include <sstream>
+
+using json = nlohmann::json;
+
+namespace {
+
+// Fills value from object[key] only when present, so missing keys keep
+// their defaults.
+template <typename T>
+void readOptional(const json &object, const char *key, T &value) {
+    auto it = object.find(key);
+    if (it != object.end() && !it->is_null()) {
+        value = it->get<T>();
+    }
+}
+
+// Accepts both "usr": "lowrance" and the legacy "usr": {"format_name": "lowrance"}.
+void readFormatMappings(const json &mappings, std::unordered_map<std::string, std::string> &formatMap) {
+    for (auto &[key, value] : mappings.items()) {
+        if (value.is_string()) {
+            formatMap[key] = value.get<std::string>();
+        } else if (value.is_object() && value.contains("format_name")) {
+            formatMap[key] = value["format_name"].get<std::string>();
+        }
+    }
+}
+
+} // namespace
+
+bool parseConfig(const std::string &text, Config &config, std::string &error) {
+    Config parsed;
+    try {
+        json root = json::parse(text);
+        if (!root.is_object()) {
+            error = "top level must be an object";
+            return false;
+        }
+
+        if (root.contains("paths")) {
+            const json &paths = root["paths"];
+            readOptional(paths, "waypoints_file", parsed.waypointsFile);
+            readOptional(paths, "watch_directory", parsed.watchDirectory);
+            readOptional(paths, "log_directory", parsed.logDirectory);
+            readOptional(paths, "temp_directory", parsed.tempDirectory);
+            readOptional(paths, "track_output_directory", parsed.trackOutputDirectory);
+            readOptional(paths, "format_mapping_file", parsed.formatMappingFile);
+        }
+
+        if (root.contains("format_mappings")) {
+            readFormatMappings(root["format_mappings"], parsed.formatMap);
+        }
+
+        if (root.contains("retry_settings")) {
+            const json &retry = root["retry_settings"];
+            readOptional(retry, "inotify_init", parsed.inotifyInitRetries);
+            readOptional(retry, "format_load", parsed.formatLoadRetries);
+            readOptional(retry, "device_connect", parsed.deviceConnectRetries);
+        }
+
+        if (root.contains("device_settings")) {
+            const json &device = root["device_settings"];
+            readOptional(device, "polling_interval", parsed.pollingIntervalMs);
+            readOptional(device, "max_retry_delay", parsed.maxRetryDelayMs);
+            readOptional(device, "connection_timeout", parsed.connectionTimeoutMs);
+            readOptional(device, "can_interfaces", parsed.canInterfaces);
+            readOptional(device, "bridge_waypoint_pgns", parsed.bridgeWaypointPgns);
+            readOptional(device, "capture_proprietary_pgns", parsed.captureProprietaryPgns);
+            readOptional(device, "media_mount_prefixes", parsed.mediaMountPrefixes);
+            readOptional(device, "media_import_workers", parsed.mediaImportWorkers);
+        }
+
+        if (root.contains("track_settings")) {
+            const json &tracks = root["track_settings"];
+            readOptional(tracks, "tolerance_meters", parsed.trackToleranceMeters);
+            readOptional(tracks, "default_point_budget", parsed.defaultTrackPointBudget);
+            readOptional(tracks, "point_budgets", parsed.trackPointBudgets);
+        }
+
+        if (root.contains("converter_settings")) {
+            const json &converter = root["converter_settings"];
+            readOptional(converter, "executable", parsed.converterExecutable);
+            readOptional(converter, "max_concurrent", parsed.converterMaxConcurrent);
+            readOptional(converter, "timeout_ms", parsed.converterTimeoutMs);
+        }
+
+        if (root.contains("waypoint_selection")) {
+            const json &selection = root["waypoint_selection"];
+            readOptional(selection, "default_capacity", parsed.defaultWaypointCapacity);
+            readOptional(selection, "capacities", parsed.waypointCapacities);
+            readOptional(selection, "hysteresis_meters", parsed.selectionHysteresisMeters);
+            readOptional(selection, "recompute_distance_meters", parsed.selectionRecomputeMeters);
+            readOptional(selection, "recency_boost", parsed.selectionRecencyBoost);
+            readOptional(selection, "recency_half_life_hours", parsed.selectionRecencyHalfLifeHours);
+        }
+
+        if (root.contains("transmit_settings")) {
+            const json &transmit = root["transmit_settings"];
+            readOptional(transmit, "max_bus_share", parsed.transmitMaxBusShare);
+            readOptional(transmit, "bus_load_ceiling", parsed.transmitBusLoadCeiling);
+        }
+
+        if (root.contains("vendor_profiles")) {
+            for (const auto &[vendor, entry] : root["vendor_profiles"].items()) {
+                VendorProfileOverride profile;
+                profile.vendor = vendor;
+                readOptional(entry, "max_name_length", profile.maxNameLength);
+                readOptional(entry, "charset", profile.charset);
+                readOptional(entry, "symbols", profile.symbols);
+                readOptional(entry, "default_symbol", profile.defaultSymbol);
+                parsed.vendorProfileOverrides.push_back(profile);
+            }
+        }
+
+        if (root.contains("memory_settings")) {
+            readOptional(root["memory_settings"], "compact_mode", parsed.compactMemory);
+        }
+
+        if (root.contains("library_export")) {
+            const json &libraryExport = root["library_export"];
+            readOptional(libraryExport, "shm_name", parsed.libraryShmName);
+            readOptional(libraryExport, "socket", parsed.librarySocketPath);
+        }
+
+        if (root.contains("nmea0183_outputs")) {
+            for (const auto &entry : root["nmea0183_outputs"]) {
+                Nmea0183OutputConfig output;
+                readOptional(entry, "type", output.type);
+                readOptional(entry, "device", output.device);
+                readOptional(entry, "host", output.host);
+                readOptional(entry, "port", output.port);
+                readOptional(entry, "baud", output.baud);
+                readOptional(entry, "enabled", output.enabled);
+                if (output.type != "serial" && output.type != "udp") {
+                    error = "unknown nmea0183 output type '" + output.type + "'";
+                    return false;
+                }
+                parsed.nmea0183Outputs.push_back(output);
+            }
+        }
+    } catch (const json::exception &e) {
+        error = e.what();
+        return false;
+    }
+
+    if (parsed.pollingIntervalMs <= 0) {
+        error = "polling_interval must be positive";
+        return false;
+    }
+    if (parsed.trackToleranceMeters < 0 || parsed.defaultTrackPointBudget < 2) {
+        error = "track_settings out of range";
+        return false;
+    }
+    if (parsed.defaultWaypointCapacity == 0 || parsed.selectionHysteresisMeters < 0 ||
+        parsed.selectionRecomputeMeters < 0 || parsed.selectionRecencyBoost < 0 ||
+        parsed.selectionRecencyHalfLifeHours <= 0) {
+        error = "waypoint_selection out of range";
+        return false;
+    }
+    for (const auto &[device, capacity] : parsed.waypointCapacities) {
+        if (capacity == 0) {
+            error = "waypoint capacity for " + device + " must be positive";
+            return false;
+        }
+    }
+    if (parsed.converterExecutable.empty() || parsed.converterMaxConcurrent <= 0 || parsed.converterTimeoutMs <= 0) {
+        error = "converter_settings out of range";
+        return false;
+    }
+    if (parsed.transmitMaxBusShare <= 0.0 || parsed.transmitMaxBusShare > 1.0 ||
+        parsed.transmitBusLoadCeiling <= 0.0 || parsed.transmitBusLoadCeiling > 1.0) {
+        error = "transmit_settings out of range";
+        return false;
+    }
+    for (const auto &profile : parsed.vendorProfileOverrides) {
+        // 32 is what the PGN 130074 name field holds.
+        if (profile.maxNameLength > 32) {
+            error = "vendor_profiles max_name_length for " + profile.vendor + " must be at most 32";
+            return false;
+        }
+        if (!profile.charset.empty() && profile.charset != "ascii" && profile.charset != "upper") {
+            error = "unknown vendor_profiles charset '" + profile.charset + "'";
+            return false;
+        }
+    }
+    if (parsed.mediaImportWorkers <= 0) {
+        error = "media_import_workers must be positive";
+        return false;
+    }
+    if (!parsed.libraryShmName.empty() &&
+        (parsed.libraryShmName[0] != '/' || parsed.libraryShmName.find('/', 1) != std::string::npos)) {
+        error = "library_export shm_name must be a single /name";
+        return false;
+    }
+
+    config = std::move(parsed);
+    return true;
+}
+
+bool loadFormatMappingFile(const std::string &path, std::unordered_map<std::string, std::string> &formatMap) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    try {
+        json mappings;
+        file >> mappings;
+        std::unordered_map<std::string, std::string> loaded;
+        readFormatMappings(mappings, loaded);
+        // Entries from config.json win over the legacy file.
+        for (auto &[key, value] : loaded) {
+            formatMap.emplace(key, value);
+        }
+    } catch (const json::exception &e) {
+        std::cerr << "Error parsing " << path << ": " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+ConfigStore::ConfigStore(const std::string &path) : path(path), snapshot(std::make_shared<const Config>()) {
+}
+
+bool ConfigStore::reload() {
+    std::lock_guard<std::mutex> lock(reloadMutex);
+
+    auto config = std::make_shared<Config>();
+    std::ifstream file(path);
+    if (file.is_open()) {
+        std::stringstream text;
+        text << file.rdbuf();
+        std::string error;
+        if (!parseConfig(text.str(), *config, error)) {
+            std::cerr << "Ignoring invalid config " << path << ": " << error << std::endl;
+            return false;
+        }
+    } else if (!isLoaded()) {
+        std::cerr << "Config " << path << " not found, using defaults." << std::endl;
+    } else {
+        // Mid-save or deleted: keep running on what we have.
+        std::cerr << "Config " << path << " is not readable, keeping current settings." << std::endl;
+        return false;
+    }
+
+    if (!config->formatMappingFile.empty()) {
+        loadFormatMappingFile(config->formatMappingFile, config->formatMap);
+    }
+    for (const auto &[key, value] : config->formatMap) {
+        std::cout << "Loaded format: " << key << " as " << value << std::endl;
+    }
+
+    // The JSON DOM is gone by now; on small installs give its pages back
+    // instead of keeping them as free heap.
+    bool trim = config->compactMemory;
+    snapshot.store(std::shared_ptr<const Config>(std::move(config)));
+    ++generation;
+    if (trim) {
+        malloc_trim(0);
+    }
+    return true;
+}
@@ -0,0 +1,135 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "vendor_profiles.h"
+
+const std::string DEFAULT_CONFIG_PATH = "/etc/waypoint_sync/config.json";
+
+struct Nmea0183OutputConfig {
+    std::string type = "serial";  // "serial" or "udp"
+    std::string device;           // serial device path
+    std::string host;             // udp destination
+    uint16_t port = 0;
+    int baud = 4800;
+    bool enabled = true;          // a disabled entry is kept but never opened
+
+    bool operator==(const Nmea0183OutputConfig &other) const {
+        return type == other.type && device == other.device && host == other.host &&
+               port == other.port && baud == other.baud && enabled == other.enabled;
+    }
+};
+
+// Typed view of config.json. Defaults match what used to be compiled in,
+// so a missing file behaves exactly like the old build.
+struct Config {
+    std::string waypointsFile = "/mnt/nvme/waypoints.json";
+    std::string watchDirectory = "/home/blake/waypoint_sync_test_dir";
+    std::string logDirectory = "/var/log/waypoint_sync";
+    std::string tempDirectory = "/tmp/waypoint_sync";
+    // Budget-reduced tracks, one file per device and imported track file.
+    std::string trackOutputDirectory = "/tmp/waypoint_sync/tracks";
+    // Legacy {"device": {"format_name": ...}} file, merged under format_mappings.
+    std::string formatMappingFile = "/home/blake/waypoint_sync_project/format_mapping.json";
+
+    std::unordered_map<std::string, std::string> formatMap;
+
+    int inotifyInitRetries = 3;
+    int formatLoadRetries = 3;
+    int deviceConnectRetries = 5;
+
+    int pollingIntervalMs = 4000;
+    int maxRetryDelayMs = 30000;
+    int connectionTimeoutMs = 5000;
+    std::vector<std::string> canInterfaces{"can0"};
+    bool bridgeWaypointPgns = false;
+    // Logs vendor proprietary frames raw under logDirectory. Read once at
+    // startup, like the CAN interfaces.
+    bool captureProprietaryPgns = false;
+    std::vector<std::string> mediaMountPrefixes{"/media", "/mnt", "/run/media"};
+    int mediaImportWorkers = 2;
+
+    std::vector<Nmea0183OutputConfig> nmea0183Outputs;
+
+    // gpsbabel runs for formats we do not read or write ourselves.
+    std::string converterExecutable = "gpsbabel";
+    int converterMaxConcurrent = 2;
+    int converterTimeoutMs = 30000;
+
+    // Tracks are simplified to each device's point budget before export.
+    double trackToleranceMeters = 5.0;
+    size_t defaultTrackPointBudget = 10000;
+    std::unordered_map<std::string, size_t> trackPointBudgets;
+
+    size_t trackPointBudgetFor(const std::string &device) const {
+        auto it = trackPointBudgets.find(device);
+        return it != trackPointBudgets.end() ? it->second : defaultTrackPointBudget;
+    }
+
+    // Plotters only hold so many waypoints; each gets the most relevant
+    // set that fits, by distance from own ship and recency.
+    size_t defaultWaypointCapacity = 2000;
+    std::unordered_map<std::string, size_t> waypointCapacities;
+    double selectionHysteresisMeters = 500.0;
+    double selectionRecomputeMeters = 200.0;
+    double selectionRecencyBoost = 1.0;
+    double selectionRecencyHalfLifeHours = 24.0;
+
+    size_t waypointCapacityFor(const std::string &device) const {
+        auto it = waypointCapacities.find(device);
+        return it != waypointCapacities.end() ? it->second : defaultWaypointCapacity;
+    }
+
+    // Waypoint sends adapt to measured bus load: our own traffic takes at
+    // most this share of the bus, and backs off while the total is above
+    // the ceiling.
+    double transmitMaxBusShare = 0.3;
+    double transmitBusLoadCeiling = 0.8;
+
+    // Per-vendor waypoint name limits and symbol maps, on top of the
+    // built-in profiles.
+    std::vector<VendorProfileOverride> vendorProfileOverrides;
+
+    // Small installs (512 MB Pi Zero 2): packed library, interned strings
+    // and arena-allocated sync temporaries. Read once at startup.
+    bool compactMemory = false;
+
+    // Read-only shared-memory export of the waypoint set for local tools.
+    // An empty name disables it. Read once at startup.
+    std::string libraryShmName = "/waypoint_sync_library";
+    std::string librarySocketPath = "@waypoint_sync_library";
+};
+
+// Parses config text on top of the defaults. Returns false and fills error
+// on malformed input; config is only written on success.
+bool parseConfig(const std::string &text, Config &config, std::string &error);
+bool loadFormatMappingFile(const std::string &path, std::unordered_map<std::string, std::string> &formatMap);
+
+// Holds the current immutable Config snapshot. Readers grab the pointer
+// and keep using that snapshot for as long as they hold it; reload()
+// builds a fresh one and swaps it in, keeping the old one on any error.
+class ConfigStore {
+public:
+    explicit ConfigStore(const std::string &path = DEFAULT_CONFIG_PATH);
+
+    std::shared_ptr<const Config> current() const { return snapshot.load(); }
+    bool reload();
+
+    const std::string &getPath() const { return path; }
+    uint64_t getGeneration() const { return generation; }
+    bool isLoaded() const { return generation > 0; }
+
+private:
+    std::string path;
+    std::atomic<std::shared_ptr<const Config>> snapshot;
+    std::atomic<uint64_t> generation{0};
+    std::mutex reloadMutex;  // Serializes writers only
+};
+
+#endif // CONFIG_H
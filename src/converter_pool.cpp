@@ -0,0 +1,458 @@
+#include "converter_pool.h"
+#include <algorithm>
+#include <climits>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace {
+
+const size_t MAX_ERROR_TEXT = 64 * 1024;
+
+void closeFd(int &fd) {
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+// A converter that exits before reading all of its input must not take
+// the daemon down with SIGPIPE: block it on this thread around each write
+// and swallow any that was raised.
+class ScopedSigpipeBlock {
+public:
+    ScopedSigpipeBlock() {
+        sigemptyset(&pipeSet);
+        sigaddset(&pipeSet, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSet, &previous);
+    }
+
+    ~ScopedSigpipeBlock() {
+        sigset_t pending;
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE) && !sigismember(&previous, SIGPIPE)) {
+            timespec zero{0, 0};
+            sigtimedwait(&pipeSet, nullptr, &zero);
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    }
+
+private:
+    sigset_t pipeSet;
+    sigset_t previous;
+};
+
+// Reaps the child, killing it if it is still around at the deadline.
+int waitForExit(pid_t pid, std::chrono::steady_clock::time_point deadline, bool &timedOut) {
+    int status = 0;
+    while (true) {
+        pid_t done = waitpid(pid, &status, WNOHANG);
+        if (done == pid || (done < 0 && errno != EINTR)) {
+            return status;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            timedOut = true;
+            kill(-pid, SIGKILL);
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            return status;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+// One converter process: spawned without a shell, stdin/stdout/stderr on
+// non-blocking pipes. The caller waits for the pipes with poll() or the
+// event loop and hands the results to service().
+class ConverterProcess {
+public:
+    ConverterProcess(const ConversionRequest &request, const ConverterPoolOptions &options,
+                     const ConverterPool::OutputCallback &onOutput, ConversionResult &result)
+        : request(request), options(options), onOutput(onOutput), result(result) {}
+    ~ConverterProcess() { closePipes(); }
+
+    bool start();
+    bool active() const { return (outFd >= 0 || errFd >= 0) && !aborted; }
+    nfds_t pollSet(pollfd *fds) const;
+    void service(const pollfd *fds, nfds_t count);
+    void abort(const std::string &reason);
+    // Closes our ends and kills the process group if the run was cut short.
+    void closePipes();
+    void finish(int status);
+    pid_t getPid() const { return pid; }
+
+private:
+    const ConversionRequest &request;
+    const ConverterPoolOptions &options;
+    const ConverterPool::OutputCallback &onOutput;
+    ConversionResult &result;
+    pid_t pid = -1;
+    int inFd = -1;
+    int outFd = -1;
+    int errFd = -1;
+    size_t written = 0;
+    bool aborted = false;
+    char chunk[64 * 1024];
+};
+
+bool ConverterProcess::start() {
+    std::vector<std::string> args{options.executable};
+    args.insert(args.end(), request.options.begin(), request.options.end());
+    args.insert(args.end(), {"-i", request.inputFormat, "-f", request.inputPath.empty() ? "-" : request.inputPath,
+                             "-o", request.outputFormat, "-F", "-"});
+    std::vector<char *> argv;
+    for (auto &arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    int inPipe[2] = {-1, -1};
+    int outPipe[2] = {-1, -1};
+    int errPipe[2] = {-1, -1};
+    if (pipe2(inPipe, O_CLOEXEC) < 0 || pipe2(outPipe, O_CLOEXEC) < 0 || pipe2(errPipe, O_CLOEXEC) < 0) {
+        result.errorText = std::string("pipe: ") + std::strerror(errno);
+        for (int *fds : {inPipe, outPipe, errPipe}) {
+            closeFd(fds[0]);
+            closeFd(fds[1]);
+        }
+        return false;
+    }
+
+    // dup2 clears close-on-exec on the child's copies only.
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, inPipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, outPipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+    // The child must not inherit a blocked SIGPIPE, and gets its own
+    // process group so a kill also takes out anything it started.
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t noSignals, defaultSignals;
+    sigemptyset(&noSignals);
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGPIPE);
+    posix_spawnattr_setsigmask(&attributes, &noSignals);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    posix_spawnattr_setpgroup(&attributes, 0);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+    int spawnError = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    closeFd(inPipe[0]);
+    closeFd(outPipe[1]);
+    closeFd(errPipe[1]);
+    if (spawnError != 0) {
+        pid = -1;
+        result.errorText = "failed to start " + options.executable + ": " + std::strerror(spawnError);
+        closeFd(inPipe[1]);
+        closeFd(outPipe[0]);
+        closeFd(errPipe[0]);
+        return false;
+    }
+
+    inFd = inPipe[1];
+    outFd = outPipe[0];
+    errFd = errPipe[0];
+    for (int fd : {inFd, outFd, errFd}) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    if (!request.inputPath.empty() || request.input.empty()) {
+        closeFd(inFd);
+    }
+    return true;
+}
+
+nfds_t ConverterProcess::pollSet(pollfd *fds) const {
+    nfds_t count = 0;
+    for (int fd : {inFd, outFd, errFd}) {
+        if (fd >= 0) {
+            fds[count++] = {fd, static_cast<short>(fd == inFd ? POLLOUT : POLLIN), 0};
+        }
+    }
+    return count;
+}
+
+void ConverterProcess::service(const pollfd *fds, nfds_t count) {
+    const std::string &input = request.input;
+    for (nfds_t i = 0; i < count && !aborted; ++i) {
+        if (fds[i].revents == 0) {
+            continue;
+        }
+        if (fds[i].fd == inFd) {
+            ssize_t n;
+            {
+                ScopedSigpipeBlock sigpipeBlock;
+                n = write(inFd, input.data() + written, std::min(input.size() - written, sizeof(chunk)));
+            }
+            if (n > 0) {
+                written += static_cast<size_t>(n);
+            }
+            // EPIPE: the converter stopped reading; its exit status tells why.
+            if (written == input.size() || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+                closeFd(inFd);
+            }
+            continue;
+        }
+
+        ssize_t n = read(fds[i].fd, chunk, sizeof(chunk));
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+            continue;
+        }
+        if (n <= 0) {
+            closeFd(fds[i].fd == outFd ? outFd : errFd);
+        } else if (fds[i].fd == errFd) {
+            size_t room = MAX_ERROR_TEXT - std::min(MAX_ERROR_TEXT, result.errorText.size());
+            result.errorText.append(chunk, std::min(static_cast<size_t>(n), room));
+        } else if (onOutput) {
+            aborted = !onOutput(chunk, static_cast<size_t>(n));
+        } else if (result.output.size() + static_cast<size_t>(n) > options.maxOutputBytes) {
+            abort("output exceeds " + std::to_string(options.maxOutputBytes) + " bytes\n");
+        } else {
+            result.output.append(chunk, static_cast<size_t>(n));
+        }
+    }
+}
+
+void ConverterProcess::abort(const std::string &reason) {
+    result.errorText += reason;
+    aborted = true;
+}
+
+void ConverterProcess::closePipes() {
+    closeFd(inFd);
+    closeFd(outFd);
+    closeFd(errFd);
+    if (pid > 0 && (result.timedOut || aborted)) {
+        kill(-pid, SIGKILL);
+    }
+}
+
+void ConverterProcess::finish(int status) {
+    result.exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    result.ok = !result.timedOut && !aborted && result.exitStatus == 0;
+    pid = -1;  // Reaped; the number may be reused
+}
+
+int msUntil(std::chrono::steady_clock::time_point deadline) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<long long>(0, std::min<long long>(remaining.count(), INT32_MAX)));
+}
+
+// The loop wakes when the child exits through a pidfd; kernels without
+// one (before 5.3) get the old 5 ms reaping poll, on the loop's timers.
+Task<int> waitForExitAsync(EventLoop &loop, pid_t pid, std::chrono::steady_clock::time_point deadline,
+                           bool &timedOut) {
+    int status = 0;
+    int pidFd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    while (true) {
+        pid_t done = waitpid(pid, &status, WNOHANG);
+        if (done == pid || (done < 0 && errno != EINTR)) {
+            break;
+        }
+        int remaining = msUntil(deadline);
+        if (remaining == 0) {
+            timedOut = true;
+            kill(-pid, SIGKILL);
+            while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+            }
+            break;
+        }
+        if (pidFd >= 0) {
+            co_await loop.readable(pidFd, remaining);
+        } else {
+            co_await loop.sleepFor(std::chrono::milliseconds(std::min(remaining, 5)));
+        }
+    }
+    if (pidFd >= 0) {
+        close(pidFd);
+    }
+    co_return status;
+}
+
+} // namespace
+
+ConverterPool::ConverterPool(const ConverterPoolOptions &options) : options(options) {
+}
+
+void ConverterPool::setOptions(const ConverterPoolOptions &newOptions) {
+    std::vector<SlotAwaiter *> granted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        options = newOptions;
+        grantQueuedSlotsLocked(granted);
+    }
+    for (SlotAwaiter *waiter : granted) {
+        waiter->resumeOnLoop();
+    }
+    slotFreed.notify_all();
+}
+
+ConverterPoolOptions ConverterPool::getOptions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return options;
+}
+
+ConverterPool::Stats ConverterPool::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+ConversionResult ConverterPool::convert(const ConversionRequest &request) {
+    return convert(request, OutputCallback());
+}
+
+ConversionResult ConverterPool::convert(const ConversionRequest &request, const OutputCallback &onOutput) {
+    ConverterPoolOptions current;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        slotFreed.wait(lock, [this] { return acquireSlotLocked(); });
+        current = options;
+    }
+
+    ConversionResult result = run(request, current, onOutput);
+    releaseSlot(result);
+    return result;
+}
+
+ConversionResult ConverterPool::run(const ConversionRequest &request, const ConverterPoolOptions &current,
+                                    const OutputCallback &onOutput) {
+    ConversionResult result;
+    ConverterProcess process(request, current, onOutput, result);
+    if (!process.start()) {
+        return result;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + current.timeout;
+    while (process.active()) {
+        int remaining = msUntil(deadline);
+        if (remaining == 0) {
+            result.timedOut = true;
+            break;
+        }
+        pollfd fds[3];
+        nfds_t count = process.pollSet(fds);
+        int ready = poll(fds, count, std::min(remaining, 1000));
+        if (ready < 0 && errno != EINTR) {
+            process.abort(std::string("poll: ") + std::strerror(errno));
+        } else if (ready > 0) {
+            process.service(fds, count);
+        }
+    }
+
+    process.closePipes();
+    process.finish(waitForExit(process.getPid(), deadline, result.timedOut));
+    return result;
+}
+
+// The same conversion with every wait going through the loop: pipes and
+// the exit through epoll, a full pool through a queue of suspended callers.
+Task<ConversionResult> ConverterPool::convertAsync(EventLoop &loop, ConversionRequest request) {
+    co_await SlotAwaiter(*this, loop);
+    ConverterPoolOptions current = getOptions();
+
+    ConversionResult result;
+    {
+        OutputCallback noCallback;
+        ConverterProcess process(request, current, noCallback, result);
+        if (process.start()) {
+            auto deadline = std::chrono::steady_clock::now() + current.timeout;
+            while (process.active()) {
+                int remaining = msUntil(deadline);
+                if (remaining == 0) {
+                    result.timedOut = true;
+                    break;
+                }
+                pollfd fds[3];
+                nfds_t count = process.pollSet(fds);
+                if (co_await loop.poll(fds, count, remaining) > 0) {
+                    process.service(fds, count);
+                }
+            }
+            process.closePipes();
+            process.finish(co_await waitForExitAsync(loop, process.getPid(), deadline, result.timedOut));
+        }
+    }
+
+    releaseSlot(result);
+    co_return result;
+}
+
+bool ConverterPool::acquireSlotLocked() {
+    if (running >= std::max<size_t>(1, options.maxConcurrent)) {
+        return false;
+    }
+    ++running;
+    ++stats.started;
+    stats.peakRunning = std::max(stats.peakRunning, running);
+    return true;
+}
+
+// Queued coroutines get freed slots first; blocked threads recheck after.
+void ConverterPool::releaseSlot(const ConversionResult &result) {
+    std::vector<SlotAwaiter *> granted;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --running;
+        stats.failed += result.ok ? 0 : 1;
+        stats.timedOut += result.timedOut ? 1 : 0;
+        grantQueuedSlotsLocked(granted);
+    }
+    for (SlotAwaiter *waiter : granted) {
+        waiter->resumeOnLoop();
+    }
+    slotFreed.notify_one();
+}
+
+void ConverterPool::grantQueuedSlotsLocked(std::vector<SlotAwaiter *> &granted) {
+    while (!slotWaiters.empty() && acquireSlotLocked()) {
+        slotWaiters.front()->queued = false;
+        granted.push_back(slotWaiters.front());
+        slotWaiters.pop_front();
+    }
+}
+
+ConverterPool::SlotAwaiter::~SlotAwaiter() {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (queued) {
+        pool.slotWaiters.erase(std::find(pool.slotWaiters.begin(), pool.slotWaiters.end(), this));
+    }
+}
+
+bool ConverterPool::SlotAwaiter::await_ready() {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    return pool.acquireSlotLocked();
+}
+
+bool ConverterPool::SlotAwaiter::await_suspend(std::coroutine_handle<> awaiting) {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (pool.acquireSlotLocked()) {
+        return false;
+    }
+    handle = awaiting;
+    queued = true;
+    pool.slotWaiters.push_back(this);
+    return true;
+}
+
+// A slot can be freed on any thread; the waiter resumes on its own loop.
+void ConverterPool::SlotAwaiter::resumeOnLoop() {
+    loop.post([waiting = handle] { waiting.resume(); });
+}
+
+ConverterPool &defaultConverterPool() {
+    static ConverterPool pool;
+    return pool;
+}
@@ -0,0 +1,110 @@
+#ifndef CONVERTER_POOL_H
+#define CONVERTER_POOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "event_loop.h"
+#include "task.h"
+
+// One gpsbabel run. The input comes from inputPath when set, otherwise
+// from the input buffer through stdin; the output always comes back
+// through stdout.
+struct ConversionRequest {
+    std::vector<std::string> options;  // e.g. {"-w", "-r"} or {"-t"}
+    std::string inputFormat;
+    std::string outputFormat;
+    std::string inputPath;
+    std::string input;
+};
+
+struct ConversionResult {
+    bool ok = false;
+    bool timedOut = false;
+    int exitStatus = -1;  // Exit code, or -1 if it did not exit normally
+    std::string output;   // Empty when streamed to a callback
+    std::string errorText;
+};
+
+struct ConverterPoolOptions {
+    std::string executable = "gpsbabel";
+    size_t maxConcurrent = 2;
+    std::chrono::milliseconds timeout{30000};
+    size_t maxOutputBytes = 256 * 1024 * 1024;
+};
+
+// Runs converter processes without a shell: posix_spawn with an argv
+// array, stdin/stdout/stderr on pipes, all three serviced from one poll
+// loop so large inputs and outputs cannot deadlock. At most maxConcurrent
+// run at once; further callers wait for a slot. A run that exceeds the
+// timeout is killed.
+//
+// gpsbabel converts one input per process, so each conversion is its own
+// process; the pool bounds how many there are, not how long they live.
+class ConverterPool {
+public:
+    using OutputCallback = std::function<bool(const char *data, size_t size)>;
+
+    explicit ConverterPool(const ConverterPoolOptions &options = ConverterPoolOptions());
+
+    // Takes effect for conversions that start after the call.
+    void setOptions(const ConverterPoolOptions &options);
+    ConverterPoolOptions getOptions() const;
+
+    ConversionResult convert(const ConversionRequest &request);
+    // Streams stdout to onOutput as it arrives; returning false from the
+    // callback aborts the conversion.
+    ConversionResult convert(const ConversionRequest &request, const OutputCallback &onOutput);
+    // For the event loop thread: waits for a slot, the pipes and the exit
+    // without blocking it, so many conversions can be in flight at once.
+    Task<ConversionResult> convertAsync(EventLoop &loop, ConversionRequest request);
+
+    struct Stats {
+        size_t started = 0;
+        size_t failed = 0;
+        size_t timedOut = 0;
+        size_t peakRunning = 0;
+    };
+    Stats getStats() const;
+
+private:
+    // A coroutine queued for a slot; it owns the slot once dequeued.
+    class SlotAwaiter {
+    public:
+        SlotAwaiter(ConverterPool &pool, EventLoop &loop) : pool(pool), loop(loop) {}
+        ~SlotAwaiter();
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> awaiting);
+        void await_resume() {}
+        void resumeOnLoop();
+
+        ConverterPool &pool;
+        EventLoop &loop;
+        std::coroutine_handle<> handle;
+        bool queued = false;
+    };
+
+    ConversionResult run(const ConversionRequest &request, const ConverterPoolOptions &options,
+                         const OutputCallback &onOutput);
+    bool acquireSlotLocked();
+    void releaseSlot(const ConversionResult &result);
+    void grantQueuedSlotsLocked(std::vector<SlotAwaiter *> &granted);
+
+    mutable std::mutex mutex;
+    std::condition_variable slotFreed;
+    std::deque<SlotAwaiter *> slotWaiters;
+    ConverterPoolOptions options;
+    size_t running = 0;
+    Stats stats;
+};
+
+// Shared by the waypoint_converter functions.
+ConverterPool &defaultConverterPool();
+
+#endif // CONVERTER_POOL_H
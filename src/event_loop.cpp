@@ -0,0 +1,379 @@
+#include "event_loop.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t steadyMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// poll(2) and epoll share bit values on Linux; spelled out for clarity.
+uint32_t epollEventsFor(short events) {
+    uint32_t mask = 0;
+    mask |= (events & POLLIN) ? uint32_t(EPOLLIN) : 0u;
+    mask |= (events & POLLOUT) ? uint32_t(EPOLLOUT) : 0u;
+    mask |= (events & POLLPRI) ? uint32_t(EPOLLPRI) : 0u;
+    return mask;
+}
+
+short pollEventsFor(uint32_t events) {
+    short mask = 0;
+    mask |= (events & EPOLLIN) ? POLLIN : 0;
+    mask |= (events & EPOLLOUT) ? POLLOUT : 0;
+    mask |= (events & EPOLLPRI) ? POLLPRI : 0;
+    mask |= (events & EPOLLERR) ? POLLERR : 0;
+    mask |= (events & EPOLLHUP) ? POLLHUP : 0;
+    return mask;
+}
+
+// epoll_event.data.ptr of the wake eventfd.
+char wakeMarker;
+
+} // namespace
+
+// Spawned tasks run inside one of these. The loop holds the frame until
+// the task finishes, then it is destroyed and forgotten.
+struct EventLoop::DetachedTask {
+    struct promise_type {
+        EventLoop *loop = nullptr;
+
+        DetachedTask get_return_object() {
+            return {std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        auto final_suspend() noexcept {
+            struct Release {
+                bool await_ready() noexcept { return false; }
+                void await_suspend(std::coroutine_handle<promise_type> finished) noexcept {
+                    finished.promise().loop->detached.erase(finished.address());
+                    finished.destroy();
+                }
+                void await_resume() noexcept {}
+            };
+            return Release{};
+        }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+EventLoop::DetachedTask EventLoop::runDetached(EventLoop &, Task<void> task) {
+    try {
+        co_await std::move(task);
+    } catch (const std::exception &e) {
+        std::cerr << "Task failed: " << e.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Task failed." << std::endl;
+    }
+}
+
+EventLoop::EventLoop() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epollFd < 0 || wakeFd < 0) {
+        throw std::runtime_error(std::string("event loop: ") + std::strerror(errno));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = &wakeMarker;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+}
+
+// Unfinished tasks are destroyed; their awaiters unregister as they go.
+EventLoop::~EventLoop() {
+    {
+        std::lock_guard<std::mutex> lock(blockingMutex);
+        blockingStopping = true;
+        blockingJobs.clear();
+    }
+    blockingWake.notify_one();
+    if (blockingWorker.joinable()) {
+        blockingWorker.join();
+    }
+    posted.clear();
+
+    std::unordered_set<void *> remaining;
+    remaining.swap(detached);
+    for (void *frame : remaining) {
+        std::coroutine_handle<>::from_address(frame).destroy();
+    }
+    close(wakeFd);
+    close(epollFd);
+}
+
+void EventLoop::spawn(Task<void> task) {
+    DetachedTask wrapper = runDetached(*this, std::move(task));
+    wrapper.handle.promise().loop = this;
+    detached.insert(wrapper.handle.address());
+    post([frame = wrapper.handle.address()] { std::coroutine_handle<>::from_address(frame).resume(); });
+}
+
+void EventLoop::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(postedMutex);
+        posted.push_back(std::move(fn));
+    }
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;  // EAGAIN only when a wake-up is already pending
+}
+
+void EventLoop::stop() {
+    stopRequested = true;
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+void EventLoop::run() {
+    stopRequested = false;
+    epoll_event events[64];
+    while (!stopRequested) {
+        runPosted();
+        fireTimers();
+        if (stopRequested || detached.empty()) {
+            break;
+        }
+
+        int count = epoll_wait(epollFd, events, 64, nextTimeoutMs());
+        if (count < 0 && errno != EINTR) {
+            std::cerr << "epoll_wait: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        // Everything ready in this batch is unregistered before any of it
+        // resumes, so a resumed coroutine cannot see a stale event.
+        std::vector<PollAwaiter *> woken;
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.ptr == &wakeMarker) {
+                uint64_t value;
+                while (read(wakeFd, &value, sizeof(value)) > 0) {
+                }
+                continue;
+            }
+            auto *registration = static_cast<PollAwaiter::Registration *>(events[i].data.ptr);
+            PollAwaiter *awaiter = registration->owner;
+            if (awaiter->descriptors()[registration->index].revents == 0) {
+                ++awaiter->ready;
+            }
+            awaiter->descriptors()[registration->index].revents = pollEventsFor(events[i].events);
+            if (awaiter->ready == 1 && awaiter->suspended) {
+                awaiter->suspended = false;
+                woken.push_back(awaiter);
+            }
+        }
+        for (PollAwaiter *awaiter : woken) {
+            awaiter->cancel();
+        }
+        for (PollAwaiter *awaiter : woken) {
+            awaiter->handle.resume();
+        }
+    }
+}
+
+void EventLoop::runPosted() {
+    std::deque<std::function<void()>> batch;
+    {
+        std::lock_guard<std::mutex> lock(postedMutex);
+        batch.swap(posted);
+    }
+    for (auto &fn : batch) {
+        fn();
+    }
+}
+
+int EventLoop::nextTimeoutMs() {
+    {
+        std::lock_guard<std::mutex> lock(postedMutex);
+        if (!posted.empty()) {
+            return 0;
+        }
+    }
+    if (timers.empty()) {
+        return -1;
+    }
+    uint64_t now = steadyMillis();
+    uint64_t deadline = timers.begin()->first;
+    return deadline <= now ? 0 : static_cast<int>(std::min<uint64_t>(deadline - now, 60000));
+}
+
+void EventLoop::fireTimers() {
+    uint64_t now = steadyMillis();
+    while (!timers.empty() && timers.begin()->first <= now) {
+        PollAwaiter *awaiter = timers.begin()->second;
+        awaiter->suspended = false;
+        awaiter->cancel();
+        awaiter->handle.resume();
+    }
+}
+
+void EventLoop::runBlocking(std::function<void()> job) {
+    std::lock_guard<std::mutex> lock(blockingMutex);
+    if (!blockingWorker.joinable()) {
+        blockingWorker = std::thread(&EventLoop::blockingWorkerLoop, this);
+    }
+    blockingJobs.push_back(std::move(job));
+    blockingWake.notify_one();
+}
+
+void EventLoop::blockingWorkerLoop() {
+    std::unique_lock<std::mutex> lock(blockingMutex);
+    while (true) {
+        blockingWake.wait(lock, [this] { return blockingStopping || !blockingJobs.empty(); });
+        if (blockingStopping) {
+            return;
+        }
+        std::function<void()> job = std::move(blockingJobs.front());
+        blockingJobs.pop_front();
+        lock.unlock();
+        job();
+        lock.lock();
+    }
+}
+
+EventLoop::PollAwaiter EventLoop::poll(pollfd *fds, size_t count, int timeoutMs) {
+    return PollAwaiter(*this, fds, count, timeoutMs);
+}
+
+EventLoop::PollAwaiter EventLoop::readable(int fd, int timeoutMs) {
+    return PollAwaiter(*this, fd, timeoutMs);
+}
+
+EventLoop::PollAwaiter EventLoop::sleepFor(std::chrono::milliseconds duration) {
+    return PollAwaiter(*this, nullptr, 0, static_cast<int>(std::max<long long>(0, duration.count())));
+}
+
+EventLoop::PollAwaiter::PollAwaiter(EventLoop &loop, pollfd *fds, size_t count, int timeoutMs)
+    : loop(loop), fds(fds), count(count), timeoutMs(timeoutMs) {
+}
+
+EventLoop::PollAwaiter::PollAwaiter(EventLoop &loop, int fd, int timeoutMs)
+    : loop(loop), fds(nullptr), count(1), timeoutMs(timeoutMs), single{fd, POLLIN, 0}, usesSingle(true) {
+}
+
+// Only moved before it is awaited, while nothing points at it yet.
+EventLoop::PollAwaiter::PollAwaiter(PollAwaiter &&other) noexcept
+    : loop(other.loop), fds(other.fds), count(other.count), timeoutMs(other.timeoutMs), single(other.single),
+      usesSingle(other.usesSingle) {
+}
+
+EventLoop::PollAwaiter::~PollAwaiter() {
+    cancel();
+}
+
+pollfd *EventLoop::PollAwaiter::descriptors() {
+    return usesSingle ? &single : fds;
+}
+
+// Descriptors epoll cannot watch (regular files) count as ready at once,
+// as they would for poll(2); bad ones report POLLNVAL.
+bool EventLoop::PollAwaiter::await_suspend(std::coroutine_handle<> awaiting) {
+    handle = awaiting;
+    ready = 0;
+    pollfd *entries = descriptors();
+    registrations.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        entries[i].revents = 0;
+        if (entries[i].fd < 0) {
+            continue;
+        }
+        registrations.push_back({this, i});
+        epoll_event event{};
+        event.events = epollEventsFor(entries[i].events);
+        event.data.ptr = &registrations.back();
+        if (epoll_ctl(loop.epollFd, EPOLL_CTL_ADD, entries[i].fd, &event) < 0) {
+            registrations.pop_back();
+            entries[i].revents = errno == EPERM ? static_cast<short>(entries[i].events & (POLLIN | POLLOUT)) : POLLNVAL;
+            ++ready;
+        }
+    }
+    if (ready > 0) {
+        cancel();
+        return false;
+    }
+    if (timeoutMs >= 0) {
+        timer = loop.timers.emplace(steadyMillis() + static_cast<uint64_t>(timeoutMs), this);
+        hasTimer = true;
+    }
+    suspended = true;
+    return true;
+}
+
+void EventLoop::PollAwaiter::cancel() {
+    pollfd *entries = descriptors();
+    for (const auto &registration : registrations) {
+        epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, entries[registration.index].fd, nullptr);
+    }
+    registrations.clear();
+    if (hasTimer) {
+        loop.timers.erase(timer);
+        hasTimer = false;
+    }
+}
+
+namespace {
+
+struct WhenAllState {
+    size_t remaining;
+    std::coroutine_handle<> parent;
+    std::exception_ptr error;
+};
+
+// Starts at once and frees itself when done; the last one to finish
+// resumes whenAll().
+struct WhenAllStarter {
+    struct promise_type {
+        WhenAllStarter get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+};
+
+WhenAllStarter startOne(Task<void> task, WhenAllState &state) {
+    try {
+        co_await std::move(task);
+    } catch (...) {
+        if (!state.error) {
+            state.error = std::current_exception();
+        }
+    }
+    if (--state.remaining == 0) {
+        state.parent.resume();
+    }
+}
+
+struct WhenAllAwaiter {
+    WhenAllState &state;
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        state.parent = awaiting;
+        return --state.remaining > 0;
+    }
+    void await_resume() const noexcept {}
+};
+
+} // namespace
+
+Task<void> whenAll(std::vector<Task<void>> tasks) {
+    // One extra count, dropped once we are suspended, so tasks that finish
+    // straight away cannot resume us early.
+    WhenAllState state{tasks.size() + 1, nullptr, nullptr};
+    for (auto &task : tasks) {
+        startOne(std::move(task), state);
+    }
+    co_await WhenAllAwaiter{state};
+    if (state.error) {
+        std::rethrow_exception(state.error);
+    }
+}
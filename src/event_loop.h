@@ -0,0 +1,171 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+#include "task.h"
+
+// Single-threaded executor for the sync pipeline: coroutines wait on file
+// descriptors and timers through epoll, so one thread keeps any number of
+// conversions and device syncs in flight and sleeps in epoll_wait() when
+// none of them can make progress.
+//
+// Everything except post() and stop() must be called on the thread that
+// runs the loop (or before run()). A descriptor may be awaited by one
+// coroutine at a time.
+class EventLoop {
+public:
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // Returns once stop() is called or every spawned task has finished.
+    void run();
+    void stop();
+
+    // The loop owns the task from here; it starts on the next iteration.
+    // An exception escaping it is logged and dropped.
+    void spawn(Task<void> task);
+    // Runs fn on the loop thread. Safe from any thread.
+    void post(std::function<void()> fn);
+
+    class PollAwaiter;
+    // co_await poll(fds, count, timeoutMs) behaves like poll(2): fills in
+    // revents and yields the number of ready descriptors, 0 on timeout.
+    // fds must stay valid until the await finishes. A negative timeout
+    // waits indefinitely.
+    PollAwaiter poll(pollfd *fds, size_t count, int timeoutMs);
+    // Yields nonzero when fd is readable (or has hung up) before the timeout.
+    PollAwaiter readable(int fd, int timeoutMs = -1);
+    PollAwaiter sleepFor(std::chrono::milliseconds duration);
+
+    template <typename F>
+    class OffloadAwaiter;
+    // Runs a blocking call (file I/O on regular files, which epoll cannot
+    // wait on) on the loop's helper thread and resumes with its result.
+    template <typename F>
+    OffloadAwaiter<F> offload(F fn) { return OffloadAwaiter<F>(*this, std::move(fn)); }
+
+    class PollAwaiter {
+    public:
+        PollAwaiter(EventLoop &loop, pollfd *fds, size_t count, int timeoutMs);
+        PollAwaiter(EventLoop &loop, int fd, int timeoutMs);
+        PollAwaiter(PollAwaiter &&other) noexcept;
+        ~PollAwaiter();
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> awaiting);
+        int await_resume() const noexcept { return ready; }
+
+    private:
+        friend class EventLoop;
+        struct Registration {
+            PollAwaiter *owner;
+            size_t index;
+        };
+
+        pollfd *descriptors();
+        void cancel();
+
+        EventLoop &loop;
+        pollfd *fds;
+        size_t count;
+        int timeoutMs;
+        pollfd single{-1, 0, 0};  // readable() waits on this instead of a caller array
+        bool usesSingle = false;
+
+        std::coroutine_handle<> handle;
+        std::vector<Registration> registrations;  // One per registered fd, addressed by epoll
+        std::multimap<uint64_t, PollAwaiter *>::iterator timer;
+        bool hasTimer = false;
+        bool suspended = false;
+        int ready = 0;
+    };
+
+    template <typename F>
+    class OffloadAwaiter {
+    public:
+        using Result = std::invoke_result_t<F>;
+
+        OffloadAwaiter(EventLoop &loop, F fn) : loop(loop), fn(std::move(fn)) {}
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> awaiting) {
+            loop.runBlocking([this, awaiting] {
+                try {
+                    if constexpr (std::is_void_v<Result>) {
+                        fn();
+                    } else {
+                        result.emplace(fn());
+                    }
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                loop.post([awaiting] { awaiting.resume(); });
+            });
+        }
+        Result await_resume() {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            if constexpr (!std::is_void_v<Result>) {
+                return std::move(*result);
+            }
+        }
+
+    private:
+        EventLoop &loop;
+        F fn;
+        std::optional<std::conditional_t<std::is_void_v<Result>, bool, Result>> result;
+        std::exception_ptr error;
+    };
+
+private:
+    friend class PollAwaiter;
+    struct DetachedTask;
+    static DetachedTask runDetached(EventLoop &loop, Task<void> task);
+
+    void runPosted();
+    int nextTimeoutMs();
+    void fireTimers();
+    void complete(PollAwaiter *awaiter);
+    void runBlocking(std::function<void()> job);
+    void blockingWorkerLoop();
+
+    int epollFd = -1;
+    int wakeFd = -1;
+    std::multimap<uint64_t, PollAwaiter *> timers;  // Deadline in steady ms
+    std::unordered_set<void *> detached;            // Frames of spawned tasks still running
+    std::atomic<bool> stopRequested{false};
+
+    std::mutex postedMutex;
+    std::deque<std::function<void()>> posted;
+
+    // Helper thread for offload(), started on first use.
+    std::thread blockingWorker;
+    std::mutex blockingMutex;
+    std::condition_variable blockingWake;
+    std::deque<std::function<void()>> blockingJobs;
+    bool blockingStopping = false;
+};
+
+// Awaits every task and yields once all have finished, in any order.
+Task<void> whenAll(std::vector<Task<void>> tasks);
+
+#endif // EVENT_LOOP_H
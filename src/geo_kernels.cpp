@@ -0,0 +1,541 @@
+#include "geo_kernels.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace geo {
+
+namespace {
+
+const double FIXED_SCALE = 1e7;
+// Anything that would round outside [-2^31, 2^31 - 2] becomes NA, as in pgn_schema.
+const double FIXED_LOW = -2147483648.5;
+const double FIXED_HIGH = 2147483646.5;
+const double RADIANS_PER_DEGREE = M_PI / 180.0;
+const double METERS_PER_DEGREE = EARTH_RADIUS_METERS * RADIANS_PER_DEGREE;
+
+void unitVector(double latitude, double longitude, double &x, double &y, double &z) {
+    double phi = latitude * RADIANS_PER_DEGREE;
+    double lambda = longitude * RADIANS_PER_DEGREE;
+    x = std::cos(phi) * std::cos(lambda);
+    y = std::cos(phi) * std::sin(lambda);
+    z = std::sin(phi);
+}
+
+// Scalar reference versions. The SIMD versions below mirror these
+// operation for operation and use them for their tails.
+
+int32_t toFixed(double degrees) {
+    double scaled = degrees * FIXED_SCALE;
+    if (!(scaled > FIXED_LOW && scaled < FIXED_HIGH)) {
+        return FIXED_NA;
+    }
+    int32_t truncated = static_cast<int32_t>(scaled);
+    double fraction = scaled - static_cast<double>(truncated);
+    return truncated + (fraction >= 0.5 ? 1 : 0) - (fraction <= -0.5 ? 1 : 0);
+}
+
+double fromFixed(int32_t fixed, double naValue) {
+    return fixed == FIXED_NA ? naValue : static_cast<double>(fixed) / FIXED_SCALE;
+}
+
+double equirectangular(double refLatitude, double refLongitude, double cosRef, double latitude, double longitude) {
+    double deltaLongitude = longitude - refLongitude;
+    double wrapDown = deltaLongitude > 180.0 ? 360.0 : 0.0;
+    double wrapUp = deltaLongitude < -180.0 ? 360.0 : 0.0;
+    deltaLongitude = (deltaLongitude - wrapDown) + wrapUp;
+    double x = deltaLongitude * cosRef;
+    double y = latitude - refLatitude;
+    return std::sqrt(x * x + y * y) * METERS_PER_DEGREE;
+}
+
+double halfChord(double rx, double ry, double rz, double x, double y, double z) {
+    double dx = x - rx;
+    double dy = y - ry;
+    double dz = z - rz;
+    return std::sqrt((dx * dx + dy * dy) + dz * dz) * 0.5;
+}
+
+bool inBox(double latitude, double longitude, const Box &box) {
+    bool latitudeIn = latitude >= box.minLatitude && latitude <= box.maxLatitude;
+    bool longitudeIn = box.minLongitude <= box.maxLongitude
+                           ? longitude >= box.minLongitude && longitude <= box.maxLongitude
+                           : longitude >= box.minLongitude || longitude <= box.maxLongitude;
+    return latitudeIn && longitudeIn;
+}
+
+void degreesToFixedScalar(const double *degrees, int32_t *fixed, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        fixed[i] = toFixed(degrees[i]);
+    }
+}
+
+void fixedToDegreesScalar(const int32_t *fixed, double *degrees, size_t count, double naValue) {
+    for (size_t i = 0; i < count; ++i) {
+        degrees[i] = fromFixed(fixed[i], naValue);
+    }
+}
+
+void equirectangularScalar(double refLatitude, double refLongitude, double cosRef, const double *latitudes,
+                           const double *longitudes, double *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = equirectangular(refLatitude, refLongitude, cosRef, latitudes[i], longitudes[i]);
+    }
+}
+
+void halfChordScalar(double rx, double ry, double rz, const double *x, const double *y, const double *z,
+                     double *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = halfChord(rx, ry, rz, x[i], y[i], z[i]);
+    }
+}
+
+size_t boundingBoxScalar(const double *latitudes, const double *longitudes, size_t count, const Box &box,
+                         uint8_t *inside) {
+    size_t matches = 0;
+    for (size_t i = 0; i < count; ++i) {
+        inside[i] = inBox(latitudes[i], longitudes[i], box) ? 1 : 0;
+        matches += inside[i];
+    }
+    return matches;
+}
+
+const KernelTable SCALAR_KERNELS = {
+    "scalar", degreesToFixedScalar, fixedToDegreesScalar, equirectangularScalar, halfChordScalar, boundingBoxScalar,
+};
+
+#if defined(__x86_64__)
+
+// SSE2 is part of x86-64, so these need no runtime check.
+
+// Picks the low 32 bits of each 64-bit lane into the low two int32 lanes.
+inline __m128i narrowMask(__m128d mask) {
+    return _mm_shuffle_epi32(_mm_castpd_si128(mask), _MM_SHUFFLE(3, 3, 2, 0));
+}
+
+void degreesToFixedSse2(const double *degrees, int32_t *fixed, size_t count) {
+    const __m128d scale = _mm_set1_pd(FIXED_SCALE);
+    const __m128d low = _mm_set1_pd(FIXED_LOW);
+    const __m128d high = _mm_set1_pd(FIXED_HIGH);
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d minusHalf = _mm_set1_pd(-0.5);
+    const __m128i na = _mm_set1_epi32(FIXED_NA);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d scaled = _mm_mul_pd(_mm_loadu_pd(degrees + i), scale);
+        __m128i valid = narrowMask(_mm_and_pd(_mm_cmpgt_pd(scaled, low), _mm_cmplt_pd(scaled, high)));
+        __m128i truncated = _mm_cvttpd_epi32(scaled);
+        __m128d fraction = _mm_sub_pd(scaled, _mm_cvtepi32_pd(truncated));
+        // Masks are -1 where set: subtracting rounds up, adding rounds down.
+        __m128i result = _mm_sub_epi32(truncated, narrowMask(_mm_cmpge_pd(fraction, half)));
+        result = _mm_add_epi32(result, narrowMask(_mm_cmple_pd(fraction, minusHalf)));
+        result = _mm_or_si128(_mm_and_si128(valid, result), _mm_andnot_si128(valid, na));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(fixed + i), result);
+    }
+    degreesToFixedScalar(degrees + i, fixed + i, count - i);
+}
+
+void fixedToDegreesSse2(const int32_t *fixed, double *degrees, size_t count, double naValue) {
+    const __m128d scale = _mm_set1_pd(FIXED_SCALE);
+    const __m128i na = _mm_set1_epi32(FIXED_NA);
+    const __m128d naValues = _mm_set1_pd(naValue);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i raw = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(fixed + i));
+        __m128d value = _mm_div_pd(_mm_cvtepi32_pd(raw), scale);
+        __m128i isNa32 = _mm_cmpeq_epi32(raw, na);
+        __m128d isNa = _mm_castsi128_pd(_mm_unpacklo_epi32(isNa32, isNa32));
+        value = _mm_or_pd(_mm_and_pd(isNa, naValues), _mm_andnot_pd(isNa, value));
+        _mm_storeu_pd(degrees + i, value);
+    }
+    fixedToDegreesScalar(fixed + i, degrees + i, count - i, naValue);
+}
+
+void equirectangularSse2(double refLatitude, double refLongitude, double cosRef, const double *latitudes,
+                         const double *longitudes, double *out, size_t count) {
+    const __m128d refLat = _mm_set1_pd(refLatitude);
+    const __m128d refLon = _mm_set1_pd(refLongitude);
+    const __m128d cosines = _mm_set1_pd(cosRef);
+    const __m128d wrap = _mm_set1_pd(360.0);
+    const __m128d east = _mm_set1_pd(180.0);
+    const __m128d west = _mm_set1_pd(-180.0);
+    const __m128d metres = _mm_set1_pd(METERS_PER_DEGREE);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d deltaLongitude = _mm_sub_pd(_mm_loadu_pd(longitudes + i), refLon);
+        __m128d wrapDown = _mm_and_pd(_mm_cmpgt_pd(deltaLongitude, east), wrap);
+        __m128d wrapUp = _mm_and_pd(_mm_cmplt_pd(deltaLongitude, west), wrap);
+        deltaLongitude = _mm_add_pd(_mm_sub_pd(deltaLongitude, wrapDown), wrapUp);
+        __m128d x = _mm_mul_pd(deltaLongitude, cosines);
+        __m128d y = _mm_sub_pd(_mm_loadu_pd(latitudes + i), refLat);
+        __m128d distance = _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)));
+        _mm_storeu_pd(out + i, _mm_mul_pd(distance, metres));
+    }
+    equirectangularScalar(refLatitude, refLongitude, cosRef, latitudes + i, longitudes + i, out + i, count - i);
+}
+
+void halfChordSse2(double rx, double ry, double rz, const double *x, const double *y, const double *z,
+                   double *out, size_t count) {
+    const __m128d refX = _mm_set1_pd(rx);
+    const __m128d refY = _mm_set1_pd(ry);
+    const __m128d refZ = _mm_set1_pd(rz);
+    const __m128d half = _mm_set1_pd(0.5);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d dx = _mm_sub_pd(_mm_loadu_pd(x + i), refX);
+        __m128d dy = _mm_sub_pd(_mm_loadu_pd(y + i), refY);
+        __m128d dz = _mm_sub_pd(_mm_loadu_pd(z + i), refZ);
+        __m128d sum = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_sqrt_pd(sum), half));
+    }
+    halfChordScalar(rx, ry, rz, x + i, y + i, z + i, out + i, count - i);
+}
+
+size_t boundingBoxSse2(const double *latitudes, const double *longitudes, size_t count, const Box &box,
+                       uint8_t *inside) {
+    const __m128d minLat = _mm_set1_pd(box.minLatitude);
+    const __m128d maxLat = _mm_set1_pd(box.maxLatitude);
+    const __m128d minLon = _mm_set1_pd(box.minLongitude);
+    const __m128d maxLon = _mm_set1_pd(box.maxLongitude);
+    const bool wraps = box.minLongitude > box.maxLongitude;
+
+    size_t matches = 0;
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128d latitude = _mm_loadu_pd(latitudes + i);
+        __m128d longitude = _mm_loadu_pd(longitudes + i);
+        __m128d latitudeIn = _mm_and_pd(_mm_cmpge_pd(latitude, minLat), _mm_cmple_pd(latitude, maxLat));
+        __m128d east = _mm_cmpge_pd(longitude, minLon);
+        __m128d west = _mm_cmple_pd(longitude, maxLon);
+        __m128d longitudeIn = wraps ? _mm_or_pd(east, west) : _mm_and_pd(east, west);
+        int bits = _mm_movemask_pd(_mm_and_pd(latitudeIn, longitudeIn));
+        inside[i] = bits & 1;
+        inside[i + 1] = (bits >> 1) & 1;
+        matches += inside[i] + inside[i + 1];
+    }
+    return matches + boundingBoxScalar(latitudes + i, longitudes + i, count - i, box, inside + i);
+}
+
+const KernelTable SSE2_KERNELS = {
+    "sse2", degreesToFixedSse2, fixedToDegreesSse2, equirectangularSse2, halfChordSse2, boundingBoxSse2,
+};
+
+// AVX2 versions, compiled for AVX2 only here and picked at runtime.
+
+__attribute__((target("avx2"))) inline __m128i narrowMask256(__m256d mask) {
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    return _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(_mm256_castpd_si256(mask), pack));
+}
+
+__attribute__((target("avx2"))) void degreesToFixedAvx2(const double *degrees, int32_t *fixed, size_t count) {
+    const __m256d scale = _mm256_set1_pd(FIXED_SCALE);
+    const __m256d low = _mm256_set1_pd(FIXED_LOW);
+    const __m256d high = _mm256_set1_pd(FIXED_HIGH);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d minusHalf = _mm256_set1_pd(-0.5);
+    const __m128i na = _mm_set1_epi32(FIXED_NA);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d scaled = _mm256_mul_pd(_mm256_loadu_pd(degrees + i), scale);
+        __m256d valid = _mm256_and_pd(_mm256_cmp_pd(scaled, low, _CMP_GT_OQ), _mm256_cmp_pd(scaled, high, _CMP_LT_OQ));
+        __m128i truncated = _mm256_cvttpd_epi32(scaled);
+        __m256d fraction = _mm256_sub_pd(scaled, _mm256_cvtepi32_pd(truncated));
+        __m128i result = _mm_sub_epi32(truncated, narrowMask256(_mm256_cmp_pd(fraction, half, _CMP_GE_OQ)));
+        result = _mm_add_epi32(result, narrowMask256(_mm256_cmp_pd(fraction, minusHalf, _CMP_LE_OQ)));
+        result = _mm_blendv_epi8(na, result, narrowMask256(valid));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(fixed + i), result);
+    }
+    degreesToFixedScalar(degrees + i, fixed + i, count - i);
+}
+
+__attribute__((target("avx2"))) void fixedToDegreesAvx2(const int32_t *fixed, double *degrees, size_t count, double naValue) {
+    const __m256d scale = _mm256_set1_pd(FIXED_SCALE);
+    const __m128i na = _mm_set1_epi32(FIXED_NA);
+    const __m256d naValues = _mm256_set1_pd(naValue);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(fixed + i));
+        __m256d value = _mm256_div_pd(_mm256_cvtepi32_pd(raw), scale);
+        __m256d isNa = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm_cmpeq_epi32(raw, na)));
+        _mm256_storeu_pd(degrees + i, _mm256_blendv_pd(value, naValues, isNa));
+    }
+    fixedToDegreesScalar(fixed + i, degrees + i, count - i, naValue);
+}
+
+__attribute__((target("avx2"))) void equirectangularAvx2(double refLatitude, double refLongitude, double cosRef,
+                                                          const double *latitudes, const double *longitudes,
+                                                          double *out, size_t count) {
+    const __m256d refLat = _mm256_set1_pd(refLatitude);
+    const __m256d refLon = _mm256_set1_pd(refLongitude);
+    const __m256d cosines = _mm256_set1_pd(cosRef);
+    const __m256d wrap = _mm256_set1_pd(360.0);
+    const __m256d east = _mm256_set1_pd(180.0);
+    const __m256d west = _mm256_set1_pd(-180.0);
+    const __m256d metres = _mm256_set1_pd(METERS_PER_DEGREE);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d deltaLongitude = _mm256_sub_pd(_mm256_loadu_pd(longitudes + i), refLon);
+        __m256d wrapDown = _mm256_and_pd(_mm256_cmp_pd(deltaLongitude, east, _CMP_GT_OQ), wrap);
+        __m256d wrapUp = _mm256_and_pd(_mm256_cmp_pd(deltaLongitude, west, _CMP_LT_OQ), wrap);
+        deltaLongitude = _mm256_add_pd(_mm256_sub_pd(deltaLongitude, wrapDown), wrapUp);
+        __m256d x = _mm256_mul_pd(deltaLongitude, cosines);
+        __m256d y = _mm256_sub_pd(_mm256_loadu_pd(latitudes + i), refLat);
+        __m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(distance, metres));
+    }
+    equirectangularScalar(refLatitude, refLongitude, cosRef, latitudes + i, longitudes + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) void halfChordAvx2(double rx, double ry, double rz, const double *x, const double *y,
+                                                    const double *z, double *out, size_t count) {
+    const __m256d refX = _mm256_set1_pd(rx);
+    const __m256d refY = _mm256_set1_pd(ry);
+    const __m256d refZ = _mm256_set1_pd(rz);
+    const __m256d half = _mm256_set1_pd(0.5);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(x + i), refX);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(y + i), refY);
+        __m256d dz = _mm256_sub_pd(_mm256_loadu_pd(z + i), refZ);
+        __m256d sum = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_sqrt_pd(sum), half));
+    }
+    halfChordScalar(rx, ry, rz, x + i, y + i, z + i, out + i, count - i);
+}
+
+__attribute__((target("avx2"))) size_t boundingBoxAvx2(const double *latitudes, const double *longitudes, size_t count,
+                                                        const Box &box, uint8_t *inside) {
+    const __m256d minLat = _mm256_set1_pd(box.minLatitude);
+    const __m256d maxLat = _mm256_set1_pd(box.maxLatitude);
+    const __m256d minLon = _mm256_set1_pd(box.minLongitude);
+    const __m256d maxLon = _mm256_set1_pd(box.maxLongitude);
+    const bool wraps = box.minLongitude > box.maxLongitude;
+
+    size_t matches = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256d latitude = _mm256_loadu_pd(latitudes + i);
+        __m256d longitude = _mm256_loadu_pd(longitudes + i);
+        __m256d latitudeIn = _mm256_and_pd(_mm256_cmp_pd(latitude, minLat, _CMP_GE_OQ), _mm256_cmp_pd(latitude, maxLat, _CMP_LE_OQ));
+        __m256d east = _mm256_cmp_pd(longitude, minLon, _CMP_GE_OQ);
+        __m256d west = _mm256_cmp_pd(longitude, maxLon, _CMP_LE_OQ);
+        __m256d longitudeIn = wraps ? _mm256_or_pd(east, west) : _mm256_and_pd(east, west);
+        int bits = _mm256_movemask_pd(_mm256_and_pd(latitudeIn, longitudeIn));
+        for (int lane = 0; lane < 4; ++lane) {
+            inside[i + lane] = (bits >> lane) & 1;
+        }
+        matches += __builtin_popcount(bits);
+    }
+    return matches + boundingBoxScalar(latitudes + i, longitudes + i, count - i, box, inside + i);
+}
+
+const KernelTable AVX2_KERNELS = {
+    "avx2", degreesToFixedAvx2, fixedToDegreesAvx2, equirectangularAvx2, halfChordAvx2, boundingBoxAvx2,
+};
+
+#elif defined(__aarch64__)
+
+// NEON is mandatory on aarch64 (Pi 3/4/5 running a 64-bit OS).
+
+inline float64x2_t maskedConstant(uint64x2_t mask, float64x2_t value) {
+    return vreinterpretq_f64_u64(vandq_u64(mask, vreinterpretq_u64_f64(value)));
+}
+
+void degreesToFixedNeon(const double *degrees, int32_t *fixed, size_t count) {
+    const float64x2_t scale = vdupq_n_f64(FIXED_SCALE);
+    const float64x2_t low = vdupq_n_f64(FIXED_LOW);
+    const float64x2_t high = vdupq_n_f64(FIXED_HIGH);
+    const float64x2_t half = vdupq_n_f64(0.5);
+    const float64x2_t minusHalf = vdupq_n_f64(-0.5);
+    const int64x2_t na = vdupq_n_s64(FIXED_NA);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        float64x2_t scaled = vmulq_f64(vld1q_f64(degrees + i), scale);
+        uint64x2_t valid = vandq_u64(vcgtq_f64(scaled, low), vcltq_f64(scaled, high));
+        int64x2_t truncated = vcvtq_s64_f64(scaled);
+        float64x2_t fraction = vsubq_f64(scaled, vcvtq_f64_s64(truncated));
+        int64x2_t result = vsubq_s64(truncated, vreinterpretq_s64_u64(vcgeq_f64(fraction, half)));
+        result = vaddq_s64(result, vreinterpretq_s64_u64(vcleq_f64(fraction, minusHalf)));
+        result = vbslq_s64(valid, result, na);
+        vst1_s32(fixed + i, vmovn_s64(result));
+    }
+    degreesToFixedScalar(degrees + i, fixed + i, count - i);
+}
+
+void fixedToDegreesNeon(const int32_t *fixed, double *degrees, size_t count, double naValue) {
+    const float64x2_t scale = vdupq_n_f64(FIXED_SCALE);
+    const int64x2_t na = vdupq_n_s64(FIXED_NA);
+    const float64x2_t naValues = vdupq_n_f64(naValue);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        int64x2_t raw = vmovl_s32(vld1_s32(fixed + i));
+        float64x2_t value = vdivq_f64(vcvtq_f64_s64(raw), scale);
+        vst1q_f64(degrees + i, vbslq_f64(vceqq_s64(raw, na), naValues, value));
+    }
+    fixedToDegreesScalar(fixed + i, degrees + i, count - i, naValue);
+}
+
+void equirectangularNeon(double refLatitude, double refLongitude, double cosRef, const double *latitudes,
+                         const double *longitudes, double *out, size_t count) {
+    const float64x2_t refLat = vdupq_n_f64(refLatitude);
+    const float64x2_t refLon = vdupq_n_f64(refLongitude);
+    const float64x2_t cosines = vdupq_n_f64(cosRef);
+    const float64x2_t wrap = vdupq_n_f64(360.0);
+    const float64x2_t east = vdupq_n_f64(180.0);
+    const float64x2_t west = vdupq_n_f64(-180.0);
+    const float64x2_t metres = vdupq_n_f64(METERS_PER_DEGREE);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        float64x2_t deltaLongitude = vsubq_f64(vld1q_f64(longitudes + i), refLon);
+        float64x2_t wrapDown = maskedConstant(vcgtq_f64(deltaLongitude, east), wrap);
+        float64x2_t wrapUp = maskedConstant(vcltq_f64(deltaLongitude, west), wrap);
+        deltaLongitude = vaddq_f64(vsubq_f64(deltaLongitude, wrapDown), wrapUp);
+        float64x2_t x = vmulq_f64(deltaLongitude, cosines);
+        float64x2_t y = vsubq_f64(vld1q_f64(latitudes + i), refLat);
+        float64x2_t distance = vsqrtq_f64(vaddq_f64(vmulq_f64(x, x), vmulq_f64(y, y)));
+        vst1q_f64(out + i, vmulq_f64(distance, metres));
+    }
+    equirectangularScalar(refLatitude, refLongitude, cosRef, latitudes + i, longitudes + i, out + i, count - i);
+}
+
+void halfChordNeon(double rx, double ry, double rz, const double *x, const double *y, const double *z,
+                   double *out, size_t count) {
+    const float64x2_t refX = vdupq_n_f64(rx);
+    const float64x2_t refY = vdupq_n_f64(ry);
+    const float64x2_t refZ = vdupq_n_f64(rz);
+    const float64x2_t half = vdupq_n_f64(0.5);
+
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        float64x2_t dx = vsubq_f64(vld1q_f64(x + i), refX);
+        float64x2_t dy = vsubq_f64(vld1q_f64(y + i), refY);
+        float64x2_t dz = vsubq_f64(vld1q_f64(z + i), refZ);
+        float64x2_t sum = vaddq_f64(vaddq_f64(vmulq_f64(dx, dx), vmulq_f64(dy, dy)), vmulq_f64(dz, dz));
+        vst1q_f64(out + i, vmulq_f64(vsqrtq_f64(sum), half));
+    }
+    halfChordScalar(rx, ry, rz, x + i, y + i, z + i, out + i, count - i);
+}
+
+size_t boundingBoxNeon(const double *latitudes, const double *longitudes, size_t count, const Box &box,
+                       uint8_t *inside) {
+    const float64x2_t minLat = vdupq_n_f64(box.minLatitude);
+    const float64x2_t maxLat = vdupq_n_f64(box.maxLatitude);
+    const float64x2_t minLon = vdupq_n_f64(box.minLongitude);
+    const float64x2_t maxLon = vdupq_n_f64(box.maxLongitude);
+    const bool wraps = box.minLongitude > box.maxLongitude;
+
+    size_t matches = 0;
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        float64x2_t latitude = vld1q_f64(latitudes + i);
+        float64x2_t longitude = vld1q_f64(longitudes + i);
+        uint64x2_t latitudeIn = vandq_u64(vcgeq_f64(latitude, minLat), vcleq_f64(latitude, maxLat));
+        uint64x2_t east = vcgeq_f64(longitude, minLon);
+        uint64x2_t west = vcleq_f64(longitude, maxLon);
+        uint64x2_t both = vandq_u64(latitudeIn, wraps ? vorrq_u64(east, west) : vandq_u64(east, west));
+        inside[i] = vgetq_lane_u64(both, 0) ? 1 : 0;
+        inside[i + 1] = vgetq_lane_u64(both, 1) ? 1 : 0;
+        matches += inside[i] + inside[i + 1];
+    }
+    return matches + boundingBoxScalar(latitudes + i, longitudes + i, count - i, box, inside + i);
+}
+
+const KernelTable NEON_KERNELS = {
+    "neon", degreesToFixedNeon, fixedToDegreesNeon, equirectangularNeon, halfChordNeon, boundingBoxNeon,
+};
+
+#endif
+
+const KernelTable &selectKernels() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return AVX2_KERNELS;
+    }
+    return SSE2_KERNELS;
+#elif defined(__aarch64__)
+    return NEON_KERNELS;
+#else
+    return SCALAR_KERNELS;
+#endif
+}
+
+} // namespace
+
+const KernelTable &kernels() {
+    static const KernelTable &selected = selectKernels();
+    return selected;
+}
+
+const KernelTable &scalarKernels() {
+    return SCALAR_KERNELS;
+}
+
+std::vector<const KernelTable *> supportedKernels() {
+    std::vector<const KernelTable *> tables{&SCALAR_KERNELS};
+#if defined(__x86_64__)
+    tables.push_back(&SSE2_KERNELS);
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        tables.push_back(&AVX2_KERNELS);
+    }
+#elif defined(__aarch64__)
+    tables.push_back(&NEON_KERNELS);
+#endif
+    return tables;
+}
+
+void UnitVectors::assign(const double *latitudes, const double *longitudes, size_t count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        unitVector(latitudes[i], longitudes[i], x[i], y[i], z[i]);
+    }
+}
+
+void degreesToFixed(const double *degrees, int32_t *fixed, size_t count) {
+    kernels().degreesToFixed(degrees, fixed, count);
+}
+
+void fixedToDegrees(const int32_t *fixed, double *degrees, size_t count, double naValue) {
+    kernels().fixedToDegrees(fixed, degrees, count, naValue);
+}
+
+void equirectangularDistances(double refLatitude, double refLongitude, const double *latitudes,
+                              const double *longitudes, size_t count, double *meters) {
+    double cosRef = std::cos(refLatitude * RADIANS_PER_DEGREE);
+    kernels().equirectangular(refLatitude, refLongitude, cosRef, latitudes, longitudes, meters, count);
+}
+
+void haversineDistances(double refLatitude, double refLongitude, const UnitVectors &points, double *meters) {
+    double rx, ry, rz;
+    unitVector(refLatitude, refLongitude, rx, ry, rz);
+    kernels().halfChord(rx, ry, rz, points.x.data(), points.y.data(), points.z.data(), meters, points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        meters[i] = 2.0 * EARTH_RADIUS_METERS * std::asin(std::min(1.0, meters[i]));
+    }
+}
+
+size_t boundingBoxFilter(const double *latitudes, const double *longitudes, size_t count, const Box &box,
+                         uint8_t *inside) {
+    return kernels().boundingBox(latitudes, longitudes, count, box, inside);
+}
+
+} // namespace geo
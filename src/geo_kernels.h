@@ -0,0 +1,74 @@
+#ifndef GEO_KERNELS_H
+#define GEO_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Batch coordinate math over columnar lat/lon arrays.
+//
+// Each kernel has a scalar version and SSE2/AVX2 (x86-64) or NEON
+// (aarch64) versions; the best one the CPU supports is picked on first
+// use. Every version does the same IEEE operations in the same order
+// (this file is built with -ffp-contract=off), so results match the
+// scalar version bit for bit. Transcendentals are never vectorised:
+// haversine computes the half-chord in SIMD and finishes with std::asin
+// per lane.
+namespace geo {
+
+const double EARTH_RADIUS_METERS = 6371008.8;
+const int32_t FIXED_NA = 0x7fffffff;  // NMEA 2000 "not available" for 4-byte signed fields
+
+// Inclusive box; minLongitude > maxLongitude means it spans the antimeridian.
+struct Box {
+    double minLatitude;
+    double maxLatitude;
+    double minLongitude;
+    double maxLongitude;
+};
+
+// Points as unit vectors on the sphere, precomputed once (scalar trig) so
+// repeated distance queries are pure arithmetic.
+struct UnitVectors {
+    std::vector<double> x, y, z;
+
+    void assign(const double *latitudes, const double *longitudes, size_t count);
+    size_t size() const { return x.size(); }
+};
+
+struct KernelTable {
+    const char *name;
+    void (*degreesToFixed)(const double *degrees, int32_t *fixed, size_t count);
+    void (*fixedToDegrees)(const int32_t *fixed, double *degrees, size_t count, double naValue);
+    void (*equirectangular)(double refLatitude, double refLongitude, double cosRef, const double *latitudes,
+                            const double *longitudes, double *out, size_t count);
+    void (*halfChord)(double rx, double ry, double rz, const double *x, const double *y, const double *z,
+                      double *out, size_t count);
+    size_t (*boundingBox)(const double *latitudes, const double *longitudes, size_t count, const Box &box,
+                          uint8_t *inside);
+};
+
+const KernelTable &kernels();
+const KernelTable &scalarKernels();
+// Every implementation this CPU can run, scalar first. For tests and benchmarks.
+std::vector<const KernelTable *> supportedKernels();
+
+// Degrees to 1e-7 fixed point, rounding half away from zero like the PGN
+// encoder. NaN and out-of-range values become FIXED_NA.
+void degreesToFixed(const double *degrees, int32_t *fixed, size_t count);
+void fixedToDegrees(const int32_t *fixed, double *degrees, size_t count, double naValue);
+
+// Flat-earth distance in metres, projected around the reference point.
+// Good to well under 0.1% within a few tens of kilometres.
+void equirectangularDistances(double refLatitude, double refLongitude, const double *latitudes,
+                              const double *longitudes, size_t count, double *meters);
+// Great-circle distance in metres from the reference to each point.
+void haversineDistances(double refLatitude, double refLongitude, const UnitVectors &points, double *meters);
+
+// Sets inside[i] to 1 for points in the box, 0 otherwise; returns the count.
+size_t boundingBoxFilter(const double *latitudes, const double *longitudes, size_t count, const Box &box,
+                         uint8_t *inside);
+
+} // namespace geo
+
+#endif // GEO_KERNELS_H
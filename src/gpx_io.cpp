@@ -0,0 +1,412 @@
+#include "gpx_io.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+static std::string decodeEntities(const std::string &text) {
+    static const std::pair<const char *, char> entities[] = {
+        {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        bool replaced = false;
+        if (text[i] == '&') {
+            for (const auto &[entity, character] : entities) {
+                size_t length = std::char_traits<char>::length(entity);
+                if (text.compare(i, length, entity) == 0) {
+                    result += character;
+                    i += length - 1;
+                    replaced = true;
+                    break;
+                }
+            }
+        }
+        if (!replaced) {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+static std::string encodeEntities(const std::string &text) {
+    std::string result;
+    result.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '&': result += "&amp;"; break;
+            case '<': result += "&lt;"; break;
+            case '>': result += "&gt;"; break;
+            case '"': result += "&quot;"; break;
+            case '\'': result += "&apos;"; break;
+            default: result += c;
+        }
+    }
+    return result;
+}
+
+static bool readAttribute(const std::string &tag, const char *name, double &value) {
+    std::string key = std::string(" ") + name + "=";
+    size_t position = tag.find(key);
+    if (position == std::string::npos || position + key.size() >= tag.size()) {
+        return false;
+    }
+    char quote = tag[position + key.size()];
+    if (quote != '"' && quote != '\'') {
+        return false;
+    }
+    size_t start = position + key.size() + 1;
+    size_t end = tag.find(quote, start);
+    if (end == std::string::npos) {
+        return false;
+    }
+    std::string text = tag.substr(start, end - start);
+    char *parsedEnd = nullptr;
+    value = std::strtod(text.c_str(), &parsedEnd);
+    return parsedEnd != text.c_str();
+}
+
+bool parseGpx(const std::string &xml, WaypointCollection &collection) {
+    std::vector<std::string> openTags;
+    Waypoint point;
+    bool inPoint = false;
+    Route *route = nullptr;
+    size_t position = 0;
+
+    while ((position = xml.find('<', position)) != std::string::npos) {
+        if (xml.compare(position, 4, "<!--") == 0) {
+            size_t end = xml.find("-->", position);
+            position = end == std::string::npos ? xml.size() : end + 3;
+            continue;
+        }
+        size_t end = xml.find('>', position);
+        if (end == std::string::npos) {
+            std::cerr << "GPX parse error: unterminated tag" << std::endl;
+            return false;
+        }
+
+        std::string tag = xml.substr(position + 1, end - position - 1);
+        position = end + 1;
+        if (tag.empty() || tag[0] == '?' || tag[0] == '!') {
+            continue;
+        }
+
+        bool closing = tag[0] == '/';
+        bool selfClosing = tag.back() == '/';
+        size_t nameEnd = tag.find_first_of(" \t\r\n/", closing ? 1 : 0);
+        std::string name = tag.substr(closing ? 1 : 0, nameEnd == std::string::npos ? std::string::npos : nameEnd - (closing ? 1 : 0));
+
+        if (closing) {
+            if ((name == "wpt" || name == "rtept") && inPoint) {
+                uint32_t index = collection.add(point);
+                if (name == "rtept" && route) {
+                    route->legs.push_back(index);
+                }
+                inPoint = false;
+            } else if (name == "rte") {
+                route = nullptr;
+            }
+            if (!openTags.empty()) {
+                openTags.pop_back();
+            }
+            continue;
+        }
+
+        if (name == "wpt" || (name == "rtept" && route)) {
+            point = Waypoint();
+            inPoint = readAttribute(tag, "lat", point.latitude) && readAttribute(tag, "lon", point.longitude);
+            if (selfClosing && inPoint) {
+                uint32_t index = collection.add(point);
+                if (name == "rtept") {
+                    route->legs.push_back(index);
+                }
+                inPoint = false;
+            }
+        } else if (name == "rte") {
+            route = &collection.addRoute("");
+        } else if ((name == "name" || name == "sym") && !selfClosing && !openTags.empty()) {
+            size_t textEnd = xml.find('<', position);
+            std::string text = decodeEntities(xml.substr(position, textEnd - position));
+            const std::string &parent = openTags.back();
+            if (inPoint && (parent == "wpt" || parent == "rtept")) {
+                (name == "name" ? point.name : point.symbol) = text;
+            } else if (route && parent == "rte" && name == "name") {
+                route->name = text;
+            }
+        }
+
+        if (!selfClosing) {
+            openTags.push_back(name);
+        }
+    }
+    return true;
+}
+
+bool readGpxFile(const std::string &path, WaypointCollection &collection) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error opening GPX file " << path << std::endl;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return parseGpx(contents.str(), collection);
+}
+
+static void formatPoint(std::string &out, const char *tag, const Waypoint &waypoint, const char *indent) {
+    char position[96];
+    std::snprintf(position, sizeof(position), "%s<%s lat=\"%.9f\" lon=\"%.9f\">", indent, tag, waypoint.latitude, waypoint.longitude);
+    out += position;
+    out += "<name>" + encodeEntities(waypoint.name) + "</name>";
+    if (!waypoint.symbol.empty()) {
+        out += "<sym>" + encodeEntities(waypoint.symbol) + "</sym>";
+    }
+    out += "</";
+    out += tag;
+    out += ">\n";
+}
+
+std::string formatGpx(const WaypointCollection &collection) {
+    std::string out =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<gpx version=\"1.1\" creator=\"Waypoint Sync\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n";
+
+    for (const auto &waypoint : collection.waypoints()) {
+        formatPoint(out, "wpt", waypoint, "  ");
+    }
+    for (const auto &route : collection.routes()) {
+        out += "  <rte>\n    <name>" + encodeEntities(route.name) + "</name>\n";
+        for (uint32_t leg : route.legs) {
+            formatPoint(out, "rtept", collection.at(leg), "    ");
+        }
+        out += "  </rte>\n";
+    }
+    out += "</gpx>\n";
+    return out;
+}
+
+bool writeGpxFile(const std::string &path, const WaypointCollection &collection) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error writing GPX file " << path << std::endl;
+        return false;
+    }
+    file << formatGpx(collection);
+    return file.good();
+}
+
+// "2024-05-01T12:34:56Z"; fractional seconds and offsets other than Z are ignored.
+static int64_t parseGpxTime(const std::string &text) {
+    std::tm time{};
+    if (std::sscanf(text.c_str(), "%d-%d-%dT%d:%d:%d", &time.tm_year, &time.tm_mon, &time.tm_mday,
+                    &time.tm_hour, &time.tm_min, &time.tm_sec) != 6) {
+        return 0;
+    }
+    time.tm_year -= 1900;
+    time.tm_mon -= 1;
+    return static_cast<int64_t>(timegm(&time));
+}
+
+// A tag with no closing '>' this long means we are not reading GPX.
+const size_t GPX_MAX_TAG_LENGTH = 64 * 1024;
+
+bool GpxTrackReader::feed(const char *data, size_t size) {
+    if (failed) {
+        return false;
+    }
+    buffer.append(data, size);
+    return parseBuffered();
+}
+
+bool GpxTrackReader::finish() {
+    if (failed) {
+        return false;
+    }
+    if (inTrack) {
+        handleTag("/trk");
+    }
+    buffer.clear();
+    position = 0;
+    return true;
+}
+
+bool GpxTrackReader::parseBuffered() {
+    while (true) {
+        size_t open = buffer.find('<', position);
+        if (open == std::string::npos) {
+            break;
+        }
+        size_t available = buffer.size() - open;
+        if (available < 4 && buffer.compare(open, available, "<!--", available) == 0) {
+            break;  // Might be the start of a comment
+        }
+        if (buffer.compare(open, 4, "<!--") == 0) {
+            size_t end = buffer.find("-->", open);
+            if (end == std::string::npos) {
+                break;
+            }
+            position = end + 3;
+            continue;
+        }
+        size_t close = buffer.find('>', open);
+        if (close == std::string::npos) {
+            if (buffer.size() - open > GPX_MAX_TAG_LENGTH) {
+                std::cerr << "GPX parse error: unterminated tag" << std::endl;
+                failed = true;
+                return false;
+            }
+            break;
+        }
+
+        if (!textTag.empty()) {
+            std::string text = decodeEntities(buffer.substr(textStart, open - textStart));
+            if (textTag == "name" && inTrack && !inPoint) {
+                trackName = text;
+            } else if (textTag == "ele" && inPoint) {
+                point.elevation = std::strtod(text.c_str(), nullptr);
+            } else if (textTag == "time" && inPoint) {
+                point.time = parseGpxTime(text);
+            }
+            textTag.clear();
+        }
+
+        handleTag(buffer.substr(open + 1, close - open - 1));
+        position = close + 1;
+        textStart = position;
+    }
+
+    // Drop what has been consumed; keep only the partial tag or text.
+    size_t keepFrom = std::min(position, textTag.empty() ? position : textStart);
+    if (keepFrom > 0) {
+        buffer.erase(0, keepFrom);
+        position -= keepFrom;
+        textStart -= std::min(textStart, keepFrom);
+    }
+    return true;
+}
+
+void GpxTrackReader::handleTag(const std::string &tag) {
+    if (tag.empty() || tag[0] == '?' || tag[0] == '!') {
+        return;
+    }
+
+    bool closing = tag[0] == '/';
+    bool selfClosing = tag.back() == '/';
+    size_t nameEnd = tag.find_first_of(" \t\r\n/", closing ? 1 : 0);
+    std::string name = tag.substr(closing ? 1 : 0, nameEnd == std::string::npos ? std::string::npos : nameEnd - (closing ? 1 : 0));
+
+    auto startTrack = [this] {
+        if (!trackStarted) {
+            sink.beginTrack(trackName);
+            trackStarted = true;
+        }
+    };
+    auto emitPoint = [this, &startTrack] {
+        startTrack();
+        sink.addPoint(point);
+        inPoint = false;
+    };
+
+    if (closing) {
+        if (name == "trkpt" && inPoint) {
+            emitPoint();
+        } else if (name == "trkseg" && inSegment) {
+            sink.endSegment();
+            inSegment = false;
+        } else if (name == "trk" && inTrack) {
+            if (inSegment) {
+                sink.endSegment();
+                inSegment = false;
+            }
+            if (trackStarted) {
+                sink.endTrack();
+            }
+            inTrack = false;
+        }
+        return;
+    }
+
+    if (name == "trk") {
+        inTrack = true;
+        trackStarted = false;
+        trackName.clear();
+    } else if (name == "trkseg" && inTrack) {
+        startTrack();
+        inSegment = !selfClosing;
+    } else if (name == "trkpt" && inSegment) {
+        point = TrackPoint();
+        inPoint = readAttribute(tag, "lat", point.latitude) && readAttribute(tag, "lon", point.longitude);
+        if (selfClosing && inPoint) {
+            emitPoint();
+        }
+    } else if ((name == "name" || name == "ele" || name == "time") && !selfClosing && inTrack) {
+        textTag = name;
+    }
+}
+
+bool readGpxTracks(std::istream &input, TrackSink &sink) {
+    GpxTrackReader reader(sink);
+    char chunk[64 * 1024];
+    while (input.read(chunk, sizeof(chunk)) || input.gcount() > 0) {
+        if (!reader.feed(chunk, static_cast<size_t>(input.gcount()))) {
+            return false;
+        }
+    }
+    return reader.finish();
+}
+
+bool readGpxTrackFile(const std::string &path, TrackSink &sink) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening GPX file " << path << std::endl;
+        return false;
+    }
+    return readGpxTracks(file, sink);
+}
+
+void writeGpxTracks(std::ostream &out, const std::vector<Track> &tracks) {
+    out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<gpx version=\"1.1\" creator=\"Waypoint Sync\" xmlns=\"http://www.topografix.com/GPX/1/1\">\n";
+
+    char line[160];
+    for (const auto &track : tracks) {
+        out << "  <trk>\n    <name>" << encodeEntities(track.name) << "</name>\n";
+        for (const auto &segment : track.segments) {
+            out << "    <trkseg>\n";
+            for (const auto &trackPoint : segment) {
+                std::snprintf(line, sizeof(line), "      <trkpt lat=\"%.9f\" lon=\"%.9f\">", trackPoint.latitude, trackPoint.longitude);
+                out << line;
+                if (!std::isnan(trackPoint.elevation)) {
+                    std::snprintf(line, sizeof(line), "<ele>%.2f</ele>", trackPoint.elevation);
+                    out << line;
+                }
+                if (trackPoint.time != 0) {
+                    std::time_t seconds = static_cast<std::time_t>(trackPoint.time);
+                    std::tm utc{};
+                    gmtime_r(&seconds, &utc);
+                    std::strftime(line, sizeof(line), "<time>%Y-%m-%dT%H:%M:%SZ</time>", &utc);
+                    out << line;
+                }
+                out << "</trkpt>\n";
+            }
+            out << "    </trkseg>\n";
+        }
+        out << "  </trk>\n";
+    }
+    out << "</gpx>\n";
+}
+
+bool writeGpxTrackFile(const std::string &path, const std::vector<Track> &tracks) {
+    std::ofstream file(path, std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error writing GPX file " << path << std::endl;
+        return false;
+    }
+    writeGpxTracks(file, tracks);
+    return file.good();
+}
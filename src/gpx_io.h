@@ -0,0 +1,54 @@
+#ifndef GPX_IO_H
+#define GPX_IO_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "route.h"
+#include "track.h"
+
+// Minimal GPX 1.1 reader/writer for waypoints and routes. Route points are
+// folded into the collection's shared waypoints so a point used by a
+// standalone <wpt> and a <rtept> is stored once.
+bool parseGpx(const std::string &xml, WaypointCollection &collection);
+bool readGpxFile(const std::string &path, WaypointCollection &collection);
+
+std::string formatGpx(const WaypointCollection &collection);
+bool writeGpxFile(const std::string &path, const WaypointCollection &collection);
+
+// Push parser for <trk> data: feed() it chunks of any size and it hands
+// each <trkpt> to the sink as soon as it is complete. Only the unparsed
+// tail of the input is buffered.
+class GpxTrackReader {
+public:
+    explicit GpxTrackReader(TrackSink &sink) : sink(sink) {}
+
+    bool feed(const char *data, size_t size);
+    bool finish();
+
+private:
+    bool parseBuffered();
+    void handleTag(const std::string &tag);
+
+    TrackSink &sink;
+    std::string buffer;
+    size_t position = 0;
+    size_t textStart = 0;
+    bool inTrack = false;
+    bool trackStarted = false;
+    bool inSegment = false;
+    bool inPoint = false;
+    std::string trackName;
+    std::string textTag;  // name/ele/time whose text we are collecting
+    TrackPoint point;
+    bool failed = false;
+};
+
+bool readGpxTracks(std::istream &input, TrackSink &sink);
+bool readGpxTrackFile(const std::string &path, TrackSink &sink);
+
+void writeGpxTracks(std::ostream &out, const std::vector<Track> &tracks);
+bool writeGpxTrackFile(const std::string &path, const std::vector<Track> &tracks);
+
+#endif // GPX_IO_H
@@ -0,0 +1,318 @@
+#include "library_publisher.h"
+#include "geo_kernels.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace shared_library;
+
+namespace {
+
+const uint32_t initialRecordCapacity = 1024;
+const uint32_t initialStringCapacity = 64 * 1024;
+const int subscribeTimeoutMs = 1000;
+
+BufferHeader *bufferAt(SegmentHeader *header, uint32_t index) {
+    return reinterpret_cast<BufferHeader *>(reinterpret_cast<char *>(header) + header->bufferOffset[index]);
+}
+
+uint16_t clampedLength(const std::string &text) {
+    return static_cast<uint16_t>(std::min<size_t>(text.size(), UINT16_MAX));
+}
+
+} // namespace
+
+LibraryPublisher::LibraryPublisher(const std::string &shmName, const std::string &socketPath)
+    : shmName(shmName), socketPath(socketPath) {
+}
+
+LibraryPublisher::~LibraryPublisher() {
+    stop();
+}
+
+bool LibraryPublisher::start() {
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        if (header) {
+            return true;
+        }
+        if (!createSegment(initialRecordCapacity, initialStringCapacity)) {
+            return false;
+        }
+        markReady();
+    }
+    if (!socketPath.empty() && !startListening()) {
+        std::cerr << "Library export has no change notification." << std::endl;
+    }
+    std::cout << "Exporting waypoint library in shared memory " << shmName << std::endl;
+    return true;
+}
+
+void LibraryPublisher::stop() {
+    if (acceptThread.joinable()) {
+        eventfd_write(stopFd, 1);
+        acceptThread.join();
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+        if (socketPath[0] != '@') {
+            unlink(socketPath.c_str());
+        }
+    }
+    if (stopFd >= 0) {
+        close(stopFd);
+        stopFd = -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(subscribersMutex);
+        for (const Subscriber &subscriber : subscribers) {
+            close(subscriber.connectionFd);
+            close(subscriber.eventFd);
+        }
+        subscribers.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(publishMutex);
+    if (header) {
+        releaseSegment();
+        shm_unlink(shmName.c_str());
+    }
+}
+
+// Readers still mapping the old segment see it retired and reopen by name.
+void LibraryPublisher::releaseSegment() {
+    header->retired.store(1, std::memory_order_release);
+    munmap(header, mappedBytes);
+    header = nullptr;
+    mappedBytes = 0;
+}
+
+bool LibraryPublisher::createSegment(uint32_t recordCapacity, uint32_t stringCapacity) {
+    if (header) {
+        releaseSegment();
+    }
+    // Also clears a segment left behind by a daemon that crashed.
+    shm_unlink(shmName.c_str());
+
+    int fd = shm_open(shmName.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create shared memory " << shmName << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    size_t bytes = segmentBytes(recordCapacity, stringCapacity);
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, bytes) == 0) {
+        mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << shmName << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(shmName.c_str());
+        return false;
+    }
+
+    // A fresh segment is zero filled: both buffers hold an empty set at
+    // revision 0.
+    header = static_cast<SegmentHeader *>(mapping);
+    mappedBytes = bytes;
+    header->layoutVersion = LAYOUT_VERSION;
+    header->segmentBytes = bytes;
+    header->recordCapacity = recordCapacity;
+    header->stringCapacity = stringCapacity;
+    size_t firstBuffer = bytes - 2 * bufferBytes(recordCapacity, stringCapacity);
+    header->bufferOffset[0] = firstBuffer;
+    header->bufferOffset[1] = firstBuffer + bufferBytes(recordCapacity, stringCapacity);
+    return true;
+}
+
+// Everything a reader looks at, the active buffer included, has to be
+// written before this.
+void LibraryPublisher::markReady() {
+    __atomic_store_n(&header->magic, MAGIC, __ATOMIC_RELEASE);
+}
+
+// The odd sequence while filling tells readers still in the buffer from
+// two publishes ago to retry.
+void LibraryPublisher::fillBuffer(uint32_t index, const Waypoint *waypoints, const int32_t *fixed, size_t count,
+                                  uint64_t revision) {
+    BufferHeader *buffer = bufferAt(header, index);
+    uint64_t sequence = buffer->sequence.load(std::memory_order_relaxed);
+    buffer->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto *records = reinterpret_cast<Record *>(buffer + 1);
+    char *strings = reinterpret_cast<char *>(records + header->recordCapacity);
+    uint32_t offset = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const Waypoint &waypoint = waypoints[i];
+        Record &record = records[i];
+        record.latitude = fixed[2 * i];
+        record.longitude = fixed[2 * i + 1];
+        record.nameOffset = offset;
+        record.nameLength = clampedLength(waypoint.name);
+        std::memcpy(strings + offset, waypoint.name.data(), record.nameLength);
+        offset += record.nameLength;
+        record.symbolOffset = offset;
+        record.symbolLength = clampedLength(waypoint.symbol);
+        std::memcpy(strings + offset, waypoint.symbol.data(), record.symbolLength);
+        offset += record.symbolLength;
+        record.id = waypoint.id;
+        record.source = waypoint.source;
+        record.reserved = 0;
+    }
+    buffer->revision = revision;
+    buffer->count = static_cast<uint32_t>(count);
+    buffer->stringBytes = offset;
+    buffer->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool LibraryPublisher::publish(const Waypoint *waypoints, size_t count, uint64_t revision) {
+    size_t stringBytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        stringBytes += clampedLength(waypoints[i].name) + clampedLength(waypoints[i].symbol);
+    }
+    if (count > UINT32_MAX / 2 || stringBytes > UINT32_MAX / 2) {
+        return false;
+    }
+
+    std::vector<double> degrees(count * 2);
+    for (size_t i = 0; i < count; ++i) {
+        degrees[2 * i] = waypoints[i].latitude;
+        degrees[2 * i + 1] = waypoints[i].longitude;
+    }
+    std::vector<int32_t> fixed(degrees.size());
+    geo::degreesToFixed(degrees.data(), fixed.data(), degrees.size());
+
+    {
+        std::lock_guard<std::mutex> lock(publishMutex);
+        if (!header) {
+            return false;
+        }
+        // A bigger segment is filled and stamped before readers can attach
+        // to it, so none of them sees it empty at an old revision.
+        if (count > header->recordCapacity || stringBytes > header->stringCapacity) {
+            uint32_t records = std::max<uint32_t>(header->recordCapacity, static_cast<uint32_t>(count * 2));
+            uint32_t strings = std::max<uint32_t>(header->stringCapacity, static_cast<uint32_t>(stringBytes * 2));
+            if (!createSegment(records, strings)) {
+                return false;
+            }
+            fillBuffer(0, waypoints, fixed.data(), count, revision);
+            header->revision.store(revision, std::memory_order_relaxed);
+            markReady();
+        } else {
+            // Fill the buffer nobody is being pointed at, then flip to it.
+            uint32_t target = 1 - header->active.load(std::memory_order_relaxed);
+            fillBuffer(target, waypoints, fixed.data(), count, revision);
+            header->active.store(target, std::memory_order_release);
+            header->revision.store(revision, std::memory_order_release);
+        }
+    }
+    notifySubscribers();
+    return true;
+}
+
+bool LibraryPublisher::startListening() {
+    sockaddr_un address;
+    socklen_t length;
+    if (!socketAddress(socketPath, address, length)) {
+        std::cerr << "Invalid library socket path " << socketPath << std::endl;
+        return false;
+    }
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (listenFd < 0 || stopFd < 0) {
+        std::cerr << "Failed to create library socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (socketPath[0] != '@') {
+        unlink(socketPath.c_str());
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&address), length) < 0 || listen(listenFd, 8) < 0) {
+        std::cerr << "Failed to listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    acceptThread = std::thread(&LibraryPublisher::acceptLoop, this);
+    return true;
+}
+
+void LibraryPublisher::acceptLoop() {
+    while (true) {
+        std::vector<pollfd> entries{{stopFd, POLLIN, 0}, {listenFd, POLLIN, 0}};
+        {
+            std::lock_guard<std::mutex> lock(subscribersMutex);
+            for (const Subscriber &subscriber : subscribers) {
+                entries.push_back({subscriber.connectionFd, POLLIN, 0});
+            }
+        }
+        if (poll(entries.data(), entries.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Library socket poll failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        if (entries[0].revents) {
+            return;
+        }
+        if (entries[1].revents & POLLIN) {
+            int connectionFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (connectionFd >= 0) {
+                addSubscriber(connectionFd);
+            }
+        }
+
+        // Subscribers never write after the handshake, so anything readable
+        // on their connection is a hangup.
+        std::lock_guard<std::mutex> lock(subscribersMutex);
+        for (size_t i = 2; i < entries.size(); ++i) {
+            if (!entries[i].revents) {
+                continue;
+            }
+            auto gone = std::find_if(subscribers.begin(), subscribers.end(), [&](const Subscriber &subscriber) {
+                return subscriber.connectionFd == entries[i].fd;
+            });
+            if (gone != subscribers.end()) {
+                close(gone->connectionFd);
+                close(gone->eventFd);
+                subscribers.erase(gone);
+            }
+        }
+    }
+}
+
+void LibraryPublisher::addSubscriber(int connectionFd) {
+    pollfd entry{connectionFd, POLLIN, 0};
+    int eventFd = -1;
+    if (poll(&entry, 1, subscribeTimeoutMs) > 0) {
+        eventFd = receiveDescriptor(connectionFd);
+    }
+    if (eventFd < 0) {
+        close(connectionFd);
+        return;
+    }
+    // Signalled once straight away so a new reader loads the current set.
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    subscribers.push_back({connectionFd, eventFd});
+    eventfd_write(eventFd, 1);
+}
+
+void LibraryPublisher::notifySubscribers() {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    for (const Subscriber &subscriber : subscribers) {
+        eventfd_write(subscriber.eventFd, 1);
+    }
+}
+
+size_t LibraryPublisher::subscriberCount() const {
+    std::lock_guard<std::mutex> lock(subscribersMutex);
+    return subscribers.size();
+}
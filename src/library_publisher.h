@@ -0,0 +1,71 @@
+#ifndef LIBRARY_PUBLISHER_H
+#define LIBRARY_PUBLISHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shared_library.h"
+#include "waypoint.h"
+
+// Writing side of the shared-memory export (see shared_library.h). Owns
+// the segment and the notification socket; a small thread accepts
+// subscribers and drops them when they disconnect.
+class LibraryPublisher {
+public:
+    LibraryPublisher(const std::string &shmName = shared_library::DEFAULT_SHM_NAME,
+                     const std::string &socketPath = shared_library::DEFAULT_SOCKET_PATH);
+    ~LibraryPublisher();
+    LibraryPublisher(const LibraryPublisher &) = delete;
+    LibraryPublisher &operator=(const LibraryPublisher &) = delete;
+
+    // Creates the segment (holding an empty set) and starts listening. An
+    // empty socket path exports without notification.
+    bool start();
+    // Removes the segment and the socket; mapped readers see it retired.
+    void stop();
+    bool isRunning() const { return header != nullptr; }
+
+    // Replaces the exported set and signals every subscriber. Readers of
+    // the previous set keep reading it undisturbed.
+    bool publish(const Waypoint *waypoints, size_t count, uint64_t revision);
+    bool publish(const std::vector<Waypoint> &waypoints, uint64_t revision) {
+        return publish(waypoints.data(), waypoints.size(), revision);
+    }
+
+    size_t subscriberCount() const;
+
+private:
+    struct Subscriber {
+        int connectionFd;
+        int eventFd;
+    };
+
+    // Maps a new segment; readers cannot attach until markReady().
+    bool createSegment(uint32_t recordCapacity, uint32_t stringCapacity);
+    void markReady();
+    void fillBuffer(uint32_t index, const Waypoint *waypoints, const int32_t *fixed, size_t count,
+                    uint64_t revision);
+    void releaseSegment();
+    bool startListening();
+    void acceptLoop();
+    void addSubscriber(int connectionFd);
+    void notifySubscribers();
+
+    std::string shmName;
+    std::string socketPath;
+
+    std::mutex publishMutex;
+    shared_library::SegmentHeader *header = nullptr;
+    size_t mappedBytes = 0;
+
+    int listenFd = -1;
+    int stopFd = -1;
+    std::thread acceptThread;
+    mutable std::mutex subscribersMutex;
+    std::vector<Subscriber> subscribers;
+};
+
+#endif // LIBRARY_PUBLISHER_H
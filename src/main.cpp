@@ -1,11 +1,15 @@
 #include "nmea_waypoint_handler.h"
 #include "sync_manager.h"
+#include "config.h"
 #include <wiringPi.h>
 #include <unordered_map>
 #include <iostream>
-#include <chrono>
-#include <thread>
 #include <csignal>
+#include <memory>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include "event_loop.h"
 
 
 // GPIO pin numbers based on WiringPi numbering
@@ -26,6 +30,23 @@ void cleanup() {
     delay(500);         // Delay to ensure LEDs are visually turned off before the program ends
 }
 
+// SIGHUP reloads the config. It is blocked and read from a signalfd, so
+// the reload runs on the event loop thread like every other change.
+Task<void> watchReloadSignal(EventLoop &loop, SyncManager &syncManager, int signalFd) {
+    if (signalFd < 0) {
+        std::cerr << "Failed to watch SIGHUP; config reload on signal disabled" << std::endl;
+        co_return;
+    }
+    while (true) {
+        co_await loop.readable(signalFd);
+        signalfd_siginfo info;
+        while (read(signalFd, &info, sizeof(info)) == static_cast<ssize_t>(sizeof(info))) {
+        }
+        // Off the loop thread, like the reload on a config file change.
+        co_await loop.offload([&syncManager] { syncManager.reloadConfig(); });
+    }
+}
+
 // Signal handler for SIGINT (CTRL+C)
 void handleSignal(int signal) {
     std::cout << " Signal received: " << signal << std::endl;
@@ -36,11 +57,17 @@ void handleSignal(int signal) {
     std::raise(signal);
 }
 
-int main() {
-    // Register the signal handlers for SIGINT (CTRL+C), SIGTERM, and SIGHUP
+int main(int argc, char* argv[]) {
+    // SIGINT (CTRL+C) and SIGTERM shut down; SIGHUP reloads the config
     std::signal(SIGINT, handleSignal);
     std::signal(SIGTERM, handleSignal);
-    std::signal(SIGHUP, handleSignal);
+    // Before any thread starts, so every thread inherits the mask
+    sigset_t reloadSignals;
+    sigemptyset(&reloadSignals);
+    sigaddset(&reloadSignals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &reloadSignals, nullptr);
+
+    std::string configPath = argc > 1 ? argv[1] : DEFAULT_CONFIG_PATH;
 
     // Initialize WiringPi
     if (wiringPiSetup() == -1) {
@@ -58,33 +85,27 @@ int main() {
     std::cout << "Turning on Power LED" << std::endl;
     digitalWrite(POWER_LED_PIN, HIGH);
 
+    int reloadFd = -1;
     try {
-        // Initialize SyncManager and load format mappings
-        SyncManager syncManager;
+        // Declared first so it outlives the tasks SyncManager hands it
+        EventLoop loop;
 
-        // Load format mappings from JSON
-        syncManager.loadFormatMappings();
+        // Initialize SyncManager from the config snapshot (format mappings included)
+        SyncManager syncManager(std::make_shared<ConfigStore>(configPath));
 
-        // Initialize inotify and add watches
+        // Initialize inotify and add watches; this also starts the buses
         syncManager.initialize();
 
-        // Sync the waypoints on boot using loaded format mappings
-        syncManager.syncWaypointsOnBoot();
+        reloadFd = signalfd(-1, &reloadSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+        loop.spawn(watchReloadSignal(loop, syncManager, reloadFd));
 
-        syncManager.getNmeaHandler()->start();
-
-        // Monitor for real-time data changes, including inotify events and polling
-        while (true) {
-            // Turn on the listening LED to indicate the system is monitoring for changes
-            std::cout << "Listening LED ON during checkForChanges()" << std::endl;
-            digitalWrite(LISTENING_LED_PIN, HIGH);
-            syncManager.checkForChanges();
-
-            std::this_thread::sleep_for(std::chrono::seconds(2));
-
-            // Turn off the listening LED to indicate the system is not monitoring for changes
-            digitalWrite(LISTENING_LED_PIN, LOW);
-        }
+        // Sync the waypoints on boot, then monitor for changes (inotify events
+        // and polling); the thread sleeps in the event loop between them
+        std::cout << "Listening LED ON while watching for changes" << std::endl;
+        digitalWrite(LISTENING_LED_PIN, HIGH);
+        loop.spawn(syncManager.watchForChanges(loop));
+        loop.run();
+        digitalWrite(LISTENING_LED_PIN, LOW);
     } catch (std::exception& e) {
         // If an exception is thrown, turn the Error LED on to indicate a failure.
         std::cerr << "An exception occurred: " << e.what() << std::endl;
@@ -95,6 +116,9 @@ int main() {
     }
 
     // Cleanup before exiting
+    if (reloadFd >= 0) {
+        close(reloadFd);
+    }
     cleanup();
 
     return 0;
@@ -0,0 +1,330 @@
+#include "media_monitor.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+std::vector<VendorLayout> defaultVendorLayouts() {
+    return {
+        {"Garmin", "Garmin/GPX", ".gpx", "gpx"},
+        {"Garmin", "Garmin/GPX/Archive", ".gpx", "gpx"},
+        {"Lowrance", "", ".usr", "lowranceusr"},
+        {"Lowrance", "", ".gpx", "gpx"},
+        {"Lowrance", "Lowrance", ".usr", "lowranceusr"},
+        {"Humminbird", "", ".hwr", "humminbird"},
+        {"Humminbird", "ExportedData", ".hwr", "humminbird"},
+        {"Raymarine", "Raymarine/Waypoints", ".gpx", "gpx"},
+        {"Raymarine", "Raymarine/Waypoints", ".rwf", "raymarine"},
+    };
+}
+
+namespace {
+
+std::string unescapeMountField(const std::string &field) {
+    std::string result;
+    result.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] == '\\' && i + 3 < field.size() && std::isdigit(static_cast<unsigned char>(field[i + 1]))) {
+            result.push_back(static_cast<char>(std::stoi(field.substr(i + 1, 3), nullptr, 8)));
+            i += 3;
+        } else {
+            result.push_back(field[i]);
+        }
+    }
+    return result;
+}
+
+std::string lowercase(std::string text) {
+    for (char &c : text) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return text;
+}
+
+bool hasPathPrefix(const std::string &path, const std::string &prefix) {
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           (path.size() == prefix.size() || path[prefix.size()] == '/' || prefix.back() == '/');
+}
+
+} // namespace
+
+// Format: id parent major:minor root mountpoint options [optional...] - fstype source superoptions
+std::vector<MountEntry> parseMountInfo(const std::string &text) {
+    std::vector<MountEntry> mounts;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        std::vector<std::string> parts;
+        std::string field;
+        while (fields >> field) {
+            parts.push_back(field);
+        }
+
+        auto separator = std::find(parts.begin(), parts.end(), "-");
+        if (parts.size() < 5 || separator == parts.end() || parts.end() - separator < 3) {
+            continue;
+        }
+        MountEntry mount;
+        mount.mountPoint = unescapeMountField(parts[4]);
+        mount.fsType = *(separator + 1);
+        mount.source = unescapeMountField(*(separator + 2));
+        mounts.push_back(mount);
+    }
+    return mounts;
+}
+
+std::vector<MountEntry> addedMounts(const std::vector<MountEntry> &previous, const std::vector<MountEntry> &current) {
+    std::vector<MountEntry> added;
+    for (const auto &mount : current) {
+        bool known = std::any_of(previous.begin(), previous.end(), [&mount](const MountEntry &other) {
+            return other.mountPoint == mount.mountPoint && other.source == mount.source;
+        });
+        if (!known) {
+            added.push_back(mount);
+        }
+    }
+    return added;
+}
+
+std::vector<MediaFile> scanMount(const std::string &mountPoint, const std::vector<VendorLayout> &layouts) {
+    std::vector<MediaFile> files;
+    for (const auto &layout : layouts) {
+        fs::path directory = layout.directory.empty() ? fs::path(mountPoint) : fs::path(mountPoint) / layout.directory;
+        std::error_code error;
+        if (!fs::is_directory(directory, error)) {
+            continue;
+        }
+
+        for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+            if (!it->is_regular_file(error) || lowercase(it->path().extension().string()) != layout.extension) {
+                continue;
+            }
+            std::string path = it->path().string();
+            bool seen = std::any_of(files.begin(), files.end(), [&path](const MediaFile &file) { return file.path == path; });
+            if (!seen) {
+                files.push_back({path, layout.format, layout.vendor});
+            }
+        }
+    }
+    return files;
+}
+
+MediaMonitor::MediaMonitor(ImportCallback importFile, MediaMonitorOptions options)
+    : importFile(std::move(importFile)), options(std::move(options)) {
+}
+
+MediaMonitor::~MediaMonitor() {
+    stop();
+}
+
+bool MediaMonitor::start() {
+    if (running) {
+        return true;
+    }
+
+    mountInfoFd = open(options.mountInfoPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (mountInfoFd < 0) {
+        std::cerr << "Cannot open " << options.mountInfoPath << ", removable media will not be detected." << std::endl;
+        return false;
+    }
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (options.useNetlink) {
+        netlinkFd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+        sockaddr_nl address{};
+        address.nl_family = AF_NETLINK;
+        address.nl_groups = 1;  // Kernel uevents
+        if (netlinkFd >= 0 && bind(netlinkFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+            // Common in containers; mountinfo alone still works.
+            close(netlinkFd);
+            netlinkFd = -1;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        running = true;
+        initialScanPending = true;
+    }
+    for (size_t i = 0; i < std::max<size_t>(1, options.importWorkers); ++i) {
+        workers.emplace_back(&MediaMonitor::workerLoop, this);
+    }
+    monitorThread = std::thread(&MediaMonitor::monitorLoop, this);
+    return true;
+}
+
+// Cleared under queueMutex so neither the workers nor a monitor thread
+// waiting on a full queue can miss it.
+void MediaMonitor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (!running.exchange(false)) {
+            return;
+        }
+        initialScanPending = false;
+    }
+    queueChanged.notify_all();
+
+    uint64_t one = 1;
+    if (wakeFd >= 0 && write(wakeFd, &one, sizeof(one)) < 0) {
+        std::cerr << "Failed to wake media monitor." << std::endl;
+    }
+    if (monitorThread.joinable()) {
+        monitorThread.join();
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    for (int *fd : {&mountInfoFd, &netlinkFd, &wakeFd}) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+bool MediaMonitor::isRemovable(const MountEntry &mount) const {
+    bool removableFs = std::find(options.fsTypes.begin(), options.fsTypes.end(), mount.fsType) != options.fsTypes.end();
+    bool underPrefix = std::any_of(options.mountPrefixes.begin(), options.mountPrefixes.end(),
+                                   [&mount](const std::string &prefix) { return hasPathPrefix(mount.mountPoint, prefix); });
+    return removableFs && underPrefix;
+}
+
+void MediaMonitor::refresh() {
+    std::ifstream file(options.mountInfoPath);
+    std::stringstream text;
+    text << file.rdbuf();
+    std::vector<MountEntry> current = parseMountInfo(text.str());
+
+    std::lock_guard<std::mutex> lock(mountsMutex);
+    for (const auto &mount : knownMounts) {
+        bool stillMounted = std::any_of(current.begin(), current.end(), [&mount](const MountEntry &other) {
+            return other.mountPoint == mount.mountPoint && other.source == mount.source;
+        });
+        if (!stillMounted && isRemovable(mount)) {
+            std::cout << "Media removed: " << mount.mountPoint << std::endl;
+            dropPendingUnder(mount.mountPoint);
+        }
+    }
+
+    for (const auto &mount : addedMounts(knownMounts, current)) {
+        if (!isRemovable(mount)) {
+            continue;
+        }
+        std::vector<MediaFile> files = scanMount(mount.mountPoint, options.layouts);
+        std::cout << "Media mounted: " << mount.source << " at " << mount.mountPoint << ", "
+                  << files.size() << " waypoint files found." << std::endl;
+        for (const auto &file : files) {
+            queueImport(file);
+        }
+    }
+    knownMounts = std::move(current);
+}
+
+void MediaMonitor::monitorLoop() {
+    // Cards inserted before we started count as new. Scanned here so a
+    // slow card or a full queue never holds up start().
+    refresh();
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        initialScanPending = false;
+    }
+    queueChanged.notify_all();
+
+    while (running) {
+        pollfd fds[3] = {
+            {wakeFd, POLLIN, 0},
+            {mountInfoFd, POLLPRI, 0},
+            {netlinkFd, POLLIN, 0},
+        };
+        int ready = poll(fds, netlinkFd >= 0 ? 3 : 2, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Media monitor poll failed." << std::endl;
+            return;
+        }
+        if (!running || (fds[0].revents & POLLIN)) {
+            return;
+        }
+        if (fds[2].revents & POLLIN) {
+            drainNetlink();
+        }
+        if ((fds[1].revents & (POLLPRI | POLLERR)) || (fds[2].revents & POLLIN)) {
+            refresh();
+        }
+    }
+}
+
+// Uevents only tell us a device changed; the mount table says what to import.
+void MediaMonitor::drainNetlink() {
+    char buffer[4096];
+    while (recv(netlinkFd, buffer, sizeof(buffer), 0) > 0) {
+    }
+}
+
+// Blocks the monitor thread while the queue is full rather than dropping
+// files; the workers bound how much I/O runs at once.
+void MediaMonitor::queueImport(const MediaFile &file) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    queueChanged.wait(lock, [this] { return !running || pendingImports.size() < options.maxPendingImports; });
+    if (!running) {
+        return;
+    }
+    pendingImports.push_back(file);
+    queueChanged.notify_all();
+}
+
+void MediaMonitor::dropPendingUnder(const std::string &mountPoint) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    pendingImports.erase(std::remove_if(pendingImports.begin(), pendingImports.end(),
+                                        [&mountPoint](const MediaFile &file) { return hasPathPrefix(file.path, mountPoint); }),
+                         pendingImports.end());
+    queueChanged.notify_all();
+}
+
+void MediaMonitor::workerLoop() {
+    while (true) {
+        MediaFile file;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueChanged.wait(lock, [this] { return !running || !pendingImports.empty(); });
+            if (!running) {
+                return;
+            }
+            file = std::move(pendingImports.front());
+            pendingImports.pop_front();
+            ++activeImports;
+            queueChanged.notify_all();
+        }
+
+        bool imported = importFile(file);
+        (imported ? importedFiles : failedImports)++;
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        --activeImports;
+        queueChanged.notify_all();
+    }
+}
+
+bool MediaMonitor::waitIdle(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    return queueChanged.wait_for(lock, timeout, [this] {
+        return !initialScanPending && pendingImports.empty() && activeImports == 0;
+    });
+}
@@ -0,0 +1,111 @@
+#ifndef MEDIA_MONITOR_H
+#define MEDIA_MONITOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct MountEntry {
+    std::string source;
+    std::string mountPoint;
+    std::string fsType;
+};
+
+// Where a vendor's plotters put exported waypoint files on a card,
+// relative to the card's root ("" is the root itself).
+struct VendorLayout {
+    std::string vendor;
+    std::string directory;
+    std::string extension;  // Including the dot, matched case-insensitively
+    std::string format;     // gpsbabel input format
+};
+
+struct MediaFile {
+    std::string path;
+    std::string format;
+    std::string vendor;
+};
+
+std::vector<VendorLayout> defaultVendorLayouts();
+
+// Parses /proc/self/mountinfo, unescaping octal sequences like \040.
+std::vector<MountEntry> parseMountInfo(const std::string &text);
+// Mounts in current that were not in previous, by mount point and source.
+std::vector<MountEntry> addedMounts(const std::vector<MountEntry> &previous, const std::vector<MountEntry> &current);
+// Lists waypoint files in the known layout folders only, never the whole card.
+std::vector<MediaFile> scanMount(const std::string &mountPoint, const std::vector<VendorLayout> &layouts);
+
+struct MediaMonitorOptions {
+    std::string mountInfoPath = "/proc/self/mountinfo";
+    std::vector<std::string> mountPrefixes{"/media", "/mnt", "/run/media"};
+    std::vector<std::string> fsTypes{"vfat", "exfat", "ntfs", "ntfs3", "fuseblk", "hfsplus"};
+    std::vector<VendorLayout> layouts = defaultVendorLayouts();
+    size_t importWorkers = 2;
+    size_t maxPendingImports = 256;
+    bool useNetlink = true;
+};
+
+// Watches for removable media being mounted and imports the waypoint
+// files on it in the background.
+//
+// The kernel flags /proc/self/mountinfo with POLLPRI whenever the mount
+// table changes; a netlink uevent socket additionally catches block
+// devices appearing. Either wakes the monitor thread, which diffs the
+// mount table and queues files from new removable mounts for a small
+// pool of import workers, so a slow card never stalls the bus or the
+// main loop.
+class MediaMonitor {
+public:
+    using ImportCallback = std::function<bool(const MediaFile &)>;
+
+    explicit MediaMonitor(ImportCallback importFile, MediaMonitorOptions options = MediaMonitorOptions());
+    ~MediaMonitor();
+
+    bool start();
+    void stop();
+    bool isRunning() const { return running; }
+
+    // Re-reads the mount table now; called by the monitor thread on events.
+    void refresh();
+    bool isRemovable(const MountEntry &mount) const;
+
+    size_t getImportedFiles() const { return importedFiles; }
+    size_t getFailedImports() const { return failedImports; }
+    // True once the initial scan is done and nothing is queued or being
+    // imported.
+    bool waitIdle(std::chrono::milliseconds timeout);
+
+private:
+    void monitorLoop();
+    void workerLoop();
+    void queueImport(const MediaFile &file);
+    void dropPendingUnder(const std::string &mountPoint);
+    void drainNetlink();
+
+    ImportCallback importFile;
+    MediaMonitorOptions options;
+
+    std::atomic<bool> running{false};
+    int mountInfoFd = -1;
+    int netlinkFd = -1;
+    int wakeFd = -1;
+    std::thread monitorThread;
+    std::mutex mountsMutex;  // Serializes refresh() between the test/main thread and the monitor
+    std::vector<MountEntry> knownMounts;
+
+    std::vector<std::thread> workers;
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<MediaFile> pendingImports;
+    size_t activeImports = 0;
+    bool initialScanPending = false;  // Until the monitor thread's first refresh()
+    std::atomic<size_t> importedFiles{0};
+    std::atomic<size_t> failedImports{0};
+};
+
+#endif // MEDIA_MONITOR_H
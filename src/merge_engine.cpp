@@ -0,0 +1,358 @@
+#include "merge_engine.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+
+VersionVector::VersionVector(const VersionVector &other) : VersionVector() {
+    assign(other.begin(), other.size);
+}
+
+VersionVector::VersionVector(VersionVector &&other) noexcept : size(other.size), single(other.single) {
+    other.size = 0;
+}
+
+VersionVector &VersionVector::operator=(const VersionVector &other) {
+    if (this != &other) {
+        assign(other.begin(), other.size);
+    }
+    return *this;
+}
+
+VersionVector &VersionVector::operator=(VersionVector &&other) noexcept {
+    if (this != &other) {
+        release();
+        size = other.size;
+        single = other.single;
+        other.size = 0;
+    }
+    return *this;
+}
+
+VersionVector::~VersionVector() {
+    release();
+}
+
+void VersionVector::release() {
+    if (size > 1) {
+        delete[] counters;
+    }
+    size = 0;
+}
+
+void VersionVector::assign(const Counter *first, size_t count) {
+    if (count <= 1) {
+        Counter copy = count == 1 ? *first : Counter{0, 0};
+        release();
+        single = copy;
+    } else {
+        Counter *copy = new Counter[count];
+        std::copy(first, first + count, copy);
+        release();
+        counters = copy;
+    }
+    size = static_cast<uint32_t>(count);
+}
+
+uint64_t VersionVector::get(SourceId source) const {
+    auto it = std::lower_bound(begin(), end(), source,
+                               [](const Counter &counter, SourceId value) { return counter.source < value; });
+    return it != end() && it->source == source ? it->count : 0;
+}
+
+void VersionVector::increment(SourceId source) {
+    auto it = std::lower_bound(begin(), end(), source,
+                               [](const Counter &counter, SourceId value) { return counter.source < value; });
+    if (it != end() && it->source == source) {
+        ++const_cast<Counter *>(it)->count;
+        return;
+    }
+    std::vector<Counter> grown(begin(), it);
+    grown.push_back({source, 1});
+    grown.insert(grown.end(), it, end());
+    assign(grown.data(), grown.size());
+}
+
+void VersionVector::mergeFrom(const VersionVector &other) {
+    std::vector<Counter> result;
+    result.reserve(size + other.size);
+
+    const Counter *a = begin();
+    const Counter *b = other.begin();
+    while (a != end() || b != other.end()) {
+        if (b == other.end() || (a != end() && a->source < b->source)) {
+            result.push_back(*a++);
+        } else if (a == end() || b->source < a->source) {
+            result.push_back(*b++);
+        } else {
+            result.push_back({a->source, std::max(a->count, b->count)});
+            ++a;
+            ++b;
+        }
+    }
+    assign(result.data(), result.size());
+}
+
+VersionVector::Order VersionVector::compare(const VersionVector &other) const {
+    bool less = false;
+    bool greater = false;
+
+    const Counter *a = begin();
+    const Counter *b = other.begin();
+    while (a != end() || b != other.end()) {
+        uint64_t mine = 0;
+        uint64_t theirs = 0;
+        if (b == other.end() || (a != end() && a->source < b->source)) {
+            mine = (a++)->count;
+        } else if (a == end() || b->source < a->source) {
+            theirs = (b++)->count;
+        } else {
+            mine = (a++)->count;
+            theirs = (b++)->count;
+        }
+        less = less || mine < theirs;
+        greater = greater || mine > theirs;
+    }
+
+    if (less && greater) {
+        return Order::Concurrent;
+    }
+    return less ? Order::Before : greater ? Order::After : Order::Equal;
+}
+
+uint64_t VersionVector::total() const {
+    uint64_t sum = 0;
+    for (const Counter *counter = begin(); counter != end(); ++counter) {
+        sum += counter->count;
+    }
+    return sum;
+}
+
+bool VersionVector::operator==(const VersionVector &other) const {
+    return size == other.size && std::equal(begin(), end(), other.begin(), [](const Counter &a, const Counter &b) {
+               return a.source == b.source && a.count == b.count;
+           });
+}
+
+MergeEngine::MergeEngine(bool compact)
+    : strings(compact ? std::make_unique<StringPool>() : nullptr),
+      arena(compact ? std::make_unique<ScratchArena>() : nullptr),
+      pendingContents(strings.get()),
+      mergedContents(strings.get()) {
+}
+
+SourceId MergeEngine::sourceId(const std::string &name) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+        if (sources[i].name == name) {
+            return static_cast<SourceId>(i);
+        }
+    }
+    std::pmr::memory_resource *resource = arena ? arena->resource() : std::pmr::get_default_resource();
+    sources.push_back({name, false, {}, PendingMap(resource)});
+    return static_cast<SourceId>(sources.size() - 1);
+}
+
+MergeEngine::Replica MergeEngine::replicaOf(const Source &source, KeyId id, const Entry &delivered) const {
+    static const VersionVector none;
+    auto edit = source.pending.find(id);
+    if (edit != source.pending.end()) {
+        return {&edit->second.version, edit->second.contentHash, &edit->second};
+    }
+    if (source.delivered && delivered.version.total() > 0) {
+        return {&delivered.version, delivered.contentHash, nullptr};
+    }
+    return {&none, 0, nullptr};
+}
+
+std::string MergeEngine::keyFor(const std::string &name) {
+    size_t first = name.find_first_not_of(" \t");
+    size_t last = name.find_last_not_of(" \t");
+    std::string key = first == std::string::npos ? std::string() : name.substr(first, last - first + 1);
+    for (char &c : key) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return key;
+}
+
+// FNV-1a over the fields a plotter can edit, positions at wire resolution.
+uint64_t MergeEngine::contentHash(const Waypoint &waypoint) {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const void *data, size_t length) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < length; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+
+    int64_t latitude = std::llround(waypoint.latitude * 1e7);
+    int64_t longitude = std::llround(waypoint.longitude * 1e7);
+    mix(&latitude, sizeof(latitude));
+    mix(&longitude, sizeof(longitude));
+    mix(waypoint.name.data(), waypoint.name.size());
+    mix("\0", 1);
+    mix(waypoint.symbol.data(), waypoint.symbol.size());
+    return hash;
+}
+
+void MergeEngine::observe(SourceId source, const Waypoint &waypoint) {
+    std::string key = keyFor(waypoint.name);
+    if (key.empty() || source >= sources.size()) {
+        return;
+    }
+
+    KeyId id = keys.intern(key);
+    Source &owner = sources[source];
+    if (owner.reportedHashes.size() < keys.size()) {
+        owner.reportedHashes.resize(keys.size(), 0);
+    }
+    uint64_t hash = contentHash(waypoint);
+    static const Entry none;
+    Replica replica = replicaOf(owner, id, id < merged.size() ? merged[id] : none);
+    bool held = replica.version->total() > 0;
+    if (owner.reportedHashes[id] == hash && held) {
+        return;  // same report as last time, possibly still stale
+    }
+    owner.reportedHashes[id] = hash;
+    if (replica.contentHash == hash && held) {
+        return;  // source caught up with what we delivered
+    }
+
+    // A genuine edit on top of whatever version the source last held.
+    VersionVector version = *replica.version;
+    version.increment(source);
+    auto [edit, inserted] = owner.pending.try_emplace(id);
+    if (inserted) {
+        edit->second.content = static_cast<uint32_t>(pendingContents.size());
+        pendingContents.resize(pendingContents.size() + 1);
+    }
+    edit->second.version = std::move(version);
+    edit->second.contentHash = hash;
+    pendingContents.set(edit->second.content, waypoint);
+}
+
+void MergeEngine::observeSnapshot(SourceId source, const std::vector<Waypoint> &waypoints) {
+    for (const auto &waypoint : waypoints) {
+        observe(source, waypoint);
+    }
+}
+
+MergeResult MergeEngine::merge() {
+    MergeResult result;
+    merged.resize(keys.size());
+    mergedContents.resize(keys.size());
+
+    for (KeyId id = 1; id < keys.size(); ++id) {
+        // Join every source's replica, keeping the dominant version;
+        // concurrent edits take the pointwise max and a deterministic
+        // content winner.
+        Entry joined;
+        const Pending *winner = nullptr;
+        bool found = false;
+        for (const Source &source : sources) {
+            Replica replica = replicaOf(source, id, merged[id]);
+            if (replica.version->total() == 0) {
+                continue;
+            }
+            if (!found) {
+                joined = Entry{*replica.version, replica.contentHash};
+                winner = replica.pending;
+                found = true;
+                continue;
+            }
+
+            switch (joined.version.compare(*replica.version)) {
+                case VersionVector::Order::Before:
+                    joined = Entry{*replica.version, replica.contentHash};
+                    winner = replica.pending;
+                    break;
+                case VersionVector::Order::Concurrent: {
+                    bool replicaWins = replica.version->total() != joined.version.total()
+                                           ? replica.version->total() > joined.version.total()
+                                           : replica.contentHash < joined.contentHash;
+                    if (joined.contentHash != replica.contentHash) {
+                        ++result.conflictsResolved;
+                    }
+                    joined.version.mergeFrom(*replica.version);
+                    if (replicaWins) {
+                        joined.contentHash = replica.contentHash;
+                        winner = replica.pending;
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        if (!found) {
+            continue;
+        }
+
+        // What each source held before this merge decides what it is sent.
+        Entry replaced;
+        const Entry *previous = &merged[id];
+        if (merged[id].version != joined.version) {
+            mergedCount += merged[id].version.total() == 0 ? 1 : 0;
+            replaced = std::move(merged[id]);
+            previous = &replaced;
+            merged[id] = std::move(joined);
+            if (winner) {
+                mergedContents.copy(id, pendingContents, winner->content);
+            }
+            result.changed.push_back(mergedContents.get(id));
+        }
+
+        // Anything a source lacks or holds at an older version goes to it.
+        const Entry &entry = merged[id];
+        for (SourceId source = 0; source < sources.size(); ++source) {
+            Replica replica = replicaOf(sources[source], id, *previous);
+            if (*replica.version != entry.version && replica.contentHash != entry.contentHash) {
+                result.updatesBySource[source].push_back(mergedContents.get(id));
+            }
+        }
+    }
+
+    // Every source now holds the merged entry for every key.
+    for (Source &source : sources) {
+        source.delivered = true;
+    }
+    releasePending();
+    return result;
+}
+
+void MergeEngine::releasePending() {
+    for (Source &source : sources) {
+        PendingMap empty(source.pending.get_allocator().resource());
+        source.pending.swap(empty);
+    }
+    pendingContents = WaypointTable(strings.get());
+    if (arena) {
+        arena->reset();
+    }
+}
+
+std::vector<Waypoint> MergeEngine::waypoints() const {
+    std::vector<Waypoint> result;
+    result.reserve(mergedCount);
+    for (KeyId id = 1; id < merged.size(); ++id) {
+        if (merged[id].version.total() > 0) {
+            result.push_back(mergedContents.get(id));
+        }
+    }
+    return result;
+}
+
+std::pmr::vector<Waypoint> MergeEngine::waypoints(std::pmr::memory_resource *resource) const {
+    std::pmr::vector<Waypoint> result(resource);
+    result.reserve(mergedCount);
+    for (KeyId id = 1; id < merged.size(); ++id) {
+        if (merged[id].version.total() > 0) {
+            result.push_back(mergedContents.get(id));
+        }
+    }
+    return result;
+}
+
+const VersionVector *MergeEngine::versionOf(const std::string &name) const {
+    KeyId id = keys.find(keyFor(name));
+    return id < merged.size() && merged[id].version.total() > 0 ? &merged[id].version : nullptr;
+}
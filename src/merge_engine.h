@@ -0,0 +1,156 @@
+#ifndef MERGE_ENGINE_H
+#define MERGE_ENGINE_H
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "compact_store.h"
+#include "waypoint.h"
+
+using SourceId = uint16_t;
+
+// Per-source edit counters for one waypoint, kept sorted by source. Most
+// waypoints are only ever edited by one source, so a single counter is
+// held inline and only longer vectors go on the heap.
+class VersionVector {
+public:
+    enum class Order { Equal, Before, After, Concurrent };
+
+    VersionVector() : single{0, 0} {}
+    VersionVector(const VersionVector &other);
+    VersionVector(VersionVector &&other) noexcept;
+    VersionVector &operator=(const VersionVector &other);
+    VersionVector &operator=(VersionVector &&other) noexcept;
+    ~VersionVector();
+
+    uint64_t get(SourceId source) const;
+    void increment(SourceId source);
+    void mergeFrom(const VersionVector &other);
+    Order compare(const VersionVector &other) const;
+    uint64_t total() const;
+
+    bool operator==(const VersionVector &other) const;
+    bool operator!=(const VersionVector &other) const { return !(*this == other); }
+
+private:
+    struct Counter {
+        SourceId source;
+        uint64_t count;
+    };
+
+    const Counter *begin() const { return size <= 1 ? &single : counters; }
+    const Counter *end() const { return begin() + size; }
+    void assign(const Counter *first, size_t count);
+    void release();
+
+    uint32_t size = 0;
+    union {
+        Counter single;     // size <= 1
+        Counter *counters;  // size > 1, owned
+    };
+};
+
+struct MergeResult {
+    // Waypoints whose merged state changed this round.
+    std::vector<Waypoint> changed;
+    // What each source is missing or holds stale, i.e. what to send it.
+    std::unordered_map<SourceId, std::vector<Waypoint>> updatesBySource;
+    size_t conflictsResolved = 0;
+};
+
+// Merges waypoint reports from several sources (SSD library, SD cards,
+// plotters) into one library.
+//
+// Waypoints are identified by their case-folded name. Each source has a
+// replica per waypoint that tracks the version it holds and the content
+// it last reported. A report that differs from both is a new edit by that
+// source. Concurrent edits pick a deterministic winner and get the
+// pointwise-max version, so every source converges after one round.
+// A waypoint missing from a report is not treated as deleted: plotters
+// with small capacity only ever hold part of the library.
+//
+// Since merge() delivers the merged entry to every source, replicas are
+// only stored for edits reported since the last merge; every other
+// replica is the merged entry itself. Keys are interned to dense IDs so
+// the merged library is a flat vector. In compact mode content is packed
+// into a shared string pool and pending edits live in an arena that is
+// released after each merge.
+class MergeEngine {
+public:
+    explicit MergeEngine(bool compact = false);
+    MergeEngine(const MergeEngine &) = delete;
+    MergeEngine &operator=(const MergeEngine &) = delete;
+
+    bool isCompact() const { return strings != nullptr; }
+    // For a compact WaypointSelector to share; null string pool in
+    // standard mode.
+    StringPool &keyPool() { return keys; }
+    StringPool *stringPool() { return strings.get(); }
+
+    SourceId sourceId(const std::string &name);
+    const std::string &sourceName(SourceId source) const { return sources[source].name; }
+
+    void observe(SourceId source, const Waypoint &waypoint);
+    void observeSnapshot(SourceId source, const std::vector<Waypoint> &waypoints);
+
+    // One pass over every key and source. Everything reported in the
+    // result is marked as delivered to the source it is meant for.
+    MergeResult merge();
+
+    size_t size() const { return mergedCount; }
+    std::vector<Waypoint> waypoints() const;
+    // Same, allocated from the given resource, for per-cycle copies.
+    std::pmr::vector<Waypoint> waypoints(std::pmr::memory_resource *resource) const;
+    const VersionVector *versionOf(const std::string &name) const;
+
+    static std::string keyFor(const std::string &name);
+    static uint64_t contentHash(const Waypoint &waypoint);
+
+private:
+    using KeyId = StringPool::Handle;
+
+    struct Entry {
+        VersionVector version;
+        uint64_t contentHash = 0;
+    };
+
+    // An edit reported since the last merge; its content is in pendingContents.
+    struct Pending {
+        VersionVector version;
+        uint64_t contentHash = 0;
+        uint32_t content = 0;
+    };
+    using PendingMap = std::pmr::unordered_map<KeyId, Pending>;
+
+    struct Source {
+        std::string name;
+        bool delivered = false;                // Has been through a merge
+        std::vector<uint64_t> reportedHashes;  // By key ID
+        PendingMap pending;
+    };
+
+    // What a source holds for a key: its pending edit, else whatever the
+    // last merge delivered to it.
+    struct Replica {
+        const VersionVector *version;
+        uint64_t contentHash;
+        const Pending *pending;
+    };
+    Replica replicaOf(const Source &source, KeyId id, const Entry &delivered) const;
+    void releasePending();
+
+    std::unique_ptr<StringPool> strings;  // Compact mode only
+    std::unique_ptr<ScratchArena> arena;  // Compact mode only
+    StringPool keys;
+    std::vector<Source> sources;
+    WaypointTable pendingContents;
+    std::vector<Entry> merged;  // By key ID
+    WaypointTable mergedContents;
+    size_t mergedCount = 0;
+};
+
+#endif // MERGE_ENGINE_H
@@ -0,0 +1,375 @@
+#include "nmea0183_output.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <termios.h>
+#include <unistd.h>
+
+// 82 characters including '$' and CRLF, so 77 up to the checksum '*'.
+const size_t NMEA0183_MAX_SENTENCE_BODY = 77;
+const size_t NMEA0183_MAX_DATAGRAM = 1400;
+// Serial batches hold roughly this much link time so pacing stays smooth.
+const int NMEA0183_BATCH_MILLISECONDS = 250;
+// How long to back off when the kernel buffer is full.
+const int NMEA0183_RETRY_MILLISECONDS = 10;
+// About three minutes of a 4800 baud link; sends beyond this are refused.
+const size_t NMEA0183_MAX_PENDING_BYTES = 96 * 1024;
+
+Nmea0183Encoder::Nmea0183Encoder(const std::string &talkerId) : talker(talkerId) {
+}
+
+void Nmea0183Encoder::clear() {
+    sentences.clear();
+    ends.clear();
+}
+
+uint8_t Nmea0183Encoder::checksum(const char *begin, const char *end) {
+    uint8_t sum = 0;
+    for (const char *p = begin; p != end; ++p) {
+        sum ^= static_cast<uint8_t>(*p);
+    }
+    return sum;
+}
+
+// Field delimiters and reserved characters are not allowed inside a field.
+std::string Nmea0183Encoder::sanitizeName(const std::string &name) {
+    std::string result;
+    result.reserve(name.size());
+    for (char c : name) {
+        bool reserved = c == ',' || c == '*' || c == '$' || c == '!' || c == '\\' || c == '^' || c == '~';
+        bool printable = c >= 0x20 && c < 0x7f;
+        result.push_back(printable && !reserved ? c : '_');
+    }
+    return result;
+}
+
+// ddmm.mmmm / dddmm.mmmm, rounded once in integer ten-thousandths of a
+// minute so 59.99995' carries into the next degree.
+void Nmea0183Encoder::appendCoordinate(double degrees, int degreeDigits, char positive, char negative) {
+    long long total = std::llround(std::fabs(degrees) * 60.0 * 10000.0);
+    long long wholeDegrees = total / 600000;
+    long long remainder = total % 600000;
+
+    char field[24];
+    int length = std::snprintf(field, sizeof(field), "%0*lld%02lld.%04lld,%c", degreeDigits, wholeDegrees,
+                               remainder / 10000, remainder % 10000, degrees < 0 ? negative : positive);
+    sentences.append(field, static_cast<size_t>(length));
+}
+
+void Nmea0183Encoder::finishSentence(size_t start) {
+    const char *data = sentences.data();
+    uint8_t sum = checksum(data + start + 1, data + sentences.size());
+
+    static const char hex[] = "0123456789ABCDEF";
+    char tail[5] = {'*', hex[sum >> 4], hex[sum & 0x0f], '\r', '\n'};
+    sentences.append(tail, sizeof(tail));
+    ends.push_back(sentences.size());
+}
+
+void Nmea0183Encoder::appendWaypoint(const Waypoint &waypoint) {
+    size_t start = sentences.size();
+    sentences += '$';
+    sentences += talker;
+    sentences += "WPL,";
+    appendCoordinate(waypoint.latitude, 2, 'N', 'S');
+    sentences += ',';
+    appendCoordinate(waypoint.longitude, 3, 'E', 'W');
+    sentences += ',';
+
+    std::string name = sanitizeName(waypoint.name);
+    size_t room = NMEA0183_MAX_SENTENCE_BODY - (sentences.size() - start);
+    sentences.append(name, 0, std::min(name.size(), room));
+    finishSentence(start);
+}
+
+void Nmea0183Encoder::appendRoute(const std::string &routeId, const std::vector<std::string> &waypointNames) {
+    if (waypointNames.empty()) {
+        return;
+    }
+
+    // "$GPRTE,n,n,c,<id>" with both counts as wide as the sentence total.
+    // Packed again one digit wider whenever the total outgrows its width.
+    std::string id = sanitizeName(routeId);
+    std::vector<std::pair<size_t, size_t>> groups;
+    std::vector<std::string> names;
+    for (size_t digits = 1;; ++digits) {
+        const size_t fixedLength = 1 + talker.size() + 4 + 2 * (digits + 1) + 2;
+        // A route ID long enough to crowd out the names is cut to leave room
+        // for at least one character of one.
+        id.resize(std::min(id.size(), NMEA0183_MAX_SENTENCE_BODY - fixedLength - 2));
+        const size_t room = NMEA0183_MAX_SENTENCE_BODY - fixedLength - id.size();
+
+        groups.clear();
+        names.clear();
+        names.reserve(waypointNames.size());
+        size_t used = 0;
+        for (size_t i = 0; i < waypointNames.size(); ++i) {
+            std::string name = sanitizeName(waypointNames[i]).substr(0, room - 1);
+            if (groups.empty() || used + 1 + name.size() > room) {
+                groups.push_back({i, i});
+                used = 0;
+            }
+            used += 1 + name.size();
+            groups.back().second = i + 1;
+            names.push_back(std::move(name));
+        }
+        if (std::to_string(groups.size()).size() <= digits) {
+            break;
+        }
+    }
+
+    char counts[48];
+    for (size_t g = 0; g < groups.size(); ++g) {
+        size_t start = sentences.size();
+        int length = std::snprintf(counts, sizeof(counts), "%zu,%zu,", groups.size(), g + 1);
+        sentences += '$';
+        sentences += talker;
+        sentences += "RTE,";
+        sentences.append(counts, static_cast<size_t>(length));
+        sentences += "c,";
+        sentences += id;
+        for (size_t i = groups[g].first; i < groups[g].second; ++i) {
+            sentences += ',';
+            sentences += names[i];
+        }
+        finishSentence(start);
+    }
+}
+
+Nmea0183Output::~Nmea0183Output() {
+    close();
+}
+
+static speed_t baudToSpeed(int baudRate) {
+    switch (baudRate) {
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return B0;
+    }
+}
+
+bool Nmea0183Output::openSerial(const std::string &device, int baudRate) {
+    speed_t speed = baudToSpeed(baudRate);
+    if (speed == B0) {
+        std::cerr << "Unsupported NMEA 0183 baud rate " << baudRate << std::endl;
+        return false;
+    }
+
+    int serialFd = ::open(device.c_str(), O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (serialFd < 0) {
+        std::cerr << "Failed to open NMEA 0183 device " << device << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    termios tty{};
+    if (tcgetattr(serialFd, &tty) == 0) {
+        cfmakeraw(&tty);
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+        tty.c_cflag |= CLOCAL;
+        tcsetattr(serialFd, TCSANOW, &tty);
+    }
+
+    std::cout << "NMEA 0183 output on " << device << " at " << baudRate << " baud" << std::endl;
+    bool opened = openFd(serialFd, baudRate);
+    name = device;
+    return opened;
+}
+
+bool Nmea0183Output::openUdp(const std::string &host, uint16_t port, int baudRate) {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *result = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &result) != 0 || !result) {
+        std::cerr << "Failed to resolve NMEA 0183 UDP target " << host << std::endl;
+        return false;
+    }
+
+    int socketFd = socket(result->ai_family, result->ai_socktype | SOCK_CLOEXEC, result->ai_protocol);
+    if (socketFd < 0 || connect(socketFd, result->ai_addr, result->ai_addrlen) != 0) {
+        std::cerr << "Failed to open NMEA 0183 UDP target " << host << ":" << port << std::endl;
+        if (socketFd >= 0) {
+            ::close(socketFd);
+        }
+        freeaddrinfo(result);
+        return false;
+    }
+    freeaddrinfo(result);
+
+    std::cout << "NMEA 0183 output to udp://" << host << ":" << port << std::endl;
+    bool opened = openFd(socketFd, baudRate);
+    datagram = true;
+    name = "udp://" + host + ":" + service;
+    return opened;
+}
+
+bool Nmea0183Output::openFd(int newFd, int newBaudRate) {
+    close();
+    fd = newFd;
+    datagram = false;
+    baudRate = newBaudRate;
+    name = "fd:" + std::to_string(newFd);
+    linkFreeAt = std::chrono::steady_clock::now();
+    if (fd >= 0) {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return fd >= 0;
+}
+
+void Nmea0183Output::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    clearPending();
+}
+
+// One sentence per waypoint, so sentences queued is waypoints queued.
+size_t Nmea0183Output::sendWaypoints(const std::vector<Waypoint> &waypoints) {
+    encoder.clear();
+    for (const auto &waypoint : waypoints) {
+        encoder.appendWaypoint(waypoint);
+    }
+    return queue(encoder, true);
+}
+
+bool Nmea0183Output::sendRoute(const std::string &routeId, const std::vector<std::string> &waypointNames) {
+    encoder.clear();
+    encoder.appendRoute(routeId, waypointNames);
+    return send(encoder);
+}
+
+bool Nmea0183Output::send(const Nmea0183Encoder &sentences) {
+    return fd >= 0 && queue(sentences, false) == sentences.sentenceEnds().size();
+}
+
+// Whole sentences only. Without partial, sentences that belong together
+// (a route) are queued all or none.
+size_t Nmea0183Output::queue(const Nmea0183Encoder &sentences, bool partial) {
+    const std::vector<size_t> &ends = sentences.sentenceEnds();
+    if (fd < 0 || ends.empty()) {
+        return 0;
+    }
+    size_t queued = pending.size() - pendingOffset;
+    size_t room = NMEA0183_MAX_PENDING_BYTES > queued ? NMEA0183_MAX_PENDING_BYTES - queued : 0;
+    size_t count = ends.size();
+    if (ends.back() > room) {
+        count = partial ? static_cast<size_t>(std::upper_bound(ends.begin(), ends.end(), room) - ends.begin()) : 0;
+        std::cerr << "NMEA 0183 output " << name << " is behind; " << (partial ? "holding back " : "dropping ")
+                  << ends.size() - count << " sentences." << std::endl;
+        if (count == 0) {
+            return 0;
+        }
+    }
+
+    // Drop what has gone out once it is most of the buffer.
+    if (pendingOffset > pending.size() / 2) {
+        pending.erase(0, pendingOffset);
+        pendingEnds.erase(pendingEnds.begin(), pendingEnds.begin() + static_cast<std::ptrdiff_t>(pendingSentence));
+        for (size_t &end : pendingEnds) {
+            end -= pendingOffset;
+        }
+        pendingSentence = 0;
+        pendingOffset = 0;
+    }
+
+    size_t base = pending.size();
+    pending.append(sentences.buffer(), 0, ends[count - 1]);
+    for (size_t i = 0; i < count; ++i) {
+        pendingEnds.push_back(base + ends[i]);
+    }
+    pump();
+    return count;
+}
+
+// Groups whole sentences into batches (one datagram, or ~250 ms of serial
+// link time) and hands each batch to the kernel in a single writev once
+// the previous one has had its time on the wire.
+int Nmea0183Output::pump() {
+    if (fd < 0 || !hasPending()) {
+        clearPending();
+        return -1;
+    }
+
+    size_t batchBytesLimit = datagram ? NMEA0183_MAX_DATAGRAM
+                           : baudRate > 0 ? std::max<size_t>(static_cast<size_t>(baudRate) / 10 * NMEA0183_BATCH_MILLISECONDS / 1000, 82)
+                           : 64 * 1024;
+
+    while (hasPending()) {
+        auto now = std::chrono::steady_clock::now();
+        if (baudRate > 0 && linkFreeAt > now) {
+            auto wait = std::chrono::ceil<std::chrono::milliseconds>(linkFreeAt - now);
+            return static_cast<int>(std::max<long long>(wait.count(), 1));
+        }
+
+        size_t last = pendingSentence + 1;
+        while (last < pendingEnds.size() && last - pendingSentence < IOV_MAX &&
+               pendingEnds[last] - pendingOffset <= batchBytesLimit) {
+            ++last;
+        }
+
+        ssize_t written = writeBatch(last);
+        if (written < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return NMEA0183_RETRY_MILLISECONDS;
+            }
+            std::cerr << "NMEA 0183 write to " << name << " failed: " << std::strerror(errno) << std::endl;
+            clearPending();
+            return -1;
+        }
+
+        bytesWritten += static_cast<uint64_t>(written);
+        // A datagram goes whole or not at all.
+        consume(datagram ? pendingEnds[last - 1] - pendingOffset : static_cast<size_t>(written));
+        if (baudRate > 0) {
+            // 8N1: ten bit times per byte on the wire.
+            linkFreeAt = now + std::chrono::microseconds(static_cast<long long>(written) * 10 * 1000000 / baudRate);
+        }
+    }
+    clearPending();
+    return -1;
+}
+
+ssize_t Nmea0183Output::writeBatch(size_t last) {
+    std::vector<iovec> iov;
+    iov.reserve(last - pendingSentence);
+    size_t start = pendingOffset;
+    for (size_t i = pendingSentence; i < last; ++i) {
+        iov.push_back({pending.data() + start, pendingEnds[i] - start});
+        start = pendingEnds[i];
+    }
+
+    ssize_t written;
+    do {
+        written = ::writev(fd, iov.data(), static_cast<int>(iov.size()));
+    } while (written < 0 && errno == EINTR);
+    return written;
+}
+
+void Nmea0183Output::consume(size_t bytes) {
+    pendingOffset += bytes;
+    while (pendingSentence < pendingEnds.size() && pendingEnds[pendingSentence] <= pendingOffset) {
+        ++pendingSentence;
+    }
+}
+
+void Nmea0183Output::clearPending() {
+    pending.clear();
+    pendingEnds.clear();
+    pendingSentence = 0;
+    pendingOffset = 0;
+}
@@ -0,0 +1,98 @@
+#ifndef NMEA0183_OUTPUT_H
+#define NMEA0183_OUTPUT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+#include <vector>
+#include "waypoint.h"
+
+// Streaming encoder for NMEA 0183 waypoint sentences. Sentences are appended
+// back to back into one buffer, CRLF terminated, with their end offsets kept
+// so the writer can batch them without copying.
+class Nmea0183Encoder {
+public:
+    explicit Nmea0183Encoder(const std::string &talkerId = "GP");
+
+    void appendWaypoint(const Waypoint &waypoint);
+    // Splits the route over as many $--RTE sentences as the 82 character
+    // limit requires.
+    void appendRoute(const std::string &routeId, const std::vector<std::string> &waypointNames);
+
+    const std::string &buffer() const { return sentences; }
+    const std::vector<size_t> &sentenceEnds() const { return ends; }
+    void clear();
+
+    static uint8_t checksum(const char *begin, const char *end);
+    static std::string sanitizeName(const std::string &name);
+
+private:
+    void finishSentence(size_t start);
+    void appendCoordinate(double degrees, int degreeDigits, char positive, char negative);
+
+    std::string talker;
+    std::string sentences;
+    std::vector<size_t> ends;
+};
+
+// Writes encoded sentences to a serial port or UDP target in batches,
+// paced so the average rate never exceeds the target link's baud rate.
+//
+// Nothing here waits for the link: sends are queued and pump() writes
+// whatever is due, on a non-blocking descriptor, then says when the next
+// batch is. Not thread safe; callers serialise access.
+class Nmea0183Output {
+public:
+    Nmea0183Output() = default;
+    ~Nmea0183Output();
+    Nmea0183Output(const Nmea0183Output &) = delete;
+    Nmea0183Output &operator=(const Nmea0183Output &) = delete;
+
+    bool openSerial(const std::string &device, int baudRate);
+    bool openUdp(const std::string &host, uint16_t port, int baudRate = 0);
+    // Takes ownership of an already open descriptor, e.g. a pty in tests.
+    bool openFd(int fd, int baudRate);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+    // Device path or udp:// target; the output's selection is keyed by it.
+    const std::string &getName() const { return name; }
+
+    // Queue the sentences and write the first batch if it is due. False
+    // when closed or when the queue is already over its limit.
+    bool sendRoute(const std::string &routeId, const std::vector<std::string> &waypointNames);
+    bool send(const Nmea0183Encoder &encoder);
+    // Queues as many of the waypoints, in order, as fit under the queue
+    // limit and returns how many; the caller offers the rest again later.
+    size_t sendWaypoints(const std::vector<Waypoint> &waypoints);
+
+    // Writes every batch whose turn on the link has come. Returns the
+    // milliseconds until the next one is due, or -1 once the queue is empty.
+    int pump();
+    bool hasPending() const { return pendingSentence < pendingEnds.size(); }
+
+    uint64_t getBytesWritten() const { return bytesWritten; }
+
+private:
+    size_t queue(const Nmea0183Encoder &sentences, bool partial);
+    ssize_t writeBatch(size_t last);
+    void consume(size_t bytes);
+    void clearPending();
+
+    int fd = -1;
+    bool datagram = false;
+    int baudRate = 0;
+    std::string name;
+    uint64_t bytesWritten = 0;
+    std::chrono::steady_clock::time_point linkFreeAt{};
+    Nmea0183Encoder encoder;
+
+    // Queued sentences back to back, with their end offsets. Everything
+    // before pendingOffset has been written; a stream fd may stop mid-sentence.
+    std::string pending;
+    std::vector<size_t> pendingEnds;
+    size_t pendingSentence = 0;
+    size_t pendingOffset = 0;
+};
+
+#endif // NMEA0183_OUTPUT_H
@@ -1,57 +1,238 @@
 #include "nmea_waypoint_handler.h"
 #include "gpio_pins.h"
 #include "sync_manager.h"
+#include "waypoint_pgns.h"
 #include <NMEA2000.h>
 #include <N2kMessages.h>
-#include "NMEA2000_CAN.h"
 #include "N2kDeviceList.h"
 #include <wiringPi.h>
-#include <fstream>
 #include <iostream>
 #include <thread>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
 
 
-std::unordered_map<uint64_t, std::string> deviceNameMap = {
-    {0x123456789ABCDEF0, "Garmin"},
-    {0x0987654321ABCDEF, "Lowrance"}
-};
+const unsigned long PGN_WAYPOINT_LIST = WaypointListPgn::pgn;
+const unsigned long PGN_POSITION_RAPID = 129025;
+const unsigned long PGN_GNSS_POSITION = 129029;
+const uint8_t N2K_MAX_SOURCE_ADDRESS = 253;
 
-const unsigned long PGN_WAYPOINT_LIST = 130074; // Placeholder PGN, replace with real
+// Route/WP information and the route and waypoint database group. Vendor
+// proprietary PGNs stay on the bus they were heard on.
+const unsigned long PGN_ROUTE_SERVICE_FIRST = 130064;
+const unsigned long PGN_ROUTE_SERVICE_LAST = 130074;
 
-NMEAWaypointHandler* NMEAWaypointHandler::instance = nullptr;
+static bool isBridgedPgn(unsigned long pgn) {
+    return pgn == RouteWaypointPgn::pgn || (pgn >= PGN_ROUTE_SERVICE_FIRST && pgn <= PGN_ROUTE_SERVICE_LAST);
+}
 
-NMEAWaypointHandler::NMEAWaypointHandler(SyncManager& sm, std::unique_ptr<tNMEA2000> nmea2000Instance)
-    : syncManager(sm), nmea2000(std::move(nmea2000Instance)) {
-    instance = this;
+static uint64_t steadyMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
+NMEAWaypointHandler::NMEAWaypointHandler(SyncManager& sm, std::unique_ptr<tNMEA2000> nmea2000Instance, const std::string& busName)
+    : nmea2000(std::move(nmea2000Instance)), syncManager(sm), busName(busName), busMessageHandler(*this) {
     if (wiringPiSetup() == -1) {
         std::cerr << "Failed to initialize WiringPi" << std::endl;
         exit(1);
     }
     pinMode(TRANSMITTING_LED_PIN, OUTPUT);
 
+    configureBus();
+
+    dispatcher.registerHandler(PGN_WAYPOINT_LIST, PgnDispatcher::AnyManufacturer,
+                               [this](const tN2kMsg &msg) { handleWaypointList(msg); });
+    dispatcher.registerHandler(PGN_POSITION_RAPID, PgnDispatcher::AnyManufacturer,
+                               [this](const tN2kMsg &msg) { handlePosition(msg); });
+    dispatcher.registerHandler(PGN_GNSS_POSITION, PgnDispatcher::AnyManufacturer,
+                               [this](const tN2kMsg &msg) { handlePosition(msg); });
+    dispatcher.setManufacturerLookup([this](unsigned char source) { return manufacturerOf(source); });
+    for (const auto &plugin : vendorPlugins.plugins()) {
+        registerVendorPgns(plugin);
+    }
+}
+
+NMEAWaypointHandler::~NMEAWaypointHandler() {
+    stop();
+    if (nmea2000) {
+        nmea2000->DetachMsgHandler(&busMessageHandler);
+    }
+}
+
+// Applies our product/device identity to the current tNMEA2000 and hooks this
+// instance's message handler and device list onto it.
+void NMEAWaypointHandler::configureBus() {
+    if (!nmea2000) {
+        return;
+    }
+
     nmea2000->SetProductInformation("00000001", 100, "Waypoint Handler", "1.0.0.0", "1.0.0");
     nmea2000->SetDeviceInformation(1, 130, 60, 4096);
     nmea2000->SetMode(tNMEA2000::N2km_ListenAndNode);
-    nmea2000->SetMsgHandler(NMEAWaypointHandler::MessageHandler);
+    nmea2000->AttachMsgHandler(&busMessageHandler);
 
     deviceList = std::make_unique<tN2kDeviceList>(nmea2000.get());
+    socketCanNode = dynamic_cast<SocketCanNode*>(nmea2000.get());
+    busCounterSource = dynamic_cast<BusCounterSource*>(nmea2000.get());
 }
 
-void NMEAWaypointHandler::MessageHandler(const tN2kMsg &N2kMsg) {
-    if (instance) {
-        instance->OnN2kMessage(N2kMsg);
+void NMEAWaypointHandler::setNMEA2000(std::unique_ptr<tNMEA2000> nmea2000Instance) {
+    if (running) {
+        std::cerr << "Cannot replace NMEA2000 instance on running bus " << busName << std::endl;
+        return;
     }
+
+    deviceList.reset();
+    socketCanNode = nullptr;
+    busCounterSource = nullptr;
+    if (nmea2000) {
+        nmea2000->DetachMsgHandler(&busMessageHandler);
+    }
+    nmea2000 = std::move(nmea2000Instance);
+    configureBus();
 }
 
+// Hot path: the dispatcher rejects unrelated PGNs before anything else runs.
+// Runs for every frame on the bus thread, so nothing here touches a file.
 void NMEAWaypointHandler::OnN2kMessage(const tN2kMsg &N2kMsg) {
-    std::ofstream log("/mnt/nvme/logs/pgn_log.txt", std::ios::app);
-    log << "Received PGN: " << N2kMsg.PGN << ", LEN: " << N2kMsg.DataLen << std::endl;
-    log.close();
+    dispatcher.dispatch(N2kMsg);
+    if (!isBridgedPgn(N2kMsg.PGN)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(bridgeMutex);
+    for (NMEAWaypointHandler* peer : bridgePeers) {
+        peer->forwardMessage(N2kMsg);
+    }
+}
+
+void NMEAWaypointHandler::registerVendorPlugin(const VendorPlugin& plugin) {
+    if (running) {
+        std::cerr << "Vendor plugins must be registered before starting bus " << busName << std::endl;
+        return;
+    }
+    vendorPlugins.add(plugin);
+    dispatcher.unregisterManufacturer(plugin.manufacturerCode);
+    registerVendorPgns(plugin);
+}
 
-    unsigned long PGN = N2kMsg.PGN;
-    if (PGN == PGN_WAYPOINT_LIST) {
-        handleWaypointList(N2kMsg);
+void NMEAWaypointHandler::registerVendorPgns(const VendorPlugin& plugin) {
+    for (const auto &vendorPgn : plugin.pgns) {
+        VendorDecoder decode = vendorPgn.decode;
+        dispatcher.registerHandler(vendorPgn.pgn, plugin.manufacturerCode, [this, decode](const tN2kMsg &msg) {
+            std::vector<Waypoint> waypoints;
+            decode(msg, waypoints);
+            bool queued = false;
+            for (auto &waypoint : waypoints) {
+                queued = queueWaypoint(std::move(waypoint), msg.Source) || queued;
+            }
+            if (queued) {
+                syncManager.notifyWaypointEvents();
+            }
+        });
+    }
+}
+
+void NMEAWaypointHandler::enableProprietaryCapture() {
+    std::vector<VendorPlugin> plugins = vendorPlugins.plugins();
+    for (auto &plugin : plugins) {
+        for (unsigned long pgn : proprietaryPgns()) {
+            bool decoded = std::any_of(plugin.pgns.begin(), plugin.pgns.end(),
+                                       [pgn](const VendorPgn &vendorPgn) { return vendorPgn.pgn == pgn; });
+            if (decoded) {
+                continue;
+            }
+            plugin.pgns.push_back({pgn, [this, vendor = plugin.name](const tN2kMsg &msg, std::vector<Waypoint> &) {
+                if (!capturedFrames.tryPush(CapturedFrame{vendor, msg})) {
+                    ++droppedCapturedFrames;
+                }
+            }});
+        }
+        registerVendorPlugin(plugin);
+    }
+}
+
+uint16_t NMEAWaypointHandler::manufacturerOf(unsigned char source) const {
+    const tNMEA2000::tDevice* device = deviceList ? deviceList->FindDeviceBySource(source) : nullptr;
+    return device ? device->GetManufacturerCode() : PgnDispatcher::AnyManufacturer;
+}
+
+// Never block the bus thread on sync work: hand off and move on.
+bool NMEAWaypointHandler::queueWaypoint(Waypoint&& waypoint, unsigned char source) {
+    waypoint.source = source;
+    if (!waypointEvents.tryPush(std::move(waypoint))) {
+        ++droppedWaypointEvents;
+        std::cerr << "Waypoint event queue full on " << busName << ", dropping waypoint." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void NMEAWaypointHandler::handlePosition(const tN2kMsg &N2kMsg) {
+    double latitude = N2kDoubleNA;
+    double longitude = N2kDoubleNA;
+    bool parsed;
+    if (N2kMsg.PGN == PGN_POSITION_RAPID) {
+        parsed = ParseN2kPGN129025(N2kMsg, latitude, longitude);
+    } else {
+        unsigned char sid, satellites, referenceStations;
+        uint16_t daysSince1970, referenceStationId;
+        double secondsSinceMidnight, altitude, hdop, pdop, geoidalSeparation, ageOfCorrection;
+        tN2kGNSStype gnssType, referenceStationType;
+        tN2kGNSSmethod method;
+        parsed = ParseN2kPGN129029(N2kMsg, sid, daysSince1970, secondsSinceMidnight, latitude, longitude, altitude,
+                                   gnssType, method, satellites, hdop, pdop, geoidalSeparation, referenceStations,
+                                   referenceStationType, referenceStationId, ageOfCorrection) &&
+                 method != N2kGNSSm_noGNSS;
+    }
+    if (!parsed || latitude == N2kDoubleNA || longitude == N2kDoubleNA || std::fabs(latitude) > 90.0 ||
+        std::fabs(longitude) > 180.0) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    std::lock_guard<std::mutex> lock(positionMutex);
+    ownShipPosition.latitude = latitude;
+    ownShipPosition.longitude = longitude;
+    ownShipPosition.timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+    ownShipPosition.valid = true;
+}
+
+OwnShipPosition NMEAWaypointHandler::getOwnShipPosition() {
+    std::lock_guard<std::mutex> lock(positionMutex);
+    return ownShipPosition;
+}
+
+void NMEAWaypointHandler::bridgeTo(NMEAWaypointHandler& peer) {
+    {
+        std::lock_guard<std::mutex> lock(bridgeMutex);
+        if (&peer == this || std::find(bridgePeers.begin(), bridgePeers.end(), &peer) != bridgePeers.end()) {
+            return;
+        }
+        bridgePeers.push_back(&peer);
+    }
+    // start() clears this before installing its filter, so a running bus
+    // is the only one that acts on it.
+    receiveFilterStale = true;
+    if (socketCanNode) {
+        socketCanNode->wake();
+    }
+    std::cout << "Bridging waypoint PGNs from " << busName << " to " << peer.getBusName() << std::endl;
+}
+
+// Called from another bus's thread: never touch nmea2000 here, just queue it
+// for this bus's own thread. Counted like our own sends, so transmitted()
+// waits behind bridged frames that are ahead in the queue.
+void NMEAWaypointHandler::forwardMessage(const tN2kMsg &N2kMsg) {
+    {
+        std::lock_guard<std::mutex> lock(txMutex);
+        txQueue.push_back(N2kMsg);
+        ++queuedMessages;
+    }
+    if (socketCanNode) {
+        socketCanNode->wake();
     }
 }
 
@@ -65,66 +246,385 @@ void NMEAWaypointHandler::handleWaypointList(const tN2kMsg &N2kMsg) {
     }
     std::cout << std::endl;
 
-    // Log raw PGN data to file
-    std::ofstream log("/mnt/nvme/logs/pgn_data_log.txt", std::ios::app);
-    log << "PGN: " << N2kMsg.PGN << " | LEN: " << N2kMsg.DataLen << " | DATA: ";
-    for (int i = 0; i < N2kMsg.DataLen; ++i) {
-        log << std::hex << std::uppercase << (int)N2kMsg.Data[i] << " ";
+    WaypointListPgn::View view(N2kMsg);
+    if (!view.isValid()) {
+        std::cerr << "Malformed waypoint list message on " << busName << ", ignoring." << std::endl;
+        return;
     }
-    log << std::endl;
-    log.close();
 
-    // Placeholder values until we parse real data
-    std::string name = "PGNWaypoint";
-    double lat = 34.1234567;   // Replace with decoded latitude
-    double lon = -84.1234567;  // Replace with decoded longitude
+    bool queued = false;
+    bool complete = view.forEachItem([&](const WaypointListPgn::ItemView &item) {
+        double latitude = item.get<WaypointListItem::Latitude>();
+        double longitude = item.get<WaypointListItem::Longitude>();
+        if (latitude == N2kDoubleNA || longitude == N2kDoubleNA) {
+            return;
+        }
+
+        Waypoint waypoint;
+        waypoint.id = static_cast<uint16_t>(item.get<WaypointListItem::Id>());
+        waypoint.name = std::string(item.get<WaypointListItem::Name>());
+        waypoint.latitude = latitude;
+        waypoint.longitude = longitude;
 
-    syncManager.syncWaypoint(lat, lon, name);
+        queued = queueWaypoint(std::move(waypoint), N2kMsg.Source) || queued;
+    });
+
+    if (!complete) {
+        std::cerr << "Waypoint list message on " << busName << " was truncated." << std::endl;
+    }
+    if (queued) {
+        syncManager.notifyWaypointEvents();
+    }
 }
 
 
 void NMEAWaypointHandler::start() {
-    static bool alreadyStarted = false;
-    if (!alreadyStarted && nmea2000) {
-        std::cout << "Calling Open() on nmea2000 from: " << __FILE__ << ":" << __LINE__ << std::endl;
+    if (!running && nmea2000) {
+        std::cout << "Calling Open() on nmea2000 for " << busName << " from: " << __FILE__ << ":" << __LINE__ << std::endl;
+        receiveFilterStale = false;
+        applyReceiveFilter();
         nmea2000->Open();
-        std::thread([] {
-            while (true) {
-                NMEA2000.ParseMessages();
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        {
+            std::lock_guard<std::mutex> lock(busTaskMutex);
+            busTasksOpen = true;
+        }
+        running = true;
+        busThread = std::thread(&NMEAWaypointHandler::busLoop, this);
+    }
+}
+
+void NMEAWaypointHandler::stop() {
+    running = false;
+    if (socketCanNode) {
+        socketCanNode->wake();
+    }
+    if (busThread.joinable()) {
+        busThread.join();
+    }
+}
+
+// One receive/transmit thread per bus: parse whatever arrived, then send
+// whatever other threads queued for us, as fast as the bus allows.
+void NMEAWaypointHandler::busLoop() {
+    busThreadId = std::this_thread::get_id();
+    while (running) {
+        if (receiveFilterStale.exchange(false)) {
+            applyReceiveFilter();
+        }
+        nmea2000->ParseMessages();
+        runBusTasks();
+        sampleBusLoad();
+        flushTransmitQueue();
+        waitForBusActivity();
+    }
+
+    // What is already queued still goes out, but only for as long as
+    // stopDrainMs: after a backoff the rate cannot rise again, and a long
+    // queue would hold up stop() for minutes. The library only flushes its
+    // fast-packet buffers inside ParseMessages(), so keep calling it.
+    const uint64_t stopDrainMs = 1000;
+    std::deque<tN2kMsg> pending;
+    {
+        std::lock_guard<std::mutex> lock(txMutex);
+        pending.swap(txQueue);
+    }
+    uint64_t deadline = steadyMillis() + stopDrainMs;
+    size_t sent = 0;
+    while (sent < pending.size()) {
+        nmea2000->ParseMessages();
+        runBusTasks();
+        uint64_t now = steadyMillis();
+        if (now >= deadline) {
+            break;
+        }
+        uint64_t waitMs;
+        {
+            std::lock_guard<std::mutex> lock(rateMutex);
+            waitMs = txRate.tryAcquire(framesForPayload(pending[sent].DataLen), now)
+                         ? 0 : std::min(txRate.msUntilAvailable(now), deadline - now);
+        }
+        if (waitMs == 0) {
+            sendNow(pending[sent++]);
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+        }
+    }
+    nmea2000->ParseMessages();
+    if (sent < pending.size()) {
+        std::cerr << "Dropped " << pending.size() - sent << " queued messages on " << busName
+                  << " when stopping." << std::endl;
+    }
+
+    // Nothing parses from here on, so the device list is settled and
+    // callers can read it themselves.
+    runBusTasks(true);
+    busThreadId = std::thread::id();
+
+    // Anything queued after the swap is never sent; do not leave its waiters hanging.
+    markTransmitted(sent, true);
+}
+
+// Everything is registered by the time this runs, so the kernel can drop
+// the rest.
+void NMEAWaypointHandler::applyReceiveFilter() {
+    if (!socketCanNode) {
+        return;
+    }
+    std::vector<unsigned long> pgns = dispatcher.registeredPgns();
+    bool bridged;
+    {
+        std::lock_guard<std::mutex> lock(bridgeMutex);
+        bridged = !bridgePeers.empty();
+    }
+    if (bridged) {
+        pgns.push_back(RouteWaypointPgn::pgn);
+        for (unsigned long pgn = PGN_ROUTE_SERVICE_FIRST; pgn <= PGN_ROUTE_SERVICE_LAST; ++pgn) {
+            pgns.push_back(pgn);
+        }
+    }
+    socketCanNode->setReceivePgns(pgns);
+}
+
+// False once the bus thread has stopped taking tasks.
+bool NMEAWaypointHandler::runOnBusThread(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(busTaskMutex);
+        if (!busTasksOpen) {
+            return false;
+        }
+        busTasks.push_back(std::move(task));
+    }
+    if (socketCanNode) {
+        socketCanNode->wake();
+    }
+    return true;
+}
+
+void NMEAWaypointHandler::runBusTasks(bool close) {
+    std::deque<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(busTaskMutex);
+        tasks.swap(busTasks);
+        if (close) {
+            busTasksOpen = false;
+        }
+    }
+    for (auto &task : tasks) {
+        task();
+    }
+}
+
+// The library's own timers (address claim, heartbeat, fast-packet sends)
+// only advance inside ParseMessages(), so even a quiet bus gets a tick.
+// With messages waiting we wake as soon as the rate allows the next one.
+void NMEAWaypointHandler::waitForBusActivity() {
+    const int idleTickMs = 100;
+    int timeoutMs = idleTickMs;
+    {
+        std::lock_guard<std::mutex> lock(txMutex);
+        if (!txQueue.empty()) {
+            std::lock_guard<std::mutex> rateLock(rateMutex);
+            timeoutMs = static_cast<int>(std::min<uint64_t>(idleTickMs, txRate.msUntilAvailable(steadyMillis())));
+        }
+    }
+    if (timeoutMs == 0) {
+        return;
+    }
+    if (socketCanNode) {
+        socketCanNode->waitForFrames(timeoutMs);
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+    }
+}
+
+// Utilisation comes from whole-bus frame and byte counters, so engine data
+// and radar that the kernel filters keep from us still count. Refused
+// frames since the last sample are backpressure.
+void NMEAWaypointHandler::sampleBusLoad() {
+    const uint64_t loadSampleMs = 100;
+    uint64_t now = steadyMillis();
+    if (now - lastLoadSampleMs < loadSampleMs) {
+        return;
+    }
+    lastLoadSampleMs = now;
+
+    BusCounters counters;
+    if (busCounterSource && busCounterSource->readBusCounters(counters)) {
+        busLoad.update(counters, now);
+    }
+    std::lock_guard<std::mutex> lock(rateMutex);
+    if (busLoad.newSendFailures() > 0) {
+        txRate.onBackpressure(now);
+    }
+    txRate.update(busLoad.utilisation(), now);
+    busUtilisation = busLoad.utilisation();
+    transmitRate = txRate.framesPerSecond();
+}
+
+void NMEAWaypointHandler::flushTransmitQueue() {
+    std::deque<tN2kMsg> ready;
+    {
+        std::lock_guard<std::mutex> lock(txMutex);
+        std::lock_guard<std::mutex> rateLock(rateMutex);
+        uint64_t now = steadyMillis();
+        while (!txQueue.empty() && txRate.tryAcquire(framesForPayload(txQueue.front().DataLen), now)) {
+            ready.push_back(std::move(txQueue.front()));
+            txQueue.pop_front();
+        }
+    }
+    for (const auto& msg : ready) {
+        sendNow(msg);
+    }
+    if (!ready.empty()) {
+        markTransmitted(ready.size());
+    }
+}
+
+void NMEAWaypointHandler::markTransmitted(size_t count, bool releaseAll) {
+    std::vector<std::function<void()>> done;
+    {
+        std::lock_guard<std::mutex> lock(txMutex);
+        sentMessages += count;
+        while (!transmitWaiters.empty() && (releaseAll || transmitWaiters.front().first <= sentMessages)) {
+            done.push_back(std::move(transmitWaiters.front().second));
+            transmitWaiters.pop_front();
+        }
+    }
+    for (auto& callback : done) {
+        callback();
+    }
+}
+
+void NMEAWaypointHandler::whenTransmitted(std::function<void()> done) {
+    {
+        std::lock_guard<std::mutex> lock(txMutex);
+        if (running && sentMessages < queuedMessages) {
+            transmitWaiters.emplace_back(queuedMessages, std::move(done));
+            return;
+        }
+    }
+    done();
+}
+
+void NMEAWaypointHandler::transmit(const tN2kMsg &msg) {
+    if (running) {
+        {
+            std::lock_guard<std::mutex> lock(txMutex);
+            txQueue.push_back(msg);
+            ++queuedMessages;
+        }
+        if (socketCanNode && std::this_thread::get_id() != busThread.get_id()) {
+            socketCanNode->wake();
+        }
+        return;
+    }
+    sendPaced(msg);
+}
+
+// Without the bus thread (not started, or draining on stop) the caller
+// waits out the rate itself.
+void NMEAWaypointHandler::sendPaced(const tN2kMsg &msg) {
+    while (true) {
+        uint64_t waitMs;
+        {
+            std::lock_guard<std::mutex> lock(rateMutex);
+            uint64_t now = steadyMillis();
+            if (txRate.tryAcquire(framesForPayload(msg.DataLen), now)) {
+                break;
             }
-        }).detach();
-        alreadyStarted = true;
+            waitMs = txRate.msUntilAvailable(now);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
     }
+    sendNow(msg);
+}
+
+// A message the library could not take or buffer is backpressure too.
+void NMEAWaypointHandler::sendNow(const tN2kMsg &msg) {
+    digitalWrite(TRANSMITTING_LED_PIN, HIGH);
+    bool sent = nmea2000->SendMsg(msg);
+    digitalWrite(TRANSMITTING_LED_PIN, LOW);
+    if (!sent) {
+        std::lock_guard<std::mutex> lock(rateMutex);
+        txRate.onBackpressure(steadyMillis());
+    }
+}
+
+void NMEAWaypointHandler::setTransmitSettings(const TransmitRateSettings &settings) {
+    std::lock_guard<std::mutex> lock(rateMutex);
+    txRate.setSettings(settings);
+}
+
+// Callers without a vendor in mind get the plain NMEA 2000 name rules.
+static EncodedWaypoint encodeForAnyPlotter(const std::string& name, double latitude, double longitude) {
+    static const VendorProfile profile = defaultVendorProfiles().front();
+    Waypoint waypoint;
+    waypoint.name = name;
+    waypoint.latitude = latitude;
+    waypoint.longitude = longitude;
+    return encodeWaypoint(waypoint, profile);
 }
 
 void NMEAWaypointHandler::addWaypoint(uint16_t waypointID, const std::string& name, double latitude, double longitude) {
-    if (waypointMap.find(waypointID) != waypointMap.end()) {
-        std::cerr << "Waypoint ID " << waypointID << " already exists. Use updateWaypoint to modify it." << std::endl;
-        return;
+    addWaypoint(waypointID, encodeForAnyPlotter(name, latitude, longitude));
+}
+
+void NMEAWaypointHandler::updateWaypoint(uint16_t waypointID, const std::string &newName, double latitude, double longitude) {
+    updateWaypoint(waypointID, encodeForAnyPlotter(newName, latitude, longitude));
+}
+
+void NMEAWaypointHandler::addWaypoint(uint16_t waypointID, const EncodedWaypoint& encoded) {
+    {
+        std::lock_guard<std::mutex> lock(waypointMutex);
+        if (waypointMap.find(waypointID) != waypointMap.end()) {
+            std::cerr << "Waypoint ID " << waypointID << " already exists. Use updateWaypoint to modify it." << std::endl;
+            return;
+        }
+
+        waypointMap[waypointID] = {encoded.name, {encoded.latitude, encoded.longitude}};
+    }
+
+    broadcastWaypoint(waypointID, encoded);
+}
+
+void NMEAWaypointHandler::updateWaypoint(uint16_t waypointID, const EncodedWaypoint& encoded) {
+    {
+        std::lock_guard<std::mutex> lock(waypointMutex);
+        waypointMap[waypointID] = {encoded.name, {encoded.latitude, encoded.longitude}};
     }
 
-    waypointMap[waypointID] = {name, {latitude, longitude}};
+    broadcastWaypoint(waypointID, encoded);
+}
 
-    // Send PGN (placeholder, customize for each vendor)
+void NMEAWaypointHandler::broadcastWaypoint(uint16_t waypointID, const EncodedWaypoint& encoded) {
+    // Single-entry WP list; vendor specific PGNs can follow the same schema route
     tN2kMsg msg;
-    msg.SetPGN(PGN_WAYPOINT_LIST);  // Replace with Garmin or Humminbird PGN when known
+    WaypointListPgn::encodeHeader(msg, waypointID, 0, 1, 0, {});
+    if (!appendWaypointRecord(msg, waypointID, encoded)) {
+        std::cerr << "Waypoint " << encoded.name << " does not fit in a waypoint list message." << std::endl;
+        return;
+    }
     msg.Priority = 3;
     msg.Source = 1;
     msg.Destination = 255; // broadcast to all
 
-    msg.Add8ByteDouble(latitude, 1e-7, N2kDoubleNA);
-    msg.Add8ByteDouble(longitude, 1e-7, N2kDoubleNA);
-    msg.AddStr(name.c_str(), strlen(name.c_str()), false);
 
-    
+    std::cout << "Broadcasting waypoint on " << busName << ": " << encoded.name << " @ [" << encoded.latitude << ", "
+              << encoded.longitude << "]" << std::endl;
+    transmit(msg);
+}
 
+// The whole route goes out as a handful of PGN 129285 fast-packet messages
+// instead of one waypoint broadcast per leg.
+void NMEAWaypointHandler::sendRoute(const Route& route, const WaypointCollection& collection) {
+    std::vector<tN2kMsg> messages = buildRouteMessages(route, collection);
 
-    std::cout << "Broadcasting waypoint: " << name << " @ [" << latitude << ", " << longitude << "]" << std::endl;
-    digitalWrite(TRANSMITTING_LED_PIN, HIGH);
-    nmea2000->SendMsg(msg);
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    digitalWrite(TRANSMITTING_LED_PIN, LOW);
+    std::cout << "Broadcasting route on " << busName << ": " << route.name << " (" << route.legs.size()
+              << " legs in " << messages.size() << " messages)" << std::endl;
+    for (auto &msg : messages) {
+        msg.Destination = 255; // broadcast to all
+        transmit(msg);
+    }
 }
 
 void NMEAWaypointHandler::enableMockMode(const std::vector<std::string>& devices) {
@@ -132,21 +632,36 @@ void NMEAWaypointHandler::enableMockMode(const std::vector<std::string>& devices
     mockDevices = devices;
 }
 
-const std::vector<std::string>& NMEAWaypointHandler::getDetectedDevices() {
-    detectedDevices.clear();
+// The device list is filled in by ParseMessages(), so while the bus runs
+// it is only read from the bus thread.
+std::vector<std::string> NMEAWaypointHandler::getDetectedDevices() {
+    if (mockMode || std::this_thread::get_id() == busThreadId) {
+        return readDetectedDevices();
+    }
+    std::promise<std::vector<std::string>> devices;
+    std::future<std::vector<std::string>> result = devices.get_future();
+    if (!runOnBusThread([this, &devices] { devices.set_value(readDetectedDevices()); })) {
+        return readDetectedDevices();
+    }
+    return result.get();
+}
 
+std::vector<std::string> NMEAWaypointHandler::readDetectedDevices() const {
     if (mockMode) {
-        detectedDevices = mockDevices;
-        return detectedDevices;
+        return mockDevices;
     }
 
-    for (uint8_t i = 0; i < deviceList->Count(); ++i) {
-        const tNMEA2000::tDevice* device = deviceList->FindDeviceBySource(i);
+    std::vector<std::string> detectedDevices;
+    if (!deviceList) {
+        return detectedDevices;
+    }
+    // The device list is indexed by source address, not by position.
+    for (uint8_t source = 0; source <= N2K_MAX_SOURCE_ADDRESS; ++source) {
+        const tNMEA2000::tDevice* device = deviceList->FindDeviceBySource(source);
         if (device) {
-            uint64_t deviceName = device->GetName();
-            auto it = deviceNameMap.find(deviceName);
-            if (it != deviceNameMap.end()) {
-                detectedDevices.push_back(it->second);
+            const VendorPlugin* plugin = vendorPlugins.findByManufacturer(device->GetManufacturerCode());
+            if (plugin && std::find(detectedDevices.begin(), detectedDevices.end(), plugin->name) == detectedDevices.end()) {
+                detectedDevices.push_back(plugin->name);
             }
         }
     }
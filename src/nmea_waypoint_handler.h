@@ -9,41 +9,202 @@
 #include "N2kDeviceList.h"
 #include <iostream>
 #include <unordered_map>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "bus_load.h"
+#include "event_loop.h"
+#include "pgn_dispatcher.h"
+#include "route.h"
+#include "socketcan_node.h"
+#include "spsc_queue.h"
+#include "vendor_plugins.h"
+#include "vendor_profiles.h"
+#include "waypoint.h"
+#include "waypoint_selection.h"
 
 class SyncManager;
 
+// Decoded waypoints travel from a bus thread to the sync worker through this.
+using WaypointEventQueue = SpscQueue<Waypoint, 256>;
+
+// A proprietary frame from a known vendor, kept raw for offline decoding.
+struct CapturedFrame {
+    std::string vendor;
+    tN2kMsg msg;
+};
+using CapturedFrameQueue = SpscQueue<CapturedFrame, 64>;
+
 class NMEAWaypointHandler {
 protected:
     std::unique_ptr<tNMEA2000> nmea2000;
     std::unique_ptr<tN2kDeviceList> deviceList;
     SyncManager& syncManager;
-    std::vector<std::string> detectedDevices;
     bool mockMode = false;
     std::vector<std::string> mockDevices;
-    static NMEAWaypointHandler* instance;
 
     void handleWaypointList(const tN2kMsg &N2kMsg);
     void detectConnectedDevices();
+    void transmit(const tN2kMsg &msg);
+    void sendNow(const tN2kMsg &msg);
+    void sendPaced(const tN2kMsg &msg);
+    bool queueWaypoint(Waypoint&& waypoint, unsigned char source);
+    void handlePosition(const tN2kMsg &N2kMsg);
 
 private:
+    // Per-instance receive hook, attached to this handler's own tNMEA2000 so
+    // several buses can dispatch into their own handler without a global.
+    class BusMessageHandler : public tNMEA2000::tMsgHandler {
+    public:
+        explicit BusMessageHandler(NMEAWaypointHandler& owner) : tNMEA2000::tMsgHandler(0), owner(owner) {}
+        void HandleMsg(const tN2kMsg &N2kMsg) override { owner.OnN2kMessage(N2kMsg); }
+    private:
+        NMEAWaypointHandler& owner;
+    };
+
     std::unordered_map<uint16_t, std::pair<std::string, std::pair<double, double>>> waypointMap;
+    std::mutex waypointMutex;
+    std::string busName;
+    BusMessageHandler busMessageHandler;
+    // Peers may be added while the bus runs; only bridged PGNs take the lock.
+    std::mutex bridgeMutex;
+    std::vector<NMEAWaypointHandler*> bridgePeers;
+    // Set when a peer is added after start(): the bus thread, which owns
+    // the socket, widens its receive filter on its next pass.
+    std::atomic<bool> receiveFilterStale{false};
+    PgnDispatcher dispatcher;
+    VendorPluginRegistry vendorPlugins = defaultVendorPlugins();
+
+    // Bus thread state: the thread owns nmea2000 once started, everything
+    // else hands outgoing messages over through txQueue.
+    std::thread busThread;
+    std::atomic<bool> running{false};
+    std::mutex txMutex;
+    std::deque<tN2kMsg> txQueue;
+    // Counted under txMutex so callers can wait for "everything queued so
+    // far has gone out"; each waiter holds the queued count it needs.
+    uint64_t queuedMessages = 0;
+    uint64_t sentMessages = 0;
+    std::deque<std::pair<uint64_t, std::function<void()>>> transmitWaiters;
+    // Work that must see nmea2000 and the device list from the bus thread,
+    // such as device list reads from the sync worker. Closed once the bus
+    // thread stops parsing.
+    std::mutex busTaskMutex;
+    std::deque<std::function<void()>> busTasks;
+    bool busTasksOpen = false;
+    std::atomic<std::thread::id> busThreadId;
+    // Set when nmea2000 is a SocketCanNode: the bus thread then sleeps in
+    // poll() instead of a fixed tick, and queuing a message wakes it.
+    SocketCanNode *socketCanNode = nullptr;
+
+    // Transmit pacing: the bus thread samples bus load a few times a
+    // second and the rate controller decides how fast txQueue drains.
+    BusCounterSource *busCounterSource = nullptr;
+    BusLoadMonitor busLoad;
+    std::mutex rateMutex;  // Guards txRate; taken after txMutex
+    TransmitRateController txRate;
+    uint64_t lastLoadSampleMs = 0;
+    std::atomic<double> busUtilisation{0.0};
+    std::atomic<double> transmitRate{0.0};
+
+    // Produced only by this bus's receive path, consumed only by the
+    // SyncManager sync worker.
+    WaypointEventQueue waypointEvents;
+    std::atomic<unsigned long> droppedWaypointEvents{0};
+    // Same hand-off for raw capture; the sync worker writes the log file.
+    CapturedFrameQueue capturedFrames;
+    std::atomic<unsigned long> droppedCapturedFrames{0};
+
+    // Latest own-ship fix heard on this bus, read by the sync worker.
+    std::mutex positionMutex;
+    OwnShipPosition ownShipPosition;
+
+    void configureBus();
+    void registerVendorPgns(const VendorPlugin& plugin);
+    uint16_t manufacturerOf(unsigned char source) const;
+    void busLoop();
+    void applyReceiveFilter();
+    bool runOnBusThread(std::function<void()> task);
+    void runBusTasks(bool close = false);
+    std::vector<std::string> readDetectedDevices() const;
+    void waitForBusActivity();
+    void flushTransmitQueue();
+    void markTransmitted(size_t count, bool releaseAll = false);
+    void sampleBusLoad();
+    void broadcastWaypoint(uint16_t waypointID, const EncodedWaypoint& encoded);
 
 public:
-    NMEAWaypointHandler(SyncManager& sm, std::unique_ptr<tNMEA2000> nmea2000Instance);
+    NMEAWaypointHandler(SyncManager& sm, std::unique_ptr<tNMEA2000> nmea2000Instance, const std::string& busName = "can0");
     ~NMEAWaypointHandler();
     
     void convertAndSendWaypoint(const std::string& waypointData, const std::string& format);
     void addWaypoint(uint16_t waypointID, const std::string& name, double latitude, double longitude);
+    // Re-sends an ID we already used with new content; plotters that key
+    // waypoints by ID overwrite it in place.
     void updateWaypoint(uint16_t waypointID, const std::string &newName, double latitude, double longitude);
+    // Already normalised for the plotters on this bus; the record is copied
+    // into the message as is.
+    void addWaypoint(uint16_t waypointID, const EncodedWaypoint& encoded);
+    void updateWaypoint(uint16_t waypointID, const EncodedWaypoint& encoded);
+    void sendRoute(const Route& route, const WaypointCollection& collection);
     void start();
+    void stop();
     void OnN2kMessage(const tN2kMsg &N2kMsg);
-    static void MessageHandler(const tN2kMsg &N2kMsg);
-    const std::vector<std::string>& getDetectedDevices();
+    // Safe from any thread: while the bus runs the device list is read on
+    // the bus thread.
+    std::vector<std::string> getDetectedDevices();
     void enableMockMode(const std::vector<std::string>& devices);
 
-    void setNMEA2000(std::unique_ptr<tNMEA2000> nmea2000Instance) {
-    nmea2000 = std::move(nmea2000Instance);
-}
+    // Bridge mode: route and waypoint PGNs received on this bus are re-sent
+    // on peer. Can be wired before or after start().
+    void bridgeTo(NMEAWaypointHandler& peer);
+    void forwardMessage(const tN2kMsg &N2kMsg);
+
+    // Adds (or replaces) a vendor's PGN decoders. Must be called before start().
+    void registerVendorPlugin(const VendorPlugin& plugin);
+    const PgnDispatcher& getDispatcher() const { return dispatcher; }
+    // Queues every known vendor's proprietary frames for the sync worker
+    // to log. Widens the receive filter, so off unless configured. Must be
+    // called before start().
+    void enableProprietaryCapture();
+    CapturedFrameQueue& getCapturedFrames() { return capturedFrames; }
+    unsigned long getDroppedCapturedFrames() const { return droppedCapturedFrames; }
+
+    WaypointEventQueue& getWaypointEvents() { return waypointEvents; }
+    unsigned long getDroppedWaypointEvents() const { return droppedWaypointEvents; }
+    OwnShipPosition getOwnShipPosition();
+
+    void setTransmitSettings(const TransmitRateSettings &settings);
+    // Calls done, on the bus thread, once every message queued before the
+    // call has been sent; at once if nothing is waiting.
+    void whenTransmitted(std::function<void()> done);
+
+    // co_await transmitted(loop) resumes on the loop once the paced queue
+    // has caught up with everything sent so far.
+    class TransmittedAwaiter {
+    public:
+        TransmittedAwaiter(NMEAWaypointHandler &handler, EventLoop &loop) : handler(handler), loop(loop) {}
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> awaiting) {
+            handler.whenTransmitted([&loop = loop, awaiting] { loop.post([awaiting] { awaiting.resume(); }); });
+        }
+        void await_resume() const noexcept {}
+
+    private:
+        NMEAWaypointHandler &handler;
+        EventLoop &loop;
+    };
+    TransmittedAwaiter transmitted(EventLoop &loop) { return TransmittedAwaiter(*this, loop); }
+    // Smoothed share of the bus in use and our current frame rate, as of
+    // the bus thread's last load sample.
+    double getBusUtilisation() const { return busUtilisation; }
+    double getTransmitRate() const { return transmitRate; }
+
+    void setNMEA2000(std::unique_ptr<tNMEA2000> nmea2000Instance);
+    const std::string& getBusName() const { return busName; }
+    bool isRunning() const { return running; }
     bool isMockMode() const { return mockMode; }
     friend class NMEAWaypointHandlerTest;
 };
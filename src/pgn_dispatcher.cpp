@@ -0,0 +1,75 @@
+#include "pgn_dispatcher.h"
+#include <algorithm>
+
+void PgnDispatcher::registerHandler(unsigned long pgn, uint16_t manufacturerCode, Handler handler) {
+    Entry entry{pgn, manufacturerCode, std::move(handler)};
+
+    // Keep entries grouped by PGN, and within a PGN keep registration order.
+    auto position = std::upper_bound(entries.begin(), entries.end(), pgn,
+                                     [](unsigned long value, const Entry &e) { return value < e.pgn; });
+    entries.insert(position, std::move(entry));
+    pgnFilter.set(filterSlot(pgn));
+}
+
+void PgnDispatcher::unregisterManufacturer(uint16_t manufacturerCode) {
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [manufacturerCode](const Entry &e) { return e.manufacturerCode == manufacturerCode; }),
+                  entries.end());
+    pgnFilter.reset();
+    for (const auto &entry : entries) {
+        pgnFilter.set(filterSlot(entry.pgn));
+    }
+}
+
+void PgnDispatcher::setManufacturerLookup(ManufacturerLookup lookup) {
+    manufacturerLookup = std::move(lookup);
+}
+
+bool PgnDispatcher::dispatch(const tN2kMsg &msg) const {
+    const unsigned long pgn = msg.PGN;
+    if (!pgnFilter.test(filterSlot(pgn))) {
+        return false;
+    }
+
+    auto it = std::lower_bound(entries.begin(), entries.end(), pgn,
+                               [](const Entry &e, unsigned long value) { return e.pgn < value; });
+
+    bool handled = false;
+    bool manufacturerResolved = false;
+    uint16_t manufacturerCode = AnyManufacturer;
+
+    for (; it != entries.end() && it->pgn == pgn; ++it) {
+        if (it->manufacturerCode != AnyManufacturer) {
+            // Only pay for the device list lookup when a vendor entry needs it.
+            if (!manufacturerResolved) {
+                manufacturerCode = manufacturerLookup ? manufacturerLookup(msg.Source) : AnyManufacturer;
+                manufacturerResolved = true;
+            }
+            if (it->manufacturerCode != manufacturerCode) {
+                continue;
+            }
+        }
+        it->handler(msg);
+        handled = true;
+    }
+    return handled;
+}
+
+bool PgnDispatcher::handles(unsigned long pgn) const {
+    if (!pgnFilter.test(filterSlot(pgn))) {
+        return false;
+    }
+    auto it = std::lower_bound(entries.begin(), entries.end(), pgn,
+                               [](const Entry &e, unsigned long value) { return e.pgn < value; });
+    return it != entries.end() && it->pgn == pgn;
+}
+
+std::vector<unsigned long> PgnDispatcher::registeredPgns() const {
+    std::vector<unsigned long> pgns;
+    for (const auto &entry : entries) {
+        if (pgns.empty() || pgns.back() != entry.pgn) {
+            pgns.push_back(entry.pgn);
+        }
+    }
+    return pgns;
+}
@@ -0,0 +1,50 @@
+#ifndef PGN_DISPATCHER_H
+#define PGN_DISPATCHER_H
+
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "N2kMsg.h"
+
+// Routes received messages to handlers registered per PGN and, optionally,
+// per manufacturer code of the sending device.
+//
+// Handlers live in a flat array sorted by PGN. A 256-bit filter keyed on
+// the PGN lets unrelated traffic out with a single test. Everything must be
+// registered before the bus thread starts dispatching.
+class PgnDispatcher {
+public:
+    using Handler = std::function<void(const tN2kMsg &)>;
+    using ManufacturerLookup = std::function<uint16_t(unsigned char source)>;
+
+    static constexpr uint16_t AnyManufacturer = 0xffff;
+
+    void registerHandler(unsigned long pgn, uint16_t manufacturerCode, Handler handler);
+    // Drops every handler registered for a manufacturer, so a vendor's
+    // decoders can be replaced rather than run alongside the old ones.
+    void unregisterManufacturer(uint16_t manufacturerCode);
+    void setManufacturerLookup(ManufacturerLookup lookup);
+
+    // Runs every handler matching the message. Returns true if any ran.
+    bool dispatch(const tN2kMsg &msg) const;
+    bool handles(unsigned long pgn) const;
+
+    std::vector<unsigned long> registeredPgns() const;
+    size_t size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        unsigned long pgn;
+        uint16_t manufacturerCode;
+        Handler handler;
+    };
+
+    static size_t filterSlot(unsigned long pgn) { return (pgn ^ (pgn >> 8)) & 0xff; }
+
+    std::vector<Entry> entries;
+    std::bitset<256> pgnFilter;
+    ManufacturerLookup manufacturerLookup;
+};
+
+#endif // PGN_DISPATCHER_H
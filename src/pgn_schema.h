@@ -0,0 +1,377 @@
+#ifndef PGN_SCHEMA_H
+#define PGN_SCHEMA_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ratio>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "N2kMsg.h"
+
+// Compile-time description of NMEA 2000 PGN layouts.
+//
+// A PGN is declared once as a list of field types (width, resolution, NA
+// value) plus an optional repeating group. The encoder writes each field
+// straight into tN2kMsg::Data; the decoder returns typed values and
+// string_views that point into the message itself. There is no runtime field
+// table: every field access compiles down to the field's own read/write.
+namespace pgn_schema {
+
+// Little-endian integer field, optionally scaled by Resolution.
+// Unscaled fields carry integers, scaled fields carry doubles with
+// N2kDoubleNA standing in for "not available".
+template <size_t Bytes, typename Resolution = std::ratio<1>, bool Signed = false>
+struct Number {
+    static_assert(Bytes >= 1 && Bytes <= 8, "NMEA 2000 numbers are 1 to 8 bytes wide");
+
+    static constexpr bool fixedSize = true;
+    static constexpr size_t minSize = Bytes;
+    static constexpr bool scaled = !(Resolution::num == 1 && Resolution::den == 1);
+
+    using raw_type = std::conditional_t<Signed, int64_t, uint64_t>;
+    using value_type = std::conditional_t<scaled, double, raw_type>;
+
+    // All ones for unsigned fields, max positive for signed ones.
+    static constexpr raw_type na = Signed
+        ? static_cast<raw_type>((uint64_t(1) << (Bytes * 8 - 1)) - 1)
+        : static_cast<raw_type>(Bytes == 8 ? ~uint64_t(0) : (uint64_t(1) << (Bytes * 8)) - 1);
+    static constexpr raw_type minRaw = Signed ? -na - 1 : 0;
+
+    static constexpr size_t encodedSize(const value_type &) { return Bytes; }
+    static size_t byteSize(const unsigned char *) { return Bytes; }
+
+    static void write(unsigned char *p, const value_type &value) {
+        uint64_t raw = static_cast<uint64_t>(toRaw(value));
+        for (size_t i = 0; i < Bytes; ++i) {
+            p[i] = static_cast<unsigned char>(raw >> (8 * i));
+        }
+    }
+
+    static value_type read(const unsigned char *p) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < Bytes; ++i) {
+            bits |= uint64_t(p[i]) << (8 * i);
+        }
+        raw_type raw;
+        if constexpr (Signed && Bytes < 8) {
+            const uint64_t signBit = uint64_t(1) << (Bytes * 8 - 1);
+            raw = static_cast<raw_type>((bits ^ signBit) - signBit);
+        } else {
+            raw = static_cast<raw_type>(bits);
+        }
+
+        if constexpr (scaled) {
+            if (raw == na) {
+                return N2kDoubleNA;
+            }
+            return static_cast<double>(raw) * Resolution::num / Resolution::den;
+        } else {
+            return raw;
+        }
+    }
+
+    static bool isNA(const value_type &value) {
+        if constexpr (scaled) {
+            return value == N2kDoubleNA;
+        } else {
+            return value == na;
+        }
+    }
+
+private:
+    // Out-of-range values go on the wire as NA rather than wrapping.
+    static raw_type toRaw(const value_type &value) {
+        if constexpr (scaled) {
+            if (value == N2kDoubleNA || std::isnan(value)) {
+                return na;
+            }
+            double scaledValue = std::round(value * Resolution::den / Resolution::num);
+            if (scaledValue < static_cast<double>(minRaw) || scaledValue >= static_cast<double>(na)) {
+                return na;
+            }
+            return static_cast<raw_type>(scaledValue);
+        } else {
+            if (value < minRaw || value > na) {
+                return na;
+            }
+            return value;
+        }
+    }
+};
+
+template <size_t Bytes>
+using UInt = Number<Bytes>;
+
+template <size_t Bytes>
+using Int = Number<Bytes, std::ratio<1>, true>;
+
+template <size_t Bytes, typename Resolution>
+using UScaled = Number<Bytes, Resolution, false>;
+
+template <size_t Bytes, typename Resolution>
+using Scaled = Number<Bytes, Resolution, true>;
+
+// Reserved bits: always written as all ones, never read. Pass {} to encode.
+struct ReservedValue {};
+
+template <size_t Bytes>
+struct Reserved {
+    static constexpr bool fixedSize = true;
+    static constexpr size_t minSize = Bytes;
+    using value_type = ReservedValue;
+
+    static constexpr size_t encodedSize(const value_type &) { return Bytes; }
+    static size_t byteSize(const unsigned char *) { return Bytes; }
+    static void write(unsigned char *p, const value_type &) { std::memset(p, 0xff, Bytes); }
+    static value_type read(const unsigned char *) { return {}; }
+};
+
+// Variable length STRING_LAU: length byte (including the two header
+// bytes), encoding byte (1 = ASCII), then the characters. Longer input is
+// cut at MaxChars.
+template <size_t MaxChars>
+struct StringLAU {
+    static_assert(MaxChars <= 253, "STRING_LAU length must fit in one byte");
+
+    static constexpr bool fixedSize = false;
+    static constexpr size_t minSize = 2;
+    using value_type = std::string_view;
+
+    static size_t encodedSize(const value_type &value) {
+        return 2 + (value.size() < MaxChars ? value.size() : MaxChars);
+    }
+
+    static size_t byteSize(const unsigned char *p) { return p[0] < 2 ? 2 : p[0]; }
+
+    static void write(unsigned char *p, const value_type &value) {
+        size_t length = encodedSize(value) - 2;
+        p[0] = static_cast<unsigned char>(length + 2);
+        p[1] = 1;
+        std::memcpy(p + 2, value.data(), length);
+    }
+
+    static value_type read(const unsigned char *p) {
+        size_t length = p[0] < 2 ? 0 : p[0] - 2;
+        return value_type(reinterpret_cast<const char *>(p + 2), length);
+    }
+};
+
+template <typename... F>
+struct Fields {};
+
+namespace detail {
+
+template <size_t Index, typename... F>
+using FieldAt = std::tuple_element_t<Index, std::tuple<F...>>;
+
+template <size_t Count, typename... F>
+constexpr bool allFixedBefore() {
+    constexpr bool fixed[] = {F::fixedSize..., true};
+    for (size_t i = 0; i < Count; ++i) {
+        if (!fixed[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <size_t Count, typename... F>
+constexpr size_t fixedOffsetOf() {
+    constexpr size_t sizes[] = {F::minSize..., 0};
+    size_t offset = 0;
+    for (size_t i = 0; i < Count; ++i) {
+        offset += sizes[i];
+    }
+    return offset;
+}
+
+// Walks the fields starting at base, recording each field's offset and
+// refusing anything that would read past available.
+template <typename... F>
+bool layout(const unsigned char *base, size_t available, std::array<size_t, sizeof...(F)> &offsets, size_t &end) {
+    size_t offset = 0;
+    size_t index = 0;
+    bool fits = true;
+    auto place = [&](auto minSize, auto byteSize) {
+        if (!fits || offset + minSize > available) {
+            fits = false;
+            return;
+        }
+        size_t size = byteSize(base + offset);
+        if (offset + size > available) {
+            fits = false;
+            return;
+        }
+        offsets[index++] = offset;
+        offset += size;
+    };
+    (place(F::minSize, &F::byteSize), ...);
+    end = offset;
+    return fits;
+}
+
+} // namespace detail
+
+template <unsigned long PGNValue, unsigned char DefaultPriority, typename Header, typename Item = Fields<>, size_t CountIndex = 0>
+struct Pgn;
+
+// Header fields H are sent once; item fields I repeat, with the header
+// field at CountIndex holding the number of items.
+template <unsigned long PGNValue, unsigned char DefaultPriority, typename... H, typename... I, size_t CountIndex>
+struct Pgn<PGNValue, DefaultPriority, Fields<H...>, Fields<I...>, CountIndex> {
+    static constexpr unsigned long pgn = PGNValue;
+    static constexpr unsigned char priority = DefaultPriority;
+    static constexpr bool hasItems = sizeof...(I) > 0;
+
+    static_assert(sizeof...(H) > 0, "A PGN needs at least one header field");
+    static_assert(!hasItems || CountIndex < sizeof...(H), "Count field index out of range");
+
+    using CountField = detail::FieldAt<CountIndex, H...>;
+    static_assert(!hasItems || detail::allFixedBefore<CountIndex + 1, H...>(),
+                  "The item count must sit at a fixed offset");
+    static constexpr size_t countOffset = detail::fixedOffsetOf<CountIndex, H...>();
+
+    // Starts a fresh message with just the header. Returns false if the
+    // header alone would not fit.
+    static bool encodeHeader(tN2kMsg &msg, const typename H::value_type &...values) {
+        msg.SetPGN(pgn);
+        msg.Priority = priority;
+        msg.DataLen = 0;
+
+        size_t total = (H::encodedSize(values) + ...);
+        if (total > static_cast<size_t>(tN2kMsg::MaxDataLen)) {
+            return false;
+        }
+
+        unsigned char *p = msg.Data;
+        ((H::write(p, values), p += H::encodedSize(values)), ...);
+        msg.DataLen = static_cast<int>(total);
+        return true;
+    }
+
+    // Appends one repeating-group entry and bumps the count field. Returns
+    // false, leaving the message untouched, once the message is full.
+    static bool appendItem(tN2kMsg &msg, const typename I::value_type &...values) {
+        static_assert(hasItems, "This PGN has no repeating group");
+
+        size_t total = (I::encodedSize(values) + ...);
+        if (msg.DataLen < 0 || static_cast<size_t>(msg.DataLen) + total > static_cast<size_t>(tN2kMsg::MaxDataLen)) {
+            return false;
+        }
+
+        unsigned char *p = msg.Data + msg.DataLen;
+        ((I::write(p, values), p += I::encodedSize(values)), ...);
+        msg.DataLen += static_cast<int>(total);
+
+        auto count = CountField::read(msg.Data + countOffset);
+        CountField::write(msg.Data + countOffset, CountField::isNA(count) ? 1 : count + 1);
+        return true;
+    }
+
+    // Encodes one repeating-group entry on its own, for callers that cache
+    // entries and add them later with appendEncodedItem().
+    static void encodeItem(std::vector<unsigned char> &item, const typename I::value_type &...values) {
+        static_assert(hasItems, "This PGN has no repeating group");
+
+        item.resize((I::encodedSize(values) + ...));
+        unsigned char *p = item.data();
+        ((I::write(p, values), p += I::encodedSize(values)), ...);
+    }
+
+    // appendItem() for an entry from encodeItem().
+    static bool appendEncodedItem(tN2kMsg &msg, const std::vector<unsigned char> &item) {
+        static_assert(hasItems, "This PGN has no repeating group");
+
+        if (msg.DataLen < 0 || static_cast<size_t>(msg.DataLen) + item.size() > static_cast<size_t>(tN2kMsg::MaxDataLen)) {
+            return false;
+        }
+        std::memcpy(msg.Data + msg.DataLen, item.data(), item.size());
+        msg.DataLen += static_cast<int>(item.size());
+
+        auto count = CountField::read(msg.Data + countOffset);
+        CountField::write(msg.Data + countOffset, CountField::isNA(count) ? 1 : count + 1);
+        return true;
+    }
+
+    // Typed, zero-copy view of one repeating-group entry.
+    class ItemView {
+    public:
+        ItemView(const unsigned char *base, size_t available) : base(base) {
+            valid = detail::layout<I...>(base, available, offsets, length);
+        }
+
+        template <size_t Index>
+        auto get() const {
+            using F = detail::FieldAt<Index, I...>;
+            return F::read(base + offsets[Index]);
+        }
+
+        bool isValid() const { return valid; }
+        size_t size() const { return length; }
+
+    private:
+        const unsigned char *base;
+        std::array<size_t, sizeof...(I)> offsets{};
+        size_t length = 0;
+        bool valid = false;
+    };
+
+    // Typed, zero-copy view over a received message. Every offset is bounds
+    // checked against DataLen before anything is read.
+    class View {
+    public:
+        explicit View(const tN2kMsg &msg) : msg(msg) {
+            valid = msg.PGN == pgn && msg.DataLen > 0 &&
+                    detail::layout<H...>(msg.Data, static_cast<size_t>(msg.DataLen), offsets, itemsOffset);
+        }
+
+        bool isValid() const { return valid; }
+
+        template <size_t Index>
+        auto header() const {
+            using F = detail::FieldAt<Index, H...>;
+            return F::read(msg.Data + offsets[Index]);
+        }
+
+        size_t itemCount() const {
+            static_assert(hasItems, "This PGN has no repeating group");
+            auto count = CountField::read(msg.Data + countOffset);
+            return CountField::isNA(count) ? 0 : static_cast<size_t>(count);
+        }
+
+        // Calls fn(const ItemView&) for each entry in order. Returns false if
+        // the message was truncated or malformed part way through.
+        template <typename Fn>
+        bool forEachItem(Fn &&fn) const {
+            if (!valid) {
+                return false;
+            }
+            size_t offset = itemsOffset;
+            size_t available = static_cast<size_t>(msg.DataLen);
+            for (size_t i = 0; i < itemCount(); ++i) {
+                ItemView item(msg.Data + offset, available - offset);
+                if (!item.isValid()) {
+                    return false;
+                }
+                fn(item);
+                offset += item.size();
+            }
+            return true;
+        }
+
+    private:
+        const tN2kMsg &msg;
+        std::array<size_t, sizeof...(H)> offsets{};
+        size_t itemsOffset = 0;
+        bool valid = false;
+    };
+};
+
+} // namespace pgn_schema
+
+#endif // PGN_SCHEMA_H
@@ -0,0 +1,93 @@
+#include "route.h"
+#include "waypoint_pgns.h"
+#include <cmath>
+#include <iostream>
+
+// Positions closer than the 1e-7 degree wire resolution are the same point.
+const double SAME_POSITION_EPSILON = 1e-7;
+
+uint32_t WaypointCollection::add(const Waypoint &waypoint) {
+    auto [first, last] = nameIndex.equal_range(waypoint.name);
+    for (auto it = first; it != last; ++it) {
+        const Waypoint &existing = waypointList[it->second];
+        if (std::fabs(existing.latitude - waypoint.latitude) < SAME_POSITION_EPSILON &&
+            std::fabs(existing.longitude - waypoint.longitude) < SAME_POSITION_EPSILON) {
+            return it->second;
+        }
+    }
+
+    uint32_t index = static_cast<uint32_t>(waypointList.size());
+    nameIndex.emplace(waypoint.name, index);
+    waypointList.push_back(waypoint);
+    Waypoint &added = waypointList.back();
+    if (added.id == 0) {
+        added.id = nextWaypointId;
+    }
+    if (added.id >= nextWaypointId) {
+        nextWaypointId = static_cast<uint16_t>(added.id + 1);
+    }
+    return index;
+}
+
+std::optional<uint32_t> WaypointCollection::findByName(const std::string &name) const {
+    auto it = nameIndex.find(name);
+    if (it == nameIndex.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+Route &WaypointCollection::addRoute(const std::string &name) {
+    Route route;
+    route.id = nextRouteId++;
+    route.name = name;
+    routeList.push_back(std::move(route));
+    return routeList.back();
+}
+
+void WaypointCollection::clear() {
+    waypointList.clear();
+    routeList.clear();
+    nameIndex.clear();
+    nextRouteId = 1;
+    nextWaypointId = 1;
+}
+
+std::vector<std::string> WaypointCollection::legNames(const Route &route) const {
+    std::vector<std::string> names;
+    names.reserve(route.legs.size());
+    for (uint32_t leg : route.legs) {
+        names.push_back(waypointList[leg].name);
+    }
+    return names;
+}
+
+std::vector<tN2kMsg> buildRouteMessages(const Route &route, const WaypointCollection &collection, uint16_t databaseId) {
+    std::vector<tN2kMsg> messages;
+
+    size_t leg = 0;
+    while (leg < route.legs.size() || messages.empty()) {
+        messages.emplace_back();
+        tN2kMsg &msg = messages.back();
+        RouteWaypointPgn::encodeHeader(msg, static_cast<uint16_t>(leg), 0, databaseId, route.id,
+                                       ROUTE_FLAGS_FORWARD, route.name, {});
+
+        size_t firstLeg = leg;
+        for (; leg < route.legs.size(); ++leg) {
+            const Waypoint &waypoint = collection.at(route.legs[leg]);
+            if (!RouteWaypointPgn::appendItem(msg, waypoint.id, waypoint.name, waypoint.latitude, waypoint.longitude)) {
+                break;
+            }
+        }
+
+        if (leg == firstLeg && leg < route.legs.size()) {
+            std::cerr << "Route " << route.name << " leg " << leg << " does not fit in a PGN 129285 message." << std::endl;
+            messages.pop_back();
+            break;
+        }
+        if (route.legs.empty()) {
+            break;
+        }
+    }
+    return messages;
+}
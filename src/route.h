@@ -0,0 +1,50 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "N2kMsg.h"
+#include "waypoint.h"
+
+// A route is an ordered list of indices into the collection's shared
+// waypoint array; a waypoint used by several routes is stored once.
+struct Route {
+    uint16_t id = 0;
+    std::string name;
+    std::vector<uint32_t> legs;
+};
+
+class WaypointCollection {
+public:
+    // Adds a waypoint, or returns the index of an identical existing one
+    // (same name and position).
+    uint32_t add(const Waypoint &waypoint);
+    std::optional<uint32_t> findByName(const std::string &name) const;
+
+    Route &addRoute(const std::string &name);
+
+    const Waypoint &at(uint32_t index) const { return waypointList[index]; }
+    const std::vector<Waypoint> &waypoints() const { return waypointList; }
+    const std::vector<Route> &routes() const { return routeList; }
+    std::vector<Route> &routes() { return routeList; }
+    void clear();
+
+    // Names of a route's legs in order, for outputs that reference by name.
+    std::vector<std::string> legNames(const Route &route) const;
+
+private:
+    std::vector<Waypoint> waypointList;
+    std::vector<Route> routeList;
+    std::unordered_multimap<std::string, uint32_t> nameIndex;
+    uint16_t nextRouteId = 1;
+    uint16_t nextWaypointId = 1;
+};
+
+// Encodes a route as PGN 129285 messages, packing as many legs into each
+// fast-packet message as will fit.
+std::vector<tN2kMsg> buildRouteMessages(const Route &route, const WaypointCollection &collection, uint16_t databaseId = 0);
+
+#endif // ROUTE_H
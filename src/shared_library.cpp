@@ -0,0 +1,293 @@
+#include "shared_library.h"
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace shared_library {
+
+namespace {
+
+size_t alignTo(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+size_t bufferBytes(uint32_t recordCapacity, uint32_t stringCapacity) {
+    return alignTo(sizeof(BufferHeader) + size_t(recordCapacity) * sizeof(Record) + stringCapacity, 64);
+}
+
+size_t segmentBytes(uint32_t recordCapacity, uint32_t stringCapacity) {
+    return alignTo(sizeof(SegmentHeader), 64) + 2 * bufferBytes(recordCapacity, stringCapacity);
+}
+
+bool socketAddress(const std::string &path, sockaddr_un &address, socklen_t &length) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+    if (path[0] == '@') {
+        address.sun_path[0] = '\0';
+    }
+    length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + (path[0] == '@' ? 0 : 1));
+    return true;
+}
+
+int connectSocket(const std::string &path) {
+    sockaddr_un address;
+    socklen_t length;
+    if (!socketAddress(path, address, length)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), length) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool sendDescriptor(int socketFd, int fd) {
+    char byte = 'N';
+    iovec payload{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr *header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(header), &fd, sizeof(int));
+    return sendmsg(socketFd, &message, MSG_NOSIGNAL) == 1;
+}
+
+int receiveDescriptor(int socketFd) {
+    char byte;
+    iovec payload{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr message{};
+    message.msg_iov = &payload;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    if (recvmsg(socketFd, &message, MSG_CMSG_CLOEXEC) != 1) {
+        return -1;
+    }
+    for (cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS &&
+            header->cmsg_len == CMSG_LEN(sizeof(int))) {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(header), sizeof(int));
+            return fd;
+        }
+    }
+    return -1;
+}
+
+} // namespace shared_library
+
+using namespace shared_library;
+
+namespace {
+
+double fromFixed(int32_t fixed) {
+    return fixed == FIXED_NA ? std::nan("") : static_cast<double>(fixed) / 1e7;
+}
+
+const int snapshotAttempts = 4;
+
+} // namespace
+
+SharedLibraryReader::SharedLibraryReader(const std::string &shmName) : shmName(shmName) {
+}
+
+SharedLibraryReader::~SharedLibraryReader() {
+    close();
+}
+
+bool SharedLibraryReader::open() {
+    if (header) {
+        return true;
+    }
+    int fd = shm_open(shmName.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(SegmentHeader)) {
+        mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    // The writer fills in the header before it sets the magic.
+    auto *segment = static_cast<const SegmentHeader *>(mapping);
+    if (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != MAGIC || segment->layoutVersion != LAYOUT_VERSION ||
+        segment->segmentBytes > static_cast<uint64_t>(info.st_size)) {
+        munmap(mapping, info.st_size);
+        return false;
+    }
+    header = segment;
+    mappedBytes = info.st_size;
+    return true;
+}
+
+void SharedLibraryReader::close() {
+    if (header) {
+        munmap(const_cast<SegmentHeader *>(header), mappedBytes);
+        header = nullptr;
+        mappedBytes = 0;
+    }
+    if (socketFd >= 0) {
+        ::close(socketFd);
+        socketFd = -1;
+    }
+    if (notifyFd >= 0) {
+        ::close(notifyFd);
+        notifyFd = -1;
+    }
+}
+
+// The daemon moves to a new, bigger segment when the library outgrows the
+// old one; readers follow it by name.
+bool SharedLibraryReader::reopenIfRetired() {
+    if (header && header->retired.load(std::memory_order_acquire)) {
+        munmap(const_cast<SegmentHeader *>(header), mappedBytes);
+        header = nullptr;
+        mappedBytes = 0;
+    }
+    return open();
+}
+
+uint64_t SharedLibraryReader::revision() {
+    return reopenIfRetired() ? header->revision.load(std::memory_order_acquire) : 0;
+}
+
+bool SharedLibraryReader::forEach(const std::function<void(const SharedWaypointView &)> &visit, uint64_t *revision) {
+    if (!reopenIfRetired()) {
+        return false;
+    }
+
+    const char *base = reinterpret_cast<const char *>(header);
+    uint32_t active = header->active.load(std::memory_order_acquire) & 1;
+    auto *buffer = reinterpret_cast<const BufferHeader *>(base + header->bufferOffset[active]);
+    uint64_t before = buffer->sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+        return false;
+    }
+
+    // Everything below may be torn by a concurrent writer, so every count
+    // and offset is bounds checked before use.
+    uint32_t count = buffer->count;
+    uint32_t stringBytes = buffer->stringBytes;
+    uint64_t bufferRevision = buffer->revision;
+    bool intact = count <= header->recordCapacity && stringBytes <= header->stringCapacity;
+    auto *records = reinterpret_cast<const Record *>(buffer + 1);
+    const char *strings = reinterpret_cast<const char *>(records + header->recordCapacity);
+    for (uint32_t i = 0; intact && i < count; ++i) {
+        Record record = records[i];
+        if (size_t(record.nameOffset) + record.nameLength > stringBytes ||
+            size_t(record.symbolOffset) + record.symbolLength > stringBytes) {
+            intact = false;
+            break;
+        }
+        SharedWaypointView view{std::string_view(strings + record.nameOffset, record.nameLength),
+                                std::string_view(strings + record.symbolOffset, record.symbolLength),
+                                fromFixed(record.latitude),
+                                fromFixed(record.longitude),
+                                record.id,
+                                record.source};
+        visit(view);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!intact || buffer->sequence.load(std::memory_order_relaxed) != before) {
+        return false;
+    }
+    if (revision) {
+        *revision = bufferRevision;
+    }
+    return true;
+}
+
+bool SharedLibraryReader::snapshot(std::vector<Waypoint> &waypoints, uint64_t *revision) {
+    for (int attempt = 0; attempt < snapshotAttempts; ++attempt) {
+        std::vector<Waypoint> copy;
+        bool intact = forEach(
+            [&copy](const SharedWaypointView &view) {
+                Waypoint waypoint;
+                waypoint.id = view.id;
+                waypoint.name = std::string(view.name);
+                waypoint.latitude = view.latitude;
+                waypoint.longitude = view.longitude;
+                waypoint.symbol = std::string(view.symbol);
+                waypoint.source = view.source;
+                copy.push_back(std::move(waypoint));
+            },
+            revision);
+        if (intact) {
+            waypoints.swap(copy);
+            return true;
+        }
+        if (!isOpen()) {
+            return false;
+        }
+    }
+    return false;
+}
+
+// The daemon keeps the connection only to notice when we go away; the
+// eventfd is what it signals.
+int SharedLibraryReader::subscribe(const std::string &socketPath) {
+    if (notifyFd >= 0) {
+        return notifyFd;
+    }
+    socketFd = connectSocket(socketPath);
+    if (socketFd < 0) {
+        return -1;
+    }
+    notifyFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (notifyFd < 0 || !sendDescriptor(socketFd, notifyFd)) {
+        if (notifyFd >= 0) {
+            ::close(notifyFd);
+            notifyFd = -1;
+        }
+        ::close(socketFd);
+        socketFd = -1;
+        return -1;
+    }
+    return notifyFd;
+}
+
+bool SharedLibraryReader::waitForChange(int timeoutMs) {
+    if (notifyFd < 0) {
+        return false;
+    }
+    pollfd entry{notifyFd, POLLIN, 0};
+    if (poll(&entry, 1, timeoutMs) <= 0) {
+        return false;
+    }
+    uint64_t count;
+    return read(notifyFd, &count, sizeof(count)) == sizeof(count);
+}
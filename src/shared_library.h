@@ -0,0 +1,141 @@
+#ifndef SHARED_LIBRARY_H
+#define SHARED_LIBRARY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vector>
+#include "waypoint.h"
+
+// Read-only export of the daemon's waypoint set in POSIX shared memory,
+// so the dashboard and chart renderer can show exactly what the daemon
+// holds without parsing waypoints.json themselves.
+//
+// The segment holds two buffers. The daemon fills whichever one is not
+// active and then flips to it, so readers of the active set are never
+// disturbed by the next publish; each buffer also carries a seqlock so a
+// reader that is still iterating when its buffer gets reused (two
+// publishes later) finds out and retries. Change notification is an
+// eventfd each reader creates and hands to the daemon over a Unix socket.
+//
+// This header and shared_library.cpp are all a reader needs
+// (build/libwaypoint_library.a); the writing side is LibraryPublisher.
+namespace shared_library {
+
+const char *const DEFAULT_SHM_NAME = "/waypoint_sync_library";
+// A leading '@' means the Linux abstract socket namespace.
+const char *const DEFAULT_SOCKET_PATH = "@waypoint_sync_library";
+
+const uint32_t MAGIC = 0x31535057;  // "WPS1"
+const uint32_t LAYOUT_VERSION = 1;
+const int32_t FIXED_NA = 0x7fffffff;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock needs lock-free 64-bit atomics");
+
+// Positions are 1e-7 degree fixed point as on the wire; strings are
+// offsets into the buffer's string area, not NUL terminated.
+struct Record {
+    int32_t latitude;
+    int32_t longitude;
+    uint32_t nameOffset;
+    uint32_t symbolOffset;
+    uint16_t nameLength;
+    uint16_t symbolLength;
+    uint16_t id;
+    uint8_t source;
+    uint8_t reserved;
+};
+
+struct BufferHeader {
+    std::atomic<uint64_t> sequence;  // Odd while the writer is filling the buffer
+    uint64_t revision;
+    uint32_t count;
+    uint32_t stringBytes;
+};
+
+struct SegmentHeader {
+    uint32_t magic;  // Stored last, with release, once the rest is filled in
+    uint32_t layoutVersion;
+    uint64_t segmentBytes;
+    uint32_t recordCapacity;  // Per buffer
+    uint32_t stringCapacity;  // Per buffer
+    uint64_t bufferOffset[2];
+    std::atomic<uint32_t> active;
+    std::atomic<uint32_t> retired;  // Set when the writer moved to a bigger segment
+    std::atomic<uint64_t> revision;
+};
+
+// Where each part of a buffer lives and how big the segment is.
+size_t bufferBytes(uint32_t recordCapacity, uint32_t stringCapacity);
+size_t segmentBytes(uint32_t recordCapacity, uint32_t stringCapacity);
+
+// Fills in a Unix socket address for path; false if it does not fit.
+bool socketAddress(const std::string &path, sockaddr_un &address, socklen_t &length);
+// Connects to the daemon's notification socket; -1 on failure.
+int connectSocket(const std::string &path);
+
+// A subscriber sends its eventfd as SCM_RIGHTS with a single data byte.
+bool sendDescriptor(int socketFd, int fd);
+int receiveDescriptor(int socketFd);
+
+} // namespace shared_library
+
+// One waypoint as seen straight from shared memory. The views are only
+// valid inside the forEach() callback.
+struct SharedWaypointView {
+    std::string_view name;
+    std::string_view symbol;
+    double latitude;   // NaN when unknown
+    double longitude;
+    uint16_t id;
+    uint8_t source;
+};
+
+// Maps the exported set read-only. Not thread safe; use one reader per
+// thread.
+class SharedLibraryReader {
+public:
+    explicit SharedLibraryReader(const std::string &shmName = shared_library::DEFAULT_SHM_NAME);
+    ~SharedLibraryReader();
+    SharedLibraryReader(const SharedLibraryReader &) = delete;
+    SharedLibraryReader &operator=(const SharedLibraryReader &) = delete;
+
+    // False until the daemon has created the segment.
+    bool open();
+    void close();
+    bool isOpen() const { return header != nullptr; }
+
+    // Revision of the current set; 0 if nothing is mapped.
+    uint64_t revision();
+
+    // Calls visit for every waypoint of the current set, zero-copy.
+    // Returns false if the buffer was reused while visiting, in which case
+    // whatever visit saw must be discarded and the call repeated.
+    bool forEach(const std::function<void(const SharedWaypointView &)> &visit, uint64_t *revision = nullptr);
+    // Copies the current set, retrying torn passes a few times.
+    bool snapshot(std::vector<Waypoint> &waypoints, uint64_t *revision = nullptr);
+
+    // Registers for change notification. Returns an eventfd that becomes
+    // readable after each publish (and once straight away), for the
+    // caller's own poll loop; -1 on failure.
+    int subscribe(const std::string &socketPath = shared_library::DEFAULT_SOCKET_PATH);
+    // Waits on the subscription; true if the set changed. Clears the
+    // pending notification.
+    bool waitForChange(int timeoutMs);
+
+private:
+    bool reopenIfRetired();
+
+    std::string shmName;
+    const shared_library::SegmentHeader *header = nullptr;
+    size_t mappedBytes = 0;
+    int socketFd = -1;
+    int notifyFd = -1;
+};
+
+#endif // SHARED_LIBRARY_H
@@ -0,0 +1,140 @@
+#include "simulated_plotter.h"
+#include "vendor_plugins.h"
+#include "waypoint_pgns.h"
+#include <algorithm>
+
+// Device function 130 / class 120: display.
+const unsigned char PLOTTER_DEVICE_FUNCTION = 130;
+const unsigned char PLOTTER_DEVICE_CLASS = 120;
+
+PlotterProfile PlotterProfile::garmin(uint32_t uniqueNumber, unsigned char sourceAddress) {
+    PlotterProfile profile;
+    profile.name = "Garmin";
+    profile.modelId = "GPSMAP 8610";
+    profile.manufacturerCode = N2K_MANUFACTURER_GARMIN;
+    profile.productCode = 2305;
+    profile.uniqueNumber = uniqueNumber;
+    profile.sourceAddress = sourceAddress;
+    profile.maxWaypoints = 5000;
+    return profile;
+}
+
+PlotterProfile PlotterProfile::lowrance(uint32_t uniqueNumber, unsigned char sourceAddress) {
+    PlotterProfile profile;
+    profile.name = "Lowrance";
+    profile.modelId = "HDS-9 Live";
+    profile.manufacturerCode = N2K_MANUFACTURER_NAVICO;
+    profile.productCode = 19201;
+    profile.uniqueNumber = uniqueNumber;
+    profile.sourceAddress = sourceAddress;
+    profile.maxWaypoints = 3000;
+    return profile;
+}
+
+PlotterProfile PlotterProfile::humminbird(uint32_t uniqueNumber, unsigned char sourceAddress) {
+    PlotterProfile profile;
+    profile.name = "Humminbird";
+    profile.modelId = "SOLIX 12";
+    profile.manufacturerCode = N2K_MANUFACTURER_HUMMINBIRD;
+    profile.productCode = 1240;
+    profile.uniqueNumber = uniqueNumber;
+    profile.sourceAddress = sourceAddress;
+    profile.maxWaypoints = 2750;
+    return profile;
+}
+
+SimulatedPlotter::ListHandler::ListHandler(SimulatedPlotter &owner)
+    : tNMEA2000::tMsgHandler(WaypointListPgn::pgn), owner(owner) {
+}
+
+void SimulatedPlotter::ListHandler::HandleMsg(const tN2kMsg &N2kMsg) {
+    WaypointListPgn::View view(N2kMsg);
+    if (!view.isValid()) {
+        return;
+    }
+    ++owner.receivedMessages;
+    view.forEachItem([this](const WaypointListPgn::ItemView &item) {
+        Waypoint waypoint;
+        waypoint.id = static_cast<uint16_t>(item.get<WaypointListItem::Id>());
+        waypoint.name = std::string(item.get<WaypointListItem::Name>());
+        waypoint.latitude = item.get<WaypointListItem::Latitude>();
+        waypoint.longitude = item.get<WaypointListItem::Longitude>();
+        owner.storeWaypoint(waypoint);
+    });
+}
+
+SimulatedPlotter::SimulatedPlotter(VirtualN2kBus &bus, const PlotterProfile &profile)
+    : profile(profile), node(std::make_unique<VirtualN2kNode>(bus)), listHandler(*this) {
+    node->SetProductInformation(std::to_string(profile.uniqueNumber).c_str(), profile.productCode,
+                                profile.modelId.c_str(), "1.0.0.0", "1.0.0");
+    node->SetDeviceInformation(profile.uniqueNumber, PLOTTER_DEVICE_FUNCTION, PLOTTER_DEVICE_CLASS,
+                               profile.manufacturerCode);
+    node->SetMode(tNMEA2000::N2km_ListenAndNode, profile.sourceAddress);
+    node->AttachMsgHandler(&listHandler);
+}
+
+bool SimulatedPlotter::open() {
+    return node->Open();
+}
+
+void SimulatedPlotter::at(uint32_t timeMs, Action action) {
+    auto position = std::upper_bound(script.begin(), script.end(), timeMs,
+                                     [](uint32_t time, const ScriptStep &step) { return time < step.timeMs; });
+    script.insert(position, ScriptStep{timeMs, std::move(action)});
+}
+
+void SimulatedPlotter::advanceTo(uint32_t timeMs) {
+    size_t due = 0;
+    while (due < script.size() && script[due].timeMs <= timeMs) {
+        ++due;
+    }
+    std::vector<ScriptStep> running(std::make_move_iterator(script.begin()), std::make_move_iterator(script.begin() + due));
+    script.erase(script.begin(), script.begin() + due);
+
+    for (auto &step : running) {
+        step.action(*this);
+    }
+    poll();
+}
+
+void SimulatedPlotter::poll() {
+    node->ParseMessages();
+}
+
+void SimulatedPlotter::setWaypoint(const Waypoint &waypoint) {
+    storeWaypoint(waypoint);
+}
+
+// A full plotter refuses new waypoints but still accepts edits.
+void SimulatedPlotter::storeWaypoint(const Waypoint &waypoint) {
+    auto existing = waypoints.find(waypoint.name);
+    if (existing != waypoints.end()) {
+        existing->second = waypoint;
+    } else if (waypoints.size() < profile.maxWaypoints) {
+        waypoints.emplace(waypoint.name, waypoint);
+    } else {
+        ++rejectedWaypoints;
+    }
+}
+
+size_t SimulatedPlotter::broadcastWaypoints() {
+    size_t sent = 0;
+    auto next = waypoints.begin();
+    uint16_t startId = 0;
+    while (next != waypoints.end()) {
+        tN2kMsg msg;
+        WaypointListPgn::encodeHeader(msg, startId, 0, waypoints.size(), 0, {});
+        uint16_t firstId = startId;
+        while (next != waypoints.end() &&
+               WaypointListPgn::appendItem(msg, next->second.id, next->second.name, next->second.latitude, next->second.longitude)) {
+            ++next;
+            ++startId;
+        }
+        msg.Destination = 255;
+        if (startId == firstId || !node->SendMsg(msg)) {
+            break;
+        }
+        ++sent;
+    }
+    return sent;
+}
@@ -0,0 +1,82 @@
+#ifndef SIMULATED_PLOTTER_H
+#define SIMULATED_PLOTTER_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "virtual_n2k_bus.h"
+#include "waypoint.h"
+
+// Identity and limits of one simulated chartplotter model.
+struct PlotterProfile {
+    std::string name;
+    std::string modelId;
+    uint16_t manufacturerCode = 0;
+    uint16_t productCode = 0;
+    uint32_t uniqueNumber = 1;
+    unsigned char sourceAddress = 20;  // Preferred address; the library may claim another
+    size_t maxWaypoints = 3000;
+
+    static PlotterProfile garmin(uint32_t uniqueNumber, unsigned char sourceAddress);
+    static PlotterProfile lowrance(uint32_t uniqueNumber, unsigned char sourceAddress);
+    static PlotterProfile humminbird(uint32_t uniqueNumber, unsigned char sourceAddress);
+};
+
+// A chartplotter on a VirtualN2kBus: keeps its own waypoint store, stores
+// waypoint lists it hears (up to its capacity) and runs a script of timed
+// actions such as edits and broadcasts.
+class SimulatedPlotter {
+public:
+    using Action = std::function<void(SimulatedPlotter &)>;
+
+    SimulatedPlotter(VirtualN2kBus &bus, const PlotterProfile &profile);
+
+    bool open();
+
+    // Script: actions run in time order from advanceTo().
+    void at(uint32_t timeMs, Action action);
+    void advanceTo(uint32_t timeMs);
+    // Handles whatever arrived on the bus since the last call.
+    void poll();
+
+    void setWaypoint(const Waypoint &waypoint);
+    // Sends the whole store as packed PGN 130074 messages. Returns the
+    // number of messages sent.
+    size_t broadcastWaypoints();
+
+    const PlotterProfile &getProfile() const { return profile; }
+    const std::map<std::string, Waypoint> &getWaypoints() const { return waypoints; }
+    size_t getReceivedMessages() const { return receivedMessages; }
+    size_t getRejectedWaypoints() const { return rejectedWaypoints; }
+    tNMEA2000 &getNMEA2000() { return *node; }
+
+private:
+    class ListHandler : public tNMEA2000::tMsgHandler {
+    public:
+        explicit ListHandler(SimulatedPlotter &owner);
+        void HandleMsg(const tN2kMsg &N2kMsg) override;
+
+    private:
+        SimulatedPlotter &owner;
+    };
+
+    struct ScriptStep {
+        uint32_t timeMs;
+        Action action;
+    };
+
+    void storeWaypoint(const Waypoint &waypoint);
+
+    PlotterProfile profile;
+    std::unique_ptr<VirtualN2kNode> node;
+    ListHandler listHandler;
+    std::map<std::string, Waypoint> waypoints;
+    std::vector<ScriptStep> script;  // Kept sorted by time
+    size_t receivedMessages = 0;
+    size_t rejectedWaypoints = 0;
+};
+
+#endif // SIMULATED_PLOTTER_H
@@ -0,0 +1,257 @@
+#include "socketcan_node.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// PF of 240 and up means PDU2: the PS byte is part of the PGN.
+bool isPdu2(unsigned long pgn) {
+    return ((pgn >> 8) & 0xff) >= 240;
+}
+
+const canid_t PGN_BITS = 0x3ffff << 8;
+const canid_t PDU1_PGN_BITS = 0x3ff00 << 8;
+
+const char *const STATISTIC_NAMES[4] = {"rx_packets", "rx_bytes", "tx_packets", "tx_bytes"};
+
+} // namespace
+
+const std::vector<unsigned long> &networkManagementPgns() {
+    static const std::vector<unsigned long> pgns{
+        59392,   // ISO acknowledgement
+        59904,   // ISO request
+        60160,   // ISO transport protocol, data transfer
+        60416,   // ISO transport protocol, connection management
+        60928,   // ISO address claim
+        65240,   // ISO commanded address
+        126208,  // NMEA group function
+        126464,  // PGN list
+        126993,  // Heartbeat
+        126996,  // Product information
+        126998,  // Configuration information
+    };
+    return pgns;
+}
+
+std::vector<can_filter> canFiltersForPgns(const std::vector<unsigned long> &pgns) {
+    std::vector<unsigned long> all(pgns);
+    all.insert(all.end(), networkManagementPgns().begin(), networkManagementPgns().end());
+    for (auto &pgn : all) {
+        if (!isPdu2(pgn)) {
+            pgn &= 0x3ff00;
+        }
+    }
+    std::sort(all.begin(), all.end());
+    all.erase(std::unique(all.begin(), all.end()), all.end());
+
+    // Extended data frames only: the flags are part of every mask.
+    std::vector<can_filter> filters;
+    for (unsigned long pgn : all) {
+        can_filter filter;
+        filter.can_id = (static_cast<canid_t>(pgn) << 8) | CAN_EFF_FLAG;
+        filter.can_mask = (isPdu2(pgn) ? PGN_BITS : PDU1_PGN_BITS) | CAN_EFF_FLAG | CAN_RTR_FLAG;
+        filters.push_back(filter);
+    }
+    return filters;
+}
+
+SocketCanNode::SocketCanNode(const std::string &interfaceName)
+    : interfaceName(interfaceName), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+    if (wakeFd < 0) {
+        std::cerr << "Failed to create wake eventfd for " << interfaceName << ": " << std::strerror(errno) << std::endl;
+    }
+}
+
+SocketCanNode::~SocketCanNode() {
+    if (socketFd >= 0) {
+        close(socketFd);
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+    for (int fd : statisticFds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void SocketCanNode::setReceivePgns(const std::vector<unsigned long> &pgns) {
+    receivePgns = pgns;
+    filtered = true;
+    if (socketFd >= 0) {
+        applyFilters();
+    }
+}
+
+bool SocketCanNode::applyFilters() {
+    if (!filtered) {
+        return true;
+    }
+
+    std::vector<can_filter> filters = canFiltersForPgns(receivePgns);
+    if (filters.size() > CAN_RAW_FILTER_MAX ||
+        setsockopt(socketFd, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(can_filter)) < 0) {
+        // The kernel keeps its default match-all filter.
+        std::cerr << "Failed to install CAN filters on " << interfaceName << ", receiving everything." << std::endl;
+        return false;
+    }
+    std::cout << "Installed " << filters.size() << " CAN filters on " << interfaceName << std::endl;
+    return true;
+}
+
+bool SocketCanNode::CANOpen() {
+    if (socketFd >= 0) {
+        return true;
+    }
+
+    int fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (fd < 0) {
+        std::cerr << "Failed to open CAN socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    ifreq request{};
+    std::strncpy(request.ifr_name, interfaceName.c_str(), IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFINDEX, &request) < 0) {
+        std::cerr << "Unknown CAN interface " << interfaceName << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    sockaddr_can address{};
+    address.can_family = AF_CAN;
+    address.can_ifindex = request.ifr_ifindex;
+    if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) < 0) {
+        std::cerr << "Failed to bind CAN socket to " << interfaceName << ": " << std::strerror(errno) << std::endl;
+        close(fd);
+        return false;
+    }
+
+    socketFd = fd;
+    applyFilters();
+    return true;
+}
+
+bool SocketCanNode::CANSendFrame(unsigned long id, unsigned char len, const unsigned char *buf, bool wait_sent) {
+    (void)wait_sent;
+    if (socketFd < 0 || len > CAN_MAX_DLEN) {
+        return false;
+    }
+
+    can_frame frame{};
+    frame.can_id = (id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+    frame.can_dlc = len;
+    std::memcpy(frame.data, buf, len);
+    // A full tx queue (ENOBUFS/EAGAIN) returns false; the library keeps
+    // the frame and retries on the next ParseMessages(). The handler sees
+    // the failure count as backpressure.
+    if (write(socketFd, &frame, sizeof(frame)) != static_cast<ssize_t>(sizeof(frame))) {
+        ++seen.sendFailures;
+        return false;
+    }
+    ++seen.frames;
+    seen.dataBytes += len;
+    return true;
+}
+
+bool SocketCanNode::CANGetFrame(unsigned long &id, unsigned char &len, unsigned char *buf) {
+    if (socketFd < 0) {
+        return false;
+    }
+
+    can_frame frame;
+    while (read(socketFd, &frame, sizeof(frame)) == static_cast<ssize_t>(sizeof(frame))) {
+        ++seen.frames;
+        seen.dataBytes += std::min<unsigned char>(frame.can_dlc, CAN_MAX_DLEN);
+        // Without filters, standard and remote frames still arrive; NMEA 2000 uses neither.
+        if (!(frame.can_id & CAN_EFF_FLAG) || (frame.can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG))) {
+            continue;
+        }
+        id = frame.can_id & CAN_EFF_MASK;
+        len = std::min<unsigned char>(frame.can_dlc, CAN_MAX_DLEN);
+        std::memcpy(buf, frame.data, len);
+        return true;
+    }
+    return false;
+}
+
+bool SocketCanNode::waitForFrames(int timeoutMs) {
+    pollfd fds[2];
+    nfds_t count = 0;
+    if (wakeFd >= 0) {
+        fds[count++] = {wakeFd, POLLIN, 0};
+    }
+    if (socketFd >= 0) {
+        fds[count++] = {socketFd, POLLIN, 0};
+    }
+
+    if (poll(fds, count, timeoutMs) <= 0) {
+        return false;
+    }
+    bool framesReady = false;
+    for (nfds_t i = 0; i < count; ++i) {
+        if (fds[i].fd == wakeFd && (fds[i].revents & POLLIN)) {
+            eventfd_t value;
+            eventfd_read(wakeFd, &value);
+        } else if (fds[i].fd == socketFd && fds[i].revents) {
+            framesReady = true;
+        }
+    }
+    return framesReady;
+}
+
+void SocketCanNode::wake() {
+    if (wakeFd >= 0) {
+        eventfd_write(wakeFd, 1);
+    }
+}
+
+bool SocketCanNode::readStatistic(size_t index, uint64_t &value) {
+    char text[32];
+    ssize_t length = pread(statisticFds[index], text, sizeof(text) - 1, 0);
+    if (length <= 0) {
+        return false;
+    }
+    text[length] = '\0';
+    value = std::strtoull(text, nullptr, 10);
+    return true;
+}
+
+// The statistics files stay open and are re-read with pread, as this runs
+// several times a second.
+bool SocketCanNode::readBusCounters(BusCounters &counters) {
+    if (!statisticsOpened) {
+        statisticsOpened = true;
+        for (size_t i = 0; i < 4; ++i) {
+            std::string path = "/sys/class/net/" + interfaceName + "/statistics/" + STATISTIC_NAMES[i];
+            statisticFds[i] = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+    }
+
+    uint64_t values[4];
+    bool fromSysfs = true;
+    for (size_t i = 0; i < 4 && fromSysfs; ++i) {
+        fromSysfs = statisticFds[i] >= 0 && readStatistic(i, values[i]);
+    }
+    if (fromSysfs) {
+        counters.frames = values[0] + values[2];
+        counters.dataBytes = values[1] + values[3];
+    } else {
+        counters.frames = seen.frames;
+        counters.dataBytes = seen.dataBytes;
+    }
+    counters.sendFailures = seen.sendFailures;
+    return true;
+}
@@ -0,0 +1,66 @@
+#ifndef SOCKETCAN_NODE_H
+#define SOCKETCAN_NODE_H
+
+#include <linux/can.h>
+#include <string>
+#include <vector>
+#include "NMEA2000.h"
+#include "bus_load.h"
+
+// ISO/NMEA network management PGNs the library needs for address claim,
+// device discovery and transport, whatever the application handles.
+const std::vector<unsigned long> &networkManagementPgns();
+
+// Kernel CAN_RAW_FILTER entries passing extended frames for the given
+// PGNs plus networkManagementPgns(). PDU1 PGNs (PF < 240) match any
+// destination address; PDU2 PGNs match exactly.
+std::vector<can_filter> canFiltersForPgns(const std::vector<unsigned long> &pgns);
+
+// tNMEA2000 over a raw SocketCAN socket that the bus thread can block on.
+// The socket is non-blocking; waitForFrames() sleeps in poll() until a
+// frame arrives, wake() is called or the timeout passes, so an idle bus
+// costs no CPU and a frame is handled as soon as it lands.
+class SocketCanNode : public tNMEA2000, public BusCounterSource {
+public:
+    explicit SocketCanNode(const std::string &interfaceName);
+    ~SocketCanNode() override;
+
+    // Restricts receive to these PGNs plus network management; until it is
+    // called everything is received. Applied at open, or immediately if
+    // already open.
+    void setReceivePgns(const std::vector<unsigned long> &pgns);
+
+    // Returns true if frames are waiting to be read.
+    bool waitForFrames(int timeoutMs);
+    // Interrupts waitForFrames(); safe from any thread.
+    void wake();
+
+    // Whole-bus counters from the interface statistics in sysfs, which
+    // count frames the receive filters drop. Without sysfs, only the
+    // frames this socket saw.
+    bool readBusCounters(BusCounters &counters) override;
+
+    const std::string &getInterfaceName() const { return interfaceName; }
+    bool isOpen() const { return socketFd >= 0; }
+
+protected:
+    bool CANSendFrame(unsigned long id, unsigned char len, const unsigned char *buf, bool wait_sent = true) override;
+    bool CANOpen() override;
+    bool CANGetFrame(unsigned long &id, unsigned char &len, unsigned char *buf) override;
+
+private:
+    bool applyFilters();
+    bool readStatistic(size_t index, uint64_t &value);
+
+    std::string interfaceName;
+    int socketFd = -1;
+    int wakeFd = -1;
+    bool filtered = false;
+    std::vector<unsigned long> receivePgns;
+
+    int statisticFds[4] = {-1, -1, -1, -1};  // rx_packets, rx_bytes, tx_packets, tx_bytes
+    bool statisticsOpened = false;
+    BusCounters seen;  // Frames through this socket, and refused sends
+};
+
+#endif // SOCKETCAN_NODE_H
@@ -0,0 +1,84 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free single-producer/single-consumer ring buffer.
+// Exactly one thread may push and exactly one thread may pop; neither side
+// ever blocks, a full queue simply rejects the push.
+template <typename T, size_t Capacity>
+class SpscQueue {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    bool tryPush(T &&item) {
+        const size_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail - cachedHead == Capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (currentTail - cachedHead == Capacity) {
+                return false;
+            }
+        }
+        slots[currentTail & mask] = std::move(item);
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPush(const T &item) {
+        T copy = item;
+        return tryPush(std::move(copy));
+    }
+
+    bool tryPop(T &out) {
+        const size_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (currentHead == cachedTail) {
+                return false;
+            }
+        }
+        out = std::move(slots[currentHead & mask]);
+        head.store(currentHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Moves up to maxItems into out with a single acquire/release pair and
+    // returns how many were taken.
+    size_t popBatch(std::vector<T> &out, size_t maxItems) {
+        const size_t currentHead = head.load(std::memory_order_relaxed);
+        cachedTail = tail.load(std::memory_order_acquire);
+        size_t available = cachedTail - currentHead;
+        size_t count = available < maxItems ? available : maxItems;
+
+        for (size_t i = 0; i < count; ++i) {
+            out.push_back(std::move(slots[(currentHead + i) & mask]));
+        }
+        if (count > 0) {
+            head.store(currentHead + count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    size_t sizeApprox() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr size_t mask = Capacity - 1;
+
+    // Producer and consumer indices live on separate cache lines, each next
+    // to the side's cached copy of the other index.
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+    alignas(64) std::array<T, Capacity> slots{};
+};
+
+#endif // SPSC_QUEUE_H
@@ -1,30 +1,83 @@
 #include "sync_manager.h"
 #include "waypoint_converter.h"
+#include "converter_pool.h"
 #include "nmea_waypoint_handler.h"
-#include "nlohmann/json.hpp"
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
+#include <unordered_set>
 #include <sys/inotify.h>
-#include "NMEA2000_SocketCAN.h"
+#include "socketcan_node.h"
+#include <fcntl.h>
 #include <unistd.h>
 #include <vector>
 #include <chrono>
 #include <thread>
 #include <filesystem>
+#include <algorithm>
 
-using json = nlohmann::json;
 namespace fs = std::filesystem;
 
-const std::string waypointFile = "/mnt/nvme/waypoints.json";
-std::unordered_map<std::string, std::string> formatMap;
 std::unordered_map<std::string, std::time_t> fileTimestamps;
 
-SyncManager::SyncManager() : nmeaHandler(nullptr) {
+static uint64_t steadyMillis() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static ConverterPoolOptions converterOptionsFrom(const Config &current) {
+    ConverterPoolOptions options = defaultConverterPool().getOptions();
+    options.executable = current.converterExecutable;
+    options.maxConcurrent = static_cast<size_t>(current.converterMaxConcurrent);
+    options.timeout = std::chrono::milliseconds(current.converterTimeoutMs);
+    return options;
+}
+
+static SelectionSettings selectionSettingsFrom(const Config &current) {
+    SelectionSettings settings;
+    settings.hysteresisMeters = current.selectionHysteresisMeters;
+    settings.recomputeDistanceMeters = current.selectionRecomputeMeters;
+    settings.recencyBoost = current.selectionRecencyBoost;
+    settings.recencyHalfLifeHours = current.selectionRecencyHalfLifeHours;
+    return settings;
+}
+
+static TransmitRateSettings transmitSettingsFrom(const Config &current) {
+    TransmitRateSettings settings;
+    settings.maxBusShare = current.transmitMaxBusShare;
+    settings.busLoadCeiling = current.transmitBusLoadCeiling;
+    return settings;
+}
+
+// Each 0183 output is a selection target of its own.
+static std::string nmea0183Target(const Nmea0183Output &output) {
+    return "0183:" + output.getName();
+}
+
+SyncManager::SyncManager() : SyncManager(std::make_shared<ConfigStore>()) {
+}
+
+SyncManager::SyncManager(std::shared_ptr<ConfigStore> store) : configStore(std::move(store)) {
+    configStore->reload();
+    canInterfaces = config()->canInterfaces;
+    bridgeWaypointPgns = config()->bridgeWaypointPgns;
+    initialize(true, true);
+}
+
+SyncManager::SyncManager(const std::vector<std::string> &canInterfaces, bool bridgeWaypointPgns)
+    : configStore(std::make_shared<ConfigStore>()), canInterfaces(canInterfaces), bridgeWaypointPgns(bridgeWaypointPgns) {
     initialize(true, true);
 }
 
 SyncManager::~SyncManager() {
+    if (mediaMonitor) {
+        mediaMonitor->stop();
+    }
+    stopSyncWorker();
+    for (auto &handler : handlersSnapshot()) {
+        handler->stop();
+    }
+
     if (inotifyFd >= 0) {
         close(inotifyFd);
         std::cout << "inotify file descriptor closed." << std::endl;
@@ -49,39 +102,169 @@ void SyncManager::clearFileTimestamps() {
     fileTimestamps.clear();
 }
 
+// Format mappings live in the config snapshot now; this just makes sure
+// one has been loaded.
 void SyncManager::loadFormatMappings() {
-    std::ifstream configFile("/home/blake/waypoint_sync_project/format_mapping.json");
-    if (!configFile.is_open()) {
-        std::cerr << "Error opening format_mapping.json" << std::endl;
-        return;
+    if (!configStore->isLoaded()) {
+        configStore->reload();
+    }
+}
+
+// Safe from the main loop at any time: readers holding the previous
+// snapshot keep it until they are done with it.
+bool SyncManager::reloadConfig() {
+    std::shared_ptr<const Config> previous = config();
+    if (!configStore->reload()) {
+        return false;
+    }
+    std::cout << "Configuration reloaded from " << configStore->getPath() << std::endl;
+    applyConfig(*previous, *config());
+    return true;
+}
+
+void SyncManager::applyConfig(const Config &previous, const Config &current) {
+    if (current.watchDirectory != previous.watchDirectory && inotifyFd >= 0) {
+        if (watchDirectoryDescriptor >= 0) {
+            inotify_rm_watch(inotifyFd, watchDirectoryDescriptor);
+        }
+        watchDirectoryDescriptor = addWatch(current.watchDirectory);
+        fileTimestamps.clear();
+    }
+
+    if (current.nmea0183Outputs != previous.nmea0183Outputs || configuredOutputs.empty()) {
+        openConfiguredOutputs(current);
+    }
+
+    if (current.mediaMountPrefixes != previous.mediaMountPrefixes ||
+        current.mediaImportWorkers != previous.mediaImportWorkers) {
+        startMediaMonitor(current);
     }
 
-    json config;
-    configFile >> config;
+    defaultConverterPool().setOptions(converterOptionsFrom(current));
 
-    for (auto& [key, value] : config.items()) {
-        formatMap[key] = value["format_name"];
-        std::cout << "Loaded format: " << key << " as " << formatMap[key] << std::endl;
+    if (current.selectionHysteresisMeters != previous.selectionHysteresisMeters ||
+        current.selectionRecomputeMeters != previous.selectionRecomputeMeters ||
+        current.selectionRecencyBoost != previous.selectionRecencyBoost ||
+        current.selectionRecencyHalfLifeHours != previous.selectionRecencyHalfLifeHours) {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        selector->setSettings(selectionSettingsFrom(current));
+    }
+
+    // Waypoints already on a bus keep their old names until they are sent again.
+    if (!(current.vendorProfileOverrides == previous.vendorProfileOverrides)) {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        encodings.setProfiles(vendorProfilesWith(current.vendorProfileOverrides));
+    }
+
+    if (current.transmitMaxBusShare != previous.transmitMaxBusShare ||
+        current.transmitBusLoadCeiling != previous.transmitBusLoadCeiling) {
+        for (auto &handler : handlersSnapshot()) {
+            handler->setTransmitSettings(transmitSettingsFrom(current));
+        }
+    }
+
+    if (current.canInterfaces != canInterfaces || current.bridgeWaypointPgns != bridgeWaypointPgns ||
+        current.compactMemory != compactMemory || current.libraryShmName != previous.libraryShmName ||
+        current.librarySocketPath != previous.librarySocketPath) {
+        std::cout << "CAN interface, memory mode and library export changes take effect on the next restart."
+                  << std::endl;
     }
 }
 
+void SyncManager::openConfiguredOutputs(const Config &current) {
+    std::vector<std::shared_ptr<Nmea0183Output>> opened;
+    for (const auto &settings : current.nmea0183Outputs) {
+        if (!settings.enabled) {
+            continue;
+        }
+        auto output = std::make_shared<Nmea0183Output>();
+        bool ok = settings.type == "udp" ? output->openUdp(settings.host, settings.port, settings.baud)
+                                         : output->openSerial(settings.device, settings.baud);
+        if (ok) {
+            opened.push_back(output);
+        } else {
+            std::cerr << "Failed to open NMEA 0183 output " << (settings.type == "udp" ? settings.host : settings.device) << std::endl;
+        }
+    }
+
+    std::vector<std::shared_ptr<Nmea0183Output>> replaced;
+    {
+        std::lock_guard<std::mutex> lock(outputsMutex);
+        for (auto &output : configuredOutputs) {
+            nmea0183Outputs.erase(std::remove(nmea0183Outputs.begin(), nmea0183Outputs.end(), output), nmea0183Outputs.end());
+        }
+        replaced.swap(configuredOutputs);
+        configuredOutputs = opened;
+        nmea0183Outputs.insert(nmea0183Outputs.end(), opened.begin(), opened.end());
+    }
+
+    // A reopened output starts from an empty set and is sent it all again.
+    if (selector) {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        for (auto &output : replaced) {
+            selector->forget(nmea0183Target(*output));
+        }
+    }
+}
+
+void SyncManager::startMediaMonitor(const Config &current) {
+    if (mediaMonitor) {
+        mediaMonitor->stop();
+    }
+
+    MediaMonitorOptions options;
+    options.mountPrefixes = current.mediaMountPrefixes;
+    options.importWorkers = static_cast<size_t>(current.mediaImportWorkers);
+    mediaMonitor = std::make_unique<MediaMonitor>(
+        [this](const MediaFile &file) {
+            std::cout << "Importing " << file.vendor << " waypoints from " << file.path << std::endl;
+            bool imported = importWaypointFile(file.path, file.format);
+            return syncTrackFile(file.path, file.format) && imported;
+        },
+        options);
+    mediaMonitor->start();
+}
+
 void SyncManager::initialize(bool reloadedFormats, bool addWatches) {
-    static bool formatsLoaded = false;
-    if (reloadedFormats && !formatsLoaded) {
+    if (reloadedFormats) {
         loadFormatMappings();
-        formatsLoaded = true;
     }
 
-    if (!nmeaHandler) {
-        nmeaHandler = std::make_shared<NMEAWaypointHandler>(*this, std::make_unique<tNMEA2000_SocketCAN>()); 
+    std::unique_lock<std::mutex> handlersLock(handlersMutex);
+    if (nmeaHandlers.empty()) {
+        for (const auto &canInterface : canInterfaces) {
+            nmeaHandlers.push_back(std::make_shared<NMEAWaypointHandler>(
+                *this, std::make_unique<SocketCanNode>(canInterface), canInterface));
+            if (config()->captureProprietaryPgns) {
+                nmeaHandlers.back()->enableProprietaryCapture();
+            }
+        }
+        if (bridgeWaypointPgns) {
+            bridgeBuses();
+        }
     }
 
-    if (nmeaHandler) {
-        nmeaHandler->start(); 
-    } else {
-        std::cerr << "Error: Failed to initialize NMEAWaypointHandler." << std::endl;
-        return;
+    // Installs with only 0183 plotters still merge, select and export.
+    if (nmeaHandlers.empty()) {
+        std::cerr << "No NMEA 2000 bus configured; syncing files and NMEA 0183 outputs only." << std::endl;
     }
+    for (auto &handler : nmeaHandlers) {
+        handler->setTransmitSettings(transmitSettingsFrom(*config()));
+        handler->start();
+    }
+    handlersLock.unlock();
+
+    defaultConverterPool().setOptions(converterOptionsFrom(*config()));
+    {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        if (!mergeEngine) {
+            createLibrary(config()->compactMemory);
+            startLibraryExport(*config());
+        }
+        selector->setSettings(selectionSettingsFrom(*config()));
+        encodings.setProfiles(vendorProfilesWith(config()->vendorProfileOverrides));
+    }
+    startSyncWorker();
 
     if (addWatches && inotifyFd < 0) {
         inotifyFd = inotify_init();
@@ -90,24 +273,37 @@ void SyncManager::initialize(bool reloadedFormats, bool addWatches) {
             return;
         }
 
-        // addWatch("/path/to/local/storage");
-        // addWatch("/path/to/sdcard/path");
-        addWatch("/home/blake/waypoint_sync_test_dir");
+        watchDirectoryDescriptor = addWatch(config()->watchDirectory);
+
+        // Editors save by rename, so watch the directory, not the file.
+        fs::path configPath(configStore->getPath());
+        configWatchDescriptor = inotify_add_watch(inotifyFd, configPath.parent_path().c_str(),
+                                                  IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        configFileName = configPath.filename().string();
+    }
+
+    if (configuredOutputs.empty()) {
+        openConfiguredOutputs(*config());
+    }
+
+    if (!mediaMonitor) {
+        startMediaMonitor(*config());
     }
 }
 
 
-void SyncManager::addWatch(const std::string &path) {
+int SyncManager::addWatch(const std::string &path) {
     int watchDescriptor = inotify_add_watch(inotifyFd, path.c_str(), IN_MODIFY | IN_CREATE);
     if (watchDescriptor < 0) {
         std::cerr << "Failed to add inotify watch for path: " << path << std::endl;
     } else {
         std::cout << "Added inotify watch for path: " << path << std::endl;
     }
+    return watchDescriptor;
 }
 
 void SyncManager::syncWaypointsOnBoot() {
-    std::ifstream file(waypointFile);
+    std::ifstream file(config()->waypointsFile);
     if (file.is_open()) {
         std::cout << "Syncing waypoints from SSD..." << std::endl;
         syncWaypointsAcrossDevices();
@@ -120,27 +316,65 @@ void SyncManager::checkForChanges() {
     bool inotifyEvent = checkInotifyChanges(); // Check inotify changes
     if (!inotifyEvent) {
         std::cout << "No inotify event, checking polling..." << std::endl;
-        pollForChanges("/home/blake/waypoint_sync_test_dir"); // Check polling changes only if no inotify event
+        pollForChanges(config()->watchDirectory); // Check polling changes only if no inotify event
     }
 
-    std::this_thread::sleep_for(std::chrono::seconds(4)); // Optional delay to control frequency
+    std::this_thread::sleep_for(std::chrono::milliseconds(config()->pollingIntervalMs)); // Optional delay to control frequency
     std::cout << "Exiting checkForChanges()" << std::endl;
 }
 
 bool SyncManager::checkInotifyChanges() {
+    bool configChanged = false;
+    bool waypointsChanged = false;
+    if (!readInotifyEvents(configChanged, waypointsChanged)) {
+        return false;
+    }
+
+    if (configChanged) {
+        reloadConfig();
+    }
+    if (waypointsChanged) {
+        handleFileChange();
+    }
+    return true;
+}
+
+// Config edits reload settings; anything else is a waypoint change.
+bool SyncManager::readInotifyEvents(bool &configChanged, bool &waypointsChanged) {
     std::vector<char> buffer(1024);
     ssize_t length = read(inotifyFd, buffer.data(), buffer.size());
 
-    if (length > 0) {
-        handleFileChange(buffer.data());
-        return true;
+    if (length <= 0) {
+        return false;
     }
-    return false;
+
+    for (ssize_t offset = 0; offset + static_cast<ssize_t>(sizeof(inotify_event)) <= length;) {
+        const inotify_event *event = reinterpret_cast<const inotify_event *>(buffer.data() + offset);
+        if (event->wd == configWatchDescriptor) {
+            configChanged = configChanged || (event->len > 0 && configFileName == event->name);
+        } else {
+            waypointsChanged = true;
+        }
+        offset += sizeof(inotify_event) + event->len;
+    }
+    return true;
 }
 
 void SyncManager::pollForChanges(const std::string &path) {
+    for (const auto &filepath : changedFiles(path)) {
+        pollChangeDetected = true;
+        if (fs::path(filepath).extension() == ".gpx") {
+            importWaypointFile(filepath, "gpx");
+        }
+        syncWaypointsAcrossDevices();
+    }
+}
+
+// Files under path whose modification time differs from the last poll.
+std::vector<std::string> SyncManager::changedFiles(const std::string &path) {
     std::cout << "Entering pollForChanges() for path: " << path << std::endl;
 
+    std::vector<std::string> changed;
     for (const auto &entry : fs::directory_iterator(path)) {
         std::string filepath = entry.path().string();
         std::time_t currentTimestamp = fs::last_write_time(entry).time_since_epoch().count();
@@ -153,47 +387,839 @@ void SyncManager::pollForChanges(const std::string &path) {
 
         if (fileTimestamps.find(filepath) == fileTimestamps.end() || fileTimestamps[filepath] != currentTimestamp) {
             std::cout << "Polling detected a change in file: " << filepath << std::endl;
-            pollChangeDetected = true;
-            syncWaypointsAcrossDevices();
+            changed.push_back(filepath);
             fileTimestamps[filepath] = currentTimestamp;
         } else { 
             std::cout << "No change detected for: " << filepath << std::endl;
         }
         std::cout << "Exiting pollForChanges()" << std::endl;
     }
+    return changed;
 }
 
-void SyncManager::handleFileChange(const char *buffer) {
+void SyncManager::handleFileChange() {
     std::cout << "File change detected by inotify, syncing waypoints..." << std::endl;
     inotifyChangeDetected = true;
     syncWaypointsAcrossDevices();
 }
 
+// Every bus forwards waypoint PGNs to every other bus.
+void SyncManager::bridgeBuses() {
+    for (auto &from : nmeaHandlers) {
+        for (auto &to : nmeaHandlers) {
+            from->bridgeTo(*to);
+        }
+    }
+}
+
 void SyncManager::syncWaypointsAcrossDevices() {
-    if (nmeaHandler) {
-        const auto& devices = nmeaHandler->getDetectedDevices();
-        for (const auto& device : devices) {
-            auto it = formatMap.find(device);
-            if (it != formatMap.end()) {
-                convertToAllFormats("test_waypoint.gpx", "gpx", { {device, it->second} });
+    std::shared_ptr<const Config> settings = config();
+    for (const auto &[device, deviceFormat] : exportTargets(*settings)) {
+        WaypointCollection collection;
+        if (chooseForExport(device, *settings, collection)) {
+            saveWaypointCollection(collection, "output." + device, deviceFormat);
+        }
+    }
+}
+
+std::vector<SyncManager::ExportTarget> SyncManager::exportTargets(const Config &settings) {
+    std::vector<ExportTarget> targets;
+    for (auto &handler : handlersSnapshot()) {
+        for (const auto &device : handler->getDetectedDevices()) {
+            auto it = settings.formatMap.find(device);
+            if (it != settings.formatMap.end()) {
+                targets.push_back({device, it->second});
+            }
+        }
+    }
+    return targets;
+}
+
+// Each export holds only what fits the device, most relevant first,
+// named the way the device wants.
+bool SyncManager::chooseForExport(const std::string &device, const Config &settings,
+                                  WaypointCollection &collection) {
+    std::vector<Waypoint> chosen;
+    {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        selector->select("file:" + device, settings.waypointCapacityFor(device), steadyMillis());
+        chosen = selector->selected("file:" + device);
+        WaypointEncodingCache::ProfileId profile = encodings.profileFor(device);
+        for (auto &waypoint : chosen) {
+            auto encoded = encodings.encode(profile, waypoint);
+            waypoint.name = encoded->name;
+            waypoint.symbol = encoded->symbol;
+        }
+        for (const auto &waypoint : chosen) {
+            collection.add(waypoint);
+        }
+        // A route's legs go with it even when the selection left them out.
+        for (const auto &[key, routeCollection] : libraryRoutes) {
+            appendEncodedRoute(routeCollection.routes().front(), routeCollection, profile, nullptr, collection);
+        }
+        syncScratch.reset();
+    }
+    if (chosen.empty() && collection.routes().empty()) {
+        std::cout << "No waypoints to sync to device: " << device << std::endl;
+        return false;
+    }
+
+    std::cout << "Syncing " << chosen.size() << " waypoints and " << collection.routes().size()
+              << " routes to device: " << device << std::endl;
+    return true;
+}
+
+// The event loop pipeline. Only the loop thread runs these coroutines;
+// anything that takes mergeMutex or waits on another thread is offloaded.
+
+Task<void> SyncManager::watchForChanges(EventLoop &loop) {
+    if (fs::exists(config()->waypointsFile)) {
+        std::cout << "Syncing waypoints from SSD..." << std::endl;
+        requestSync(loop);
+    }
+    if (inotifyFd >= 0) {
+        fcntl(inotifyFd, F_SETFL, fcntl(inotifyFd, F_GETFL) | O_NONBLOCK);
+    }
+
+    while (true) {
+        bool waypointsChanged = false;
+        if (co_await loop.readable(inotifyFd, config()->pollingIntervalMs) > 0) {
+            bool configChanged = false;
+            if (readInotifyEvents(configChanged, waypointsChanged) && configChanged) {
+                // Restarting the media monitor joins workers that may be
+                // waiting out a gpsbabel timeout.
+                co_await loop.offload([this] { reloadConfig(); });
             }
-            std::cout << "Syncing waypoints to device: " << device << std::endl;  
+            if (waypointsChanged) {
+                std::cout << "File change detected by inotify, syncing waypoints..." << std::endl;
+                inotifyChangeDetected = true;
+            }
+        } else {
+            // Nothing from inotify for a whole interval: poll the directory
+            // in case the watch missed something (e.g. network mounts).
+            for (const auto &filepath : changedFiles(config()->watchDirectory)) {
+                pollChangeDetected = true;
+                waypointsChanged = true;
+                if (fs::path(filepath).extension() == ".gpx") {
+                    co_await importWaypointFileAsync(loop, filepath, "gpx");
+                }
+            }
+        }
+        if (waypointsChanged) {
+            requestSync(loop);
         }
-    } else { 
-        std::cerr << "NMEA handler not set." << std::endl;
+    }
+}
+
+void SyncManager::requestSync(EventLoop &loop) {
+    if (syncInFlight) {
+        syncRequested = true;
+        return;
+    }
+    syncInFlight = true;
+    loop.spawn(runRequestedSyncs(loop));
+}
+
+Task<void> SyncManager::runRequestedSyncs(EventLoop &loop) {
+    do {
+        syncRequested = false;
+        try {
+            co_await syncWaypointsAcrossDevicesAsync(loop);
+        } catch (const std::exception &e) {
+            std::cerr << "Waypoint sync failed: " << e.what() << std::endl;
+        }
+    } while (syncRequested);
+    syncInFlight = false;
+}
+
+static Task<void> busCaughtUp(EventLoop &loop, std::shared_ptr<NMEAWaypointHandler> handler) {
+    co_await handler->transmitted(loop);
+}
+
+// Every device export is its own task, so while one waits on gpsbabel the
+// others convert, write their files or wait on the bus. The sync is done
+// once each bus and 0183 output has also sent everything queued for it.
+Task<void> SyncManager::syncWaypointsAcrossDevicesAsync(EventLoop &loop) {
+    co_await importsReachedTheWorker(loop);
+    auto handlers = handlersSnapshot();
+
+    std::shared_ptr<const Config> settings = config();
+    // Listing a bus's devices waits on that bus's thread.
+    auto targets = co_await loop.offload([this, &settings] { return exportTargets(*settings); });
+    std::vector<Task<void>> exports;
+    for (const auto &[device, deviceFormat] : targets) {
+        exports.push_back(exportToDevice(loop, device, deviceFormat, settings));
+    }
+    for (auto &handler : handlers) {
+        exports.push_back(busCaughtUp(loop, handler));
+    }
+    exports.push_back(drainNmea0183Outputs(loop));
+    co_await whenAll(std::move(exports));
+}
+
+// Imports reach the buses and 0183 outputs through the sync worker, so
+// until it has queued them there is nothing yet to wait out.
+Task<void> SyncManager::importsReachedTheWorker(EventLoop &loop) {
+    uint64_t merged = importsMerged;
+    while (importsQueued < merged && syncWorkerRunning) {
+        co_await loop.sleepFor(std::chrono::milliseconds(10));
+    }
+}
+
+Task<void> SyncManager::exportToDevice(EventLoop &loop, std::string device, std::string format,
+                                       std::shared_ptr<const Config> settings) {
+    WaypointCollection collection;
+    // Selection runs under mergeMutex, which merges hold for as long as they take.
+    if (!co_await loop.offload([&] { return chooseForExport(device, *settings, collection); })) {
+        co_return;
+    }
+    if (!co_await saveWaypointCollectionAsync(loop, std::move(collection), "output." + device, format)) {
+        std::cerr << "Failed to sync waypoints to device: " << device << std::endl;
+    }
+}
+
+Task<bool> SyncManager::importWaypointFileAsync(EventLoop &loop, std::string path, std::string format) {
+    WaypointCollection collection;
+    if (!co_await loadWaypointCollectionAsync(loop, path, format, collection)) {
+        std::cerr << "Failed to import waypoints from " << path << std::endl;
+        co_return false;
+    }
+    // The merge takes the lock the sync worker and media imports use, so
+    // it runs off the loop thread.
+    co_await loop.offload([this, &path, &collection] { mergeImported(path, collection); });
+    co_return true;
+}
+
+// A full set takes minutes at 4800 baud; the loop waits out each output's
+// pacing with timers and writes only what is due.
+Task<void> SyncManager::drainNmea0183Outputs(EventLoop &loop) {
+    for (int waitMs = pumpNmea0183Outputs(); waitMs >= 0; waitMs = pumpNmea0183Outputs()) {
+        co_await loop.sleepFor(std::chrono::milliseconds(waitMs));
     }
 }
 
 void SyncManager::syncWaypoint(double lat, double lon, const std::string &name) {
     std::cout << "Syncing waypoint: " << name << " [" << lat << ", " << lon << "] across devices." << std::endl;
-    nmeaHandler->addWaypoint(nextWaypointId++, name, lat, lon);
+    uint16_t waypointId = nextWaypointId++;
+    for (auto &handler : handlersSnapshot()) {
+        handler->addWaypoint(waypointId, name, lat, lon);
+    }
+}
+
+// Leg names and IDs on each bus match the waypoints its plotters were
+// sent, so the route refers to them rather than to new copies.
+void SyncManager::syncRoute(const Route &route, const WaypointCollection &collection) {
+    std::cout << "Syncing route: " << route.name << " (" << route.legs.size() << " legs) across devices." << std::endl;
+    auto handlers = handlersSnapshot();
+    std::vector<std::vector<std::string>> vendors;
+    for (auto &handler : handlers) {
+        vendors.push_back(handler->getDetectedDevices());
+    }
+    std::vector<WaypointCollection> busRoutes(handlers.size());
+    {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        for (size_t i = 0; i < handlers.size(); ++i) {
+            auto slots = busSlots.find(handlers[i]->getBusName());
+            appendEncodedRoute(route, collection, encodings.profileFor(vendors[i]),
+                               slots == busSlots.end() ? nullptr : &slots->second, busRoutes[i]);
+            const Route &sent = busRoutes[i].routes().front();
+            for (size_t leg = 0; leg < route.legs.size(); ++leg) {
+                rememberSentName(handlers[i]->getBusName(), busRoutes[i].at(sent.legs[leg]).name,
+                                 collection.at(route.legs[leg]).name);
+            }
+        }
+    }
+    for (size_t i = 0; i < handlers.size(); ++i) {
+        handlers[i]->sendRoute(busRoutes[i].routes().front(), busRoutes[i]);
+    }
+
+    std::vector<std::string> legNames = collection.legNames(route);
+    {
+        std::lock_guard<std::mutex> lock(outputsMutex);
+        for (auto &output : nmea0183Outputs) {
+            output->sendRoute(std::to_string(route.id), legNames);
+        }
+    }
+    syncWorkerWake.notify_one();
+}
+
+// Called from bus receive threads: only a wake-up, never any real work.
+void SyncManager::notifyWaypointEvents() {
+    syncWorkerWake.notify_one();
+}
+
+void SyncManager::startSyncWorker() {
+    if (syncWorkerRunning.exchange(true)) {
+        return;
+    }
+    syncWorker = std::thread(&SyncManager::syncWorkerLoop, this);
+}
+
+void SyncManager::stopSyncWorker() {
+    if (!syncWorkerRunning.exchange(false)) {
+        return;
+    }
+    syncWorkerWake.notify_one();
+    if (syncWorker.joinable()) {
+        syncWorker.join();
+    }
+}
+
+void SyncManager::syncWorkerLoop() {
+    std::vector<Waypoint> batch;
+    batch.reserve(waypointEventBatchSize);
+    auto lastSelectionRefresh = std::chrono::steady_clock::now();
+
+    while (syncWorkerRunning) {
+        {
+            // Timed wait so a wake-up racing with the check costs at most one
+            // tick; sooner when a 0183 output has its next batch due.
+            auto wait = std::chrono::milliseconds(100);
+            int outputWaitMs = pumpNmea0183Outputs();
+            if (outputWaitMs >= 0) {
+                wait = std::min(wait, std::chrono::milliseconds(outputWaitMs));
+            }
+            std::unique_lock<std::mutex> lock(syncWorkerMutex);
+            syncWorkerWake.wait_for(lock, wait);
+        }
+        // The selection follows the ship even when nothing new arrived.
+        bool observed = drainWaypointEvents(batch);
+        bool imported;
+        uint64_t merged;
+        std::vector<WaypointCollection> routes;
+        {
+            std::lock_guard<std::mutex> lock(mergeMutex);
+            merged = importsMerged;
+            imported = selectionDirty;
+            selectionDirty = false;
+            routes.swap(pendingRoutes);
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (observed || imported || now - lastSelectionRefresh >= selectionRefreshInterval) {
+            refreshSelections();
+            lastSelectionRefresh = now;
+        }
+        for (const auto &routeCollection : routes) {
+            syncRoute(routeCollection.routes().front(), routeCollection);
+        }
+        importsQueued = merged;
+        drainCapturedFrames();
+    }
+    drainWaypointEvents(batch);
+    drainCapturedFrames();
+}
+
+bool SyncManager::drainWaypointEvents(std::vector<Waypoint> &batch) {
+    {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        bool observed = false;
+        for (auto &handler : handlersSnapshot()) {
+            while (handler->getWaypointEvents().popBatch(batch, waypointEventBatchSize) > 0) {
+                for (auto &waypoint : batch) {
+                    resolveSentName(handler->getBusName(), waypoint);
+                    std::string source = handler->getBusName() + ":" + std::to_string(waypoint.source);
+                    mergeEngine->observe(mergeEngine->sourceId(source), waypoint);
+                    selector->markHeld(handler->getBusName(), waypoint);
+                    holdSlot(handler->getBusName(), waypoint);
+                }
+                batch.clear();
+                observed = true;
+            }
+        }
+        if (!observed) {
+            return false;
+        }
+        reportMerge(mergeEngine->merge());
+        updateSelectorLibrary();
+    }
+    return true;
+}
+
+// Raw capture log, written here so the bus threads never touch a file.
+// Frames that cannot be written are dropped rather than left to fill the
+// queues.
+void SyncManager::drainCapturedFrames() {
+    std::ofstream log;
+    bool opened = false;
+    CapturedFrame frame;
+    for (auto &handler : handlersSnapshot()) {
+        while (handler->getCapturedFrames().tryPop(frame)) {
+            if (!opened) {
+                opened = true;
+                fs::path directory = config()->logDirectory;
+                std::error_code error;
+                fs::create_directories(directory, error);
+                log.open(directory / "pgn_capture.log", std::ios::app);
+                if (!log && !captureLogFailed) {
+                    std::cerr << "Failed to open capture log in " << directory << std::endl;
+                }
+                captureLogFailed = !log;
+            }
+            if (!log) {
+                continue;
+            }
+            log << "[" << handler->getBusName() << "] " << frame.vendor << " PGN: " << frame.msg.PGN
+                << " | SRC: " << static_cast<int>(frame.msg.Source) << " | LEN: " << frame.msg.DataLen << " | DATA:";
+            for (int i = 0; i < frame.msg.DataLen; ++i) {
+                log << ' ' << std::hex << std::uppercase << static_cast<int>(frame.msg.Data[i]) << std::dec;
+            }
+            log << '\n';
+        }
+    }
+}
+
+bool SyncManager::importWaypointFile(const std::string &path, const std::string &format) {
+    WaypointCollection collection;
+    if (!loadWaypointCollection(path, format, collection)) {
+        std::cerr << "Failed to import waypoints from " << path << std::endl;
+        return false;
+    }
+    mergeImported(path, collection);
+    return true;
+}
+
+// Route legs are waypoints too, so the sync worker sends them before the
+// routes that refer to them.
+void SyncManager::mergeImported(const std::string &path, const WaypointCollection &collection) {
+    {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        mergeEngine->observeSnapshot(mergeEngine->sourceId("file:" + path), collection.waypoints());
+        reportMerge(mergeEngine->merge());
+        updateSelectorLibrary();
+        for (auto &routeCollection : mergeRoutes(path, collection)) {
+            pendingRoutes.push_back(std::move(routeCollection));
+        }
+        selectionDirty = true;
+        ++importsMerged;
+    }
+    syncWorkerWake.notify_one();
+}
+
+static bool sameRoute(const WaypointCollection &a, const Route &routeA, const WaypointCollection &b,
+                      const Route &routeB) {
+    if (routeA.name != routeB.name || routeA.legs.size() != routeB.legs.size()) {
+        return false;
+    }
+    for (size_t leg = 0; leg < routeA.legs.size(); ++leg) {
+        const Waypoint &x = a.at(routeA.legs[leg]);
+        const Waypoint &y = b.at(routeB.legs[leg]);
+        if (x.name != y.name || x.latitude != y.latitude || x.longitude != y.longitude) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Called with mergeMutex held. Returns the routes that are new or differ
+// from the library's copy; unnamed routes are told apart by file and
+// position in it.
+std::vector<WaypointCollection> SyncManager::mergeRoutes(const std::string &path, const WaypointCollection &collection) {
+    std::vector<WaypointCollection> changed;
+    for (size_t i = 0; i < collection.routes().size(); ++i) {
+        const Route &route = collection.routes()[i];
+        std::string key = route.name.empty() ? path + "#" + std::to_string(i) : MergeEngine::keyFor(route.name);
+
+        uint16_t id = 0;
+        auto existing = libraryRoutes.find(key);
+        if (existing != libraryRoutes.end()) {
+            const Route &known = existing->second.routes().front();
+            if (sameRoute(existing->second, known, collection, route)) {
+                continue;
+            }
+            id = known.id;
+        } else {
+            id = nextLibraryRouteId++;
+        }
+
+        WaypointCollection routeCollection;
+        Route copy;
+        copy.name = route.name;
+        for (uint32_t leg : route.legs) {
+            copy.legs.push_back(routeCollection.add(collection.at(leg)));
+        }
+        Route &added = routeCollection.addRoute(copy.name);
+        added.id = id;
+        added.legs = std::move(copy.legs);
+        libraryRoutes[key] = routeCollection;
+        changed.push_back(std::move(routeCollection));
+    }
+    return changed;
+}
+
+// Called with mergeMutex held. Copies a route and its legs into a target's
+// collection, legs named for the target's profile and, on a bus, carrying
+// the IDs the bus's plotters already have for them.
+void SyncManager::appendEncodedRoute(const Route &route, const WaypointCollection &from,
+                                     WaypointEncodingCache::ProfileId profile,
+                                     const std::unordered_map<std::string, uint16_t> *slots, WaypointCollection &to) {
+    std::vector<uint32_t> legs;
+    legs.reserve(route.legs.size());
+    for (uint32_t leg : route.legs) {
+        Waypoint waypoint = from.at(leg);
+        if (slots) {
+            auto slot = slots->find(MergeEngine::keyFor(waypoint.name));
+            if (slot != slots->end()) {
+                waypoint.id = slot->second;
+            }
+        }
+        auto encoded = encodings.encode(profile, waypoint);
+        waypoint.name = encoded->name;
+        waypoint.symbol = encoded->symbol;
+        legs.push_back(to.add(waypoint));
+    }
+    Route &added = to.addRoute(route.name);
+    added.id = route.id;
+    added.legs = std::move(legs);
+}
+
+// Import workers run concurrently, so every device and source track file
+// gets its own output: "output_track.<device>.<source path>", with the
+// source's directories flattened into the name.
+static std::string trackOutputName(const std::string &source, const std::string &device) {
+    std::string flattened = fs::path(source).replace_extension().relative_path().string();
+    std::replace(flattened.begin(), flattened.end(), '/', '_');
+    return "output_track." + device + "." + flattened;
+}
+
+// Streams the track file once at the largest budget any device needs,
+// then trims that in memory for each smaller device.
+bool SyncManager::syncTrackFile(const std::string &path, const std::string &format) {
+    std::shared_ptr<const Config> settings = config();
+    std::vector<std::pair<std::string, std::string>> targets;
+    size_t largestBudget = 0;
+    for (auto &handler : handlersSnapshot()) {
+        for (const auto &device : handler->getDetectedDevices()) {
+            auto it = settings->formatMap.find(device);
+            if (it != settings->formatMap.end()) {
+                targets.push_back({device, it->second});
+                largestBudget = std::max(largestBudget, settings->trackPointBudgetFor(device));
+            }
+        }
+    }
+    if (targets.empty()) {
+        return true;
+    }
+
+    TrackSimplifier simplifier(settings->trackToleranceMeters, largestBudget);
+    if (!readTrackFile(path, format, simplifier)) {
+        return false;
+    }
+
+    fs::path directory = settings->trackOutputDirectory;
+    std::error_code error;
+    fs::create_directories(directory, error);
+
+    bool synced = true;
+    for (const auto &[device, deviceFormat] : targets) {
+        std::vector<Track> tracks;
+        for (const auto &track : simplifier.getTracks()) {
+            tracks.push_back(reduceToBudget(track, settings->trackPointBudgetFor(device), track.tolerance));
+        }
+        std::cout << "Syncing " << tracks.size() << " tracks from " << path << " (" << simplifier.getInputPoints()
+                  << " points) to device: " << device << std::endl;
+        synced = saveTracks(tracks, (directory / trackOutputName(path, device)).string(), deviceFormat) && synced;
+    }
+    return synced;
+}
+
+// What each bus and 0183 output is sent comes from its selection of the
+// merged library, so the per-source updates are not used here.
+void SyncManager::reportMerge(const MergeResult &result) {
+    if (result.conflictsResolved > 0) {
+        std::cout << "Resolved " << result.conflictsResolved << " conflicting waypoint edits." << std::endl;
+    }
+}
+
+// Queued sentences go out from the sync worker as each output's link
+// allows. Returns the milliseconds until the next batch is due, or -1
+// when every output is idle.
+int SyncManager::pumpNmea0183Outputs() {
+    std::lock_guard<std::mutex> lock(outputsMutex);
+    int nextMs = -1;
+    for (auto &output : nmea0183Outputs) {
+        int waitMs = output->pump();
+        if (waitMs >= 0 && (nextMs < 0 || waitMs < nextMs)) {
+            nextMs = waitMs;
+        }
+    }
+    return nextMs;
+}
+
+// Sync worker only. Every plotter on a bus hears every waypoint sent on
+// it, so the smallest one bounds the bus's set. Buses with no recognised plotter use the
+// default capacity.
+void SyncManager::refreshSelections() {
+    std::shared_ptr<const Config> settings = config();
+    auto handlers = handlersSnapshot();
+
+    std::vector<size_t> capacities;
+    std::vector<std::vector<std::string>> vendors;
+    for (auto &handler : handlers) {
+        size_t capacity = 0;
+        vendors.push_back(handler->getDetectedDevices());
+        for (const auto &device : vendors.back()) {
+            size_t deviceCapacity = settings->waypointCapacityFor(device);
+            capacity = capacity == 0 ? deviceCapacity : std::min(capacity, deviceCapacity);
+        }
+        capacities.push_back(capacity == 0 ? settings->defaultWaypointCapacity : capacity);
+    }
+
+    OwnShipPosition latest;
+    for (auto &handler : handlers) {
+        OwnShipPosition fix = handler->getOwnShipPosition();
+        if (fix.valid && (!latest.valid || fix.timeMs > latest.timeMs)) {
+            latest = fix;
+        }
+    }
+
+    std::vector<std::shared_ptr<Nmea0183Output>> outputs;
+    {
+        std::lock_guard<std::mutex> lock(outputsMutex);
+        outputs = nmea0183Outputs;
+    }
+
+    std::vector<std::vector<SlotUpdate>> updates(handlers.size());
+    std::vector<std::vector<Waypoint>> outputUpdates(outputs.size());
+    {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        selector->setPosition(latest);
+        for (size_t i = 0; i < handlers.size(); ++i) {
+            SelectionDelta delta = selector->select(handlers[i]->getBusName(), capacities[i], steadyMillis());
+            if (!delta.empty()) {
+                std::cout << "Waypoint set on " << handlers[i]->getBusName() << ": " << delta.added.size()
+                          << " in, " << delta.removed.size() << " out." << std::endl;
+            }
+            updates[i] = assignSlots(handlers[i]->getBusName(), delta);
+            WaypointEncodingCache::ProfileId profile = encodings.profileFor(vendors[i]);
+            for (auto &update : updates[i]) {
+                update.encoded = encodings.encode(profile, update.waypoint);
+                rememberSentName(handlers[i]->getBusName(), update.encoded->name, update.waypoint.name);
+            }
+        }
+        // 0183 plotters cannot report what they hold or delete anything,
+        // so each output just gets whatever enters or changes in its set.
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            outputUpdates[i] =
+                selector->select(nmea0183Target(*outputs[i]), settings->defaultWaypointCapacity, steadyMillis()).added;
+        }
+        syncScratch.reset();
+    }
+
+    // An output that is still behind takes what fits; the rest goes back
+    // to its selection to be offered again on a later refresh.
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(outputsMutex);
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            if (!outputUpdates[i].empty()) {
+                size_t sent = outputs[i]->sendWaypoints(outputUpdates[i]);
+                queued = queued || sent > 0;
+                outputUpdates[i].erase(outputUpdates[i].begin(), outputUpdates[i].begin() + static_cast<std::ptrdiff_t>(sent));
+            }
+        }
+    }
+    if (queued) {
+        syncWorkerWake.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mergeMutex);
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            selector->release(nmea0183Target(*outputs[i]), outputUpdates[i]);
+        }
+    }
+
+    for (size_t i = 0; i < handlers.size(); ++i) {
+        for (const auto &update : updates[i]) {
+            if (update.reuse) {
+                handlers[i]->updateWaypoint(update.id, *update.encoded);
+            } else {
+                handlers[i]->addWaypoint(update.id, *update.encoded);
+            }
+        }
+    }
+}
+
+// IDs we allocated and IDs plotters reported are recycled alike, so a
+// waypoint that leaves the set is overwritten by the next one in rather
+// than left taking up the plotter's capacity.
+std::vector<SyncManager::SlotUpdate> SyncManager::assignSlots(const std::string &bus, const SelectionDelta &delta) {
+    auto &slots = busSlots[bus];
+    auto &freeSlots = freeBusSlots[bus];
+    for (const auto &waypoint : delta.removed) {
+        auto slot = slots.find(MergeEngine::keyFor(waypoint.name));
+        if (slot != slots.end()) {
+            freeSlots.push_back(slot->second);
+            slots.erase(slot);
+        }
+    }
+
+    std::vector<SlotUpdate> updates;
+    for (const auto &waypoint : delta.added) {
+        std::string key = MergeEngine::keyFor(waypoint.name);
+        auto slot = slots.find(key);
+        if (slot != slots.end()) {
+            updates.push_back({slot->second, waypoint, true, nullptr});
+        } else if (!freeSlots.empty()) {
+            updates.push_back({freeSlots.back(), waypoint, true, nullptr});
+            slots.emplace(key, freeSlots.back());
+            freeSlots.pop_back();
+        } else {
+            uint16_t id = nextWaypointId++;
+            updates.push_back({id, waypoint, false, nullptr});
+            slots.emplace(key, id);
+        }
+    }
+    return updates;
+}
+
+// Called with mergeMutex held. A waypoint heard from a plotter keeps the
+// plotter's ID as its slot, unless another waypoint on the bus already
+// has that ID (two plotters numbering independently).
+void SyncManager::holdSlot(const std::string &bus, const Waypoint &waypoint) {
+    auto &slots = busSlots[bus];
+    std::string key = MergeEngine::keyFor(waypoint.name);
+    if (slots.count(key)) {
+        return;
+    }
+    for (const auto &[otherKey, id] : slots) {
+        if (id == waypoint.id) {
+            return;
+        }
+    }
+    // Reported again after it left the set: it is still there, so it is
+    // held again rather than free.
+    auto &freeSlots = freeBusSlots[bus];
+    freeSlots.erase(std::remove(freeSlots.begin(), freeSlots.end(), waypoint.id), freeSlots.end());
+    slots.emplace(key, waypoint.id);
+}
+
+// Called with mergeMutex held. Only names the profile changed need an entry.
+void SyncManager::rememberSentName(const std::string &bus, const std::string &sentName,
+                                   const std::string &libraryName) {
+    std::string sentKey = MergeEngine::keyFor(sentName);
+    if (sentKey != MergeEngine::keyFor(libraryName)) {
+        sentNames[bus][sentKey] = libraryName;
+    }
+}
+
+// Called with mergeMutex held.
+void SyncManager::resolveSentName(const std::string &bus, Waypoint &waypoint) const {
+    auto names = sentNames.find(bus);
+    if (names == sentNames.end()) {
+        return;
+    }
+    auto name = names->second.find(MergeEngine::keyFor(waypoint.name));
+    if (name != names->second.end()) {
+        waypoint.name = name->second;
+    }
+}
+
+// Called with mergeMutex held. A plotter can echo a waypoint long after it
+// left the bus's set, so names are kept until the library drops the waypoint.
+void SyncManager::forgetSentNames(const std::pmr::vector<Waypoint> &library) {
+    if (sentNames.empty()) {
+        return;
+    }
+    std::unordered_set<std::string> libraryKeys;
+    libraryKeys.reserve(library.size());
+    for (const auto &waypoint : library) {
+        libraryKeys.insert(MergeEngine::keyFor(waypoint.name));
+    }
+    for (auto &[bus, names] : sentNames) {
+        for (auto it = names.begin(); it != names.end();) {
+            it = libraryKeys.count(MergeEngine::keyFor(it->second)) ? std::next(it) : names.erase(it);
+        }
+    }
+}
+
+void SyncManager::createLibrary(bool compact) {
+    compactMemory = compact;
+    mergeEngine = std::make_unique<MergeEngine>(compact);
+    if (compact) {
+        selector = std::make_unique<WaypointSelector>(selectionSettingsFrom(*config()), mergeEngine->keyPool(),
+                                                      *mergeEngine->stringPool());
+    } else {
+        selector = std::make_unique<WaypointSelector>(selectionSettingsFrom(*config()));
+    }
+    selector->setScratch(scratchResource());
+    if (compact) {
+        useCompactAllocator();
+        std::cout << "Compact memory mode: library packed, sync temporaries in a scratch arena." << std::endl;
+    }
+}
+
+// Called with mergeMutex held, before anything is merged.
+void SyncManager::startLibraryExport(const Config &current) {
+    if (current.libraryShmName.empty()) {
+        return;
+    }
+    libraryPublisher = std::make_unique<LibraryPublisher>(current.libraryShmName, current.librarySocketPath);
+    if (!libraryPublisher->start()) {
+        libraryPublisher.reset();
+    }
+}
+
+std::pmr::memory_resource *SyncManager::scratchResource() {
+    return compactMemory ? syncScratch.resource() : std::pmr::get_default_resource();
+}
+
+// Called with mergeMutex held. The full library copy is only needed while
+// the selector diffs it, so in compact mode it lives in the scratch arena.
+void SyncManager::updateSelectorLibrary() {
+    {
+        std::pmr::vector<Waypoint> library = mergeEngine->waypoints(scratchResource());
+        selector->setLibrary(library.data(), library.size(), steadyMillis());
+        if (libraryPublisher && selector->libraryRevision() != publishedRevision) {
+            publishedRevision = selector->libraryRevision();
+            libraryPublisher->publish(library.data(), library.size(), publishedRevision);
+        }
+        if (selector->libraryRevision() != encodingsRevision) {
+            encodingsRevision = selector->libraryRevision();
+            encodings.retain(library.data(), library.size());
+            forgetSentNames(library);
+        }
+    }
+    syncScratch.reset();
+    if (compactMemory) {
+        releaseFreeMemory();
+    }
+}
+
+std::vector<std::shared_ptr<NMEAWaypointHandler>> SyncManager::handlersSnapshot() {
+    std::lock_guard<std::mutex> lock(handlersMutex);
+    return nmeaHandlers;
 }
 
 void SyncManager::setNMEAHandler(std::shared_ptr<NMEAWaypointHandler> handler) {
-    nmeaHandler = handler;
+    std::lock_guard<std::mutex> lock(handlersMutex);
+    nmeaHandlers.clear();
+    if (handler) {
+        nmeaHandlers.push_back(handler);
+    }
+}
+
+void SyncManager::addNMEAHandler(std::shared_ptr<NMEAWaypointHandler> handler) {
+    if (!handler) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(handlersMutex);
+    nmeaHandlers.push_back(handler);
+    if (bridgeWaypointPgns) {
+        bridgeBuses();
+    }
+}
+
+void SyncManager::addNmea0183Output(std::shared_ptr<Nmea0183Output> output) {
+    if (!output || !output->isOpen()) {
+        std::cerr << "Ignoring NMEA 0183 output that is not open." << std::endl;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(outputsMutex);
+    nmea0183Outputs.push_back(output);
 }
 
 std::shared_ptr<NMEAWaypointHandler> SyncManager::getNmeaHandler() {
-    return nmeaHandler;
+    std::lock_guard<std::mutex> lock(handlersMutex);
+    return nmeaHandlers.empty() ? nullptr : nmeaHandlers.front();
 }
 
@@ -1,23 +1,42 @@
 #ifndef SYNC_MANAGER_H
 #define SYNC_MANAGER_H
 
+#include <map>
 #include <unordered_map>
 #include <string>
 #include <ctime>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "nmea_waypoint_handler.h" 
+#include "nmea0183_output.h"
+#include "merge_engine.h"
+#include "config.h"
+#include "media_monitor.h"
+#include "waypoint_selection.h"
+#include "library_publisher.h"
+#include "event_loop.h"
+#include "task.h"
 
 class SyncManager {
 public:
     SyncManager();
+    explicit SyncManager(std::shared_ptr<ConfigStore> store);
+    explicit SyncManager(const std::vector<std::string> &canInterfaces, bool bridgeWaypointPgns = false);
     ~SyncManager();
     
     void checkForChanges();
     bool checkInotifyChanges();
     void checkPollingChanges(const std::string &path);
     void loadFormatMappings();
+    bool reloadConfig();
+    std::shared_ptr<const Config> config() const { return configStore->current(); }
     void initialize(bool reloadedFormats = true, bool addWatches = true);
-    void addWatch(const std::string &path);
+    int addWatch(const std::string &path);
     void syncWaypointsOnBoot();
     void resetChangeFlags();
     void clearFileTimestamps();
@@ -25,21 +44,165 @@ public:
     bool isPollChangeDetected();
     void syncWaypointsAcrossDevices();
     void syncWaypoint(double lat, double lon, const std::string &name);
+    void syncRoute(const Route &route, const WaypointCollection &collection);
+    void notifyWaypointEvents();
     void setNMEAHandler(std::shared_ptr<NMEAWaypointHandler> handler);  
+    void addNMEAHandler(std::shared_ptr<NMEAWaypointHandler> handler);
+    void addNmea0183Output(std::shared_ptr<Nmea0183Output> output);
+    bool importWaypointFile(const std::string &path, const std::string &format);
+
+    // The daemon's pipeline on an event loop: waits for inotify events
+    // (polling the watch directory on timeout) and runs device syncs as
+    // tasks, so gpsbabel runs, file I/O and bus pacing for every device
+    // overlap on one thread. Replaces calling checkForChanges() in a loop.
+    Task<void> watchForChanges(EventLoop &loop);
+    Task<void> syncWaypointsAcrossDevicesAsync(EventLoop &loop);
+    Task<bool> importWaypointFileAsync(EventLoop &loop, std::string path, std::string format);
+    bool syncTrackFile(const std::string &path, const std::string &format);
 
     std::shared_ptr<NMEAWaypointHandler> getNmeaHandler();
+    const std::vector<std::shared_ptr<NMEAWaypointHandler>>& getNmeaHandlers() const { return nmeaHandlers; }
 
     int getInotifyFdForTesting() const { return inotifyFd; }
     void setInotifyFdForTesting(int fd) { inotifyFd = fd; }
 
 private:
+    std::shared_ptr<ConfigStore> configStore;
     int inotifyFd = -1;  
+    int watchDirectoryDescriptor = -1;
+    int configWatchDescriptor = -1;
+    std::string configFileName;
+    void applyConfig(const Config &previous, const Config &current);
+    void openConfiguredOutputs(const Config &current);
+    void startMediaMonitor(const Config &current);
+
+    // SD cards and USB sticks: imported on mount, no polling.
+    std::unique_ptr<MediaMonitor> mediaMonitor;
     bool inotifyChangeDetected = false; 
     bool pollChangeDetected = false;
-    uint16_t nextWaypointId = 1000;
-    void handleFileChange(const char *buffer); 
+    std::atomic<uint16_t> nextWaypointId{1000};  // Sync worker and file imports both allocate
+    void handleFileChange();
     void pollForChanges(const std::string &path); 
-    std::shared_ptr<NMEAWaypointHandler> nmeaHandler;
+    bool readInotifyEvents(bool &configChanged, bool &waypointsChanged);
+    std::vector<std::string> changedFiles(const std::string &path);
+
+    // Device exports: the selected, vendor-normalised waypoints for each
+    // detected device with a known file format.
+    using ExportTarget = std::pair<std::string, std::string>;  // Device, gpsbabel format
+    std::vector<ExportTarget> exportTargets(const Config &settings);
+    bool chooseForExport(const std::string &device, const Config &settings, WaypointCollection &collection);
+    Task<void> exportToDevice(EventLoop &loop, std::string device, std::string format,
+                              std::shared_ptr<const Config> settings);
+    void mergeImported(const std::string &path, const WaypointCollection &collection);
+
+    // Routes from imported files, by merge key of the route name, each in
+    // a collection of its own with its legs. A route keeps its ID across
+    // imports so plotters replace it rather than add a copy. Guarded by
+    // mergeMutex.
+    std::map<std::string, WaypointCollection> libraryRoutes;
+    uint16_t nextLibraryRouteId = 1;
+    // Imports on other threads only merge; the sync worker runs every
+    // refresh, so slots are assigned and their sends queued in one order.
+    // Routes wait for the refresh that sends their legs. Both guarded by
+    // mergeMutex.
+    bool selectionDirty = false;
+    std::vector<WaypointCollection> pendingRoutes;
+    // Imports merged, and how many of them the sync worker has queued on
+    // the buses and 0183 outputs; a sync waits for the two to meet.
+    std::atomic<uint64_t> importsMerged{0};
+    std::atomic<uint64_t> importsQueued{0};
+    Task<void> importsReachedTheWorker(EventLoop &loop);
+    std::vector<WaypointCollection> mergeRoutes(const std::string &path, const WaypointCollection &collection);
+    void appendEncodedRoute(const Route &route, const WaypointCollection &from, WaypointEncodingCache::ProfileId profile,
+                            const std::unordered_map<std::string, uint16_t> *slots, WaypointCollection &to);
+
+    // Changes that arrive while a sync runs fold into one more pass after
+    // it. Loop thread only.
+    bool syncInFlight = false;
+    bool syncRequested = false;
+    void requestSync(EventLoop &loop);
+    Task<void> runRequestedSyncs(EventLoop &loop);
+    void bridgeBuses();
+    std::vector<std::shared_ptr<NMEAWaypointHandler>> handlersSnapshot();
+
+    // Sync worker: drains each bus's waypoint event queue in batches so the
+    // receive threads never run sync or transmit work themselves.
+    static constexpr size_t waypointEventBatchSize = 64;
+    std::thread syncWorker;
+    std::atomic<bool> syncWorkerRunning{false};
+    std::mutex syncWorkerMutex;
+    std::condition_variable syncWorkerWake;
+    void startSyncWorker();
+    void stopSyncWorker();
+    void syncWorkerLoop();
+    bool drainWaypointEvents(std::vector<Waypoint> &batch);
+    void drainCapturedFrames();
+    bool captureLogFailed = false;  // Sync worker only; reported once
+
+    // Every bus device and imported file is a merge source; each target
+    // is then sent its own selection of the merged library.
+    std::unique_ptr<MergeEngine> mergeEngine;
+    std::mutex mergeMutex;  // Guards mergeEngine, selector, encodings and syncScratch
+    void reportMerge(const MergeResult &result);
+
+    // What each bus and device export holds is picked by the selector from
+    // the merged library. On a bus, a waypoint that drops out hands its ID
+    // to one that comes in, so ID-keyed plotters swap in place.
+    struct SlotUpdate {
+        uint16_t id;
+        Waypoint waypoint;
+        bool reuse;  // ID already sent on this bus
+        std::shared_ptr<const EncodedWaypoint> encoded;  // As the bus's plotters want it
+    };
+    static constexpr std::chrono::milliseconds selectionRefreshInterval{1000};  // Sync worker only
+    std::unique_ptr<WaypointSelector> selector;
+    std::unordered_map<std::string, std::unordered_map<std::string, uint16_t>> busSlots;  // Bus -> merge key -> ID
+    std::unordered_map<std::string, std::vector<uint16_t>> freeBusSlots;
+    void refreshSelections();
+    std::vector<SlotUpdate> assignSlots(const std::string &bus, const SelectionDelta &delta);
+    void holdSlot(const std::string &bus, const Waypoint &waypoint);
+
+    // Plotters report waypoints back under the names they were sent, which
+    // the vendor profile may have shortened or transliterated; each bus
+    // remembers what it sent so those reports merge into the original.
+    std::unordered_map<std::string, std::unordered_map<std::string, std::string>> sentNames;  // Bus -> key of name sent -> library name
+    void rememberSentName(const std::string &bus, const std::string &sentName, const std::string &libraryName);
+    void resolveSentName(const std::string &bus, Waypoint &waypoint) const;
+    void forgetSentNames(const std::pmr::vector<Waypoint> &library);
+
+    // Compact mode (config memory_settings) packs the library and keeps
+    // each cycle's temporaries in syncScratch, released as the cycle ends.
+    // Fixed for the life of the process, like the CAN interfaces.
+    bool compactMemory = false;
+    ScratchArena syncScratch;
+    void createLibrary(bool compact);
+    std::pmr::memory_resource *scratchResource();
+    void updateSelectorLibrary();
+
+    // Names and symbols per plotter vendor (config vendor_profiles),
+    // normalised once per waypoint and profile rather than on every send.
+    WaypointEncodingCache encodings;
+    uint64_t encodingsRevision = 0;
+
+    // Read-only copy of the merged set in shared memory for local tools
+    // (config library_export), republished whenever the library changes.
+    std::unique_ptr<LibraryPublisher> libraryPublisher;
+    uint64_t publishedRevision = 0;
+    void startLibraryExport(const Config &current);
+
+    // One handler per CAN interface; the first one is the primary bus.
+    std::vector<std::string> canInterfaces;
+    bool bridgeWaypointPgns = false;
+    std::vector<std::shared_ptr<NMEAWaypointHandler>> nmeaHandlers;
+    std::mutex handlersMutex;
+
+    // Legacy plotters: each output has its own selection, sent as $GPWPL,
+    // and the sync worker pumps the queued sentences out at link speed.
+    std::vector<std::shared_ptr<Nmea0183Output>> nmea0183Outputs;
+    std::vector<std::shared_ptr<Nmea0183Output>> configuredOutputs;  // Owned by the config, replaced on reload
+    std::mutex outputsMutex;
+    int pumpNmea0183Outputs();
+    Task<void> drainNmea0183Outputs(EventLoop &loop);
 
 };
 
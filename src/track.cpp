@@ -0,0 +1,204 @@
+#include "track.h"
+#include <algorithm>
+#include <cmath>
+
+// Metres per degree of latitude on the WGS84 mean radius.
+const double METERS_PER_DEGREE = 6371008.8 * M_PI / 180.0;
+
+size_t Track::pointCount() const {
+    size_t count = 0;
+    for (const auto &segment : segments) {
+        count += segment.size();
+    }
+    return count;
+}
+
+void TrackCollector::beginTrack(const std::string &name) {
+    tracks.push_back(Track{name, {}, 0.0});
+    segmentOpen = false;
+}
+
+void TrackCollector::addPoint(const TrackPoint &point) {
+    if (tracks.empty()) {
+        beginTrack("");
+    }
+    if (!segmentOpen) {
+        tracks.back().segments.emplace_back();
+        segmentOpen = true;
+    }
+    tracks.back().segments.back().push_back(point);
+}
+
+void TrackCollector::endSegment() {
+    segmentOpen = false;
+}
+
+void TrackCollector::endTrack() {
+    segmentOpen = false;
+}
+
+void douglasPeucker(const TrackPoint *points, size_t count, double toleranceMeters, std::vector<uint8_t> &keep) {
+    keep.assign(count, 0);
+    if (count == 0) {
+        return;
+    }
+    keep.front() = 1;
+    keep.back() = 1;
+    if (count < 3) {
+        return;
+    }
+
+    // Project once into flat arrays so the distance loop below is a plain
+    // streaming computation the compiler can vectorise.
+    std::vector<double> xs(count);
+    std::vector<double> ys(count);
+    std::vector<double> distances(count);
+    const double scaleX = METERS_PER_DEGREE * std::cos(points[0].latitude * M_PI / 180.0);
+    for (size_t i = 0; i < count; ++i) {
+        xs[i] = (points[i].longitude - points[0].longitude) * scaleX;
+        ys[i] = (points[i].latitude - points[0].latitude) * METERS_PER_DEGREE;
+    }
+
+    const double tolerance2 = toleranceMeters * toleranceMeters;
+    std::vector<std::pair<size_t, size_t>> stack{{0, count - 1}};
+    while (!stack.empty()) {
+        auto [first, last] = stack.back();
+        stack.pop_back();
+        if (last - first < 2) {
+            continue;
+        }
+
+        const double ax = xs[first], ay = ys[first];
+        const double dx = xs[last] - ax, dy = ys[last] - ay;
+        const double length2 = dx * dx + dy * dy;
+        const double inverse = length2 > 0.0 ? 1.0 / length2 : 0.0;
+        for (size_t i = first + 1; i < last; ++i) {
+            const double px = xs[i] - ax, py = ys[i] - ay;
+            const double t = std::min(1.0, std::max(0.0, (px * dx + py * dy) * inverse));
+            const double ex = px - t * dx, ey = py - t * dy;
+            distances[i] = ex * ex + ey * ey;
+        }
+
+        size_t farthest = first + 1;
+        for (size_t i = first + 2; i < last; ++i) {
+            farthest = distances[i] > distances[farthest] ? i : farthest;
+        }
+        if (distances[farthest] > tolerance2) {
+            keep[farthest] = 1;
+            stack.push_back({first, farthest});
+            stack.push_back({farthest, last});
+        }
+    }
+}
+
+TrackSegment simplifySegment(const TrackSegment &segment, double toleranceMeters) {
+    std::vector<uint8_t> keep;
+    douglasPeucker(segment.data(), segment.size(), toleranceMeters, keep);
+
+    TrackSegment result;
+    for (size_t i = 0; i < segment.size(); ++i) {
+        if (keep[i]) {
+            result.push_back(segment[i]);
+        }
+    }
+    return result;
+}
+
+Track reduceToBudget(const Track &track, size_t pointBudget, double toleranceMeters) {
+    Track result = track;
+    result.tolerance = std::max(result.tolerance, toleranceMeters);
+    size_t count = result.pointCount();
+    while (count > pointBudget) {
+        result.tolerance = result.tolerance > 0.0 ? result.tolerance * 2.0 : 1.0;
+        for (auto &segment : result.segments) {
+            segment = simplifySegment(segment, result.tolerance);
+        }
+        size_t reduced = result.pointCount();
+        if (reduced == count) {
+            break;  // Only segment end points left
+        }
+        count = reduced;
+    }
+    return result;
+}
+
+TrackSimplifier::TrackSimplifier(double toleranceMeters, size_t pointBudget, size_t windowSize)
+    : baseTolerance(toleranceMeters), pointBudget(pointBudget), windowSize(std::max<size_t>(windowSize, 3)),
+      tolerance(toleranceMeters) {
+    window.reserve(this->windowSize);
+}
+
+void TrackSimplifier::beginTrack(const std::string &name) {
+    if (current) {
+        endTrack();
+    }
+    tracks.push_back(Track{name, {}, baseTolerance});
+    current = &tracks.back();
+    tolerance = baseTolerance;
+    emittedPoints = 0;
+}
+
+void TrackSimplifier::addPoint(const TrackPoint &point) {
+    if (!current) {
+        beginTrack("");
+    }
+    if (window.empty()) {
+        current->segments.emplace_back();
+    }
+    ++inputPoints;
+    window.push_back(point);
+    if (window.size() == windowSize) {
+        flushWindow(false);
+    }
+}
+
+void TrackSimplifier::endSegment() {
+    flushWindow(true);
+}
+
+void TrackSimplifier::endTrack() {
+    flushWindow(true);
+    if (current) {
+        enforceBudget();
+        current->tolerance = tolerance;
+    }
+    current = nullptr;
+}
+
+void TrackSimplifier::flushWindow(bool final) {
+    if (window.empty()) {
+        return;
+    }
+
+    douglasPeucker(window.data(), window.size(), tolerance, keep);
+    TrackSegment &segment = current->segments.back();
+    size_t last = final ? window.size() : window.size() - 1;
+    for (size_t i = 0; i < last; ++i) {
+        if (keep[i]) {
+            segment.push_back(window[i]);
+            ++emittedPoints;
+        }
+    }
+
+    TrackPoint carry = window.back();
+    window.clear();
+    if (!final) {
+        window.push_back(carry);
+    }
+    enforceBudget();
+}
+
+void TrackSimplifier::enforceBudget() {
+    while (emittedPoints + window.size() > pointBudget) {
+        tolerance = tolerance > 0.0 ? tolerance * 2.0 : 1.0;
+        size_t reduced = 0;
+        for (auto &segment : current->segments) {
+            segment = simplifySegment(segment, tolerance);
+            reduced += segment.size();
+        }
+        if (reduced == emittedPoints) {
+            break;
+        }
+        emittedPoints = reduced;
+    }
+}
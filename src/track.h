@@ -0,0 +1,99 @@
+#ifndef TRACK_H
+#define TRACK_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+struct TrackPoint {
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double elevation = std::numeric_limits<double>::quiet_NaN();
+    int64_t time = 0;  // Unix seconds, 0 if unknown
+};
+
+using TrackSegment = std::vector<TrackPoint>;
+
+struct Track {
+    std::string name;
+    std::vector<TrackSegment> segments;
+    double tolerance = 0.0;  // Simplification tolerance actually used, in metres
+
+    size_t pointCount() const;
+};
+
+// Receives a track as it is parsed, one point at a time, so the whole
+// input never has to be in memory.
+class TrackSink {
+public:
+    virtual ~TrackSink() = default;
+    virtual void beginTrack(const std::string &name) = 0;
+    virtual void addPoint(const TrackPoint &point) = 0;
+    virtual void endSegment() = 0;
+    virtual void endTrack() = 0;
+};
+
+// Collects tracks unchanged; fine for small inputs and tests.
+class TrackCollector : public TrackSink {
+public:
+    void beginTrack(const std::string &name) override;
+    void addPoint(const TrackPoint &point) override;
+    void endSegment() override;
+    void endTrack() override;
+
+    const std::vector<Track> &getTracks() const { return tracks; }
+
+private:
+    std::vector<Track> tracks;
+    bool segmentOpen = false;
+};
+
+// Douglas-Peucker over points[0..count), marking kept points in keep. The
+// end points are always kept. Distances are in metres on a local
+// equirectangular projection, which is well inside the tolerance for the
+// few kilometres a window spans.
+void douglasPeucker(const TrackPoint *points, size_t count, double toleranceMeters, std::vector<uint8_t> &keep);
+TrackSegment simplifySegment(const TrackSegment &segment, double toleranceMeters);
+
+// Doubles the tolerance until the track fits in pointBudget points (or
+// stops shrinking). Returns the simplified track with its tolerance set.
+Track reduceToBudget(const Track &track, size_t pointBudget, double toleranceMeters);
+
+// Single-pass streaming simplifier. Points are buffered in a fixed-size
+// window; each full window is simplified and all but its last kept point
+// are emitted, and that point seeds the next window. If a track's output
+// outgrows the point budget, the tolerance doubles and the output so far
+// is simplified again, so memory stays at roughly window + 2 * budget
+// points whatever the input size. Repeated passes compound, so the final
+// error is at most twice the reported tolerance.
+class TrackSimplifier : public TrackSink {
+public:
+    TrackSimplifier(double toleranceMeters, size_t pointBudget, size_t windowSize = 4096);
+
+    void beginTrack(const std::string &name) override;
+    void addPoint(const TrackPoint &point) override;
+    void endSegment() override;
+    void endTrack() override;
+
+    const std::vector<Track> &getTracks() const { return tracks; }
+    size_t getInputPoints() const { return inputPoints; }
+
+private:
+    void flushWindow(bool final);
+    void enforceBudget();
+
+    double baseTolerance;
+    size_t pointBudget;
+    size_t windowSize;
+
+    std::vector<Track> tracks;
+    Track *current = nullptr;
+    double tolerance;
+    size_t emittedPoints = 0;  // In the current track
+    std::vector<TrackPoint> window;
+    std::vector<uint8_t> keep;
+    size_t inputPoints = 0;
+};
+
+#endif // TRACK_H
@@ -0,0 +1,48 @@
+#include "vendor_plugins.h"
+
+// Proprietary PGNs: single-frame addressable and the fast-packet range.
+const unsigned long PGN_PROPRIETARY_ADDRESSABLE = 126720;
+const unsigned long PGN_PROPRIETARY_FAST_PACKET_FIRST = 130816;
+const unsigned long PGN_PROPRIETARY_FAST_PACKET_LAST = 130821;
+
+void VendorPluginRegistry::add(VendorPlugin plugin) {
+    for (auto &existing : registered) {
+        if (existing.manufacturerCode == plugin.manufacturerCode) {
+            existing = std::move(plugin);
+            return;
+        }
+    }
+    registered.push_back(std::move(plugin));
+}
+
+const VendorPlugin *VendorPluginRegistry::findByManufacturer(uint16_t manufacturerCode) const {
+    for (const auto &plugin : registered) {
+        if (plugin.manufacturerCode == manufacturerCode) {
+            return &plugin;
+        }
+    }
+    return nullptr;
+}
+
+uint16_t manufacturerCodeFromName(uint64_t deviceName) {
+    return static_cast<uint16_t>((deviceName >> 21) & 0x7ff);
+}
+
+std::vector<unsigned long> proprietaryPgns() {
+    std::vector<unsigned long> pgns{PGN_PROPRIETARY_ADDRESSABLE};
+    for (unsigned long pgn = PGN_PROPRIETARY_FAST_PACKET_FIRST; pgn <= PGN_PROPRIETARY_FAST_PACKET_LAST; ++pgn) {
+        pgns.push_back(pgn);
+    }
+    return pgns;
+}
+
+// No proprietary waypoint payload is decoded yet, so the plugins only
+// identify the vendors; capture is opt-in per handler.
+VendorPluginRegistry defaultVendorPlugins() {
+    VendorPluginRegistry registry;
+    registry.add({"Garmin", N2K_MANUFACTURER_GARMIN, {}});
+    registry.add({"Lowrance", N2K_MANUFACTURER_NAVICO, {}});
+    registry.add({"Humminbird", N2K_MANUFACTURER_HUMMINBIRD, {}});
+    registry.add({"Raymarine", N2K_MANUFACTURER_RAYMARINE, {}});
+    return registry;
+}
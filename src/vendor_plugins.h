@@ -0,0 +1,52 @@
+#ifndef VENDOR_PLUGINS_H
+#define VENDOR_PLUGINS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "N2kMsg.h"
+#include "waypoint.h"
+
+// Manufacturer codes as assigned by NMEA (bits 21-31 of a device NAME).
+const uint16_t N2K_MANUFACTURER_GARMIN = 229;
+const uint16_t N2K_MANUFACTURER_NAVICO = 275;
+const uint16_t N2K_MANUFACTURER_HUMMINBIRD = 467;
+const uint16_t N2K_MANUFACTURER_RAYMARINE = 1851;
+
+// Decodes one vendor message into zero or more waypoints.
+using VendorDecoder = std::function<void(const tN2kMsg &, std::vector<Waypoint> &)>;
+
+struct VendorPgn {
+    unsigned long pgn;
+    VendorDecoder decode;
+};
+
+// Everything we know about one plotter vendor. name matches the device keys
+// in format_mapping.json.
+struct VendorPlugin {
+    std::string name;
+    uint16_t manufacturerCode;
+    std::vector<VendorPgn> pgns;
+};
+
+class VendorPluginRegistry {
+public:
+    void add(VendorPlugin plugin);
+    const VendorPlugin *findByManufacturer(uint16_t manufacturerCode) const;
+    const std::vector<VendorPlugin> &plugins() const { return registered; }
+
+private:
+    std::vector<VendorPlugin> registered;
+};
+
+// Garmin, Navico (Lowrance/Simrad/B&G), Humminbird and Raymarine.
+VendorPluginRegistry defaultVendorPlugins();
+
+uint16_t manufacturerCodeFromName(uint64_t deviceName);
+
+// 126720 and the 130816-130821 fast-packet range, where vendors put the
+// waypoint payloads we cannot decode yet.
+std::vector<unsigned long> proprietaryPgns();
+
+#endif // VENDOR_PLUGINS_H
@@ -0,0 +1,295 @@
+#include "vendor_profiles.h"
+#include "waypoint_pgns.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+namespace {
+
+// ASCII spellings of U+00C0 to U+00FF; empty means drop.
+const char *const LATIN1_UPPER_HALF[64] = {
+    "A", "A", "A", "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I", "I",
+    "D", "N", "O", "O", "O", "O", "O", "x", "O", "U", "U", "U", "U", "Y", "TH", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", "", "o", "u", "u", "u", "u", "y", "th", "y",
+};
+
+const char *transliterate(uint32_t codePoint) {
+    if (codePoint >= 0xc0 && codePoint <= 0xff) {
+        return LATIN1_UPPER_HALF[codePoint - 0xc0];
+    }
+    switch (codePoint) {
+    case 0xa0:
+        return " ";
+    case 0x2010: case 0x2011: case 0x2012: case 0x2013: case 0x2014:
+        return "-";
+    case 0x2018: case 0x2019:
+        return "'";
+    case 0x201c: case 0x201d:
+        return "\"";
+    default:
+        return "";
+    }
+}
+
+// Next code point from UTF-8; a byte that does not start a valid sequence
+// is taken as Latin-1, which is what older vendor files contain.
+uint32_t nextCodePoint(std::string_view text, size_t &i) {
+    unsigned char lead = static_cast<unsigned char>(text[i]);
+    size_t length = lead >= 0xf0 && lead < 0xf8 ? 4 : lead >= 0xe0 ? 3 : lead >= 0xc2 && lead < 0xe0 ? 2 : 1;
+    if (length > 1 && i + length <= text.size()) {
+        uint32_t codePoint = lead & (0x7f >> length);
+        bool valid = true;
+        for (size_t k = 1; k < length && valid; ++k) {
+            unsigned char next = static_cast<unsigned char>(text[i + k]);
+            valid = (next & 0xc0) == 0x80;
+            codePoint = (codePoint << 6) | (next & 0x3f);
+        }
+        if (valid) {
+            i += length;
+            return codePoint;
+        }
+    }
+    ++i;
+    return lead;
+}
+
+bool allowed(char c, NameCharset charset) {
+    if (charset == NameCharset::Upper) {
+        return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == ' ' || c == '-' || c == '.';
+    }
+    return c >= 0x20 && c <= 0x7e;
+}
+
+uint64_t contentHashOf(const Waypoint &waypoint) {
+    uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const void *data, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    };
+    mix(&waypoint.latitude, sizeof(waypoint.latitude));
+    mix(&waypoint.longitude, sizeof(waypoint.longitude));
+    mix(waypoint.symbol.data(), waypoint.symbol.size());
+    return hash;
+}
+
+} // namespace
+
+std::vector<VendorProfile> defaultVendorProfiles() {
+    std::vector<VendorProfile> profiles(5);
+    profiles[0].name = NMEA2000_PROFILE;
+    profiles[0].maxNameLength = 32;
+    profiles[1].name = "Garmin";
+    profiles[1].maxNameLength = 30;
+    profiles[2].name = "Lowrance";
+    profiles[2].maxNameLength = 15;
+    profiles[3].name = "Humminbird";
+    profiles[3].maxNameLength = 12;
+    profiles[4].name = "Raymarine";
+    profiles[4].maxNameLength = 16;
+    profiles[4].charset = NameCharset::Upper;
+    return profiles;
+}
+
+bool parseNameCharset(const std::string &text, NameCharset &charset) {
+    if (text == "ascii") {
+        charset = NameCharset::Ascii;
+    } else if (text == "upper") {
+        charset = NameCharset::Upper;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<VendorProfile> vendorProfilesWith(const std::vector<VendorProfileOverride> &overrides) {
+    std::vector<VendorProfile> profiles = defaultVendorProfiles();
+    for (const auto &entry : overrides) {
+        auto it = std::find_if(profiles.begin(), profiles.end(),
+                               [&](const VendorProfile &profile) { return profile.name == entry.vendor; });
+        if (it == profiles.end()) {
+            profiles.push_back(profiles[0]);
+            profiles.back().name = entry.vendor;
+            it = profiles.end() - 1;
+        }
+        if (entry.maxNameLength > 0) {
+            it->maxNameLength = entry.maxNameLength;
+        }
+        parseNameCharset(entry.charset, it->charset);
+        for (const auto &[from, to] : entry.symbols) {
+            it->symbols[from] = to;
+        }
+        if (!entry.defaultSymbol.empty()) {
+            it->defaultSymbol = entry.defaultSymbol;
+        }
+    }
+    return profiles;
+}
+
+std::string normaliseName(std::string_view name, const VendorProfile &profile) {
+    std::string ascii;
+    ascii.reserve(name.size());
+    for (size_t i = 0; i < name.size();) {
+        uint32_t codePoint = nextCodePoint(name, i);
+        if (codePoint < 0x80) {
+            ascii.push_back(static_cast<char>(codePoint));
+        } else {
+            ascii += transliterate(codePoint);
+        }
+    }
+
+    // Unsupported characters become spaces; runs of spaces collapse.
+    std::string result;
+    for (char c : ascii) {
+        if (profile.charset == NameCharset::Upper && c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+        if (!allowed(c, profile.charset)) {
+            if (profile.charset == NameCharset::Ascii) {
+                continue;
+            }
+            c = ' ';
+        }
+        if (c == ' ' && (result.empty() || result.back() == ' ')) {
+            continue;
+        }
+        result.push_back(c);
+    }
+    if (result.size() > profile.maxNameLength) {
+        result.resize(profile.maxNameLength);
+    }
+    while (!result.empty() && result.back() == ' ') {
+        result.pop_back();
+    }
+    return result.empty() ? "WPT" : result;
+}
+
+std::string mapSymbol(const std::string &symbol, const VendorProfile &profile) {
+    auto it = profile.symbols.find(symbol);
+    if (it != profile.symbols.end()) {
+        return it->second;
+    }
+    return profile.defaultSymbol.empty() ? symbol : profile.defaultSymbol;
+}
+
+EncodedWaypoint encodeWaypoint(const Waypoint &waypoint, const VendorProfile &profile) {
+    EncodedWaypoint encoded;
+    encoded.name = normaliseName(waypoint.name, profile);
+    encoded.symbol = mapSymbol(waypoint.symbol, profile);
+    encoded.latitude = waypoint.latitude;
+    encoded.longitude = waypoint.longitude;
+    WaypointListPgn::encodeItem(encoded.record, 0, encoded.name, waypoint.latitude, waypoint.longitude);
+    return encoded;
+}
+
+bool appendWaypointRecord(tN2kMsg &msg, uint16_t id, const EncodedWaypoint &encoded) {
+    int start = msg.DataLen;
+    if (!WaypointListPgn::appendEncodedItem(msg, encoded.record)) {
+        return false;
+    }
+    pgn_schema::UInt<2>::write(msg.Data + start, id);
+    return true;
+}
+
+WaypointEncodingCache::WaypointEncodingCache(std::vector<VendorProfile> profiles) {
+    setProfiles(std::move(profiles));
+}
+
+void WaypointEncodingCache::setProfiles(std::vector<VendorProfile> configured) {
+    profiles.clear();
+    profileByName.clear();
+    cached.clear();
+    bool hasDefault = std::any_of(configured.begin(), configured.end(),
+                                  [](const VendorProfile &profile) { return profile.name == NMEA2000_PROFILE; });
+    if (!hasDefault) {
+        configured.insert(configured.begin(), defaultVendorProfiles().front());
+    }
+    for (auto &profile : configured) {
+        addProfile(std::move(profile));
+    }
+}
+
+WaypointEncodingCache::ProfileId WaypointEncodingCache::addProfile(VendorProfile profile) {
+    ProfileId id = profiles.size();
+    profileByName[profile.name] = id;
+    profiles.push_back(std::move(profile));
+    cached.emplace_back();
+    return id;
+}
+
+// Every plotter on a bus hears every waypoint sent on it, so a bus gets
+// the shortest name limit and narrowest charset of its plotters.
+WaypointEncodingCache::ProfileId WaypointEncodingCache::profileFor(const std::vector<std::string> &vendors) {
+    std::vector<ProfileId> known;
+    for (const auto &vendor : vendors) {
+        auto it = profileByName.find(vendor);
+        if (it != profileByName.end()) {
+            known.push_back(it->second);
+        }
+    }
+    std::sort(known.begin(), known.end());
+    known.erase(std::unique(known.begin(), known.end()), known.end());
+    if (known.empty()) {
+        return profileByName.at(NMEA2000_PROFILE);
+    }
+    if (known.size() == 1) {
+        return known[0];
+    }
+
+    std::string name;
+    for (ProfileId id : known) {
+        name += (name.empty() ? "" : "+") + profiles[id].name;
+    }
+    auto existing = profileByName.find(name);
+    if (existing != profileByName.end()) {
+        return existing->second;
+    }
+    VendorProfile combined = profiles[known[0]];
+    combined.name = name;
+    for (ProfileId id : known) {
+        combined.maxNameLength = std::min(combined.maxNameLength, profiles[id].maxNameLength);
+        if (profiles[id].charset == NameCharset::Upper) {
+            combined.charset = NameCharset::Upper;
+        }
+    }
+    return addProfile(std::move(combined));
+}
+
+std::shared_ptr<const EncodedWaypoint> WaypointEncodingCache::encode(ProfileId profile, const Waypoint &waypoint) {
+    uint64_t hash = contentHashOf(waypoint);
+    auto &entries = cached[profile];
+    auto it = entries.find(waypoint.name);
+    if (it != entries.end() && it->second.contentHash == hash) {
+        ++hits;
+        return it->second.encoded;
+    }
+    ++misses;
+    auto encoded = std::make_shared<const EncodedWaypoint>(encodeWaypoint(waypoint, profiles[profile]));
+    entries[waypoint.name] = Cached{hash, encoded};
+    return encoded;
+}
+
+void WaypointEncodingCache::retain(const Waypoint *waypoints, size_t count) {
+    std::unordered_set<std::string_view> live;
+    live.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        live.insert(waypoints[i].name);
+    }
+    for (auto &entries : cached) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            it = live.count(it->first) ? std::next(it) : entries.erase(it);
+        }
+    }
+}
+
+WaypointEncodingCache::Stats WaypointEncodingCache::getStats() const {
+    Stats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    for (const auto &entries : cached) {
+        stats.entries += entries.size();
+    }
+    return stats;
+}
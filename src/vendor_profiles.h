@@ -0,0 +1,119 @@
+#ifndef VENDOR_PROFILES_H
+#define VENDOR_PROFILES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "waypoint.h"
+
+class tN2kMsg;
+
+// How each plotter vendor wants waypoint names and symbols. name matches
+// the vendor names of detected devices and the device keys in
+// format_mappings.
+enum class NameCharset {
+    Ascii,  // Printable ASCII
+    Upper,  // A-Z, 0-9, space, '-' and '.'
+};
+
+struct VendorProfile {
+    std::string name;
+    size_t maxNameLength = 32;
+    NameCharset charset = NameCharset::Ascii;
+    std::unordered_map<std::string, std::string> symbols;  // Our symbol -> the vendor's
+    std::string defaultSymbol;  // For symbols not in the map; empty passes them through
+};
+
+// Used on a bus with no recognised plotter: the PGN 130074 name field.
+const char *const NMEA2000_PROFILE = "NMEA2000";
+
+// Conservative limits for the plotters we support, plus NMEA2000_PROFILE.
+std::vector<VendorProfile> defaultVendorProfiles();
+
+// A vendor_profiles config entry. Unset fields keep the built-in values and
+// symbols are added to the built-in map.
+struct VendorProfileOverride {
+    std::string vendor;
+    size_t maxNameLength = 0;
+    std::string charset;  // "ascii", "upper" or empty
+    std::unordered_map<std::string, std::string> symbols;
+    std::string defaultSymbol;
+
+    bool operator==(const VendorProfileOverride &other) const {
+        return vendor == other.vendor && maxNameLength == other.maxNameLength && charset == other.charset &&
+               symbols == other.symbols && defaultSymbol == other.defaultSymbol;
+    }
+};
+
+std::vector<VendorProfile> vendorProfilesWith(const std::vector<VendorProfileOverride> &overrides);
+bool parseNameCharset(const std::string &text, NameCharset &charset);
+
+// UTF-8 (or stray Latin-1) in, the vendor's charset and length out.
+// Accented letters are transliterated, anything else unsupported is
+// dropped; a name that ends up empty becomes "WPT".
+std::string normaliseName(std::string_view name, const VendorProfile &profile);
+std::string mapSymbol(const std::string &symbol, const VendorProfile &profile);
+
+// A waypoint as one vendor gets it. record is the PGN 130074 list entry
+// with ID 0; appendWaypointRecord() fills in the ID of the slot it goes to.
+struct EncodedWaypoint {
+    std::string name;
+    std::string symbol;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    std::vector<unsigned char> record;
+};
+
+EncodedWaypoint encodeWaypoint(const Waypoint &waypoint, const VendorProfile &profile);
+bool appendWaypointRecord(tN2kMsg &msg, uint16_t id, const EncodedWaypoint &encoded);
+
+// The encoded form of each waypoint per profile, computed when a waypoint
+// first goes to that profile and again only when its position or symbol
+// changes. Not thread safe.
+class WaypointEncodingCache {
+public:
+    using ProfileId = size_t;
+
+    explicit WaypointEncodingCache(std::vector<VendorProfile> profiles = defaultVendorProfiles());
+
+    // Replaces the profiles and drops everything cached.
+    void setProfiles(std::vector<VendorProfile> profiles);
+
+    // Profile for a target holding these vendors' devices: the vendor's own
+    // for one, the strictest combination for several, NMEA2000_PROFILE when
+    // none is known.
+    ProfileId profileFor(const std::vector<std::string> &vendors);
+    ProfileId profileFor(const std::string &vendor) { return profileFor(std::vector<std::string>{vendor}); }
+    const VendorProfile &profile(ProfileId id) const { return profiles[id]; }
+
+    std::shared_ptr<const EncodedWaypoint> encode(ProfileId profile, const Waypoint &waypoint);
+    // Forgets waypoints that are no longer in the library.
+    void retain(const Waypoint *waypoints, size_t count);
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t entries = 0;
+    };
+    Stats getStats() const;
+
+private:
+    struct Cached {
+        uint64_t contentHash;
+        std::shared_ptr<const EncodedWaypoint> encoded;
+    };
+
+    ProfileId addProfile(VendorProfile profile);
+
+    std::vector<VendorProfile> profiles;  // Configured ones, then combinations
+    std::unordered_map<std::string, ProfileId> profileByName;
+    std::vector<std::unordered_map<std::string, Cached>> cached;  // Per profile, by waypoint name
+    size_t hits = 0;
+    size_t misses = 0;
+};
+
+#endif // VENDOR_PROFILES_H
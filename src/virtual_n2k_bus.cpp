@@ -0,0 +1,123 @@
+#include "virtual_n2k_bus.h"
+#include <algorithm>
+#include <cstring>
+
+void VirtualN2kBus::attach(VirtualN2kNode *node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::find(nodes.begin(), nodes.end(), node) == nodes.end()) {
+        nodes.push_back(node);
+    }
+}
+
+void VirtualN2kBus::detach(VirtualN2kNode *node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    nodes.erase(std::remove(nodes.begin(), nodes.end(), node), nodes.end());
+}
+
+size_t VirtualN2kBus::nodeCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return nodes.size();
+}
+
+VirtualN2kBus::Stats VirtualN2kBus::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void VirtualN2kBus::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    stats = Stats();
+    statsSince = std::chrono::steady_clock::now();
+}
+
+double VirtualN2kBus::utilisation() const {
+    std::chrono::steady_clock::time_point since;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        since = statsSince;
+    }
+    return utilisation(std::chrono::steady_clock::now() - since);
+}
+
+double VirtualN2kBus::utilisation(std::chrono::duration<double> elapsed) const {
+    if (elapsed.count() <= 0) {
+        return 0.0;
+    }
+    return static_cast<double>(getStats().bits) / (bitRate * elapsed.count());
+}
+
+// Holding the bus lock for the whole fan-out keeps frame order identical
+// on every node, like arbitration does on the wire.
+void VirtualN2kBus::deliver(const VirtualN2kNode *from, unsigned long id, unsigned char len, const unsigned char *buf) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++stats.frames;
+    stats.dataBytes += len;
+    stats.bits += frameBits(len);
+
+    for (VirtualN2kNode *node : nodes) {
+        if (node != from && !node->receive(id, len, buf)) {
+            ++stats.droppedFrames;
+        }
+    }
+}
+
+VirtualN2kNode::VirtualN2kNode(VirtualN2kBus &bus, size_t rxCapacity) : bus(bus), rxCapacity(rxCapacity) {
+}
+
+VirtualN2kNode::~VirtualN2kNode() {
+    if (attached) {
+        bus.detach(this);
+    }
+}
+
+size_t VirtualN2kNode::pendingFrames() const {
+    std::lock_guard<std::mutex> lock(rxMutex);
+    return rxQueue.size();
+}
+
+bool VirtualN2kNode::readBusCounters(BusCounters &counters) {
+    VirtualN2kBus::Stats stats = bus.getStats();
+    counters.frames = stats.frames;
+    counters.dataBytes = stats.dataBytes;
+    counters.sendFailures = sendFailures;
+    return true;
+}
+
+bool VirtualN2kNode::CANOpen() {
+    bus.attach(this);
+    attached = true;
+    return true;
+}
+
+bool VirtualN2kNode::CANSendFrame(unsigned long id, unsigned char len, const unsigned char *buf, bool /*wait_sent*/) {
+    if (!attached || len > 8) {
+        ++sendFailures;
+        return false;
+    }
+    bus.deliver(this, id, len, buf);
+    return true;
+}
+
+bool VirtualN2kNode::CANGetFrame(unsigned long &id, unsigned char &len, unsigned char *buf) {
+    std::lock_guard<std::mutex> lock(rxMutex);
+    if (rxQueue.empty()) {
+        return false;
+    }
+    const Frame &frame = rxQueue.front();
+    id = frame.id;
+    len = frame.len;
+    std::memcpy(buf, frame.data, frame.len);
+    rxQueue.pop_front();
+    return true;
+}
+
+bool VirtualN2kNode::receive(unsigned long id, unsigned char len, const unsigned char *buf) {
+    std::lock_guard<std::mutex> lock(rxMutex);
+    if (rxQueue.size() >= rxCapacity) {
+        return false;
+    }
+    Frame frame{id, len, {}};
+    std::memcpy(frame.data, buf, len);
+    rxQueue.push_back(frame);
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef VIRTUAL_N2K_BUS_H
+#define VIRTUAL_N2K_BUS_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "NMEA2000.h"
+#include "bus_load.h"
+
+class VirtualN2kNode;
+
+// In-process CAN segment. Every frame a node sends is copied into the
+// receive queue of every other open node, as on a real bus (no loopback).
+// Address claim, product info and fast-packet reassembly are left to each
+// node's own tNMEA2000, so they run exactly as they would on can0.
+class VirtualN2kBus {
+public:
+    static constexpr unsigned long bitRate = 250000;
+
+    struct Stats {
+        uint64_t frames = 0;
+        uint64_t dataBytes = 0;
+        uint64_t bits = 0;           // Unstuffed extended frames, including IFS
+        uint64_t droppedFrames = 0;  // Lost to a full node receive queue
+    };
+
+    void attach(VirtualN2kNode *node);
+    void detach(VirtualN2kNode *node);
+    size_t nodeCount() const;
+
+    Stats getStats() const;
+    void resetStats();
+    // Share of the wire the recorded frames would have taken up since the
+    // last reset, given real elapsed time.
+    double utilisation() const;
+    double utilisation(std::chrono::duration<double> elapsed) const;
+
+    static uint32_t frameBits(unsigned char len) { return canFrameBits(len); }
+
+private:
+    friend class VirtualN2kNode;
+    void deliver(const VirtualN2kNode *from, unsigned long id, unsigned char len, const unsigned char *buf);
+
+    mutable std::mutex mutex;
+    std::vector<VirtualN2kNode *> nodes;
+    Stats stats;
+    std::chrono::steady_clock::time_point statsSince = std::chrono::steady_clock::now();
+};
+
+// A tNMEA2000 whose CAN driver is a VirtualN2kBus. Can be handed to
+// NMEAWaypointHandler in place of SocketCanNode.
+class VirtualN2kNode : public tNMEA2000, public BusCounterSource {
+public:
+    explicit VirtualN2kNode(VirtualN2kBus &bus, size_t rxCapacity = 4096);
+    ~VirtualN2kNode() override;
+
+    size_t pendingFrames() const;
+    // The whole segment's traffic since its last stats reset.
+    bool readBusCounters(BusCounters &counters) override;
+
+protected:
+    bool CANSendFrame(unsigned long id, unsigned char len, const unsigned char *buf, bool wait_sent = true) override;
+    bool CANOpen() override;
+    bool CANGetFrame(unsigned long &id, unsigned char &len, unsigned char *buf) override;
+
+private:
+    friend class VirtualN2kBus;
+    struct Frame {
+        unsigned long id;
+        unsigned char len;
+        unsigned char data[8];
+    };
+
+    bool receive(unsigned long id, unsigned char len, const unsigned char *buf);
+
+    VirtualN2kBus &bus;
+    size_t rxCapacity;
+    mutable std::mutex rxMutex;
+    std::deque<Frame> rxQueue;
+    bool attached = false;
+    uint64_t sendFailures = 0;
+};
+
+#endif // VIRTUAL_N2K_BUS_H
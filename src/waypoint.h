@@ -0,0 +1,17 @@
+#ifndef WAYPOINT_H
+#define WAYPOINT_H
+
+#include <cstdint>
+#include <string>
+
+// A single waypoint as decoded from the bus or read from a waypoint file.
+struct Waypoint {
+    uint16_t id = 0;
+    std::string name;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    std::string symbol;
+    uint8_t source = 255;  // Bus source address it was heard from, 255 otherwise
+};
+
+#endif // WAYPOINT_H
@@ -1,7 +1,9 @@
 #include "waypoint_converter.h"
-#include <cstdlib>
+#include "converter_pool.h"
+#include "gpx_io.h"
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <unordered_map>
 
 // Utility function to check file existence
@@ -26,16 +28,62 @@ std::string convertWaypoint(const std::string &input, const std::string &format,
     return convertWaypointFile(input, output, "gpx", formatIt->second) ? output : "";
 }
 
+static void reportConversionStart(const ConversionRequest &request, const std::string &what) {
+    std::cout << "Converting " << what << " from " << request.inputFormat << " to " << request.outputFormat << std::endl;
+}
+
+static bool reportConversionResult(const ConversionResult &result, const std::string &what) {
+    if (!result.ok) {
+        std::cerr << "gpsbabel conversion of " << what << (result.timedOut ? " timed out." : " failed.") << std::endl;
+        if (!result.errorText.empty()) {
+            std::cerr << result.errorText << std::endl;
+        }
+        return false;
+    }
+    return true;
+}
+
+// gpsbabel runs through the shared pool: no shell, output comes back in memory.
+static bool runGpsbabel(const ConversionRequest &request, const std::string &what, ConversionResult &result,
+                        const ConverterPool::OutputCallback &onOutput = ConverterPool::OutputCallback()) {
+    reportConversionStart(request, what);
+    result = onOutput ? defaultConverterPool().convert(request, onOutput) : defaultConverterPool().convert(request);
+    return reportConversionResult(result, what);
+}
+
+static Task<bool> runGpsbabelAsync(EventLoop &loop, ConversionRequest request, std::string what,
+                                   ConversionResult &result) {
+    reportConversionStart(request, what);
+    result = co_await defaultConverterPool().convertAsync(loop, request);
+    co_return reportConversionResult(result, what);
+}
+
+static bool writeOutputFile(const std::string &path, const std::string &contents) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open() || !file.write(contents.data(), contents.size())) {
+        std::cerr << "Error: cannot write " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// -w -r: carry both waypoints and routes, gpsbabel drops routes otherwise
+static ConversionRequest waypointRequest(const std::string &inputFormat, const std::string &outputFormat) {
+    ConversionRequest request;
+    request.options = {"-w", "-r"};
+    request.inputFormat = inputFormat;
+    request.outputFormat = outputFormat;
+    return request;
+}
+
 // Function to convert waypoint files across formats, using formatMap
 bool convertWaypointFile(const std::string &inputFile, const std::string &outputFile, const std::string &inputFormat, const std::string &outputFormat) {
     if (!checkFileExists(inputFile)) return false;
 
-    std::string command = "gpsbabel -i " + inputFormat + " -f " + inputFile + " -o " + outputFormat + " -F " + outputFile;
-    std::cout << "Running command: " << command << std::endl;
-
-    int result = std::system(command.c_str());
-    if (result != 0) {
-        std::cerr << "gpsbabel command exited with an error." << std::endl;
+    ConversionRequest request = waypointRequest(inputFormat, outputFormat);
+    request.inputPath = inputFile;
+    ConversionResult result;
+    if (!runGpsbabel(request, inputFile, result) || !writeOutputFile(outputFile, result.output)) {
         return false;
     }
 
@@ -69,3 +117,93 @@ void convertToAllFormats(const std::string &inputFile, const std::string &inputF
     }
 }
 
+
+// Other formats go through gpsbabel as GPX held in memory, never a scratch file.
+bool loadWaypointCollection(const std::string &inputFile, const std::string &inputFormat, WaypointCollection &collection) {
+    if (inputFormat == "gpx") {
+        return readGpxFile(inputFile, collection);
+    }
+    if (!checkFileExists(inputFile)) return false;
+
+    ConversionRequest request = waypointRequest(inputFormat, "gpx");
+    request.inputPath = inputFile;
+    ConversionResult result;
+    return runGpsbabel(request, inputFile, result) && parseGpx(result.output, collection);
+}
+
+bool saveWaypointCollection(const WaypointCollection &collection, const std::string &outputFile, const std::string &outputFormat) {
+    if (outputFormat == "gpx") {
+        return writeGpxFile(outputFile, collection);
+    }
+
+    ConversionRequest request = waypointRequest("gpx", outputFormat);
+    request.input = formatGpx(collection);
+    ConversionResult result;
+    return runGpsbabel(request, outputFile, result) && writeOutputFile(outputFile, result.output);
+}
+
+Task<bool> loadWaypointCollectionAsync(EventLoop &loop, std::string inputFile, std::string inputFormat,
+                                       WaypointCollection &collection) {
+    if (inputFormat == "gpx") {
+        co_return co_await loop.offload([&] { return readGpxFile(inputFile, collection); });
+    }
+    if (!checkFileExists(inputFile)) co_return false;
+
+    ConversionRequest request = waypointRequest(inputFormat, "gpx");
+    request.inputPath = inputFile;
+    ConversionResult result;
+    co_return co_await runGpsbabelAsync(loop, request, inputFile, result) && parseGpx(result.output, collection);
+}
+
+Task<bool> saveWaypointCollectionAsync(EventLoop &loop, WaypointCollection collection, std::string outputFile,
+                                       std::string outputFormat) {
+    if (outputFormat == "gpx") {
+        co_return co_await loop.offload([&] { return writeGpxFile(outputFile, collection); });
+    }
+
+    ConversionRequest request = waypointRequest("gpx", outputFormat);
+    request.input = formatGpx(collection);
+    ConversionResult result;
+    if (!co_await runGpsbabelAsync(loop, request, outputFile, result)) {
+        co_return false;
+    }
+    co_return co_await loop.offload([&] { return writeOutputFile(outputFile, result.output); });
+}
+
+bool readTrackFile(const std::string &inputFile, const std::string &inputFormat, TrackSink &sink) {
+    if (inputFormat == "gpx") {
+        return readGpxTrackFile(inputFile, sink);
+    }
+    if (!checkFileExists(inputFile)) return false;
+
+    // -t only: waypoints are imported separately
+    ConversionRequest request;
+    request.options = {"-t"};
+    request.inputFormat = inputFormat;
+    request.outputFormat = "gpx";
+    request.inputPath = inputFile;
+
+    GpxTrackReader reader(sink);
+    ConversionResult result;
+    if (!runGpsbabel(request, inputFile, result, [&reader](const char *data, size_t size) { return reader.feed(data, size); })) {
+        return false;
+    }
+    return reader.finish();
+}
+
+bool saveTracks(const std::vector<Track> &tracks, const std::string &outputFile, const std::string &outputFormat) {
+    if (outputFormat == "gpx") {
+        return writeGpxTrackFile(outputFile, tracks);
+    }
+
+    std::ostringstream gpx;
+    writeGpxTracks(gpx, tracks);
+    ConversionRequest request;
+    request.options = {"-t"};
+    request.inputFormat = "gpx";
+    request.outputFormat = outputFormat;
+    request.input = gpx.str();
+
+    ConversionResult result;
+    return runGpsbabel(request, outputFile, result) && writeOutputFile(outputFile, result.output);
+}
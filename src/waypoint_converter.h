@@ -3,11 +3,30 @@
 
 #include <string>
 #include <unordered_map>
+#include "event_loop.h"
+#include "route.h"
+#include "task.h"
+#include "track.h"
 
 std::string convertWaypoint(const std::string& input, const std::string& format, const std::unordered_map<std::string, std::string>& formatMap);
 bool convertWaypointFile(const std::string &inputFile, const std::string &outputFile, const std::string &inputFormat, const std::string &outputFormat);
 void convertToAllFormats(const std::string &inputFile, const std::string &inputFormat, const std::unordered_map<std::string, std::string>& formatMap);
 
+// Read/write waypoints and routes in any gpsbabel format, going through GPX.
+bool loadWaypointCollection(const std::string &inputFile, const std::string &inputFormat, WaypointCollection &collection);
+bool saveWaypointCollection(const WaypointCollection &collection, const std::string &outputFile, const std::string &outputFormat);
+// The same on the event loop: gpsbabel through convertAsync(), GPX and
+// output files read and written on the loop's helper thread.
+Task<bool> loadWaypointCollectionAsync(EventLoop &loop, std::string inputFile, std::string inputFormat,
+                                       WaypointCollection &collection);
+Task<bool> saveWaypointCollectionAsync(EventLoop &loop, WaypointCollection collection, std::string outputFile,
+                                       std::string outputFormat);
+
+// Tracks are streamed: GPX is read directly, other formats come through
+// gpsbabel's stdout, and each point goes to the sink as it is parsed.
+bool readTrackFile(const std::string &inputFile, const std::string &inputFormat, TrackSink &sink);
+bool saveTracks(const std::vector<Track> &tracks, const std::string &outputFile, const std::string &outputFormat);
+
 // Optionally include this if `checkFileExists` elsewhere
 // bool checkFileExists(const std::string &filePath);
 
@@ -0,0 +1,61 @@
+#ifndef WAYPOINT_PGNS_H
+#define WAYPOINT_PGNS_H
+
+#include "pgn_schema.h"
+
+// Layouts of the standard route/waypoint service PGNs we send and receive.
+
+using Resolution1e7 = std::ratio<1, 10000000>;
+
+// PGN 130074 Route and WP Service - WP List - WP Name & Position
+using WaypointListPgn = pgn_schema::Pgn<130074, 7,
+    pgn_schema::Fields<
+        pgn_schema::UInt<2>,        // Start WP ID
+        pgn_schema::UInt<2>,        // Number of items in this message
+        pgn_schema::UInt<2>,        // Number of valid WPs in the WP list
+        pgn_schema::UInt<2>,        // Database ID
+        pgn_schema::Reserved<2>>,
+    pgn_schema::Fields<
+        pgn_schema::UInt<2>,        // WP ID
+        pgn_schema::StringLAU<32>,  // WP name
+        pgn_schema::Scaled<4, Resolution1e7>,  // Latitude
+        pgn_schema::Scaled<4, Resolution1e7>>, // Longitude
+    1>;
+
+namespace WaypointListField {
+enum { StartId, ItemCount, ValidCount, DatabaseId, Reserved };
+}
+
+namespace WaypointListItem {
+enum { Id, Name, Latitude, Longitude };
+}
+
+// PGN 129285 Navigation - Route/WP Information
+using RouteWaypointPgn = pgn_schema::Pgn<129285, 6,
+    pgn_schema::Fields<
+        pgn_schema::UInt<2>,        // Start RPS# (index of the first leg in this message)
+        pgn_schema::UInt<2>,        // Number of items in this message
+        pgn_schema::UInt<2>,        // Database ID
+        pgn_schema::UInt<2>,        // Route ID
+        pgn_schema::UInt<1>,        // Direction (2 bits), supplementary data (2 bits), reserved (4 bits)
+        pgn_schema::StringLAU<32>,  // Route name
+        pgn_schema::Reserved<1>>,
+    pgn_schema::Fields<
+        pgn_schema::UInt<2>,        // WP ID
+        pgn_schema::StringLAU<32>,  // WP name
+        pgn_schema::Scaled<4, Resolution1e7>,  // Latitude
+        pgn_schema::Scaled<4, Resolution1e7>>, // Longitude
+    1>;
+
+namespace RouteWaypointField {
+enum { StartRps, ItemCount, DatabaseId, RouteId, Flags, RouteName, Reserved };
+}
+
+namespace RouteWaypointItem {
+enum { Id, Name, Latitude, Longitude };
+}
+
+// Forward direction, no supplementary data, reserved bits set.
+const uint8_t ROUTE_FLAGS_FORWARD = 0xf0;
+
+#endif // WAYPOINT_PGNS_H
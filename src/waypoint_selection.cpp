@@ -0,0 +1,227 @@
+#include "waypoint_selection.h"
+#include "merge_engine.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+WaypointSelector::WaypointSelector(const SelectionSettings &settings, bool compact)
+    : settings(settings), ownStrings(compact ? std::make_unique<StringPool>() : nullptr), keys(&ownKeys),
+      strings(ownStrings.get()), library(strings) {
+}
+
+WaypointSelector::WaypointSelector(const SelectionSettings &settings, StringPool &sharedKeys, StringPool &sharedStrings)
+    : settings(settings), keys(&sharedKeys), strings(&sharedStrings), library(strings) {
+}
+
+// Settings change the ranking, so every target is re-ranked on its next select().
+void WaypointSelector::setSettings(const SelectionSettings &newSettings) {
+    settings = newSettings;
+    for (auto &[name, state] : targets) {
+        state.ranked = false;
+    }
+}
+
+void WaypointSelector::setLibrary(const Waypoint *waypoints, size_t count, uint64_t nowMs) {
+    std::vector<Entry> next;
+    WaypointTable nextLibrary(strings);
+    std::vector<uint32_t> nextByKey;
+    std::pmr::vector<double> latitudes(scratch), longitudes(scratch);
+    next.reserve(count);
+    nextLibrary.resize(count);
+    latitudes.reserve(count);
+    longitudes.reserve(count);
+    bool changed = count != entries.size();
+
+    for (size_t i = 0; i < count; ++i) {
+        const Waypoint &waypoint = waypoints[i];
+        KeyId key = keys->intern(MergeEngine::keyFor(waypoint.name));
+        if (nextByKey.size() < keys->size()) {
+            nextByKey.resize(keys->size(), 0);
+        }
+        if (nextByKey[key] != 0) {
+            continue;
+        }
+        uint64_t hash = MergeEngine::contentHash(waypoint);
+        uint64_t modifiedMs = nowMs;
+        uint32_t existing = key < entryByKey.size() ? entryByKey[key] : 0;
+        if (existing != 0 && entries[existing - 1].contentHash == hash) {
+            modifiedMs = entries[existing - 1].modifiedMs;
+        } else {
+            changed = true;
+        }
+        nextLibrary.set(next.size(), waypoint);
+        next.push_back({key, hash, modifiedMs});
+        nextByKey[key] = static_cast<uint32_t>(next.size());
+        latitudes.push_back(waypoint.latitude);
+        longitudes.push_back(waypoint.longitude);
+    }
+    if (!changed) {
+        return;
+    }
+
+    nextLibrary.resize(next.size());
+    unitVectors.assign(latitudes.data(), longitudes.data(), next.size());
+    entries.swap(next);
+    std::swap(library, nextLibrary);
+    entryByKey.swap(nextByKey);
+    ++revision;
+    compactKeys();
+}
+
+// Names come and go as the library changes, and an interned key is never
+// freed, so the selector's own pool is rebuilt from the live keys once
+// most of it is dead. A pool shared with the merge engine only holds the
+// engine's keys and is left to it.
+void WaypointSelector::compactKeys() {
+    if (keys != &ownKeys) {
+        return;
+    }
+    size_t live = entries.size();
+    for (const auto &[name, state] : targets) {
+        live += state.sent.size();
+    }
+    if (ownKeys.size() <= 2 * live + keyCompactionSlack) {
+        return;
+    }
+
+    StringPool fresh;
+    for (auto &entry : entries) {
+        entry.key = fresh.intern(ownKeys.view(entry.key));
+    }
+    for (auto &[name, state] : targets) {
+        std::unordered_map<KeyId, SentWaypoint> sent;
+        sent.reserve(state.sent.size());
+        for (auto &[key, waypoint] : state.sent) {
+            sent.emplace(fresh.intern(ownKeys.view(key)), std::move(waypoint));
+        }
+        state.sent.swap(sent);
+    }
+    entryByKey.assign(fresh.size(), 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        entryByKey[entries[i].key] = static_cast<uint32_t>(i + 1);
+    }
+    ownKeys = std::move(fresh);
+}
+
+void WaypointSelector::setPosition(const OwnShipPosition &fix) {
+    if (fix.valid) {
+        position = fix;
+    }
+}
+
+void WaypointSelector::markHeld(const std::string &target, const Waypoint &waypoint) {
+    targets[target].sent[keys->intern(MergeEngine::keyFor(waypoint.name))] = {waypoint,
+                                                                           MergeEngine::contentHash(waypoint)};
+}
+
+bool WaypointSelector::needsRanking(const TargetState &state, size_t capacity) const {
+    if (!state.ranked || state.rankedRevision != revision || state.rankedCapacity != capacity ||
+        state.rankedWithPosition != position.valid) {
+        return true;
+    }
+    if (!position.valid) {
+        return false;
+    }
+    double moved;
+    geo::equirectangularDistances(state.rankedLatitude, state.rankedLongitude, &position.latitude,
+                                  &position.longitude, 1, &moved);
+    return moved >= settings.recomputeDistanceMeters;
+}
+
+SelectionDelta WaypointSelector::select(const std::string &target, size_t capacity, uint64_t nowMs) {
+    TargetState &state = targets[target];
+    SelectionDelta delta;
+    if (!needsRanking(state, capacity)) {
+        return delta;
+    }
+
+    // Score is distance shrunk by recency; lower is better. Without a fix
+    // every distance is zero and recency alone decides.
+    const size_t count = entries.size();
+    std::pmr::vector<double> scores(count, 0.0, scratch);
+    if (position.valid && count > 0) {
+        geo::haversineDistances(position.latitude, position.longitude, unitVectors, scores.data());
+    }
+    for (size_t i = 0; i < count; ++i) {
+        double ageHours = nowMs > entries[i].modifiedMs ? (nowMs - entries[i].modifiedMs) / 3600000.0 : 0.0;
+        scores[i] /= 1.0 + settings.recencyBoost * std::exp2(-ageHours / settings.recencyHalfLifeHours);
+        if (position.valid && state.sent.count(entries[i].key)) {
+            scores[i] -= settings.hysteresisMeters;
+        }
+    }
+
+    auto better = [&](size_t a, size_t b) {
+        if (scores[a] != scores[b]) {
+            return scores[a] < scores[b];
+        }
+        if (entries[a].modifiedMs != entries[b].modifiedMs) {
+            return entries[a].modifiedMs > entries[b].modifiedMs;
+        }
+        return keys->view(entries[a].key) < keys->view(entries[b].key);
+    };
+    std::pmr::vector<size_t> order(count, scratch);
+    std::iota(order.begin(), order.end(), 0);
+    size_t keep = std::min(capacity, count);
+    if (keep < count) {
+        std::nth_element(order.begin(), order.begin() + keep, order.end(), better);
+        order.resize(keep);
+    }
+    // Most relevant first, so they are on the plotter soonest.
+    std::sort(order.begin(), order.end(), better);
+
+    std::unordered_map<KeyId, SentWaypoint> next;
+    next.reserve(keep);
+    for (size_t index : order) {
+        const Entry &entry = entries[index];
+        Waypoint waypoint = library.get(index);
+        auto sent = state.sent.find(entry.key);
+        if (sent == state.sent.end() || sent->second.contentHash != entry.contentHash) {
+            delta.added.push_back(waypoint);
+        }
+        next.emplace(entry.key, SentWaypoint{std::move(waypoint), entry.contentHash});
+    }
+    for (const auto &[key, sent] : state.sent) {
+        if (!next.count(key)) {
+            delta.removed.push_back(sent.waypoint);
+        }
+    }
+    std::sort(delta.removed.begin(), delta.removed.end(),
+              [](const Waypoint &a, const Waypoint &b) { return a.name < b.name; });
+
+    state.sent.swap(next);
+    state.ranked = true;
+    state.rankedWithPosition = position.valid;
+    state.rankedLatitude = position.latitude;
+    state.rankedLongitude = position.longitude;
+    state.rankedRevision = revision;
+    state.rankedCapacity = capacity;
+    return delta;
+}
+
+std::vector<Waypoint> WaypointSelector::selected(const std::string &target) const {
+    std::vector<Waypoint> waypoints;
+    auto it = targets.find(target);
+    if (it == targets.end()) {
+        return waypoints;
+    }
+    for (const auto &[key, sent] : it->second.sent) {
+        waypoints.push_back(sent.waypoint);
+    }
+    std::sort(waypoints.begin(), waypoints.end(), [](const Waypoint &a, const Waypoint &b) { return a.name < b.name; });
+    return waypoints;
+}
+
+void WaypointSelector::forget(const std::string &target) {
+    targets.erase(target);
+}
+
+void WaypointSelector::release(const std::string &target, const std::vector<Waypoint> &waypoints) {
+    auto it = targets.find(target);
+    if (it == targets.end() || waypoints.empty()) {
+        return;
+    }
+    for (const auto &waypoint : waypoints) {
+        it->second.sent.erase(keys->intern(MergeEngine::keyFor(waypoint.name)));
+    }
+    it->second.ranked = false;
+}
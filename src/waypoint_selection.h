@@ -0,0 +1,138 @@
+#ifndef WAYPOINT_SELECTION_H
+#define WAYPOINT_SELECTION_H
+
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "compact_store.h"
+#include "geo_kernels.h"
+#include "waypoint.h"
+
+// Own-ship fix, from PGN 129025 or 129029 on any bus.
+struct OwnShipPosition {
+    double latitude = 0.0;
+    double longitude = 0.0;
+    uint64_t timeMs = 0;
+    bool valid = false;
+};
+
+struct SelectionSettings {
+    // A waypoint already on a target is only displaced by one at least
+    // this much closer, so small moves never cause churn.
+    double hysteresisMeters = 500.0;
+    // Re-rank once the ship has moved this far from the last ranking.
+    double recomputeDistanceMeters = 200.0;
+    // A just-edited waypoint ranks as if (1 + boost) times closer; the
+    // boost halves every half-life.
+    double recencyBoost = 1.0;
+    double recencyHalfLifeHours = 24.0;
+};
+
+struct SelectionDelta {
+    std::vector<Waypoint> added;    // New to the target, or edited since it was sent
+    std::vector<Waypoint> removed;  // Fell out of the target's set
+
+    bool empty() const { return added.empty() && removed.empty(); }
+};
+
+// Picks, for each named target (a bus, a device export), the waypoints
+// most relevant to the current position that fit its capacity, and keeps
+// each target's set stable between calls so only small swaps go out.
+//
+// Re-ranking only happens when the ship has moved, the library changed or
+// the capacity changed; otherwise select() is a few comparisons. Without a
+// position fix the most recently edited waypoints win.
+//
+// In compact mode the library copy is packed; ranking temporaries come
+// from the scratch resource, which the caller may reset between calls.
+// A compact selector can share the merge engine's string pools, so its
+// copy of the library adds no strings of its own; calls must then be
+// serialised with the engine's.
+class WaypointSelector {
+public:
+    explicit WaypointSelector(const SelectionSettings &settings = SelectionSettings(), bool compact = false);
+    WaypointSelector(const SelectionSettings &settings, StringPool &sharedKeys, StringPool &sharedStrings);
+    WaypointSelector(const WaypointSelector &) = delete;
+    WaypointSelector &operator=(const WaypointSelector &) = delete;
+
+    void setSettings(const SelectionSettings &settings);
+    void setScratch(std::pmr::memory_resource *resource) { scratch = resource; }
+    // Diffs against the previous library. New or edited waypoints are
+    // stamped with nowMs for the recency ranking.
+    void setLibrary(const Waypoint *waypoints, size_t count, uint64_t nowMs);
+    void setLibrary(const std::vector<Waypoint> &waypoints, uint64_t nowMs) {
+        setLibrary(waypoints.data(), waypoints.size(), nowMs);
+    }
+    void setPosition(const OwnShipPosition &position);
+
+    // Records a waypoint the target already holds (heard from it), so it
+    // is not sent straight back.
+    void markHeld(const std::string &target, const Waypoint &waypoint);
+
+    SelectionDelta select(const std::string &target, size_t capacity, uint64_t nowMs);
+    std::vector<Waypoint> selected(const std::string &target) const;
+    void forget(const std::string &target);
+    // Un-sends waypoints a target did not take after all, so the next
+    // select() offers them again.
+    void release(const std::string &target, const std::vector<Waypoint> &waypoints);
+
+    size_t librarySize() const { return entries.size(); }
+    size_t keyCount() const { return keys->size(); }
+    uint64_t libraryRevision() const { return revision; }
+    const OwnShipPosition &getPosition() const { return position; }
+
+private:
+    using KeyId = StringPool::Handle;
+
+    // The waypoint itself is in library at the same index.
+    struct Entry {
+        KeyId key = 0;
+        uint64_t contentHash = 0;
+        uint64_t modifiedMs = 0;
+    };
+
+    struct SentWaypoint {
+        Waypoint waypoint;
+        uint64_t contentHash = 0;
+    };
+
+    struct TargetState {
+        std::unordered_map<KeyId, SentWaypoint> sent;
+        bool ranked = false;
+        bool rankedWithPosition = false;
+        double rankedLatitude = 0.0;
+        double rankedLongitude = 0.0;
+        uint64_t rankedRevision = 0;
+        size_t rankedCapacity = 0;
+    };
+
+    bool needsRanking(const TargetState &state, size_t capacity) const;
+    void compactKeys();
+
+    // Keys of waypoints that left the library stay interned until this
+    // many more than the live ones have built up.
+    static constexpr size_t keyCompactionSlack = 1024;
+
+    SelectionSettings settings;
+    OwnShipPosition position;
+    std::pmr::memory_resource *scratch = std::pmr::get_default_resource();
+
+    // Library, with the coordinates kept columnar for the geo kernels.
+    // Merge keys are interned, so an entry is found by key ID.
+    StringPool ownKeys;
+    std::unique_ptr<StringPool> ownStrings;  // Compact mode only
+    StringPool *keys;
+    StringPool *strings;  // Null in standard mode
+    std::vector<Entry> entries;
+    WaypointTable library;
+    std::vector<uint32_t> entryByKey;  // Key ID -> entry index + 1, 0 when absent
+    geo::UnitVectors unitVectors;
+    uint64_t revision = 0;
+
+    std::unordered_map<std::string, TargetState> targets;
+};
+
+#endif // WAYPOINT_SELECTION_H
@@ -0,0 +1,161 @@
+// Memory benchmark for compact mode: builds a 50k waypoint library the
+// way the sync worker does (file import, two plotters, merge, selection)
+// and reports resident size and live heap for each mode. Each mode runs in
+// its own child process so neither sees the other's heap. In compact mode
+// large blocks are mapped, so its heap column leaves them out; the ratio
+// that counts is rss, checked against compact mode's 3x goal.
+//
+//   make bench_memory            # 50000 waypoints
+//   build/bench_memory 200000
+#include "compact_store.h"
+#include "merge_engine.h"
+#include "waypoint_selection.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <malloc.h>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const double targetRssRatio = 3.0;
+
+struct Usage {
+    long rssKb = 0;
+    long heapKb = 0;
+};
+
+Usage currentUsage() {
+    Usage usage;
+    long pages = 0;
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm) {
+        if (std::fscanf(statm, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        std::fclose(statm);
+    }
+    usage.rssKb = pages * (sysconf(_SC_PAGESIZE) / 1024);
+    usage.heapKb = static_cast<long>(mallinfo2().uordblks / 1024);
+    return usage;
+}
+
+// Names like a real library: short plotter-style ones and longer
+// descriptive ones past the std::string inline buffer.
+std::vector<Waypoint> makeLibrary(size_t count) {
+    static const char *symbols[] = {"Waypoint", "Anchor", "Fishing Area", "Wreck", "Buoy", "Marina", "Danger", "Dive"};
+    std::vector<Waypoint> waypoints(count);
+    for (size_t i = 0; i < count; ++i) {
+        Waypoint &waypoint = waypoints[i];
+        waypoint.name = i % 2 ? "WPT" + std::to_string(i) : "Ledge south of marker " + std::to_string(i);
+        waypoint.latitude = 24.0 + (i % 1000) * 0.01 + (i / 1000) * 0.0001;
+        waypoint.longitude = -82.0 + (i / 1000) * 0.01;
+        waypoint.symbol = symbols[i % 8];
+    }
+    return waypoints;
+}
+
+Usage runMode(bool compact, size_t count) {
+    if (compact) {
+        useCompactAllocator();
+    }
+    Usage before = currentUsage();
+
+    ScratchArena scratch;
+    MergeEngine engine(compact);
+    // Set up the way SyncManager::createLibrary does.
+    std::unique_ptr<WaypointSelector> selector =
+        compact ? std::make_unique<WaypointSelector>(SelectionSettings(), engine.keyPool(), *engine.stringPool())
+                : std::make_unique<WaypointSelector>();
+    selector->setScratch(compact ? scratch.resource() : std::pmr::get_default_resource());
+
+    auto cycle = [&](uint64_t nowMs) {
+        engine.merge();
+        {
+            std::pmr::vector<Waypoint> library =
+                engine.waypoints(compact ? scratch.resource() : std::pmr::get_default_resource());
+            selector->setLibrary(library.data(), library.size(), nowMs);
+        }
+        OwnShipPosition fix;
+        fix.latitude = 25.0;
+        fix.longitude = -81.5;
+        fix.valid = true;
+        selector->setPosition(fix);
+        selector->select("can0", 2000, nowMs);
+        selector->select("file:Garmin", 5000, nowMs);
+        scratch.reset();
+        if (compact) {
+            releaseFreeMemory();
+        }
+    };
+
+    {
+        std::vector<Waypoint> imported = makeLibrary(count);
+        engine.observeSnapshot(engine.sourceId("file:library.gpx"), imported);
+        for (const char *plotter : {"can0:12", "can0:30"}) {
+            SourceId source = engine.sourceId(plotter);
+            for (size_t i = 0; i < imported.size(); i += imported.size() / 2000 + 1) {
+                engine.observe(source, imported[i]);
+            }
+        }
+    }
+    cycle(1000);
+
+    // A plotter edit: one more merge and selection round, as in steady state.
+    Waypoint edited = makeLibrary(1)[0];
+    edited.latitude += 0.001;
+    engine.observe(engine.sourceId("can0:12"), edited);
+    cycle(2000);
+
+    Usage after = currentUsage();
+    return {after.rssKb - before.rssKb, after.heapKb - before.heapKb};
+}
+
+bool runInChild(bool compact, size_t count, Usage &usage) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        Usage measured = runMode(compact, count);
+        bool ok = write(fds[1], &measured, sizeof(measured)) == static_cast<ssize_t>(sizeof(measured));
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    bool ok = pid > 0 && read(fds[0], &usage, sizeof(usage)) == static_cast<ssize_t>(sizeof(usage));
+    close(fds[0]);
+    int status = 0;
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+    return ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+
+    Usage standard, compact;
+    if (!runInChild(false, count, standard) || !runInChild(true, count, compact)) {
+        std::cerr << "Benchmark child failed." << std::endl;
+        return 1;
+    }
+
+    std::cout << count << " waypoints, 3 sources, 2 selection targets" << std::endl;
+    std::printf("%-10s %12s %12s\n", "mode", "rss KiB", "heap KiB");
+    std::printf("%-10s %12ld %12ld\n", "standard", standard.rssKb, standard.heapKb);
+    std::printf("%-10s %12ld %12ld\n", "compact", compact.rssKb, compact.heapKb);
+    if (compact.rssKb > 0 && compact.heapKb > 0) {
+        double rssRatio = double(standard.rssKb) / compact.rssKb;
+        std::printf("%-10s %11.2fx %11.2fx\n", "ratio", rssRatio, double(standard.heapKb) / compact.heapKb);
+        std::printf("compact rss goal %.1fx: %s\n", targetRssRatio, rssRatio >= targetRssRatio ? "met" : "not met");
+    }
+    return 0;
+}
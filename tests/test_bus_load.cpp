@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+#include "bus_load.h"
+
+namespace {
+
+// Counters after frames of len bytes have been on the wire.
+BusCounters countersFor(uint64_t frames, unsigned char len, uint64_t failures = 0) {
+    BusCounters counters;
+    counters.frames = frames;
+    counters.dataBytes = frames * len;
+    counters.sendFailures = failures;
+    return counters;
+}
+
+} // namespace
+
+TEST(BusLoadTest, FramesPerPayload) {
+    EXPECT_EQ(framesForPayload(0), 1u);
+    EXPECT_EQ(framesForPayload(8), 1u);
+    EXPECT_EQ(framesForPayload(9), 2u);   // 6 + 3
+    EXPECT_EQ(framesForPayload(13), 2u);  // 6 + 7
+    EXPECT_EQ(framesForPayload(14), 3u);
+    EXPECT_EQ(framesForPayload(223), 32u);  // Largest fast-packet message
+}
+
+TEST(BusLoadTest, MonitorConvergesOnMeasuredLoad) {
+    BusLoadMonitor monitor(250000);
+    monitor.update(countersFor(0, 8), 0);
+    EXPECT_EQ(monitor.utilisation(), 0.0);
+
+    // 954 eight-byte frames a second is half of 250 kbit/s.
+    uint64_t frames = 0;
+    for (uint64_t ms = 100; ms <= 5000; ms += 100) {
+        frames += 95;
+        monitor.update(countersFor(frames, 8), ms);
+    }
+    EXPECT_NEAR(monitor.utilisation(), 95 * 10 * 131.0 / 250000, 0.01);
+
+    // Counters reset with the interface: no spike, just a new baseline.
+    monitor.update(countersFor(10, 8), 5100);
+    EXPECT_NEAR(monitor.utilisation(), 0.5, 0.01);
+}
+
+TEST(BusLoadTest, MonitorReportsNewSendFailures) {
+    BusLoadMonitor monitor;
+    monitor.update(countersFor(0, 8, 3), 0);
+    monitor.update(countersFor(10, 8, 5), 100);
+    EXPECT_EQ(monitor.newSendFailures(), 2u);
+    monitor.update(countersFor(20, 8, 5), 200);
+    EXPECT_EQ(monitor.newSendFailures(), 0u);
+}
+
+TEST(BusLoadTest, RateGrowsOnIdleBusUpToShare) {
+    TransmitRateController controller;
+    double start = controller.framesPerSecond();
+    for (uint64_t ms = 0; ms < 5000; ms += 100) {
+        controller.update(0.05, ms);
+    }
+    EXPECT_GT(controller.framesPerSecond(), start);
+    EXPECT_DOUBLE_EQ(controller.framesPerSecond(), controller.maxFramesPerSecond());
+    EXPECT_NEAR(controller.maxFramesPerSecond(), 0.3 * 250000 / 131, 1e-9);
+}
+
+TEST(BusLoadTest, RateHalvesOverCeilingAndOnBackpressure) {
+    TransmitRateController controller;
+    for (uint64_t ms = 0; ms < 5000; ms += 100) {
+        controller.update(0.1, ms);
+    }
+    double full = controller.framesPerSecond();
+
+    controller.update(0.9, 5000);
+    EXPECT_DOUBLE_EQ(controller.framesPerSecond(), full / 2);
+    // A burst of failures within one interval counts once.
+    controller.onBackpressure(5010);
+    controller.onBackpressure(5020);
+    EXPECT_DOUBLE_EQ(controller.framesPerSecond(), full / 2);
+    controller.onBackpressure(5100);
+    EXPECT_DOUBLE_EQ(controller.framesPerSecond(), full / 4);
+
+    for (uint64_t ms = 5200; ms < 10000; ms += 100) {
+        controller.update(0.95, ms);
+    }
+    EXPECT_GT(controller.framesPerSecond(), 0.0);
+    EXPECT_LT(controller.framesPerSecond(), 50.0);
+}
+
+TEST(BusLoadTest, TokenBucketPacesMessages) {
+    TransmitRateSettings settings;
+    TransmitRateController controller(settings);
+    double rate = controller.framesPerSecond();
+
+    // A fresh bucket lets the first message through, overdrawn or not.
+    EXPECT_TRUE(controller.tryAcquire(32, 0));
+    EXPECT_FALSE(controller.tryAcquire(1, 0));
+    uint64_t waitMs = controller.msUntilAvailable(0);
+    EXPECT_NEAR(static_cast<double>(waitMs), (32 - rate * 0.1) * 1000 / rate, 2.0);
+    EXPECT_FALSE(controller.tryAcquire(1, waitMs - 2));
+    EXPECT_TRUE(controller.tryAcquire(1, waitMs));
+
+    // Frames sent over a second stay near the rate.
+    size_t frames = 0;
+    for (uint64_t ms = 10000; ms < 11000; ++ms) {
+        while (controller.tryAcquire(3, ms)) {
+            frames += 3;
+        }
+    }
+    EXPECT_NEAR(static_cast<double>(frames), rate, rate * 0.2);
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include "compact_store.h"
+#include <cmath>
+#include <string>
+#include <vector>
+
+TEST(StringPoolTest, InternsOnceWithDenseHandles) {
+    StringPool pool;
+    EXPECT_EQ(pool.intern(""), 0u);
+
+    StringPool::Handle reef = pool.intern("Reef");
+    StringPool::Handle dock = pool.intern("Dock");
+    EXPECT_EQ(reef, 1u);
+    EXPECT_EQ(dock, 2u);
+    EXPECT_EQ(pool.intern(std::string("Reef")), reef);
+    EXPECT_EQ(pool.view(dock), "Dock");
+    EXPECT_EQ(pool.find("Dock"), dock);
+    EXPECT_EQ(pool.find("Buoy"), StringPool::npos);
+    EXPECT_EQ(pool.size(), 3u);
+}
+
+TEST(StringPoolTest, ViewsSurviveGrowth) {
+    StringPool pool;
+    std::vector<StringPool::Handle> handles;
+    for (int i = 0; i < 20000; ++i) {
+        handles.push_back(pool.intern("WPT" + std::to_string(i)));
+    }
+    std::string longName(40000, 'x');
+    StringPool::Handle longHandle = pool.intern(longName);
+    StringPool::Handle after = pool.intern("after");
+
+    for (int i = 0; i < 20000; ++i) {
+        ASSERT_EQ(pool.view(handles[i]), "WPT" + std::to_string(i));
+        ASSERT_EQ(pool.find("WPT" + std::to_string(i)), handles[i]);
+    }
+    EXPECT_EQ(pool.view(longHandle), longName);
+    EXPECT_EQ(pool.view(after), "after");
+}
+
+TEST(PackedWaypointTest, RoundTripsAtWireResolution) {
+    StringPool pool;
+    Waypoint waypoint;
+    waypoint.id = 42;
+    waypoint.name = "Harbour Entrance";
+    waypoint.latitude = 34.1234567;
+    waypoint.longitude = -84.7654321;
+    waypoint.symbol = "Anchor";
+    waypoint.source = 17;
+
+    EXPECT_LE(sizeof(PackedWaypoint), 20u);
+    Waypoint unpacked = unpackWaypoint(packWaypoint(waypoint, pool), pool);
+    EXPECT_EQ(unpacked.id, 42);
+    EXPECT_EQ(unpacked.name, "Harbour Entrance");
+    EXPECT_EQ(unpacked.symbol, "Anchor");
+    EXPECT_EQ(unpacked.source, 17);
+    EXPECT_DOUBLE_EQ(unpacked.latitude, 34.1234567);
+    EXPECT_DOUBLE_EQ(unpacked.longitude, -84.7654321);
+
+    waypoint.latitude = std::nan("");
+    EXPECT_TRUE(std::isnan(unpackWaypoint(packWaypoint(waypoint, pool), pool).latitude));
+}
+
+TEST(WaypointTableTest, CopiesBetweenPackedAndPlainTables) {
+    StringPool pool;
+    WaypointTable packed(&pool);
+    WaypointTable plain;
+    packed.resize(2);
+    plain.resize(2);
+    EXPECT_TRUE(packed.isPacked());
+    EXPECT_FALSE(plain.isPacked());
+
+    Waypoint waypoint;
+    waypoint.name = "Dock";
+    waypoint.latitude = 34.5;
+    waypoint.longitude = -84.25;
+    plain.set(0, waypoint);
+    packed.copy(1, plain, 0);
+    plain.copy(1, packed, 1);
+
+    EXPECT_EQ(packed.get(1).name, "Dock");
+    EXPECT_DOUBLE_EQ(packed.latitude(1), 34.5);
+    EXPECT_DOUBLE_EQ(plain.longitude(1), -84.25);
+}
+
+TEST(ScratchArenaTest, ResetReusesNothingFromTheHeap) {
+    ScratchArena arena(4096);
+    for (int cycle = 0; cycle < 3; ++cycle) {
+        std::pmr::vector<double> values(arena.resource());
+        values.resize(100000, 1.0);
+        EXPECT_EQ(values.back(), 1.0);
+        values = std::pmr::vector<double>(arena.resource());
+        arena.reset();
+    }
+}
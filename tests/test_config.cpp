@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "config.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::string readFile(const std::string &path) {
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+static void writeFile(const std::string &path, const std::string &text) {
+    std::ofstream file(path, std::ios::trunc);
+    file << text;
+}
+
+class ConfigStoreTest : public ::testing::Test {
+protected:
+    std::string path = (fs::temp_directory_path() / ("waypoint_sync_config_" + std::to_string(getpid()) + ".json")).string();
+
+    void TearDown() override {
+        fs::remove(path);
+    }
+};
+
+TEST(ConfigTest, ParsesTemplate) {
+    Config config;
+    std::string error;
+    ASSERT_TRUE(parseConfig(readFile("config/config.json.template"), config, error)) << error;
+
+    EXPECT_EQ(config.waypointsFile, "/mnt/nvme/waypoints.json");
+    EXPECT_EQ(config.formatMap.at("usr"), "lowrance");
+    EXPECT_EQ(config.deviceConnectRetries, 5);
+    EXPECT_EQ(config.pollingIntervalMs, 4000);
+    ASSERT_EQ(config.canInterfaces.size(), 1u);
+    EXPECT_EQ(config.canInterfaces[0], "can0");
+    EXPECT_FALSE(config.captureProprietaryPgns);
+    ASSERT_EQ(config.nmea0183Outputs.size(), 1u);
+    EXPECT_EQ(config.nmea0183Outputs[0].device, "/dev/ttyUSB0");
+    EXPECT_EQ(config.nmea0183Outputs[0].baud, 4800);
+    EXPECT_FALSE(config.nmea0183Outputs[0].enabled);
+    EXPECT_EQ(config.waypointCapacityFor("Garmin"), 5000u);
+    EXPECT_EQ(config.waypointCapacityFor("Unknown"), config.defaultWaypointCapacity);
+    EXPECT_FALSE(config.compactMemory);
+    EXPECT_EQ(config.libraryShmName, "/waypoint_sync_library");
+    EXPECT_DOUBLE_EQ(config.transmitMaxBusShare, 0.3);
+    EXPECT_DOUBLE_EQ(config.transmitBusLoadCeiling, 0.8);
+    ASSERT_EQ(config.vendorProfileOverrides.size(), 2u);
+    for (const auto &profile : config.vendorProfileOverrides) {
+        if (profile.vendor == "Raymarine") {
+            EXPECT_EQ(profile.charset, "upper");
+        } else {
+            EXPECT_EQ(profile.vendor, "Humminbird");
+            EXPECT_EQ(profile.maxNameLength, 12u);
+            EXPECT_EQ(profile.symbols.at("anchor"), "Anchor");
+        }
+    }
+}
+
+TEST(ConfigTest, MissingKeysKeepDefaults) {
+    Config config;
+    std::string error;
+    ASSERT_TRUE(parseConfig(R"({"device_settings": {"can_interfaces": ["can0", "can1"]}})", config, error));
+
+    EXPECT_EQ(config.watchDirectory, Config().watchDirectory);
+    EXPECT_EQ(config.canInterfaces.size(), 2u);
+    EXPECT_FALSE(config.bridgeWaypointPgns);
+
+    // No NMEA 2000 bus: files and 0183 outputs only.
+    ASSERT_TRUE(parseConfig(R"({"device_settings": {"can_interfaces": []}})", config, error));
+    EXPECT_TRUE(config.canInterfaces.empty());
+
+    ASSERT_TRUE(parseConfig(R"({"memory_settings": {"compact_mode": true}})", config, error));
+    EXPECT_TRUE(config.compactMemory);
+
+    ASSERT_TRUE(parseConfig(R"({"library_export": {"shm_name": ""}})", config, error));
+    EXPECT_TRUE(config.libraryShmName.empty());
+    EXPECT_EQ(config.librarySocketPath, "@waypoint_sync_library");
+
+    ASSERT_TRUE(parseConfig(R"({"nmea0183_outputs": [{"type": "udp", "host": "127.0.0.1", "port": 10110}]})",
+                            config, error));
+    ASSERT_EQ(config.nmea0183Outputs.size(), 1u);
+    EXPECT_TRUE(config.nmea0183Outputs[0].enabled);
+}
+
+TEST(ConfigTest, InvalidInputLeavesConfigUntouched) {
+    Config config;
+    config.pollingIntervalMs = 1234;
+    std::string error;
+
+    EXPECT_FALSE(parseConfig("{ not json", config, error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(parseConfig(R"({"device_settings": {"polling_interval": "fast"}})", config, error));
+    EXPECT_FALSE(parseConfig(R"({"nmea0183_outputs": [{"type": "bluetooth"}]})", config, error));
+    EXPECT_FALSE(parseConfig(R"({"transmit_settings": {"max_bus_share": 1.5}})", config, error));
+    EXPECT_FALSE(parseConfig(R"({"vendor_profiles": {"Garmin": {"max_name_length": 40}}})", config, error));
+    EXPECT_FALSE(parseConfig(R"({"vendor_profiles": {"Garmin": {"charset": "utf8"}}})", config, error));
+    EXPECT_EQ(config.pollingIntervalMs, 1234);
+}
+
+TEST_F(ConfigStoreTest, ReloadSwapsSnapshotWithoutDisturbingReaders) {
+    writeFile(path, R"({"paths": {"format_mapping_file": ""}, "device_settings": {"polling_interval": 1000}})");
+    ConfigStore store(path);
+    ASSERT_TRUE(store.reload());
+    std::shared_ptr<const Config> before = store.current();
+    EXPECT_EQ(before->pollingIntervalMs, 1000);
+
+    writeFile(path, R"({"paths": {"format_mapping_file": ""}, "device_settings": {"polling_interval": 2000}})");
+    ASSERT_TRUE(store.reload());
+
+    // The reader's snapshot is immutable; new readers see the new one.
+    EXPECT_EQ(before->pollingIntervalMs, 1000);
+    EXPECT_EQ(store.current()->pollingIntervalMs, 2000);
+    EXPECT_EQ(store.getGeneration(), 2u);
+}
+
+TEST_F(ConfigStoreTest, BadReloadKeepsCurrentSnapshot) {
+    writeFile(path, R"({"paths": {"format_mapping_file": ""}, "format_mappings": {"gpx": "gpx"}})");
+    ConfigStore store(path);
+    ASSERT_TRUE(store.reload());
+
+    writeFile(path, R"({"format_mappings": )");
+    EXPECT_FALSE(store.reload());
+    EXPECT_EQ(store.current()->formatMap.at("gpx"), "gpx");
+    EXPECT_EQ(store.getGeneration(), 1u);
+}
@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include "converter_pool.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// Stands in for gpsbabel: copies input to stdout, and the input format
+// picks a misbehaviour.
+static const char *fakeConverter = R"(#!/bin/sh
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -i) in="$2"; shift ;;
+        -f) file="$2"; shift ;;
+        -o) out="$2"; shift ;;
+    esac
+    shift
+done
+case "$in" in
+    slow) sleep 10 ;;
+    busy) sleep 0.2 ;;
+    fail) echo "unknown file type" >&2; exit 1 ;;
+    args) printf '%s' "$out"; exit 0 ;;
+    early) exit 0 ;;
+esac
+if [ "$file" = "-" ]; then cat; else cat "$file"; fi
+)";
+
+class ConverterPoolTest : public ::testing::Test {
+protected:
+    fs::path directory = fs::temp_directory_path() / ("waypoint_sync_converter_" + std::to_string(getpid()));
+    ConverterPoolOptions options;
+
+    void SetUp() override {
+        fs::create_directories(directory);
+        fs::path script = directory / "fake_gpsbabel";
+        std::ofstream(script) << fakeConverter;
+        fs::permissions(script, fs::perms::owner_all);
+        options.executable = script.string();
+        options.timeout = std::chrono::milliseconds(5000);
+    }
+
+    void TearDown() override {
+        fs::remove_all(directory);
+    }
+
+    static ConversionRequest request(const std::string &inputFormat, const std::string &input = "") {
+        ConversionRequest request;
+        request.inputFormat = inputFormat;
+        request.outputFormat = "gpx";
+        request.input = input;
+        return request;
+    }
+};
+
+TEST_F(ConverterPoolTest, StreamsLargeInputAndOutputThroughPipes) {
+    ConverterPool pool(options);
+    // Well past the pipe buffer in both directions.
+    std::string input(4 * 1024 * 1024, 'x');
+    for (size_t i = 0; i < input.size(); i += 4096) {
+        input[i] = static_cast<char>('a' + (i / 4096) % 26);
+    }
+
+    ConversionResult result = pool.convert(request("gpx", input));
+    ASSERT_TRUE(result.ok) << result.errorText;
+    EXPECT_EQ(result.exitStatus, 0);
+    EXPECT_EQ(result.output, input);
+
+    size_t streamed = 0;
+    result = pool.convert(request("gpx", input), [&](const char *, size_t size) {
+        streamed += size;
+        return true;
+    });
+    EXPECT_TRUE(result.ok);
+    EXPECT_TRUE(result.output.empty());
+    EXPECT_EQ(streamed, input.size());
+}
+
+TEST_F(ConverterPoolTest, ReadsInputPathAndPassesArgumentsWithoutAShell) {
+    ConverterPool pool(options);
+    fs::path inputFile = directory / "in put; rm -rf x.usr";
+    std::ofstream(inputFile) << "from a file";
+
+    ConversionRequest fromFile = request("lowrance");
+    fromFile.inputPath = inputFile.string();
+    ConversionResult result = pool.convert(fromFile);
+    ASSERT_TRUE(result.ok) << result.errorText;
+    EXPECT_EQ(result.output, "from a file");
+
+    ConversionRequest args = request("args");
+    args.outputFormat = "garmin $(echo injected) 'quoted'";
+    result = pool.convert(args);
+    EXPECT_EQ(result.output, args.outputFormat);
+}
+
+TEST_F(ConverterPoolTest, ReportsFailuresAndSurvivesEarlyExit) {
+    ConverterPool pool(options);
+    ConversionResult result = pool.convert(request("fail", "data"));
+    EXPECT_FALSE(result.ok);
+    EXPECT_EQ(result.exitStatus, 1);
+    EXPECT_NE(result.errorText.find("unknown file type"), std::string::npos);
+
+    // The converter exits without reading: no SIGPIPE, just a result.
+    result = pool.convert(request("early", std::string(1024 * 1024, 'x')));
+    EXPECT_EQ(result.exitStatus, 0);
+
+    options.executable = (directory / "missing").string();
+    pool.setOptions(options);
+    result = pool.convert(request("gpx", "data"));
+    EXPECT_FALSE(result.ok);
+    EXPECT_EQ(pool.getStats().failed, 2u);
+}
+
+TEST_F(ConverterPoolTest, KillsConversionsThatTimeOut) {
+    options.timeout = std::chrono::milliseconds(200);
+    ConverterPool pool(options);
+
+    auto started = std::chrono::steady_clock::now();
+    ConversionResult result = pool.convert(request("slow", "data"));
+    auto elapsed = std::chrono::steady_clock::now() - started;
+    EXPECT_FALSE(result.ok);
+    EXPECT_TRUE(result.timedOut);
+    EXPECT_LT(elapsed, std::chrono::seconds(3));
+    EXPECT_EQ(pool.getStats().timedOut, 1u);
+}
+
+TEST_F(ConverterPoolTest, BoundsConcurrentConversions) {
+    options.maxConcurrent = 2;
+    ConverterPool pool(options);
+
+    std::vector<std::thread> callers;
+    std::atomic<int> succeeded{0};
+    for (int i = 0; i < 6; ++i) {
+        callers.emplace_back([&] {
+            if (pool.convert(request("busy", "data")).ok) {
+                ++succeeded;
+            }
+        });
+    }
+    for (auto &caller : callers) {
+        caller.join();
+    }
+
+    EXPECT_EQ(succeeded, 6);
+    EXPECT_EQ(pool.getStats().started, 6u);
+    EXPECT_EQ(pool.getStats().peakRunning, 2u);
+}
+
+namespace {
+
+Task<void> convertInto(EventLoop &loop, ConverterPool &pool, ConversionRequest request, ConversionResult &result) {
+    result = co_await pool.convertAsync(loop, std::move(request));
+}
+
+} // namespace
+
+TEST_F(ConverterPoolTest, AsyncConversionsShareOneThreadWithinTheBound) {
+    options.maxConcurrent = 2;
+    options.timeout = std::chrono::milliseconds(500);
+    ConverterPool pool(options);
+    EventLoop loop;
+
+    std::string large(1024 * 1024, 'y');
+    std::vector<ConversionResult> results(6);
+    std::vector<Task<void>> tasks;
+    for (size_t i = 0; i < 4; ++i) {
+        tasks.push_back(convertInto(loop, pool, request("busy", "data"), results[i]));
+    }
+    tasks.push_back(convertInto(loop, pool, request("gpx", large), results[4]));
+    tasks.push_back(convertInto(loop, pool, request("slow", "data"), results[5]));
+
+    auto started = std::chrono::steady_clock::now();
+    loop.spawn(whenAll(std::move(tasks)));
+    loop.run();
+    auto elapsed = std::chrono::steady_clock::now() - started;
+
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_TRUE(results[i].ok) << results[i].errorText;
+        EXPECT_EQ(results[i].output, "data");
+    }
+    EXPECT_EQ(results[4].output, large);
+    EXPECT_TRUE(results[5].timedOut);
+    EXPECT_LT(elapsed, std::chrono::seconds(3));
+    EXPECT_EQ(pool.getStats().started, 6u);
+    EXPECT_EQ(pool.getStats().peakRunning, 2u);
+}
@@ -0,0 +1,139 @@
+#include <gtest/gtest.h>
+#include "event_loop.h"
+#include <chrono>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+Task<int> addLater(EventLoop &loop, int a, int b, int delayMs) {
+    co_await loop.sleepFor(std::chrono::milliseconds(delayMs));
+    co_return a + b;
+}
+
+Task<void> record(EventLoop &loop, std::vector<int> &order, int id, int delayMs) {
+    co_await loop.sleepFor(std::chrono::milliseconds(delayMs));
+    order.push_back(id);
+}
+
+Task<int> fail() {
+    throw std::runtime_error("conversion failed");
+    co_return 0;
+}
+
+} // namespace
+
+TEST(EventLoopTest, TasksReturnValuesAndExceptions) {
+    EventLoop loop;
+    int sum = 0;
+    std::string error;
+    loop.spawn([](EventLoop &loop, int &sum, std::string &error) -> Task<void> {
+        sum = co_await addLater(loop, 2, 3, 1);
+        try {
+            co_await fail();
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+    }(loop, sum, error));
+    loop.run();
+    EXPECT_EQ(sum, 5);
+    EXPECT_EQ(error, "conversion failed");
+}
+
+TEST(EventLoopTest, WhenAllRunsTasksConcurrently) {
+    EventLoop loop;
+    std::vector<int> order;
+    auto start = Clock::now();
+    loop.spawn([](EventLoop &loop, std::vector<int> &order) -> Task<void> {
+        std::vector<Task<void>> tasks;
+        tasks.push_back(record(loop, order, 1, 150));
+        tasks.push_back(record(loop, order, 2, 50));
+        tasks.push_back(record(loop, order, 3, 100));
+        co_await whenAll(std::move(tasks));
+        order.push_back(0);
+    }(loop, order));
+    loop.run();
+
+    EXPECT_EQ(order, (std::vector<int>{2, 3, 1, 0}));
+    EXPECT_LT(Clock::now() - start, std::chrono::milliseconds(280));
+}
+
+TEST(EventLoopTest, WaitsOnDescriptorsWithTimeouts) {
+    EventLoop loop;
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+
+    int timedOut = -1;
+    int readableResult = 0;
+    std::string received;
+    loop.spawn([](EventLoop &loop, int fd, int &timedOut, int &readableResult, std::string &received) -> Task<void> {
+        timedOut = co_await loop.readable(fd, 20);
+        readableResult = co_await loop.readable(fd, 5000);
+        char buffer[16];
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        received.assign(buffer, n > 0 ? static_cast<size_t>(n) : 0);
+    }(loop, fds[0], timedOut, readableResult, received));
+
+    // Written from another thread once the first wait has timed out.
+    std::thread writer([fd = fds[1]] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        ssize_t written = write(fd, "wpt", 3);
+        (void)written;
+    });
+    loop.run();
+    writer.join();
+
+    EXPECT_EQ(timedOut, 0);
+    EXPECT_EQ(readableResult, 1);
+    EXPECT_EQ(received, "wpt");
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(EventLoopTest, OffloadAndPostResumeOnTheLoopThread) {
+    EventLoop loop;
+    std::thread::id loopThread = std::this_thread::get_id();
+    std::thread::id workerThread;
+    bool resumedOnLoop = false;
+    loop.spawn([](EventLoop &loop, std::thread::id loopThread, std::thread::id &workerThread,
+                  bool &resumedOnLoop) -> Task<void> {
+        int value = co_await loop.offload([&workerThread] {
+            workerThread = std::this_thread::get_id();
+            return 42;
+        });
+        resumedOnLoop = value == 42 && std::this_thread::get_id() == loopThread;
+    }(loop, loopThread, workerThread, resumedOnLoop));
+    loop.run();
+
+    EXPECT_TRUE(resumedOnLoop);
+    EXPECT_NE(workerThread, loopThread);
+}
+
+TEST(EventLoopTest, StopEndsRunAndDestroysPendingTasks) {
+    auto loop = std::make_unique<EventLoop>();
+    int fds[2];
+    ASSERT_EQ(pipe2(fds, O_NONBLOCK), 0);
+    bool finished = false;
+    loop->spawn([](EventLoop &loop, int fd, bool &finished) -> Task<void> {
+        co_await loop.readable(fd);
+        finished = true;
+    }(*loop, fds[0], finished));
+
+    std::thread stopper([&loop] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        loop->stop();
+    });
+    loop->run();
+    stopper.join();
+    loop.reset();
+
+    EXPECT_FALSE(finished);
+    close(fds[0]);
+    close(fds[1]);
+}
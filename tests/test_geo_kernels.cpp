@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include "geo_kernels.h"
+#include "waypoint_pgns.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Odd length so every SIMD width also runs its scalar tail.
+static const size_t SAMPLE_COUNT = 1001;
+
+static std::vector<double> randomDegrees(std::mt19937_64 &rng, double limit, size_t count) {
+    std::uniform_real_distribution<double> distribution(-limit, limit);
+    std::vector<double> values(count);
+    for (auto &value : values) {
+        value = distribution(rng);
+    }
+    return values;
+}
+
+static bool sameBits(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+TEST(GeoKernelsTest, FixedPointMatchesScalarAndPgnEncoding) {
+    std::mt19937_64 rng(37);
+    std::vector<double> degrees = randomDegrees(rng, 180.0, SAMPLE_COUNT);
+    // Rounding edges, NaN and values that do not fit 32 bits.
+    const double edges[] = {0.0, -0.0, 0.00000005, -0.00000005, 0.00000015, -0.00000025,
+                            12.34567895, -12.34567895, 214.7483646, -214.7483648, 214.7483647,
+                            -214.74836485, 1e3, -1e3, std::numeric_limits<double>::quiet_NaN(),
+                            std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); ++i) {
+        degrees[i * 3] = edges[i];
+    }
+
+    std::vector<int32_t> expected(degrees.size());
+    geo::scalarKernels().degreesToFixed(degrees.data(), expected.data(), degrees.size());
+
+    using Latitude = pgn_schema::Scaled<4, Resolution1e7>;
+    for (size_t i = 0; i < degrees.size(); ++i) {
+        unsigned char wire[4];
+        Latitude::write(wire, degrees[i]);
+        int32_t raw;
+        std::memcpy(&raw, wire, sizeof(raw));
+        ASSERT_EQ(expected[i], raw) << "degrees " << degrees[i];
+    }
+
+    for (const geo::KernelTable *table : geo::supportedKernels()) {
+        std::vector<int32_t> fixed(degrees.size());
+        table->degreesToFixed(degrees.data(), fixed.data(), degrees.size());
+        EXPECT_EQ(expected, fixed) << table->name;
+
+        std::vector<double> back(fixed.size());
+        table->fixedToDegrees(fixed.data(), back.data(), fixed.size(), N2kDoubleNA);
+        for (size_t i = 0; i < fixed.size(); ++i) {
+            unsigned char wire[4];
+            std::memcpy(wire, &fixed[i], sizeof(wire));
+            double reference = Latitude::read(wire);
+            ASSERT_TRUE(sameBits(reference, back[i])) << table->name << " at " << i;
+        }
+    }
+}
+
+TEST(GeoKernelsTest, DistancesMatchScalarBitForBit) {
+    std::mt19937_64 rng(1037);
+    std::vector<double> latitudes = randomDegrees(rng, 89.0, SAMPLE_COUNT);
+    std::vector<double> longitudes = randomDegrees(rng, 180.0, SAMPLE_COUNT);
+    geo::UnitVectors vectors;
+    vectors.assign(latitudes.data(), longitudes.data(), latitudes.size());
+
+    const double refLatitude = 34.25;
+    const double refLongitude = 179.5;  // forces antimeridian wrapping
+    const double cosRef = std::cos(refLatitude * M_PI / 180.0);
+    const geo::KernelTable &scalar = geo::scalarKernels();
+    std::vector<double> flat(latitudes.size()), chord(latitudes.size());
+    scalar.equirectangular(refLatitude, refLongitude, cosRef, latitudes.data(), longitudes.data(), flat.data(), flat.size());
+    scalar.halfChord(0.1, 0.2, 0.97, vectors.x.data(), vectors.y.data(), vectors.z.data(), chord.data(), chord.size());
+
+    for (const geo::KernelTable *table : geo::supportedKernels()) {
+        std::vector<double> out(latitudes.size());
+        table->equirectangular(refLatitude, refLongitude, cosRef, latitudes.data(), longitudes.data(), out.data(), out.size());
+        for (size_t i = 0; i < out.size(); ++i) {
+            ASSERT_TRUE(sameBits(flat[i], out[i])) << table->name << " equirectangular at " << i;
+        }
+        table->halfChord(0.1, 0.2, 0.97, vectors.x.data(), vectors.y.data(), vectors.z.data(), out.data(), out.size());
+        for (size_t i = 0; i < out.size(); ++i) {
+            ASSERT_TRUE(sameBits(chord[i], out[i])) << table->name << " halfChord at " << i;
+        }
+    }
+}
+
+TEST(GeoKernelsTest, DistancesAgreeWithTextbookFormulas) {
+    const double refLatitude = 34.0;
+    const double refLongitude = -84.0;
+    std::vector<double> latitudes{34.0, 34.01, 33.5, -33.9, 34.0};
+    std::vector<double> longitudes{-84.0, -84.01, -84.2, 151.2, -83.99};
+
+    geo::UnitVectors vectors;
+    vectors.assign(latitudes.data(), longitudes.data(), latitudes.size());
+    std::vector<double> haversine(latitudes.size()), flat(latitudes.size());
+    geo::haversineDistances(refLatitude, refLongitude, vectors, haversine.data());
+    geo::equirectangularDistances(refLatitude, refLongitude, latitudes.data(), longitudes.data(), latitudes.size(), flat.data());
+
+    const double radians = M_PI / 180.0;
+    for (size_t i = 0; i < latitudes.size(); ++i) {
+        double dLat = (latitudes[i] - refLatitude) * radians;
+        double dLon = (longitudes[i] - refLongitude) * radians;
+        double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+                   std::cos(refLatitude * radians) * std::cos(latitudes[i] * radians) * std::sin(dLon / 2) * std::sin(dLon / 2);
+        double reference = 2 * geo::EARTH_RADIUS_METERS * std::asin(std::sqrt(a));
+        EXPECT_NEAR(reference, haversine[i], 1e-6 * reference + 1e-6) << i;
+        if (reference < 50000.0) {
+            EXPECT_NEAR(reference, flat[i], 1e-3 * reference + 1e-6) << i;
+        }
+    }
+    EXPECT_EQ(0.0, haversine[0]);
+    EXPECT_EQ(0.0, flat[0]);
+}
+
+TEST(GeoKernelsTest, BoundingBoxHandlesAntimeridian) {
+    std::mt19937_64 rng(2037);
+    std::vector<double> latitudes = randomDegrees(rng, 90.0, SAMPLE_COUNT);
+    std::vector<double> longitudes = randomDegrees(rng, 180.0, SAMPLE_COUNT);
+    latitudes[5] = std::numeric_limits<double>::quiet_NaN();
+
+    const geo::Box boxes[] = {{30.0, 40.0, -90.0, -80.0}, {-20.0, 20.0, 170.0, -170.0}};
+    for (const geo::Box &box : boxes) {
+        std::vector<uint8_t> expected(latitudes.size());
+        size_t expectedCount = 0;
+        for (size_t i = 0; i < latitudes.size(); ++i) {
+            bool latitudeIn = latitudes[i] >= box.minLatitude && latitudes[i] <= box.maxLatitude;
+            bool longitudeIn = box.minLongitude <= box.maxLongitude
+                                   ? longitudes[i] >= box.minLongitude && longitudes[i] <= box.maxLongitude
+                                   : longitudes[i] >= box.minLongitude || longitudes[i] <= box.maxLongitude;
+            expected[i] = latitudeIn && longitudeIn;
+            expectedCount += expected[i];
+        }
+        ASSERT_GT(expectedCount, 0u);
+
+        for (const geo::KernelTable *table : geo::supportedKernels()) {
+            std::vector<uint8_t> inside(latitudes.size(), 7);
+            EXPECT_EQ(expectedCount, table->boundingBox(latitudes.data(), longitudes.data(), latitudes.size(), box, inside.data()))
+                << table->name;
+            EXPECT_EQ(expected, inside) << table->name;
+        }
+    }
+}
+
+TEST(GeoKernelsTest, DispatchPicksASupportedKernel) {
+    auto tables = geo::supportedKernels();
+    ASSERT_FALSE(tables.empty());
+    EXPECT_STREQ("scalar", tables.front()->name);
+    EXPECT_EQ(tables.back(), &geo::kernels());
+}
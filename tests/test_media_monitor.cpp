@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+#include "media_monitor.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::string mountInfoLine(const std::string &mountPoint, const std::string &fsType, const std::string &source) {
+    return "120 29 179:1 / " + mountPoint + " rw,relatime shared:70 - " + fsType + " " + source + " rw\n";
+}
+
+class MediaMonitorTest : public ::testing::Test {
+protected:
+    fs::path root = fs::temp_directory_path() / ("waypoint_sync_media_" + std::to_string(getpid()));
+    fs::path mountInfo = root / "mountinfo";
+
+    void SetUp() override {
+        fs::create_directories(root);
+    }
+
+    void TearDown() override {
+        fs::remove_all(root);
+    }
+
+    void touch(const fs::path &path) {
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << "data";
+    }
+};
+
+TEST(MountInfoTest, ParsesAndUnescapes) {
+    std::string text =
+        "22 1 259:2 / / rw,relatime shared:1 - ext4 /dev/nvme0n1p2 rw\n"
+        "120 29 179:1 / /media/pi/MY\\040CARD rw,nosuid shared:70 - vfat /dev/mmcblk1p1 rw,uid=1000\n"
+        "garbage line\n";
+    std::vector<MountEntry> mounts = parseMountInfo(text);
+
+    ASSERT_EQ(mounts.size(), 2u);
+    EXPECT_EQ(mounts[0].mountPoint, "/");
+    EXPECT_EQ(mounts[1].mountPoint, "/media/pi/MY CARD");
+    EXPECT_EQ(mounts[1].fsType, "vfat");
+    EXPECT_EQ(mounts[1].source, "/dev/mmcblk1p1");
+
+    std::vector<MountEntry> added = addedMounts({mounts[0]}, mounts);
+    ASSERT_EQ(added.size(), 1u);
+    EXPECT_EQ(added[0].source, "/dev/mmcblk1p1");
+}
+
+TEST_F(MediaMonitorTest, ScansOnlyVendorFolders) {
+    touch(root / "card" / "Garmin" / "GPX" / "Waypoints_01.GPX");
+    touch(root / "card" / "Garmin" / "GPX" / "notes.txt");
+    touch(root / "card" / "lake.usr");
+    touch(root / "card" / "Photos" / "trip.gpx");  // Not a vendor folder
+
+    std::vector<MediaFile> files = scanMount((root / "card").string(), defaultVendorLayouts());
+    ASSERT_EQ(files.size(), 2u);
+
+    auto garmin = std::find_if(files.begin(), files.end(), [](const MediaFile &file) { return file.vendor == "Garmin"; });
+    ASSERT_NE(garmin, files.end());
+    EXPECT_EQ(garmin->format, "gpx");
+    auto lowrance = std::find_if(files.begin(), files.end(), [](const MediaFile &file) { return file.vendor == "Lowrance"; });
+    ASSERT_NE(lowrance, files.end());
+    EXPECT_EQ(lowrance->format, "lowranceusr");
+}
+
+TEST_F(MediaMonitorTest, ImportsExistingAndNewlyMountedCards) {
+    touch(root / "card1" / "Garmin" / "GPX" / "a.gpx");
+    touch(root / "card2" / "Humminbird.hwr");
+    touch(root / "disk" / "Garmin" / "GPX" / "ignored.gpx");
+
+    std::ofstream(mountInfo) << mountInfoLine((root / "card1").string(), "vfat", "/dev/sda1")
+                             << mountInfoLine((root / "disk").string(), "ext4", "/dev/nvme0n1p1");
+
+    std::mutex importedMutex;
+    std::vector<std::string> imported;
+    MediaMonitorOptions options;
+    options.mountInfoPath = mountInfo.string();
+    options.mountPrefixes = {root.string()};
+    options.useNetlink = false;
+    MediaMonitor monitor([&](const MediaFile &file) {
+        std::lock_guard<std::mutex> lock(importedMutex);
+        imported.push_back(fs::path(file.path).filename().string());
+        return true;
+    }, options);
+
+    ASSERT_TRUE(monitor.start());
+    ASSERT_TRUE(monitor.waitIdle(std::chrono::seconds(5)));
+    EXPECT_EQ(imported, std::vector<std::string>{"a.gpx"});
+
+    std::ofstream(mountInfo, std::ios::app) << mountInfoLine((root / "card2").string(), "exfat", "/dev/sdb1");
+    monitor.refresh();
+    ASSERT_TRUE(monitor.waitIdle(std::chrono::seconds(5)));
+    monitor.stop();
+
+    std::lock_guard<std::mutex> lock(importedMutex);
+    EXPECT_EQ(imported, (std::vector<std::string>{"a.gpx", "Humminbird.hwr"}));
+    EXPECT_EQ(monitor.getImportedFiles(), 2u);
+}
+
+// A card with more files than the queue holds, imported slower than it is
+// scanned: neither start() nor stop() may wait for the backlog.
+TEST_F(MediaMonitorTest, StartAndStopDoNotWaitOnAFullImportQueue) {
+    for (int i = 0; i < 6; ++i) {
+        touch(root / "card" / "Garmin" / "GPX" / ("w" + std::to_string(i) + ".gpx"));
+    }
+    std::ofstream(mountInfo) << mountInfoLine((root / "card").string(), "vfat", "/dev/sda1");
+
+    std::mutex releaseMutex;
+    std::condition_variable releaseChanged;
+    bool release = false;
+    MediaMonitorOptions options;
+    options.mountInfoPath = mountInfo.string();
+    options.mountPrefixes = {root.string()};
+    options.useNetlink = false;
+    options.importWorkers = 1;
+    options.maxPendingImports = 1;
+    MediaMonitor monitor([&](const MediaFile &) {
+        std::unique_lock<std::mutex> lock(releaseMutex);
+        releaseChanged.wait_for(lock, std::chrono::seconds(5), [&release] { return release; });
+        return true;
+    }, options);
+
+    auto started = std::chrono::steady_clock::now();
+    ASSERT_TRUE(monitor.start());
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+    EXPECT_FALSE(monitor.waitIdle(std::chrono::milliseconds(100)));
+
+    std::thread releaser([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::lock_guard<std::mutex> lock(releaseMutex);
+        release = true;
+        releaseChanged.notify_all();
+    });
+    auto stopping = std::chrono::steady_clock::now();
+    monitor.stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - stopping, std::chrono::seconds(2));
+    releaser.join();
+    EXPECT_LT(monitor.getImportedFiles(), 6u);
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include "merge_engine.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static Waypoint makeWaypoint(const std::string &name, double latitude, double longitude) {
+    Waypoint waypoint;
+    waypoint.name = name;
+    waypoint.latitude = latitude;
+    waypoint.longitude = longitude;
+    return waypoint;
+}
+
+static bool contains(const std::vector<Waypoint> &waypoints, const std::string &name) {
+    return std::any_of(waypoints.begin(), waypoints.end(),
+                       [&name](const Waypoint &waypoint) { return waypoint.name == name; });
+}
+
+TEST(VersionVectorTest, ComparesAndMerges) {
+    VersionVector a;
+    VersionVector b;
+    EXPECT_EQ(a.compare(b), VersionVector::Order::Equal);
+
+    a.increment(1);
+    EXPECT_EQ(a.compare(b), VersionVector::Order::After);
+    EXPECT_EQ(b.compare(a), VersionVector::Order::Before);
+
+    b.increment(2);
+    EXPECT_EQ(a.compare(b), VersionVector::Order::Concurrent);
+
+    a.mergeFrom(b);
+    EXPECT_EQ(a.get(1), 1u);
+    EXPECT_EQ(a.get(2), 1u);
+    EXPECT_EQ(a.compare(b), VersionVector::Order::After);
+}
+
+TEST(VersionVectorTest, CopiesAndMovesInlineAndSpilledCounters) {
+    VersionVector single;
+    single.increment(3);
+    VersionVector several;
+    several.increment(5);
+    several.increment(1);
+    several.increment(3);
+    several.increment(3);
+
+    VersionVector copy = several;
+    EXPECT_EQ(copy, several);
+    EXPECT_EQ(copy.get(3), 2u);
+    copy = single;
+    EXPECT_EQ(copy, single);
+    EXPECT_NE(copy, several);
+
+    VersionVector moved = std::move(several);
+    EXPECT_EQ(moved.get(1), 1u);
+    EXPECT_EQ(moved.get(5), 1u);
+    EXPECT_EQ(moved.total(), 4u);
+    moved = std::move(copy);
+    EXPECT_EQ(moved, single);
+    EXPECT_EQ(moved.compare(single), VersionVector::Order::Equal);
+}
+
+TEST(MergeEngineTest, NewWaypointGoesToEveryOtherSource) {
+    MergeEngine engine;
+    SourceId library = engine.sourceId("file:library.gpx");
+    SourceId plotter = engine.sourceId("can0:12");
+
+    engine.observe(library, makeWaypoint("Dock", 34.1, -84.1));
+    engine.observe(plotter, makeWaypoint("Reef", 34.2, -84.2));
+    MergeResult result = engine.merge();
+
+    EXPECT_EQ(result.changed.size(), 2u);
+    ASSERT_EQ(result.updatesBySource[library].size(), 1u);
+    EXPECT_EQ(result.updatesBySource[library][0].name, "Reef");
+    ASSERT_EQ(result.updatesBySource[plotter].size(), 1u);
+    EXPECT_EQ(result.updatesBySource[plotter][0].name, "Dock");
+
+    // Nothing new: the next round is a no-op, even if the plotter repeats itself.
+    engine.observe(plotter, makeWaypoint("Reef", 34.2, -84.2));
+    result = engine.merge();
+    EXPECT_TRUE(result.changed.empty());
+    EXPECT_TRUE(result.updatesBySource.empty());
+}
+
+TEST(MergeEngineTest, LaterEditDominatesWithoutConflict) {
+    MergeEngine engine;
+    SourceId a = engine.sourceId("can0:12");
+    SourceId b = engine.sourceId("can0:20");
+
+    engine.observe(a, makeWaypoint("Dock", 34.1, -84.1));
+    engine.merge();
+
+    // b received Dock from the first round and now moves it.
+    engine.observe(b, makeWaypoint("dock", 34.15, -84.1));
+    MergeResult result = engine.merge();
+
+    EXPECT_EQ(result.conflictsResolved, 0u);
+    ASSERT_EQ(result.updatesBySource[a].size(), 1u);
+    EXPECT_DOUBLE_EQ(result.updatesBySource[a][0].latitude, 34.15);
+    EXPECT_FALSE(contains(result.updatesBySource[b], "dock"));
+    EXPECT_EQ(engine.size(), 1u);
+}
+
+TEST(MergeEngineTest, ConcurrentEditsConvergeDeterministically) {
+    auto run = [](bool reversed) {
+        MergeEngine engine;
+        SourceId a = engine.sourceId("can0:12");
+        SourceId b = engine.sourceId("can1:30");
+        engine.observe(a, makeWaypoint("Dock", 34.1, -84.1));
+        engine.merge();
+
+        Waypoint fromA = makeWaypoint("Dock", 34.2, -84.1);
+        Waypoint fromB = makeWaypoint("Dock", 34.3, -84.1);
+        if (reversed) {
+            engine.observe(b, fromB);
+            engine.observe(a, fromA);
+        } else {
+            engine.observe(a, fromA);
+            engine.observe(b, fromB);
+        }
+        MergeResult result = engine.merge();
+        EXPECT_EQ(result.conflictsResolved, 1u);
+
+        // Both sides end up at a version that dominates either edit.
+        const VersionVector *version = engine.versionOf("Dock");
+        EXPECT_NE(version, nullptr);
+        EXPECT_EQ(version->get(a), 2u);
+        EXPECT_EQ(version->get(b), 1u);
+        return engine.waypoints()[0].latitude;
+    };
+
+    EXPECT_DOUBLE_EQ(run(false), run(true));
+}
+
+TEST(MergeEngineTest, StaleReportAfterLosingConflictIsNotANewEdit) {
+    MergeEngine engine;
+    SourceId a = engine.sourceId("can0:12");
+    SourceId b = engine.sourceId("can0:20");
+    engine.observe(a, makeWaypoint("Dock", 34.1, -84.1));
+    engine.merge();
+
+    engine.observe(a, makeWaypoint("Dock", 34.2, -84.1));
+    engine.observe(b, makeWaypoint("Dock", 34.3, -84.1));
+    engine.merge();
+    double winner = engine.waypoints()[0].latitude;
+
+    // Neither plotter has applied the result yet and both repeat themselves.
+    engine.observe(a, makeWaypoint("Dock", 34.2, -84.1));
+    engine.observe(b, makeWaypoint("Dock", 34.3, -84.1));
+    MergeResult result = engine.merge();
+    EXPECT_TRUE(result.changed.empty());
+    EXPECT_DOUBLE_EQ(engine.waypoints()[0].latitude, winner);
+}
+
+TEST(MergeEngineTest, MissingWaypointIsNotADeletion) {
+    MergeEngine engine;
+    SourceId library = engine.sourceId("file:library.gpx");
+    SourceId plotter = engine.sourceId("can0:12");
+
+    engine.observeSnapshot(library, {makeWaypoint("Dock", 34.1, -84.1), makeWaypoint("Reef", 34.2, -84.2)});
+    engine.merge();
+
+    engine.observeSnapshot(plotter, {makeWaypoint("Dock", 34.1, -84.1)});
+    MergeResult result = engine.merge();
+    EXPECT_TRUE(result.changed.empty());
+    EXPECT_EQ(engine.size(), 2u);
+}
+
+TEST(MergeEngineTest, CompactModeMergesLikeStandard) {
+    auto run = [](bool compact) {
+        MergeEngine engine(compact);
+        SourceId library = engine.sourceId("file:library.gpx");
+        SourceId plotter = engine.sourceId("can0:12");
+        engine.observeSnapshot(library, {makeWaypoint("Dock", 34.1234567, -84.1), makeWaypoint("Reef", 34.2, -84.2)});
+        engine.observe(plotter, makeWaypoint("dock ", 34.15, -84.1));
+        engine.merge();
+        engine.observe(plotter, makeWaypoint("Buoy", -33.9, 151.2));
+        MergeResult result = engine.merge();
+
+        EXPECT_EQ(engine.isCompact(), compact);
+        EXPECT_EQ(engine.size(), 3u);
+        EXPECT_NE(engine.versionOf("REEF"), nullptr);
+        EXPECT_EQ(engine.versionOf("Wreck"), nullptr);
+        std::vector<Waypoint> waypoints = engine.waypoints();
+        std::sort(waypoints.begin(), waypoints.end(),
+                  [](const Waypoint &a, const Waypoint &b) { return a.name < b.name; });
+        EXPECT_EQ(result.updatesBySource[library].size(), 1u);
+        return waypoints;
+    };
+
+    std::vector<Waypoint> standard = run(false);
+    std::vector<Waypoint> compact = run(true);
+    ASSERT_EQ(standard.size(), compact.size());
+    for (size_t i = 0; i < standard.size(); ++i) {
+        EXPECT_EQ(standard[i].name, compact[i].name);
+        EXPECT_DOUBLE_EQ(standard[i].latitude, compact[i].latitude);
+        EXPECT_DOUBLE_EQ(standard[i].longitude, compact[i].longitude);
+        EXPECT_EQ(MergeEngine::contentHash(standard[i]), MergeEngine::contentHash(compact[i]));
+    }
+}
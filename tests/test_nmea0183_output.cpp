@@ -0,0 +1,278 @@
+#include <gtest/gtest.h>
+#include "nmea0183_output.h"
+#include <chrono>
+#include <cstdio>
+#include <pty.h>
+#include <sstream>
+#include <string>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Splits CRLF terminated sentences and checks each one's checksum.
+static std::vector<std::string> splitAndVerify(const std::string &data) {
+    std::vector<std::string> sentences;
+    size_t start = 0;
+    while (start < data.size()) {
+        size_t end = data.find("\r\n", start);
+        EXPECT_NE(end, std::string::npos);
+        if (end == std::string::npos) {
+            break;
+        }
+        std::string sentence = data.substr(start, end - start);
+        size_t star = sentence.find('*');
+        EXPECT_NE(star, std::string::npos);
+        EXPECT_EQ(sentence[0], '$');
+        EXPECT_LE(sentence.size() + 2, 82u);
+
+        char expected[3];
+        std::snprintf(expected, sizeof(expected), "%02X",
+                      Nmea0183Encoder::checksum(sentence.data() + 1, sentence.data() + star));
+        EXPECT_EQ(sentence.substr(star + 1), expected) << sentence;
+
+        sentences.push_back(sentence);
+        start = end + 2;
+    }
+    return sentences;
+}
+
+TEST(Nmea0183EncoderTest, ChecksumMatchesReferenceSentence) {
+    std::string body = "GPWPL,4917.16,N,12310.64,W,003";
+    EXPECT_EQ(Nmea0183Encoder::checksum(body.data(), body.data() + body.size()), 0x65);
+}
+
+TEST(Nmea0183EncoderTest, EncodesWaypointSentence) {
+    Nmea0183Encoder encoder;
+    Waypoint waypoint;
+    waypoint.name = "003";
+    waypoint.latitude = 49.286;
+    waypoint.longitude = -123.177333333;
+    encoder.appendWaypoint(waypoint);
+
+    auto sentences = splitAndVerify(encoder.buffer());
+    ASSERT_EQ(sentences.size(), 1u);
+    EXPECT_EQ(sentences[0].substr(0, sentences[0].find('*')), "$GPWPL,4917.1600,N,12310.6400,W,003");
+}
+
+TEST(Nmea0183EncoderTest, RoundsMinutesIntoNextDegree) {
+    Nmea0183Encoder encoder;
+    Waypoint waypoint;
+    waypoint.name = "EDGE";
+    waypoint.latitude = -(10.0 + 59.999996 / 60.0);
+    waypoint.longitude = 0.0;
+    encoder.appendWaypoint(waypoint);
+
+    EXPECT_EQ(encoder.buffer().substr(0, 29), "$GPWPL,1100.0000,S,00000.0000");
+}
+
+TEST(Nmea0183EncoderTest, ReplacesReservedCharactersInNames) {
+    EXPECT_EQ(Nmea0183Encoder::sanitizeName("Reef, North*2"), "Reef_ North_2");
+}
+
+TEST(Nmea0183EncoderTest, SplitsLongRoutesAcrossSentences) {
+    Nmea0183Encoder encoder;
+    std::vector<std::string> names;
+    for (int i = 0; i < 40; ++i) {
+        names.push_back("WAYPT" + std::to_string(i));
+    }
+    encoder.appendRoute("Home", names);
+
+    auto sentences = splitAndVerify(encoder.buffer());
+    ASSERT_GT(sentences.size(), 1u);
+
+    std::vector<std::string> decoded;
+    for (size_t i = 0; i < sentences.size(); ++i) {
+        std::string body = sentences[i].substr(0, sentences[i].find('*'));
+        std::stringstream fields(body);
+        std::string field;
+        std::vector<std::string> parts;
+        while (std::getline(fields, field, ',')) {
+            parts.push_back(field);
+        }
+        ASSERT_GE(parts.size(), 6u);
+        EXPECT_EQ(parts[0], "$GPRTE");
+        EXPECT_EQ(parts[1], std::to_string(sentences.size()));
+        EXPECT_EQ(parts[2], std::to_string(i + 1));
+        EXPECT_EQ(parts[3], "c");
+        EXPECT_EQ(parts[4], "Home");
+        decoded.insert(decoded.end(), parts.begin() + 5, parts.end());
+    }
+    EXPECT_EQ(decoded, names);
+}
+
+// Past nine and ninety-nine sentences the counts widen; names cut to fit
+// still leave every sentence within 82 characters.
+TEST(Nmea0183EncoderTest, WidensSentenceCountsForLongRoutes) {
+    Nmea0183Encoder encoder;
+    std::vector<std::string> names;
+    for (int i = 0; i < 120; ++i) {
+        names.push_back("Channel Marker Off The North Breakwater " + std::to_string(i));
+    }
+    encoder.appendRoute("Harbour Approach By The Long Way Round", names);
+
+    auto sentences = splitAndVerify(encoder.buffer());
+    ASSERT_GT(sentences.size(), 99u);
+    for (size_t i = 0; i < sentences.size(); ++i) {
+        std::string body = sentences[i].substr(0, sentences[i].find('*'));
+        std::stringstream fields(body);
+        std::string field;
+        std::vector<std::string> parts;
+        while (std::getline(fields, field, ',')) {
+            parts.push_back(field);
+        }
+        ASSERT_GE(parts.size(), 6u);
+        EXPECT_EQ(parts[1], std::to_string(sentences.size()));
+        EXPECT_EQ(parts[2], std::to_string(i + 1));
+        EXPECT_EQ(parts[4], "Harbour Approach By The Long Way Round");
+    }
+}
+
+TEST(Nmea0183EncoderTest, CutsRouteIdsThatLeaveNoRoomForNames) {
+    Nmea0183Encoder encoder;
+    encoder.appendRoute(std::string(100, 'R'), {"A", "B"});
+
+    auto sentences = splitAndVerify(encoder.buffer());
+    ASSERT_EQ(sentences.size(), 2u);
+    EXPECT_NE(sentences[0].find(",A*"), std::string::npos);
+    EXPECT_NE(sentences[1].find(",B*"), std::string::npos);
+}
+
+class Nmea0183OutputTest : public ::testing::Test {
+protected:
+    int master = -1;
+    int slave = -1;
+
+    void SetUp() override {
+        // Raw mode, as openSerial() would configure a real port.
+        termios raw{};
+        cfmakeraw(&raw);
+        ASSERT_EQ(openpty(&master, &slave, nullptr, &raw, nullptr), 0);
+    }
+
+    void TearDown() override {
+        if (master >= 0) {
+            close(master);
+        }
+    }
+
+    // Pumps the output until its queue is empty, sleeping as it asks.
+    static void drain(Nmea0183Output &output) {
+        for (int waitMs = output.pump(); waitMs >= 0; waitMs = output.pump()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(waitMs));
+        }
+    }
+
+    // Reads from the pty master until expectedBytes have arrived.
+    std::string readAll(size_t expectedBytes) {
+        std::string received;
+        char buffer[4096];
+        while (received.size() < expectedBytes) {
+            ssize_t n = read(master, buffer, sizeof(buffer));
+            if (n <= 0) {
+                break;
+            }
+            received.append(buffer, static_cast<size_t>(n));
+        }
+        return received;
+    }
+};
+
+TEST_F(Nmea0183OutputTest, StreamsThousandWaypointsThroughPty) {
+    std::vector<Waypoint> waypoints(1000);
+    for (size_t i = 0; i < waypoints.size(); ++i) {
+        waypoints[i].name = "WP" + std::to_string(i);
+        waypoints[i].latitude = 30.0 + i * 0.001;
+        waypoints[i].longitude = -80.0 - i * 0.001;
+    }
+
+    Nmea0183Encoder expected;
+    for (const auto &waypoint : waypoints) {
+        expected.appendWaypoint(waypoint);
+    }
+
+    Nmea0183Output output;
+    ASSERT_TRUE(output.openFd(slave, 0));
+    slave = -1;
+
+    std::string received;
+    std::thread reader([&] { received = readAll(expected.buffer().size()); });
+    EXPECT_EQ(output.sendWaypoints(waypoints), waypoints.size());
+    drain(output);
+    reader.join();
+
+    EXPECT_EQ(received, expected.buffer());
+    EXPECT_EQ(splitAndVerify(received).size(), waypoints.size());
+    EXPECT_EQ(output.getBytesWritten(), expected.buffer().size());
+}
+
+TEST_F(Nmea0183OutputTest, PacesOutputToBaudRate) {
+    std::vector<Waypoint> waypoints(24);
+    for (size_t i = 0; i < waypoints.size(); ++i) {
+        waypoints[i].name = "PACE" + std::to_string(i);
+        waypoints[i].latitude = 10.0;
+        waypoints[i].longitude = 20.0;
+    }
+
+    Nmea0183Output output;
+    ASSERT_TRUE(output.openFd(slave, 9600));
+    slave = -1;
+
+    Nmea0183Encoder expected;
+    for (const auto &waypoint : waypoints) {
+        expected.appendWaypoint(waypoint);
+    }
+
+    std::string received;
+    std::thread reader([&] { received = readAll(expected.buffer().size()); });
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(output.sendWaypoints(waypoints), waypoints.size());
+    // Only the first batch goes out at once; the caller is not held up.
+    auto queuedAfter = std::chrono::steady_clock::now() - start;
+    EXPECT_TRUE(output.hasPending());
+    EXPECT_LT(output.getBytesWritten(), expected.buffer().size());
+    EXPECT_LT(std::chrono::duration<double>(queuedAfter).count(), 0.1);
+
+    drain(output);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    reader.join();
+
+    // ~1000 bytes at 960 bytes/s; everything but the last batch must wait.
+    double expectedSeconds = output.getBytesWritten() * 10.0 / 9600.0;
+    EXPECT_GT(std::chrono::duration<double>(elapsed).count(), expectedSeconds * 0.6);
+    EXPECT_EQ(received, expected.buffer());
+}
+
+// More than the queue limit at once: the output takes the sentences that
+// fit and the rest is queued once the first part has drained.
+TEST_F(Nmea0183OutputTest, QueuesWhatFitsWhenABatchPassesTheLimit) {
+    std::vector<Waypoint> waypoints(2500);
+    for (size_t i = 0; i < waypoints.size(); ++i) {
+        waypoints[i].name = "Limit Mark " + std::to_string(i);
+        waypoints[i].latitude = 30.0 + i * 0.001;
+        waypoints[i].longitude = -80.0 - i * 0.001;
+    }
+    Nmea0183Encoder expected;
+    for (const auto &waypoint : waypoints) {
+        expected.appendWaypoint(waypoint);
+    }
+    ASSERT_GT(expected.buffer().size(), 96u * 1024);
+
+    Nmea0183Output output;
+    ASSERT_TRUE(output.openFd(slave, 0));
+    slave = -1;
+
+    std::string received;
+    std::thread reader([&] { received = readAll(expected.buffer().size()); });
+    size_t first = output.sendWaypoints(waypoints);
+    EXPECT_GT(first, 0u);
+    EXPECT_LT(first, waypoints.size());
+    drain(output);
+    std::vector<Waypoint> rest(waypoints.begin() + static_cast<std::ptrdiff_t>(first), waypoints.end());
+    EXPECT_EQ(output.sendWaypoints(rest), rest.size());
+    drain(output);
+    reader.join();
+
+    EXPECT_EQ(received, expected.buffer());
+    EXPECT_EQ(splitAndVerify(received).size(), waypoints.size());
+}
@@ -1,168 +1,298 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
-#include <wiringPi.h>
 #include "NMEA2000.h"
 #include "nmea_waypoint_handler.h"
 #include "sync_manager.h"
 #include "mock_nmea2000.h"
-
-// GPIO pin definitions (WiringPi pin numbers)
-#define POWER_LED_PIN 7            // GPIO 4 (Blue LED for Power)
-#define LISTENING_LED_PIN 3        // GPIO 22 (Green LED for Listening)
-#define TRANSMITTING_LED_PIN 0     // GPIO 17 (Yellow LED for Transmitting)
-#define ERROR_LED_PIN 2            // GPIO 27 (Red LED for Error)
-
-// Mock class for SyncManager
-class MockSyncManager : public SyncManager {
-public:
-    MOCK_METHOD(void, syncWaypoint, (double lat, double lon, const std::string &name));
-};
-
-// Mock class for NMEAWaypointHandler with simulated devices
-class MockNMEAWaypointHandler : public NMEAWaypointHandler {
-public: 
-    MockNMEAWaypointHandler(SyncManager& sm, std::unique_ptr<tNMEA2000> nmea2000Instance)
-        : NMEAWaypointHandler(sm, std::move(nmea2000Instance)) {
-        enableMockMode({"Garmin", "Lowrance"});
-    }
-
-
-    // MOCK_METHOD(std::vector<std::string>&, getDetectedDevices, (), (override));
-    MOCK_METHOD(void, addWaypoint, (uint16_t waypointID, const std::string &name, double latitude, double longitude));
-    MOCK_METHOD(void, updateWaypoint, (uint16_t waypointID, const std::string &newName, double latitude, double longitude));
-    // Directly implement getDetectedDevices to return mockDevices
-    std::vector<std::string> mockDevices = { "Garmin", "Lowrance" };
-    
-};
-
-// Define a fixture for the NMEAWaypointHandler tests
+#include "virtual_n2k_bus.h"
+#include "waypoint_pgns.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <thread>
+
+namespace fs = std::filesystem;
+using ::testing::_;
+using ::testing::NiceMock;
+using ::testing::Return;
+
+// A manager with no CAN interfaces, no 0183 outputs and nothing outside a
+// scratch directory, for handlers to report to.
 class NMEAWaypointHandlerTest : public ::testing::Test {
 protected:
-    MockNMEA2000* mockNMEA2000;                       // Raw pointer for mock
-    MockSyncManager mockSyncManager;                 // Mock SyncManager
-    std::unique_ptr<NMEAWaypointHandler> nmeaHandler;
-
-void SetUp() override {
-        // Initialize WiringPi
-        if (wiringPiSetup() == -1) {
-            std::cerr << "WiringPi initialization failed" << std::endl;
-            FAIL() << "Failed to initialize WiringPi";
-        }
-
-                // Set GPIO pin modes for LEDs
-        pinMode(POWER_LED_PIN, OUTPUT);
-        pinMode(LISTENING_LED_PIN, OUTPUT);
-        pinMode(TRANSMITTING_LED_PIN, OUTPUT);
-        pinMode(ERROR_LED_PIN, OUTPUT);
-
-        // Turn on Power LED to indicate the test setup is starting
-        digitalWrite(POWER_LED_PIN, HIGH);
-         // Delay for 2 seconds
-
-        // Create a mock instance as a unique_ptr
-        auto mockInstance = std::make_unique<MockNMEA2000>();
-        mockNMEA2000 = mockInstance.get(); 
-
-        // Pass the unique_ptr to NMEAWaypointHandler's constructor
-        nmeaHandler = std::make_unique<NMEAWaypointHandler>(mockSyncManager, std::move(mockInstance));
-
-        // Set up expectations on the mock instance before calling start
-        EXPECT_CALL(*mockNMEA2000, Open()).Times(1);
-        EXPECT_CALL(*mockNMEA2000, SendMsg(::testing::_)).Times(::testing::AnyNumber());
-
-        // Enable mock mode and start the handler
-        nmeaHandler->enableMockMode({"Garmin", "Lowrance"});
-        nmeaHandler->start();
-        
+    fs::path dir;
+    std::unique_ptr<SyncManager> syncManager;
+
+    void SetUp() override {
+        std::string pattern = (fs::temp_directory_path() / "handler_test_XXXXXX").string();
+        dir = fs::path(mkdtemp(pattern.data()));
+        fs::create_directories(dir / "watch");
+        std::ofstream config(dir / "config.json");
+        config << "{\"paths\": {\"watch_directory\": \"" << (dir / "watch").string() << "\", "
+               << "\"waypoints_file\": \"" << (dir / "waypoints.json").string() << "\"}, "
+               << "\"device_settings\": {\"can_interfaces\": [], \"media_mount_prefixes\": []}, "
+               << "\"library_export\": {\"shm_name\": \"\"}}";
+        config.close();
+        syncManager = std::make_unique<SyncManager>(std::make_shared<ConfigStore>((dir / "config.json").string()));
     }
 
     void TearDown() override {
-
-        // Turn on Error LED to indicate teardown is happening (for testing purposes)
-        digitalWrite(ERROR_LED_PIN, HIGH);
-        delay(500);
-        digitalWrite(ERROR_LED_PIN, LOW);
-        digitalWrite(POWER_LED_PIN, LOW);
-
-        // Reset the handler and mock pointer to clean up after tests
-        nmeaHandler.reset();
-        mockNMEA2000 = nullptr;
+        syncManager.reset();
+        fs::remove_all(dir);
     }
 };
 
+// Collects one PGN from a virtual bus; parsed on the test thread.
+class PgnCollector : public tNMEA2000::tMsgHandler {
+public:
+    PgnCollector(VirtualN2kBus &bus, unsigned long pgn) : tNMEA2000::tMsgHandler(pgn), node(bus) {
+        node.SetMode(tNMEA2000::N2km_ListenOnly);
+        node.AttachMsgHandler(this);
+        node.Open();
+    }
+    ~PgnCollector() override { node.DetachMsgHandler(this); }
 
+    void HandleMsg(const tN2kMsg &N2kMsg) override { messages.push_back(N2kMsg); }
 
-// Test for verifying device detection
-TEST_F(NMEAWaypointHandlerTest, DetectsDevicesCorrectly) {
-    // Turn on Listening LED to indicate device detection is being tested
-    digitalWrite(LISTENING_LED_PIN, HIGH);
-    delay(1000);
-
-    const auto& devices = nmeaHandler->getDetectedDevices();
+    bool waitForCount(size_t count, std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (messages.size() < count && std::chrono::steady_clock::now() < deadline) {
+            node.ParseMessages();
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        node.ParseMessages();
+        return messages.size() >= count;
+    }
 
-    EXPECT_FALSE(devices.empty());
-    EXPECT_EQ(devices.size(), 2);
-    EXPECT_EQ(devices[0], "Garmin");
-    EXPECT_EQ(devices[1], "Lowrance");
+    VirtualN2kNode node;
+    std::vector<tN2kMsg> messages;
+};
 
-    // Turn off Listening LED after test is done
-    digitalWrite(LISTENING_LED_PIN, LOW);
+TEST_F(NMEAWaypointHandlerTest, ReportsMockDevicesBeforeAndWhileRunning) {
+    VirtualN2kBus bus;
+    NMEAWaypointHandler handler(*syncManager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+    handler.enableMockMode({"Garmin", "Lowrance"});
+    EXPECT_EQ(handler.getDetectedDevices(), (std::vector<std::string>{"Garmin", "Lowrance"}));
 
-    testing::Mock::AllowLeak(mockNMEA2000);
+    handler.start();
+    EXPECT_EQ(handler.getDetectedDevices(), (std::vector<std::string>{"Garmin", "Lowrance"}));
+    handler.stop();
 }
 
-// Test for adding a waypoint
-TEST_F(NMEAWaypointHandlerTest, AddsWaypointCorrectly) {
-    std::vector<std::tuple<uint16_t, std::string, double, double>> waypoints = {
-        {101, "Waypoint 1", 37.7749, -122.4194},
-        {102, "Waypoint 2", 40.7128, -74.0060},
-        {103, "Waypoint 3", 34.0522, -118.2437}, 
-        {104, "Waypoint 4", 41.8781, -87.6298},
-        {105, "Waypoint 5", 29.7604, -95.3698},
-        {106, "Waypoint 6", 32.7767, -96.7970},
-        {107, "Waypoint 7", 39.9526, -75.1652},
-        {108, "Waypoint 8", 33.4484, -112.0740},
-        {109, "Waypoint 9", 37.7749, -122.4194},
-        {110, "Waypoint 10", 40.7128, -74.0060}
-    };
+// The device list read is posted to the bus thread while it runs and done
+// directly once it stops.
+TEST_F(NMEAWaypointHandlerTest, ReadsTheDeviceListFromAnyThread) {
+    VirtualN2kBus bus;
+    NMEAWaypointHandler handler(*syncManager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+    EXPECT_TRUE(handler.getDetectedDevices().empty());
+
+    handler.start();
+    std::vector<std::thread> readers;
+    std::atomic<int> reads{0};
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&handler, &reads] {
+            for (int j = 0; j < 5; ++j) {
+                handler.getDetectedDevices();
+                ++reads;
+            }
+        });
+    }
+    for (auto &reader : readers) {
+        reader.join();
+    }
+    EXPECT_EQ(reads, 20);
+    handler.stop();
+    EXPECT_TRUE(handler.getDetectedDevices().empty());
+}
 
-    // Set up a single EXPECT_CALL for all iterations
-    EXPECT_CALL(*mockNMEA2000, SendMsg(::testing::Field(&tN2kMsg::PGN, 130074))).Times(waypoints.size());
+// addWaypoint only queues; the bus thread sends in order at the paced rate.
+TEST_F(NMEAWaypointHandlerTest, QueuedWaypointsGoOutInOrderAtThePacedRate) {
+    VirtualN2kBus bus;
+    PgnCollector collector(bus, WaypointListPgn::pgn);
+    NMEAWaypointHandler handler(*syncManager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+    handler.start();
+
+    const int count = 10;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        handler.addWaypoint(static_cast<uint16_t>(101 + i), "Waypoint " + std::to_string(i + 1), 37.0 + i * 0.01,
+                            -122.0);
+    }
+    auto queuedIn = std::chrono::steady_clock::now() - start;
+
+    std::promise<void> sent;
+    handler.whenTransmitted([&sent] { sent.set_value(); });
+    ASSERT_EQ(sent.get_future().wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    auto sentIn = std::chrono::steady_clock::now() - start;
+
+    ASSERT_TRUE(collector.waitForCount(count));
+    size_t frames = 0;
+    for (int i = 0; i < count; ++i) {
+        WaypointListPgn::View view(collector.messages[i]);
+        ASSERT_TRUE(view.isValid());
+        uint16_t id = 0;
+        view.forEachItem([&id](const WaypointListPgn::ItemView &item) {
+            id = static_cast<uint16_t>(item.get<WaypointListItem::Id>());
+        });
+        EXPECT_EQ(id, 101 + i);
+        frames += framesForPayload(collector.messages[i].DataLen);
+    }
 
-    for (const auto& [waypointID, name, latitude, longitude] : waypoints) {
+    // From a standing start the controller allows its minimum rate plus a
+    // short burst, so the sends take longer than queuing them did.
+    TransmitRateController fresh;
+    double minimumMs = (frames - fresh.framesPerSecond() * 0.1) * 1000.0 / fresh.maxFramesPerSecond();
+    EXPECT_LT(queuedIn, std::chrono::milliseconds(50));
+    double sentMs = std::chrono::duration<double, std::milli>(sentIn).count();
+    EXPECT_GE(sentMs, minimumMs);
+    handler.stop();
+}
 
-        digitalWrite(TRANSMITTING_LED_PIN, HIGH);
-        delay(200);
+// A driver that refuses frames is backpressure: the paced rate drops
+// instead of the queue hammering a full controller.
+TEST_F(NMEAWaypointHandlerTest, RefusedFramesBackOffTheTransmitRate) {
+    auto mock = std::make_unique<NiceMock<MockNMEA2000>>();
+    std::atomic<bool> refuse{false};
+    ON_CALL(*mock, CANOpen()).WillByDefault(Return(true));
+    ON_CALL(*mock, CANGetFrame(_, _, _)).WillByDefault(Return(false));
+    ON_CALL(*mock, CANSendFrame(_, _, _, _)).WillByDefault([&refuse](unsigned long, unsigned char,
+                                                                     const unsigned char *, bool) {
+        return !refuse.load();
+    });
+    NMEAWaypointHandler handler(*syncManager, std::move(mock), "mock0");
+    handler.start();
+
+    // An idle bus lets the rate climb.
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (handler.getTransmitRate() < 250.0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    double climbed = handler.getTransmitRate();
+    ASSERT_GE(climbed, 250.0);
 
-        auto start = std::chrono::high_resolution_clock::now();
-        nmeaHandler->addWaypoint(waypointID, name, latitude, longitude);
-        auto end = std::chrono::high_resolution_clock::now();
+    refuse = true;
+    for (int i = 0; i < 30; ++i) {
+        handler.addWaypoint(static_cast<uint16_t>(i), "WPT" + std::to_string(i), 25.0, -80.0);
+    }
+    double lowest = climbed;
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+    while (std::chrono::steady_clock::now() < deadline) {
+        lowest = std::min(lowest, handler.getTransmitRate());
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_LT(lowest, climbed / 2);
+    handler.stop();
+}
 
-        // Turn off the Transmitting LED after transmission
-        digitalWrite(TRANSMITTING_LED_PIN, LOW);
-        delay(200); 
+// After a backoff the rate cannot climb while stopping, so stop() gives
+// up on a long queue instead of sending it at the minimum rate.
+TEST_F(NMEAWaypointHandlerTest, StopDoesNotWaitOutALongQueue) {
+    auto mock = std::make_unique<NiceMock<MockNMEA2000>>();
+    ON_CALL(*mock, CANOpen()).WillByDefault(Return(true));
+    ON_CALL(*mock, CANGetFrame(_, _, _)).WillByDefault(Return(false));
+    ON_CALL(*mock, CANSendFrame(_, _, _, _)).WillByDefault(Return(false));
+    NMEAWaypointHandler handler(*syncManager, std::move(mock), "mock0");
+    handler.start();
+
+    for (int i = 0; i < 3000; ++i) {
+        handler.addWaypoint(static_cast<uint16_t>(i), "WPT" + std::to_string(i), 25.0, -80.0);
+    }
+    std::promise<void> released;
+    handler.whenTransmitted([&released] { released.set_value(); });
 
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
-        std::cout << "Added " << name << " in " << duration << " ms" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    handler.stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(3));
+    EXPECT_EQ(released.get_future().wait_for(std::chrono::seconds(0)), std::future_status::ready);
+}
 
+// Frames forwarded from a bridged bus share the paced queue, so
+// transmitted() waits until they are on the wire too.
+TEST_F(NMEAWaypointHandlerTest, TransmittedWaitsForBridgedFrames) {
+    VirtualN2kBus bus;
+    NMEAWaypointHandler handler(*syncManager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+    handler.start();
+
+    WaypointCollection collection;
+    Route &route = collection.addRoute("Out");
+    for (int i = 0; i < 8; ++i) {
+        route.legs.push_back(collection.add({0, "Leg " + std::to_string(i), 25.0 + i * 0.01, -80.0, "", 255}));
+    }
+    std::vector<tN2kMsg> messages = buildRouteMessages(collection.routes()[0], collection);
+    uint64_t expectedFrames = 0;
+    for (int copy = 0; copy < 4; ++copy) {
+        for (auto &msg : messages) {
+            msg.Destination = 255;
+            handler.forwardMessage(msg);
+            expectedFrames += framesForPayload(msg.DataLen);
+        }
     }
 
-    // Turn off Transmitting LED after waypoints are added
-    digitalWrite(TRANSMITTING_LED_PIN, LOW);
+    EventLoop loop;
+    uint64_t framesWhenDone = 0;
+    loop.spawn([](EventLoop &loop, NMEAWaypointHandler &handler, VirtualN2kBus &bus,
+                  uint64_t &framesWhenDone) -> Task<void> {
+        co_await handler.transmitted(loop);
+        framesWhenDone = bus.getStats().frames;
+    }(loop, handler, bus, framesWhenDone));
+    loop.run();
+
+    EXPECT_GE(framesWhenDone, expectedFrames);
+    handler.stop();
 }
 
-// Test for handling waypoint list message
-TEST_F(NMEAWaypointHandlerTest, HandlesWaypointListMessage) {
-    // Turn on Listening LED to indicate the message handler is being tested
-    digitalWrite(LISTENING_LED_PIN, HIGH);
-
+TEST_F(NMEAWaypointHandlerTest, QueuesWaypointsFromAWaypointListMessage) {
+    VirtualN2kBus bus;
+    NMEAWaypointHandler handler(*syncManager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+
+    tN2kMsg msg;
+    WaypointListPgn::encodeHeader(msg, 0, 0, 2, 0, {});
+    WaypointListPgn::appendItem(msg, 7, "Reef", 25.1, -80.3);
+    WaypointListPgn::appendItem(msg, 8, "Wreck", 25.2, -80.4);
+    msg.Source = 42;
+    handler.OnN2kMessage(msg);
+
+    std::vector<std::string> names;
+    Waypoint waypoint;
+    while (handler.getWaypointEvents().tryPop(waypoint)) {
+        EXPECT_EQ(waypoint.source, 42);
+        names.push_back(waypoint.name);
+    }
+    EXPECT_EQ(names, (std::vector<std::string>{"Reef", "Wreck"}));
+}
 
-    tN2kMsg receivedMsg;
-    receivedMsg.PGN = 130074;
+// Registering a vendor again replaces its decoders rather than adding a
+// second set that would queue every waypoint twice.
+TEST_F(NMEAWaypointHandlerTest, ReregisteringAVendorPluginReplacesItsDecoders) {
+    VirtualN2kBus bus;
+    NMEAWaypointHandler handler(*syncManager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+    size_t before = handler.getDispatcher().size();
+
+    VendorPlugin plugin{"Test", 999, {{65280, [](const tN2kMsg &, std::vector<Waypoint> &) {}},
+                                      {65281, [](const tN2kMsg &, std::vector<Waypoint> &) {}}}};
+    handler.registerVendorPlugin(plugin);
+    EXPECT_EQ(handler.getDispatcher().size(), before + 2);
+    plugin.pgns.pop_back();
+    handler.registerVendorPlugin(plugin);
+    EXPECT_EQ(handler.getDispatcher().size(), before + 1);
+    EXPECT_FALSE(handler.getDispatcher().handles(65281));
+}
 
-    nmeaHandler->OnN2kMessage(receivedMsg);
-    
-    // Turn off Listening LED after message handling is complete
-    digitalWrite(LISTENING_LED_PIN, LOW);
+// Proprietary frames are only received, and queued raw for the sync
+// worker, once capture is turned on.
+TEST_F(NMEAWaypointHandlerTest, CapturesProprietaryFramesOnlyWhenEnabled) {
+    VirtualN2kBus bus;
+    NMEAWaypointHandler handler(*syncManager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+    for (unsigned long pgn : proprietaryPgns()) {
+        EXPECT_FALSE(handler.getDispatcher().handles(pgn)) << pgn;
+    }
 
+    handler.enableProprietaryCapture();
+    for (unsigned long pgn : proprietaryPgns()) {
+        EXPECT_TRUE(handler.getDispatcher().handles(pgn)) << pgn;
+    }
+    EXPECT_TRUE(handler.getDispatcher().handles(WaypointListPgn::pgn));
 }
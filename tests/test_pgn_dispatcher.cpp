@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "pgn_dispatcher.h"
+#include "vendor_plugins.h"
+#include <algorithm>
+#include <vector>
+
+static tN2kMsg makeMessage(unsigned long pgn, unsigned char source) {
+    tN2kMsg msg;
+    msg.SetPGN(pgn);
+    msg.Source = source;
+    msg.DataLen = 1;
+    msg.Data[0] = 0;
+    return msg;
+}
+
+TEST(PgnDispatcherTest, RejectsUnregisteredPgns) {
+    PgnDispatcher dispatcher;
+    int calls = 0;
+    dispatcher.registerHandler(130074, PgnDispatcher::AnyManufacturer, [&](const tN2kMsg &) { ++calls; });
+
+    EXPECT_FALSE(dispatcher.dispatch(makeMessage(127488, 10)));  // engine rapid update
+    EXPECT_FALSE(dispatcher.dispatch(makeMessage(130075, 10)));
+    EXPECT_TRUE(dispatcher.dispatch(makeMessage(130074, 10)));
+    EXPECT_EQ(calls, 1);
+    EXPECT_TRUE(dispatcher.handles(130074));
+    EXPECT_FALSE(dispatcher.handles(129025));
+}
+
+TEST(PgnDispatcherTest, RoutesByManufacturerOfSource) {
+    PgnDispatcher dispatcher;
+    std::vector<std::string> seen;
+
+    dispatcher.registerHandler(126720, N2K_MANUFACTURER_GARMIN, [&](const tN2kMsg &) { seen.push_back("Garmin"); });
+    dispatcher.registerHandler(126720, N2K_MANUFACTURER_RAYMARINE, [&](const tN2kMsg &) { seen.push_back("Raymarine"); });
+    dispatcher.setManufacturerLookup([](unsigned char source) -> uint16_t {
+        return source == 5 ? N2K_MANUFACTURER_RAYMARINE : N2K_MANUFACTURER_GARMIN;
+    });
+
+    EXPECT_TRUE(dispatcher.dispatch(makeMessage(126720, 5)));
+    EXPECT_TRUE(dispatcher.dispatch(makeMessage(126720, 9)));
+    ASSERT_EQ(seen.size(), 2u);
+    EXPECT_EQ(seen[0], "Raymarine");
+    EXPECT_EQ(seen[1], "Garmin");
+}
+
+TEST(PgnDispatcherTest, ManufacturerLookupOnlyRunsForVendorEntries) {
+    PgnDispatcher dispatcher;
+    int lookups = 0;
+    dispatcher.registerHandler(130074, PgnDispatcher::AnyManufacturer, [](const tN2kMsg &) {});
+    dispatcher.registerHandler(126720, N2K_MANUFACTURER_NAVICO, [](const tN2kMsg &) {});
+    dispatcher.setManufacturerLookup([&](unsigned char) -> uint16_t {
+        ++lookups;
+        return PgnDispatcher::AnyManufacturer;
+    });
+
+    dispatcher.dispatch(makeMessage(130074, 1));
+    EXPECT_EQ(lookups, 0);
+    EXPECT_FALSE(dispatcher.dispatch(makeMessage(126720, 1)));
+    EXPECT_EQ(lookups, 1);
+}
+
+TEST(PgnDispatcherTest, UnregisteringAManufacturerLeavesTheRest) {
+    PgnDispatcher dispatcher;
+    std::vector<std::string> seen;
+    dispatcher.registerHandler(126720, N2K_MANUFACTURER_GARMIN, [&](const tN2kMsg &) { seen.push_back("old"); });
+    dispatcher.registerHandler(130842, N2K_MANUFACTURER_GARMIN, [&](const tN2kMsg &) { seen.push_back("old"); });
+    dispatcher.registerHandler(126720, N2K_MANUFACTURER_NAVICO, [&](const tN2kMsg &) { seen.push_back("Navico"); });
+    dispatcher.registerHandler(130074, PgnDispatcher::AnyManufacturer, [&](const tN2kMsg &) { seen.push_back("list"); });
+    dispatcher.setManufacturerLookup([](unsigned char source) -> uint16_t {
+        return source == 5 ? N2K_MANUFACTURER_NAVICO : N2K_MANUFACTURER_GARMIN;
+    });
+
+    dispatcher.unregisterManufacturer(N2K_MANUFACTURER_GARMIN);
+    dispatcher.registerHandler(126720, N2K_MANUFACTURER_GARMIN, [&](const tN2kMsg &) { seen.push_back("new"); });
+
+    EXPECT_TRUE(dispatcher.dispatch(makeMessage(126720, 9)));
+    EXPECT_FALSE(dispatcher.dispatch(makeMessage(130842, 9)));
+    EXPECT_FALSE(dispatcher.handles(130842));
+    EXPECT_TRUE(dispatcher.dispatch(makeMessage(126720, 5)));
+    EXPECT_TRUE(dispatcher.dispatch(makeMessage(130074, 9)));
+    EXPECT_EQ(seen, (std::vector<std::string>{"new", "Navico", "list"}));
+    EXPECT_EQ(dispatcher.size(), 3u);
+}
+
+TEST(PgnDispatcherTest, RegisteredPgnsAreSortedAndUnique) {
+    PgnDispatcher dispatcher;
+    VendorPluginRegistry registry = defaultVendorPlugins();
+    for (const auto &plugin : registry.plugins()) {
+        for (unsigned long pgn : proprietaryPgns()) {
+            dispatcher.registerHandler(pgn, plugin.manufacturerCode, [](const tN2kMsg &) {});
+        }
+    }
+    dispatcher.registerHandler(130074, PgnDispatcher::AnyManufacturer, [](const tN2kMsg &) {});
+
+    auto pgns = dispatcher.registeredPgns();
+    EXPECT_TRUE(std::is_sorted(pgns.begin(), pgns.end()));
+    EXPECT_EQ(std::adjacent_find(pgns.begin(), pgns.end()), pgns.end());
+    EXPECT_EQ(pgns.front(), 126720u);
+}
+
+TEST(VendorPluginRegistryTest, FindsVendorsByManufacturerCode) {
+    VendorPluginRegistry registry = defaultVendorPlugins();
+
+    ASSERT_NE(registry.findByManufacturer(N2K_MANUFACTURER_GARMIN), nullptr);
+    EXPECT_EQ(registry.findByManufacturer(N2K_MANUFACTURER_GARMIN)->name, "Garmin");
+    EXPECT_EQ(registry.findByManufacturer(N2K_MANUFACTURER_NAVICO)->name, "Lowrance");
+    EXPECT_EQ(registry.findByManufacturer(1), nullptr);
+
+    registry.add({"Simrad", N2K_MANUFACTURER_NAVICO, {}});
+    EXPECT_EQ(registry.findByManufacturer(N2K_MANUFACTURER_NAVICO)->name, "Simrad");
+}
+
+TEST(VendorPluginRegistryTest, ExtractsManufacturerFromName) {
+    uint64_t name = (uint64_t(N2K_MANUFACTURER_RAYMARINE) << 21) | 0x12345;
+    EXPECT_EQ(manufacturerCodeFromName(name), N2K_MANUFACTURER_RAYMARINE);
+}
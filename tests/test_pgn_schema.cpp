@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "pgn_schema.h"
+#include "waypoint_pgns.h"
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace pgn_schema;
+
+TEST(PgnSchemaTest, NumberFieldsRoundTrip) {
+    unsigned char buffer[8];
+
+    UInt<2>::write(buffer, 0x1234);
+    EXPECT_EQ(buffer[0], 0x34);
+    EXPECT_EQ(buffer[1], 0x12);
+    EXPECT_EQ(UInt<2>::read(buffer), 0x1234u);
+
+    Int<2>::write(buffer, -2);
+    EXPECT_EQ(Int<2>::read(buffer), -2);
+
+    using Latitude = Scaled<4, Resolution1e7>;
+    Latitude::write(buffer, -84.1234567);
+    EXPECT_DOUBLE_EQ(Latitude::read(buffer), -84.1234567);
+}
+
+TEST(PgnSchemaTest, NotAvailableValues) {
+    unsigned char buffer[8];
+    using Latitude = Scaled<4, Resolution1e7>;
+
+    Latitude::write(buffer, N2kDoubleNA);
+    EXPECT_EQ(buffer[0], 0xff);
+    EXPECT_EQ(buffer[3], 0x7f);
+    EXPECT_EQ(Latitude::read(buffer), N2kDoubleNA);
+
+    // 400 degrees does not fit in 32 bits at 1e-7 and must not wrap.
+    Latitude::write(buffer, 400.0);
+    EXPECT_EQ(Latitude::read(buffer), N2kDoubleNA);
+
+    UInt<2>::write(buffer, UInt<2>::na);
+    EXPECT_TRUE(UInt<2>::isNA(UInt<2>::read(buffer)));
+}
+
+TEST(PgnSchemaTest, WaypointListRoundTrip) {
+    tN2kMsg msg;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(msg, 10, 0, 2, 0, {}));
+    ASSERT_TRUE(WaypointListPgn::appendItem(msg, 10, "Dock", 34.1234567, -84.1234567));
+    ASSERT_TRUE(WaypointListPgn::appendItem(msg, 11, "Fuel", -33.5, 151.25));
+
+    EXPECT_EQ(msg.PGN, 130074u);
+    EXPECT_EQ(msg.DataLen, 10 + (2 + 6 + 8) * 2);
+
+    WaypointListPgn::View view(msg);
+    ASSERT_TRUE(view.isValid());
+    EXPECT_EQ(view.header<WaypointListField::StartId>(), 10u);
+    EXPECT_EQ(view.itemCount(), 2u);
+
+    std::vector<std::string> names;
+    std::vector<double> latitudes;
+    EXPECT_TRUE(view.forEachItem([&](const WaypointListPgn::ItemView &item) {
+        names.emplace_back(item.get<WaypointListItem::Name>());
+        latitudes.push_back(item.get<WaypointListItem::Latitude>());
+    }));
+
+    ASSERT_EQ(names.size(), 2u);
+    EXPECT_EQ(names[0], "Dock");
+    EXPECT_EQ(names[1], "Fuel");
+    EXPECT_DOUBLE_EQ(latitudes[0], 34.1234567);
+    EXPECT_DOUBLE_EQ(latitudes[1], -33.5);
+}
+
+TEST(PgnSchemaTest, EncodedItemsMatchAppendedOnes) {
+    tN2kMsg direct;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(direct, 10, 0, 1, 0, {}));
+    ASSERT_TRUE(WaypointListPgn::appendItem(direct, 10, "Dock", 34.1234567, -84.1234567));
+
+    std::vector<unsigned char> item;
+    WaypointListPgn::encodeItem(item, 10, "Dock", 34.1234567, -84.1234567);
+    EXPECT_EQ(item.size(), 2u + 6 + 8);
+    tN2kMsg cached;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(cached, 10, 0, 1, 0, {}));
+    ASSERT_TRUE(WaypointListPgn::appendEncodedItem(cached, item));
+
+    ASSERT_EQ(cached.DataLen, direct.DataLen);
+    EXPECT_EQ(std::memcmp(cached.Data, direct.Data, direct.DataLen), 0);
+    EXPECT_EQ(WaypointListPgn::View(cached).itemCount(), 1u);
+}
+
+TEST(PgnSchemaTest, AppendStopsWhenMessageIsFull) {
+    tN2kMsg msg;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(msg, 0, 0, 0, 0, {}));
+
+    std::string name(32, 'W');
+    size_t appended = 0;
+    while (WaypointListPgn::appendItem(msg, static_cast<uint16_t>(appended), name, 1.0, 2.0)) {
+        ++appended;
+    }
+
+    const int maxDataLen = tN2kMsg::MaxDataLen;
+    EXPECT_EQ(appended, static_cast<size_t>((maxDataLen - 10) / (2 + 34 + 8)));
+    EXPECT_LE(msg.DataLen, maxDataLen);
+    EXPECT_EQ(WaypointListPgn::View(msg).itemCount(), appended);
+}
+
+TEST(PgnSchemaTest, LongNamesAreCutAtFieldLimit) {
+    tN2kMsg msg;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(msg, 0, 0, 1, 0, {}));
+    ASSERT_TRUE(WaypointListPgn::appendItem(msg, 1, std::string(50, 'x'), 1.0, 2.0));
+
+    WaypointListPgn::View view(msg);
+    view.forEachItem([](const WaypointListPgn::ItemView &item) {
+        EXPECT_EQ(item.get<WaypointListItem::Name>().size(), 32u);
+    });
+}
+
+TEST(PgnSchemaTest, RejectsTruncatedMessages) {
+    tN2kMsg msg;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(msg, 0, 0, 1, 0, {}));
+    ASSERT_TRUE(WaypointListPgn::appendItem(msg, 1, "Reef", 1.0, 2.0));
+
+    msg.DataLen -= 3;
+    WaypointListPgn::View view(msg);
+    ASSERT_TRUE(view.isValid());
+    EXPECT_FALSE(view.forEachItem([](const WaypointListPgn::ItemView &) {}));
+
+    msg.DataLen = 4;
+    EXPECT_FALSE(WaypointListPgn::View(msg).isValid());
+
+    msg.DataLen = 20;
+    msg.PGN = 129285;
+    EXPECT_FALSE(WaypointListPgn::View(msg).isValid());
+}
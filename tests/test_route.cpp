@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "gpx_io.h"
+#include "route.h"
+#include "waypoint_pgns.h"
+#include <string>
+
+static const char *sampleGpx = R"(<?xml version="1.0" encoding="UTF-8"?>
+<gpx version="1.1" creator="test">
+  <!-- <wpt lat="1" lon="1"><name>Commented</name></wpt> -->
+  <wpt lat="34.1234567" lon="-84.1234567"><name>Dock</name><sym>Anchor</sym></wpt>
+  <wpt lon='-84.2' lat='34.2'><name>Fuel &amp; Ice</name></wpt>
+  <rte>
+    <name>Evening run</name>
+    <rtept lat="34.1234567" lon="-84.1234567"><name>Dock</name></rtept>
+    <rtept lat="34.3" lon="-84.3"><name>Point</name></rtept>
+    <rtept lat="34.1234567" lon="-84.1234567"><name>Dock</name></rtept>
+  </rte>
+</gpx>
+)";
+
+TEST(RouteTest, ParsesWaypointsAndRoutesFromGpx) {
+    WaypointCollection collection;
+    ASSERT_TRUE(parseGpx(sampleGpx, collection));
+
+    ASSERT_EQ(collection.waypoints().size(), 3u);
+    EXPECT_EQ(collection.at(0).name, "Dock");
+    EXPECT_EQ(collection.at(0).symbol, "Anchor");
+    EXPECT_DOUBLE_EQ(collection.at(0).latitude, 34.1234567);
+    EXPECT_EQ(collection.at(1).name, "Fuel & Ice");
+    EXPECT_DOUBLE_EQ(collection.at(1).longitude, -84.2);
+
+    ASSERT_EQ(collection.routes().size(), 1u);
+    const Route &route = collection.routes()[0];
+    EXPECT_EQ(route.name, "Evening run");
+    // The route reuses the shared Dock waypoint instead of copying it.
+    ASSERT_EQ(route.legs.size(), 3u);
+    EXPECT_EQ(route.legs[0], 0u);
+    EXPECT_EQ(route.legs[1], 2u);
+    EXPECT_EQ(route.legs[2], 0u);
+}
+
+TEST(RouteTest, GpxRoundTripPreservesRoutes) {
+    WaypointCollection original;
+    ASSERT_TRUE(parseGpx(sampleGpx, original));
+
+    WaypointCollection reloaded;
+    ASSERT_TRUE(parseGpx(formatGpx(original), reloaded));
+
+    ASSERT_EQ(reloaded.waypoints().size(), original.waypoints().size());
+    for (size_t i = 0; i < original.waypoints().size(); ++i) {
+        EXPECT_EQ(reloaded.at(i).name, original.at(i).name);
+        EXPECT_EQ(reloaded.at(i).symbol, original.at(i).symbol);
+        EXPECT_NEAR(reloaded.at(i).latitude, original.at(i).latitude, 1e-9);
+        EXPECT_NEAR(reloaded.at(i).longitude, original.at(i).longitude, 1e-9);
+    }
+    ASSERT_EQ(reloaded.routes().size(), 1u);
+    EXPECT_EQ(reloaded.routes()[0].name, "Evening run");
+    EXPECT_EQ(reloaded.routes()[0].legs, original.routes()[0].legs);
+}
+
+TEST(RouteTest, LargeRouteFitsInAHandfulOfMessages) {
+    WaypointCollection collection;
+    Route &route = collection.addRoute("Delivery");
+    for (int i = 0; i < 200; ++i) {
+        Waypoint waypoint;
+        waypoint.name = "R" + std::to_string(i);
+        waypoint.latitude = 25.0 + i * 0.01;
+        waypoint.longitude = -80.0;
+        route.legs.push_back(collection.add(waypoint));
+    }
+
+    auto messages = buildRouteMessages(collection.routes()[0], collection);
+    ASSERT_FALSE(messages.empty());
+    EXPECT_LT(messages.size(), 20u);
+
+    size_t expectedStart = 0;
+    for (const auto &msg : messages) {
+        RouteWaypointPgn::View view(msg);
+        ASSERT_TRUE(view.isValid());
+        EXPECT_EQ(msg.PGN, 129285u);
+        EXPECT_EQ(view.header<RouteWaypointField::StartRps>(), expectedStart);
+        EXPECT_EQ(view.header<RouteWaypointField::RouteName>(), "Delivery");
+
+        size_t item = 0;
+        EXPECT_TRUE(view.forEachItem([&](const RouteWaypointPgn::ItemView &entry) {
+            const Waypoint &waypoint = collection.at(collection.routes()[0].legs[expectedStart + item]);
+            EXPECT_EQ(entry.get<RouteWaypointItem::Name>(), waypoint.name);
+            EXPECT_NEAR(entry.get<RouteWaypointItem::Latitude>(), waypoint.latitude, 1e-7);
+            ++item;
+        }));
+        expectedStart += view.itemCount();
+    }
+    EXPECT_EQ(expectedStart, 200u);
+}
+
+TEST(RouteTest, EmptyRouteStillAnnouncesItself) {
+    WaypointCollection collection;
+    collection.addRoute("Empty");
+
+    auto messages = buildRouteMessages(collection.routes()[0], collection);
+    ASSERT_EQ(messages.size(), 1u);
+    EXPECT_EQ(RouteWaypointPgn::View(messages[0]).itemCount(), 0u);
+}
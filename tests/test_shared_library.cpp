@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include "library_publisher.h"
+#include "shared_library.h"
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Unique per run so parallel test runs do not share a segment.
+std::string shmName() {
+    return "/waypoint_sync_test_" + std::to_string(getpid());
+}
+
+std::string socketPath() {
+    return "@waypoint_sync_test_" + std::to_string(getpid());
+}
+
+std::vector<Waypoint> makeWaypoints(size_t count, const std::string &prefix = "WPT") {
+    std::vector<Waypoint> waypoints(count);
+    for (size_t i = 0; i < count; ++i) {
+        waypoints[i].id = static_cast<uint16_t>(i + 1);
+        waypoints[i].name = prefix + std::to_string(i);
+        waypoints[i].latitude = 24.5 + i * 0.001;
+        waypoints[i].longitude = -81.25 - i * 0.001;
+        waypoints[i].symbol = i % 2 ? "Anchor" : "Wreck";
+        waypoints[i].source = static_cast<uint8_t>(i % 3);
+    }
+    return waypoints;
+}
+
+} // namespace
+
+TEST(SharedLibraryTest, ReaderSeesPublishedSet) {
+    LibraryPublisher publisher(shmName(), "");
+    ASSERT_TRUE(publisher.start());
+    SharedLibraryReader reader(shmName());
+    ASSERT_TRUE(reader.open());
+
+    std::vector<Waypoint> copy;
+    uint64_t revision = 99;
+    ASSERT_TRUE(reader.snapshot(copy, &revision));
+    EXPECT_TRUE(copy.empty());
+    EXPECT_EQ(revision, 0u);
+
+    std::vector<Waypoint> waypoints = makeWaypoints(10);
+    waypoints[3].latitude = std::nan("");
+    ASSERT_TRUE(publisher.publish(waypoints, 7));
+    EXPECT_EQ(reader.revision(), 7u);
+    ASSERT_TRUE(reader.snapshot(copy, &revision));
+    EXPECT_EQ(revision, 7u);
+    ASSERT_EQ(copy.size(), waypoints.size());
+    for (size_t i = 0; i < copy.size(); ++i) {
+        EXPECT_EQ(copy[i].id, waypoints[i].id);
+        EXPECT_EQ(copy[i].name, waypoints[i].name);
+        EXPECT_EQ(copy[i].symbol, waypoints[i].symbol);
+        EXPECT_EQ(copy[i].source, waypoints[i].source);
+        if (i == 3) {
+            EXPECT_TRUE(std::isnan(copy[i].latitude));
+        } else {
+            EXPECT_NEAR(copy[i].latitude, waypoints[i].latitude, 1e-7);
+        }
+        EXPECT_NEAR(copy[i].longitude, waypoints[i].longitude, 1e-7);
+    }
+}
+
+TEST(SharedLibraryTest, ReaderInReusedBufferSeesTornPass) {
+    LibraryPublisher publisher(shmName(), "");
+    ASSERT_TRUE(publisher.start());
+    ASSERT_TRUE(publisher.publish(makeWaypoints(5), 1));
+    SharedLibraryReader reader(shmName());
+    ASSERT_TRUE(reader.open());
+
+    // One publish goes to the other buffer and leaves this pass alone; the
+    // second reuses the buffer being read.
+    int visits = 0;
+    EXPECT_TRUE(reader.forEach([&](const SharedWaypointView &) {
+        if (visits++ == 0) {
+            publisher.publish(makeWaypoints(5, "A"), 2);
+        }
+    }));
+    visits = 0;
+    EXPECT_FALSE(reader.forEach([&](const SharedWaypointView &) {
+        if (visits++ == 0) {
+            publisher.publish(makeWaypoints(5, "B"), 3);
+            publisher.publish(makeWaypoints(5, "C"), 4);
+        }
+    }));
+
+    std::vector<Waypoint> copy;
+    uint64_t revision = 0;
+    ASSERT_TRUE(reader.snapshot(copy, &revision));
+    EXPECT_EQ(revision, 4u);
+    EXPECT_EQ(copy[0].name, "C0");
+}
+
+TEST(SharedLibraryTest, ReaderFollowsSegmentGrowth) {
+    LibraryPublisher publisher(shmName(), "");
+    ASSERT_TRUE(publisher.start());
+    ASSERT_TRUE(publisher.publish(makeWaypoints(3), 1));
+    SharedLibraryReader reader(shmName());
+    ASSERT_TRUE(reader.open());
+    EXPECT_EQ(reader.revision(), 1u);
+
+    std::vector<Waypoint> large = makeWaypoints(5000);
+    ASSERT_TRUE(publisher.publish(large, 2));
+
+    std::vector<Waypoint> copy;
+    ASSERT_TRUE(reader.snapshot(copy));
+    ASSERT_EQ(copy.size(), large.size());
+    EXPECT_EQ(copy.back().name, large.back().name);
+
+    publisher.stop();
+    EXPECT_FALSE(reader.snapshot(copy));
+}
+
+// Readers attaching while the segment grows never see a revision paired
+// with anything but the set published under it.
+TEST(SharedLibraryTest, ReaderAttachingDuringGrowthSeesAFilledSegment) {
+    LibraryPublisher publisher(shmName(), "");
+    ASSERT_TRUE(publisher.start());
+    auto countFor = [](uint64_t revision) { return revision == 0 ? 0 : size_t(1100) << (revision - 1); };
+
+    std::atomic<bool> done{false};
+    std::atomic<int> attached{0};
+    std::atomic<int> mismatched{0};
+    std::thread attacher([&] {
+        std::vector<Waypoint> copy;
+        while (!done) {
+            SharedLibraryReader reader(shmName());
+            uint64_t revision = 0;
+            if (reader.open() && reader.snapshot(copy, &revision)) {
+                ++attached;
+                if (copy.size() != countFor(revision)) {
+                    ++mismatched;
+                }
+            }
+        }
+    });
+    for (uint64_t revision = 1; revision <= 7; ++revision) {
+        ASSERT_TRUE(publisher.publish(makeWaypoints(countFor(revision)), revision));
+    }
+    done = true;
+    attacher.join();
+    EXPECT_GT(attached, 0);
+    EXPECT_EQ(mismatched, 0);
+}
+
+TEST(SharedLibraryTest, SubscriberIsNotifiedOfChanges) {
+    LibraryPublisher publisher(shmName(), socketPath());
+    ASSERT_TRUE(publisher.start());
+    SharedLibraryReader reader(shmName());
+    ASSERT_TRUE(reader.open());
+    ASSERT_GE(reader.subscribe(socketPath()), 0);
+
+    // Signalled once on subscribe, then once per publish.
+    EXPECT_TRUE(reader.waitForChange(2000));
+    EXPECT_EQ(publisher.subscriberCount(), 1u);
+    EXPECT_FALSE(reader.waitForChange(0));
+    ASSERT_TRUE(publisher.publish(makeWaypoints(2), 5));
+    EXPECT_TRUE(reader.waitForChange(2000));
+    EXPECT_EQ(reader.revision(), 5u);
+
+    reader.close();
+    for (int i = 0; i < 200 && publisher.subscriberCount() > 0; ++i) {
+        usleep(5000);
+    }
+    EXPECT_EQ(publisher.subscriberCount(), 0u);
+}
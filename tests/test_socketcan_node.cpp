@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "socketcan_node.h"
+#include <chrono>
+#include <thread>
+
+// Builds a 29-bit NMEA 2000 CAN id the way the library does.
+static canid_t frameId(unsigned long pgn, unsigned char source, unsigned char destination = 255, unsigned char priority = 3) {
+    unsigned long id = (static_cast<unsigned long>(priority) << 26) | (pgn << 8) | source;
+    if (((pgn >> 8) & 0xff) < 240) {
+        id = (id & ~0xff00UL) | (static_cast<unsigned long>(destination) << 8);
+    }
+    return static_cast<canid_t>(id) | CAN_EFF_FLAG;
+}
+
+// Same test the kernel's raw socket applies.
+static bool accepted(const std::vector<can_filter> &filters, canid_t id) {
+    for (const auto &filter : filters) {
+        if ((id & filter.can_mask) == (filter.can_id & filter.can_mask)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(SocketCanNodeTest, FiltersPassHandledPgnsAndNetworkManagement) {
+    const unsigned long waypointList = 130074;
+    const unsigned long rapidPosition = 129025;
+    auto filters = canFiltersForPgns({waypointList, rapidPosition, waypointList});
+    EXPECT_EQ(filters.size(), 2 + networkManagementPgns().size());
+
+    EXPECT_TRUE(accepted(filters, frameId(waypointList, 17)));
+    EXPECT_TRUE(accepted(filters, frameId(waypointList, 200, 255, 6)));
+    EXPECT_TRUE(accepted(filters, frameId(rapidPosition, 3)));
+    for (unsigned long pgn : networkManagementPgns()) {
+        EXPECT_TRUE(accepted(filters, frameId(pgn, 42))) << pgn;
+    }
+}
+
+TEST(SocketCanNodeTest, FiltersDropUnrelatedTraffic) {
+    auto filters = canFiltersForPgns({130074});
+
+    EXPECT_FALSE(accepted(filters, frameId(127488, 10)));  // Engine rapid update
+    EXPECT_FALSE(accepted(filters, frameId(130312, 10)));  // Temperature
+    EXPECT_FALSE(accepted(filters, frameId(130075, 10)));  // Neighbouring PGN
+    // Same PGN bits but a standard or remote frame.
+    EXPECT_FALSE(accepted(filters, frameId(130074, 10) & ~CAN_EFF_FLAG));
+    EXPECT_FALSE(accepted(filters, frameId(130074, 10) | CAN_RTR_FLAG));
+}
+
+TEST(SocketCanNodeTest, Pdu1FiltersIgnoreDestination) {
+    // 59904 and 60928 are PDU1: the PS byte carries the destination.
+    auto filters = canFiltersForPgns({});
+    for (unsigned char destination : {0, 25, 254, 255}) {
+        EXPECT_TRUE(accepted(filters, frameId(59904, 1, destination))) << int(destination);
+        EXPECT_TRUE(accepted(filters, frameId(60928, 1, destination))) << int(destination);
+    }
+    // A different PDU1 PF must not sneak through on a destination byte.
+    EXPECT_FALSE(accepted(filters, frameId(61184, 1, 0xea)));
+}
+
+TEST(SocketCanNodeTest, WakeInterruptsWait) {
+    SocketCanNode node("waypoint_sync_test0");
+    EXPECT_FALSE(node.isOpen());
+
+    auto started = std::chrono::steady_clock::now();
+    std::thread waker([&node] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        node.wake();
+    });
+    EXPECT_FALSE(node.waitForFrames(5000));
+    waker.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(2));
+
+    // The wake-up was consumed: the next wait runs to its timeout.
+    started = std::chrono::steady_clock::now();
+    EXPECT_FALSE(node.waitForFrames(50));
+    EXPECT_GE(std::chrono::steady_clock::now() - started, std::chrono::milliseconds(40));
+}
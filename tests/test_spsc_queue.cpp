@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "spsc_queue.h"
+#include "waypoint.h"
+#include <thread>
+#include <vector>
+
+TEST(SpscQueueTest, PushPopPreservesOrder) {
+    SpscQueue<int, 8> queue;
+
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(queue.tryPush(i));
+    }
+
+    int value = -1;
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_TRUE(queue.tryPop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.tryPop(value));
+}
+
+TEST(SpscQueueTest, RejectsPushWhenFull) {
+    SpscQueue<int, 4> queue;
+
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.tryPush(i));
+    }
+    EXPECT_FALSE(queue.tryPush(99));
+
+    int value = -1;
+    ASSERT_TRUE(queue.tryPop(value));
+    EXPECT_TRUE(queue.tryPush(99));
+}
+
+TEST(SpscQueueTest, PopBatchTakesAtMostMaxItems) {
+    SpscQueue<Waypoint, 16> queue;
+
+    for (int i = 0; i < 10; ++i) {
+        Waypoint waypoint;
+        waypoint.name = "WP" + std::to_string(i);
+        ASSERT_TRUE(queue.tryPush(std::move(waypoint)));
+    }
+
+    std::vector<Waypoint> batch;
+    EXPECT_EQ(queue.popBatch(batch, 4), 4u);
+    EXPECT_EQ(queue.popBatch(batch, 64), 6u);
+    ASSERT_EQ(batch.size(), 10u);
+    EXPECT_EQ(batch.front().name, "WP0");
+    EXPECT_EQ(batch.back().name, "WP9");
+    EXPECT_EQ(queue.popBatch(batch, 64), 0u);
+}
+
+// One producer thread, one consumer thread, every item delivered exactly once
+// and in order.
+TEST(SpscQueueTest, DeliversEverythingAcrossThreads) {
+    SpscQueue<int, 64> queue;
+    const int total = 200000;
+
+    std::thread producer([&] {
+        for (int i = 0; i < total; ++i) {
+            while (!queue.tryPush(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<int> batch;
+    int expected = 0;
+    while (expected < total) {
+        batch.clear();
+        if (queue.popBatch(batch, 32) == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (int value : batch) {
+            ASSERT_EQ(value, expected);
+            ++expected;
+        }
+    }
+    producer.join();
+    EXPECT_EQ(queue.sizeApprox(), 0u);
+}
@@ -1,112 +1,702 @@
 #include <gtest/gtest.h>
-#include <gmock/gmock.h>
 #include "../src/sync_manager.h"
 #include "NMEA2000.h"
-#include "mock_nmea2000.h"
+#include "gpx_io.h"
+#include "simulated_plotter.h"
+#include "track.h"
+#include "virtual_n2k_bus.h"
+#include "waypoint_converter.h"
+#include "waypoint_pgns.h"
 #include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <poll.h>
+#include <pty.h>
+#include <set>
+#include <termios.h>
 #include <thread>
 
 namespace fs = std::filesystem;
 
-// Utility function to create or modify a test file
-void modifyTestFile(const std::string &path) {
-    fs::remove(path);
-    std::ofstream file(path);
-    file << "Waypoint test data" << std::endl;
-    file.close();
+// A config in a scratch directory: no CAN bus, no shared-memory export and
+// nothing outside the directory, logs included.
+static std::string writeScratchConfig(const fs::path &dir, const std::string &extraSections = "",
+                                      const std::string &extraDeviceSettings = "") {
+    fs::create_directories(dir / "watch");
+    std::ofstream config(dir / "config.json");
+    config << "{\"paths\": {\"watch_directory\": \"" << (dir / "watch").string() << "\", "
+           << "\"waypoints_file\": \"" << (dir / "waypoints.json").string() << "\", "
+           << "\"log_directory\": \"" << (dir / "logs").string() << "\", "
+           << "\"track_output_directory\": \"" << (dir / "tracks").string() << "\"}, "
+           << "\"device_settings\": {" << extraDeviceSettings << "\"can_interfaces\": [], \"media_mount_prefixes\": []}, "
+           << extraSections << "\"library_export\": {\"shm_name\": \"\"}}";
+    return (dir / "config.json").string();
+}
 
-    // Ensure the file modification time is updated by adding a slight delay
-    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+static fs::path makeScratchDirectory() {
+    std::string pattern = (fs::temp_directory_path() / "sync_manager_test_XXXXXX").string();
+    return fs::path(mkdtemp(pattern.data()));
 }
 
-// Mock class for NMEAWaypointHandler
-class MockNMEAWaypointHandler : public NMEAWaypointHandler {
-public:
-    MockNMEAWaypointHandler(SyncManager& sm)
-        : NMEAWaypointHandler(sm, std::make_unique<MockNMEA2000>()) {
-        enableMockMode({"Garmin", "Lowrance"});
+// Reads CRLF terminated sentences from fd until count have arrived or
+// the timeout passes.
+static std::vector<std::string> readSentences(int fd, size_t count, int timeoutMs) {
+    std::vector<std::string> sentences;
+    std::string buffered;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (sentences.size() < count && std::chrono::steady_clock::now() < deadline) {
+        pollfd readFd{fd, POLLIN, 0};
+        if (poll(&readFd, 1, 50) <= 0) {
+            continue;
+        }
+        char data[1024];
+        ssize_t n = read(fd, data, sizeof(data));
+        if (n <= 0) {
+            break;
+        }
+        buffered.append(data, static_cast<size_t>(n));
+        for (size_t end; (end = buffered.find("\r\n")) != std::string::npos;) {
+            sentences.push_back(buffered.substr(0, end));
+            buffered.erase(0, end + 2);
+        }
     }
+    return sentences;
+}
 
-    MOCK_METHOD(void, addWaypoint, (uint16_t waypointID, const std::string &name, double latitude, double longitude), ());
-    MOCK_METHOD(const std::vector<std::string>&, getDetectedDevices, (), ());
-    MOCK_METHOD(void, start, (), ());
-};
-
-// Define a fixture for SyncManager tests
+// Every test gets its own scratch directory and a manager built from it,
+// as the daemon builds one from config.json.
 class SyncManagerTest : public ::testing::Test {
 protected:
-    std::shared_ptr<MockNMEAWaypointHandler> mockNmeaHandler;
-    SyncManager syncManager;
+    fs::path dir;
+    std::unique_ptr<SyncManager> syncManager;
 
-    SyncManagerTest() : mockNmeaHandler(std::make_shared<MockNMEAWaypointHandler>(syncManager)) {
-        syncManager.setNMEAHandler(mockNmeaHandler);
-        syncManager.initialize();
+    void SetUp() override {
+        dir = makeScratchDirectory();
+        syncManager = std::make_unique<SyncManager>(
+            std::make_shared<ConfigStore>(writeScratchConfig(dir, "", "\"polling_interval\": 10, ")));
+        syncManager->clearFileTimestamps();
     }
 
-    void SetUp() override {
-        syncManager.clearFileTimestamps();
+    void TearDown() override {
+        syncManager.reset();
+        fs::remove_all(dir);
+    }
+
+    void writeWatchedFile(const std::string &name) {
+        std::ofstream file(dir / "watch" / name);
+        file << "Waypoint test data" << std::endl;
     }
 };
 
-// Test inotify-based change detection
+// The constructor watches the configured directory.
 TEST_F(SyncManagerTest, DetectsInotifyChanges) {
-    std::string testDir = "/home/blake/waypoint_sync_test_dir";
-    std::string testFilePath = testDir + "/test_waypoint_change.gpx";
+    writeWatchedFile("change.txt");
 
-    // Create test directory and file
-    fs::create_directory(testDir);
-    modifyTestFile(testFilePath);
+    syncManager->checkForChanges();
+    EXPECT_TRUE(syncManager->isInotifyChangeDetected());
 
-    // Add watch on the temporary directory
-    syncManager.addWatch(testDir);
+    syncManager->resetChangeFlags();
+    EXPECT_FALSE(syncManager->isInotifyChangeDetected());
+}
 
-    // Simulate a file change to trigger inotify
-    modifyTestFile(testFilePath);
+// Without inotify the watch directory is polled by modification time.
+TEST_F(SyncManagerTest, DetectsPollingChanges) {
+    close(syncManager->getInotifyFdForTesting());
+    syncManager->setInotifyFdForTesting(-1);
+    writeWatchedFile("change.txt");
 
-    // Check if inotify detected the change
-    syncManager.checkForChanges();
-    EXPECT_TRUE(syncManager.isInotifyChangeDetected());
+    syncManager->checkForChanges();
+    EXPECT_TRUE(syncManager->isPollChangeDetected());
 
-    // Reset flags and ensure inotify is cleared
-    syncManager.resetChangeFlags();
-    EXPECT_FALSE(syncManager.isInotifyChangeDetected());
+    // Unchanged since the last poll.
+    syncManager->resetChangeFlags();
+    syncManager->checkForChanges();
+    EXPECT_FALSE(syncManager->isPollChangeDetected());
+}
+
+// Building a manager from a config opens its 0183 outputs and starts the
+// sync worker that drains the buses; no CAN interfaces means no handlers.
+TEST(SyncManagerConstructionTest, OpensConfiguredOutputsAndStartsTheSyncWorker) {
+    fs::path dir = makeScratchDirectory();
+    {
+        termios raw{};
+        cfmakeraw(&raw);
+        int master = -1;
+        int slave = -1;
+        char slaveName[256];
+        ASSERT_EQ(openpty(&master, &slave, slaveName, &raw, nullptr), 0);
+        std::string outputs = std::string("\"nmea0183_outputs\": [{\"type\": \"serial\", \"device\": \"") + slaveName +
+                              "\", \"baud\": 38400}], ";
+        SyncManager manager(std::make_shared<ConfigStore>(writeScratchConfig(dir, outputs)));
+        EXPECT_TRUE(manager.getNmeaHandlers().empty());
+
+        VirtualN2kBus bus;
+        SimulatedPlotter plotter(bus, PlotterProfile::garmin(3, 40));
+        ASSERT_TRUE(plotter.open());
+        auto handler = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+        manager.addNMEAHandler(handler);
+        handler->start();
 
-    // Clean up
-    fs::remove(testFilePath);
-    fs::remove(testDir);
+        // Heard on the bus, merged by the worker, sent on to the output.
+        plotter.setWaypoint({1, "Channel Marker", 41.50, -71.30, "", 255});
+        ASSERT_GT(plotter.broadcastWaypoints(), 0u);
+        std::vector<std::string> sentences = readSentences(master, 1, 3000);
+        ASSERT_EQ(sentences.size(), 1u);
+        EXPECT_EQ(sentences[0].rfind("$GPWPL,", 0), 0u) << sentences[0];
+        EXPECT_NE(sentences[0].find("Channel Marker"), std::string::npos) << sentences[0];
+        EXPECT_EQ(handler->getDroppedWaypointEvents(), 0u);
+
+        handler->stop();
+        close(master);
+        close(slave);
+    }
+    fs::remove_all(dir);
 }
 
-// Test polling-based change detection
-TEST_F(SyncManagerTest, DetectsPollingChanges) {
-    std::string testDir = "/home/blake/waypoint_sync_test_dir";
-    std::string testFilePath = testDir + "/test_waypoint_change.gpx";
+// Card and SSD imports reach 0183 plotters from their own selection, even
+// with no NMEA 2000 bus at all.
+TEST(SyncManagerOutputsTest, FileImportsReachNmea0183OutputsWithoutAnN2kBus) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(writeScratchConfig(dir)));
+        EXPECT_TRUE(manager.getNmeaHandlers().empty());
+
+        termios raw{};
+        cfmakeraw(&raw);
+        int master = -1;
+        int slave = -1;
+        ASSERT_EQ(openpty(&master, &slave, nullptr, &raw, nullptr), 0);
+        auto output = std::make_shared<Nmea0183Output>();
+        ASSERT_TRUE(output->openFd(slave, 0));
+        manager.addNmea0183Output(output);
+
+        WaypointCollection collection;
+        collection.add({0, "Reef", 25.1, -80.3, "", 255});
+        collection.add({0, "Wreck", 25.2, -80.4, "", 255});
+        collection.add({0, "Inlet", 25.3, -80.5, "", 255});
+        std::string path = (dir / "card.gpx").string();
+        ASSERT_TRUE(writeGpxFile(path, collection));
+        ASSERT_TRUE(manager.importWaypointFile(path, "gpx"));
+
+        std::vector<std::string> sentences = readSentences(master, 3, 2000);
+        ASSERT_EQ(sentences.size(), 3u);
+        std::vector<std::string> names;
+        for (const auto &sentence : sentences) {
+            EXPECT_EQ(sentence.rfind("$GPWPL,", 0), 0u) << sentence;
+            size_t star = sentence.find('*');
+            names.push_back(sentence.substr(sentence.rfind(',', star) + 1, star - sentence.rfind(',', star) - 1));
+        }
+        std::sort(names.begin(), names.end());
+        EXPECT_EQ(names, (std::vector<std::string>{"Inlet", "Reef", "Wreck"}));
+        close(master);
+    }
+    fs::remove_all(dir);
+}
+
+// A first sync bigger than an output's queue limit still arrives in full:
+// what does not fit is offered again once the output has caught up.
+TEST(SyncManagerOutputsTest, SetsLargerThanTheOutputQueueArriveInFull) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(
+            writeScratchConfig(dir, "\"waypoint_selection\": {\"default_capacity\": 2500}, ")));
+
+        termios raw{};
+        cfmakeraw(&raw);
+        int master = -1;
+        int slave = -1;
+        ASSERT_EQ(openpty(&master, &slave, nullptr, &raw, nullptr), 0);
+        auto output = std::make_shared<Nmea0183Output>();
+        ASSERT_TRUE(output->openFd(slave, 0));
+        manager.addNmea0183Output(output);
 
-    // Create test directory and file
-    fs::create_directory(testDir);
-    modifyTestFile(testFilePath);
+        const size_t count = 2500;
+        WaypointCollection collection;
+        for (size_t i = 0; i < count; ++i) {
+            collection.add({0, "Survey Mark " + std::to_string(i), 25.0 + i * 0.0001, -80.0, "", 255});
+        }
+        std::string path = (dir / "survey.gpx").string();
+        ASSERT_TRUE(writeGpxFile(path, collection));
+        ASSERT_TRUE(manager.importWaypointFile(path, "gpx"));
+
+        std::vector<std::string> sentences = readSentences(master, count, 10000);
+        size_t bytes = 0;
+        std::set<std::string> names;
+        for (const auto &sentence : sentences) {
+            bytes += sentence.size() + 2;
+            size_t star = sentence.find('*');
+            names.insert(sentence.substr(sentence.rfind(',', star) + 1, star - sentence.rfind(',', star) - 1));
+        }
+        EXPECT_GT(bytes, 96u * 1024);
+        EXPECT_EQ(names.size(), count);
+        close(master);
+    }
+    fs::remove_all(dir);
+}
 
-    // Disable inotify by closing its file descriptor
-    close(syncManager.getInotifyFdForTesting());
-    syncManager.setInotifyFdForTesting(-1);
+// The import merges off the loop thread and the sync waits out 0183 pacing
+// on timers, so other tasks keep running the whole time.
+TEST(SyncManagerOutputsTest, AsyncImportAndSyncKeepTheLoopResponsive) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(writeScratchConfig(dir)));
 
-    // Simulate a file change to trigger polling
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // Wait for polling interval
-    modifyTestFile(testFilePath);
+        termios raw{};
+        cfmakeraw(&raw);
+        int master = -1;
+        int slave = -1;
+        ASSERT_EQ(openpty(&master, &slave, nullptr, &raw, nullptr), 0);
+        auto output = std::make_shared<Nmea0183Output>();
+        ASSERT_TRUE(output->openFd(slave, 38400));
+        manager.addNmea0183Output(output);
 
-    // Check if polling detected the change
-    syncManager.checkForChanges();
-    EXPECT_TRUE(syncManager.isPollChangeDetected());
+        WaypointCollection collection;
+        for (int i = 0; i < 100; ++i) {
+            collection.add({0, "WPT" + std::to_string(i), 25.0 + i * 0.01, -80.0, "", 255});
+        }
+        std::string path = (dir / "ssd.gpx").string();
+        ASSERT_TRUE(writeGpxFile(path, collection));
+
+        std::vector<std::string> sentences;
+        std::thread reader([&] { sentences = readSentences(master, 100, 5000); });
+
+        using Clock = std::chrono::steady_clock;
+        EventLoop loop;
+        bool done = false;
+        int ticks = 0;
+        Clock::duration importTime{}, syncTime{};
+        loop.spawn([](EventLoop &loop, SyncManager &manager, std::string path, bool &done,
+                      Clock::duration &importTime, Clock::duration &syncTime) -> Task<void> {
+            auto start = Clock::now();
+            co_await manager.importWaypointFileAsync(loop, path, "gpx");
+            importTime = Clock::now() - start;
+            co_await manager.syncWaypointsAcrossDevicesAsync(loop);
+            syncTime = Clock::now() - start;
+            done = true;
+        }(loop, manager, path, done, importTime, syncTime));
+        loop.spawn([](EventLoop &loop, bool &done, int &ticks) -> Task<void> {
+            while (!done) {
+                co_await loop.sleepFor(std::chrono::milliseconds(20));
+                ++ticks;
+            }
+        }(loop, done, ticks));
+        loop.run();
+        reader.join();
+
+        // ~4 KB at 3840 bytes/s: about a second on the wire.
+        EXPECT_EQ(sentences.size(), 100u);
+        EXPECT_FALSE(output->hasPending());
+        EXPECT_LT(importTime, std::chrono::milliseconds(500));
+        EXPECT_GT(syncTime, std::chrono::milliseconds(500));
+        EXPECT_GT(ticks, static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(syncTime).count() / 20 / 2));
+        close(master);
+    }
+    fs::remove_all(dir);
+}
+
+// Hears one PGN, or every PGN when given 0, on a virtual bus.
+class MessageListener : public tNMEA2000::tMsgHandler {
+public:
+    MessageListener(VirtualN2kBus &bus, unsigned long pgn) : tNMEA2000::tMsgHandler(pgn), node(bus) {
+        node.SetMode(tNMEA2000::N2km_ListenOnly);
+        node.AttachMsgHandler(this);
+        node.Open();
+    }
+
+    void HandleMsg(const tN2kMsg &N2kMsg) override { messages.push_back(N2kMsg); }
+
+    bool heard(unsigned long pgn) const {
+        return std::any_of(messages.begin(), messages.end(), [pgn](const tN2kMsg &msg) { return msg.PGN == pgn; });
+    }
+
+    // Parses until done() holds or the timeout passes.
+    template <typename Done>
+    bool waitFor(Done done, std::chrono::milliseconds timeout = std::chrono::seconds(3)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!done() && std::chrono::steady_clock::now() < deadline) {
+            node.ParseMessages();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        node.ParseMessages();
+        return done();
+    }
+
+    VirtualN2kNode node;
+    std::vector<tN2kMsg> messages;
+};
 
-    // Reset flags and ensure polling is cleared
-    syncManager.resetChangeFlags();
-    EXPECT_FALSE(syncManager.isPollChangeDetected());
+// A route in an imported GPX goes out on the bus as PGN 129285 and into
+// the next device export.
+TEST(SyncManagerOutputsTest, ImportedRoutesReachTheBusAndDeviceExports) {
+    fs::path dir = makeScratchDirectory();
+    fs::path previous = fs::current_path();
+    {
+        SyncManager manager(
+            std::make_shared<ConfigStore>(writeScratchConfig(dir, "\"format_mappings\": {\"Garmin\": \"gpx\"}, ")));
+        VirtualN2kBus bus;
+        MessageListener listener(bus, RouteWaypointPgn::pgn);
+        auto handler = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+        handler->enableMockMode({"Garmin"});
+        manager.addNMEAHandler(handler);
+        handler->start();
 
-    // Reinitialize inotify for further tests
-    syncManager.initialize(false, true);
+        WaypointCollection collection;
+        collection.add({0, "Marina", 25.10, -80.30, "", 255});
+        Route &route = collection.addRoute("Harbour Run");
+        route.legs.push_back(collection.add({0, "Breakwater", 25.11, -80.31, "", 255}));
+        route.legs.push_back(collection.add({0, "Fairway Buoy Outside The Southern Breakwater", 25.12, -80.32, "", 255}));
+        route.legs.push_back(collection.add({0, "Anchorage", 25.13, -80.33, "", 255}));
+        std::string path = (dir / "plan.gpx").string();
+        ASSERT_TRUE(writeGpxFile(path, collection));
+        ASSERT_TRUE(manager.importWaypointFile(path, "gpx"));
 
-    // Clean up
-    fs::remove(testFilePath);
-    fs::remove(testDir);
+        listener.waitFor([&listener] { return !listener.messages.empty(); });
+        ASSERT_EQ(listener.messages.size(), 1u);
+        RouteWaypointPgn::View view(listener.messages[0]);
+        ASSERT_TRUE(view.isValid());
+        EXPECT_EQ(view.header<RouteWaypointField::RouteName>(), "Harbour Run");
+        EXPECT_EQ(view.itemCount(), 3u);
+        std::vector<std::string> legs;
+        view.forEachItem([&legs](const RouteWaypointPgn::ItemView &item) {
+            legs.push_back(std::string(item.get<RouteWaypointItem::Name>()));
+        });
+        // Named as the Garmin was sent them.
+        std::vector<std::string> garminLegs;
+        for (uint32_t leg : collection.routes()[0].legs) {
+            garminLegs.push_back(encodeWaypoint(collection.at(leg), defaultVendorProfiles()[1]).name);
+        }
+        EXPECT_NE(garminLegs[1], collection.at(collection.routes()[0].legs[1]).name);
+        EXPECT_EQ(legs, garminLegs);
+
+        // Reimporting an unchanged route sends nothing more.
+        ASSERT_TRUE(manager.importWaypointFile(path, "gpx"));
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        listener.node.ParseMessages();
+        EXPECT_EQ(listener.messages.size(), 1u);
+
+        fs::current_path(dir);
+        manager.syncWaypointsAcrossDevices();
+        fs::current_path(previous);
+        handler->stop();
+
+        WaypointCollection exported;
+        ASSERT_TRUE(readGpxFile((dir / "output.Garmin").string(), exported));
+        ASSERT_EQ(exported.routes().size(), 1u);
+        EXPECT_EQ(exported.routes()[0].name, "Harbour Run");
+        EXPECT_EQ(exported.legNames(exported.routes()[0]), garminLegs);
+        EXPECT_EQ(exported.waypoints().size(), 4u);
+    }
+    fs::remove_all(dir);
+}
+
+// Devices sharing a format, and track files sharing a name, each keep
+// their own budget-reduced output.
+TEST(SyncManagerOutputsTest, TrackOutputsAreNamedPerDeviceAndSource) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(writeScratchConfig(
+            dir, "\"format_mappings\": {\"Garmin\": \"gpx\", \"Raymarine\": \"gpx\"}, "
+                 "\"track_settings\": {\"point_budgets\": {\"Garmin\": 10, \"Raymarine\": 50}}, ")));
+        VirtualN2kBus bus;
+        auto handler = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+        handler->enableMockMode({"Garmin", "Raymarine"});
+        manager.addNMEAHandler(handler);
+
+        std::vector<std::string> sources;
+        for (const std::string card : {"card1", "card2"}) {
+            Track track;
+            track.name = card;
+            track.segments.emplace_back();
+            for (int i = 0; i < 200; ++i) {
+                TrackPoint point;
+                point.latitude = 25.0 + i * 0.001;
+                point.longitude = -80.0;
+                track.segments.back().push_back(point);
+            }
+            fs::create_directories(dir / card);
+            sources.push_back((dir / card / "track.gpx").string());
+            ASSERT_TRUE(writeGpxTrackFile(sources.back(), {track}));
+        }
+        for (const auto &source : sources) {
+            ASSERT_TRUE(manager.syncTrackFile(source, "gpx"));
+        }
+
+        std::set<std::string> outputs;
+        for (const auto &entry : fs::directory_iterator(dir / "tracks")) {
+            outputs.insert(entry.path().filename().string());
+        }
+        ASSERT_EQ(outputs.size(), 4u);
+        for (const auto &source : sources) {
+            std::string card = fs::path(source).parent_path().filename().string();
+            for (const auto &[device, budget] : {std::pair<std::string, size_t>{"Garmin", 10},
+                                                 std::pair<std::string, size_t>{"Raymarine", 50}}) {
+                auto output = std::find_if(outputs.begin(), outputs.end(), [&](const std::string &name) {
+                    return name.rfind("output_track." + device + ".", 0) == 0 &&
+                           name.find(card + "_track") != std::string::npos;
+                });
+                ASSERT_NE(output, outputs.end()) << device << " " << card;
+                TrackCollector collector;
+                ASSERT_TRUE(readTrackFile((dir / "tracks" / *output).string(), "gpx", collector));
+                ASSERT_EQ(collector.getTracks().size(), 1u);
+                EXPECT_EQ(collector.getTracks()[0].name, card);
+                EXPECT_LE(collector.getTracks()[0].pointCount(), budget);
+            }
+        }
+    }
+    fs::remove_all(dir);
+}
+
+// A plotter that stores shortened names reports them back; they must merge
+// into the waypoint they were sent for, not come back as new ones.
+TEST(SyncManagerOutputsTest, PlotterEchoesOfShortenedNamesMergeIntoTheOriginal) {
+    fs::path dir = makeScratchDirectory();
+    fs::path previous = fs::current_path();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(
+            writeScratchConfig(dir, "\"format_mappings\": {\"Chartplotter\": \"gpx\"}, ")));
+        VirtualN2kBus bus;
+        SimulatedPlotter plotter(bus, PlotterProfile::lowrance(7, 30));
+        ASSERT_TRUE(plotter.open());
+        auto handler = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+        handler->enableMockMode({"Lowrance", "Chartplotter"});
+        manager.addNMEAHandler(handler);
+        handler->start();
+
+        const std::string name = "Ledge South Of The Point";
+        WaypointCollection collection;
+        collection.add({0, name, 43.60, -70.20, "", 255});
+        std::string path = (dir / "marks.gpx").string();
+        ASSERT_TRUE(writeGpxFile(path, collection));
+        ASSERT_TRUE(manager.importWaypointFile(path, "gpx"));
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+        while (plotter.getWaypoints().empty() && std::chrono::steady_clock::now() < deadline) {
+            plotter.poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        ASSERT_EQ(plotter.getWaypoints().size(), 1u);
+        std::string stored = plotter.getWaypoints().begin()->first;
+        EXPECT_NE(MergeEngine::keyFor(stored), MergeEngine::keyFor(name));
+
+        // The echo goes through the sync worker; give it a few passes.
+        ASSERT_GT(plotter.broadcastWaypoints(), 0u);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        fs::current_path(dir);
+        manager.syncWaypointsAcrossDevices();
+        fs::current_path(previous);
+        handler->stop();
+
+        WaypointCollection exported;
+        ASSERT_TRUE(readGpxFile((dir / "output.Chartplotter").string(), exported));
+        ASSERT_EQ(exported.waypoints().size(), 1u);
+        EXPECT_EQ(exported.waypoints()[0].name, name);
+    }
+    fs::remove_all(dir);
+}
+
+// A waypoint the plotter already held takes up its capacity like one we
+// sent; when the selection drops it, the next waypoint in overwrites it.
+TEST(SyncManagerOutputsTest, WaypointsDroppedFromTheSelectionAreOverwrittenOnThePlotter) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(
+            writeScratchConfig(dir, "\"waypoint_selection\": {\"default_capacity\": 1}, ")));
+        VirtualN2kBus bus;
+        MessageListener sent(bus, WaypointListPgn::pgn);
+        SimulatedPlotter plotter(bus, PlotterProfile::lowrance(7, 30));
+        ASSERT_TRUE(plotter.open());
+        auto handler = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+        handler->enableMockMode({"Lowrance"});
+        manager.addNMEAHandler(handler);
+        handler->start();
+
+        plotter.setWaypoint({7, "Old Mark", 43.60, -70.20, "", 255});
+        ASSERT_GT(plotter.broadcastWaypoints(), 0u);
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        size_t heard = sent.messages.size();
+
+        WaypointCollection collection;
+        collection.add({0, "New Mark", 43.61, -70.21, "", 255});
+        std::string path = (dir / "marks.gpx").string();
+        ASSERT_TRUE(writeGpxFile(path, collection));
+        ASSERT_TRUE(manager.importWaypointFile(path, "gpx"));
+
+        std::vector<uint16_t> ids;
+        sent.waitFor([&] {
+            for (; heard < sent.messages.size(); ++heard) {
+                WaypointListPgn::View view(sent.messages[heard]);
+                view.forEachItem([&ids](const WaypointListPgn::ItemView &item) {
+                    if (MergeEngine::keyFor(std::string(item.get<WaypointListItem::Name>())) == "new mark") {
+                        ids.push_back(static_cast<uint16_t>(item.get<WaypointListItem::Id>()));
+                    }
+                });
+            }
+            return !ids.empty();
+        });
+        handler->stop();
+        ASSERT_FALSE(ids.empty());
+        EXPECT_EQ(ids.back(), 7);
+    }
+    fs::remove_all(dir);
+}
+
+// Captured proprietary frames are written by the sync worker into the
+// configured log directory.
+TEST(SyncManagerCaptureTest, ProprietaryFramesAreLoggedInTheLogDirectory) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(writeScratchConfig(dir)));
+        VirtualN2kBus bus;
+        auto handler = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+        handler->enableProprietaryCapture();
+        manager.addNMEAHandler(handler);
+        handler->start();
+        SimulatedPlotter plotter(bus, PlotterProfile::garmin(3, 40));
+        ASSERT_TRUE(plotter.open());
+
+        // Only frames from a device the handler knows as a vendor's are kept.
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+        while (handler->getDetectedDevices().empty() && std::chrono::steady_clock::now() < deadline) {
+            plotter.poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        ASSERT_FALSE(handler->getDetectedDevices().empty());
+
+        tN2kMsg msg;
+        msg.SetPGN(130817);
+        msg.Priority = 6;
+        for (unsigned char byte : {0xE5, 0x98, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08}) {
+            msg.AddByte(byte);
+        }
+        ASSERT_TRUE(plotter.getNMEA2000().SendMsg(msg));
+
+        fs::path log = dir / "logs" / "pgn_capture.log";
+        std::string text;
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+        while (text.find("130817") == std::string::npos && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            std::ifstream file(log);
+            text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        handler->stop();
+        EXPECT_NE(text.find("[vcan0] Garmin PGN: 130817"), std::string::npos) << text;
+        EXPECT_NE(text.find("LEN: 10 | DATA: E5 98 1 2 3 4 5 6 7 8"), std::string::npos) << text;
+        EXPECT_EQ(handler->getDroppedCapturedFrames(), 0u);
+    }
+    fs::remove_all(dir);
+}
+
+// Only route and waypoint PGNs cross a bridge; vendor proprietary traffic
+// stays on the bus it was heard on.
+TEST(SyncManagerBridgeTest, BridgesOnlyRouteAndWaypointPgns) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(std::make_shared<ConfigStore>(writeScratchConfig(dir)));
+        VirtualN2kBus busA, busB;
+        NMEAWaypointHandler a(manager, std::make_unique<VirtualN2kNode>(busA), "vcan0");
+        NMEAWaypointHandler b(manager, std::make_unique<VirtualN2kNode>(busB), "vcan1");
+        a.bridgeTo(b);
+        MessageListener listener(busB, 0);
+        VirtualN2kNode sender(busA);
+        sender.SetMode(tNMEA2000::N2km_ListenAndSend, 40);
+        ASSERT_TRUE(sender.Open());
+        a.start();
+        b.start();
+
+        tN2kMsg waypoints;
+        WaypointListPgn::encodeHeader(waypoints, 0, 0, 1, 0, {});
+        WaypointListPgn::appendItem(waypoints, 1, "Reef", 25.1, -80.3);
+        WaypointCollection collection;
+        Route &route = collection.addRoute("Out");
+        route.legs.push_back(collection.add({0, "Reef", 25.1, -80.3, "", 255}));
+        tN2kMsg routeMsg = buildRouteMessages(collection.routes()[0], collection)[0];
+        tN2kMsg proprietary;
+        proprietary.SetPGN(130842);  // Simrad/Garmin proprietary fast packet
+        proprietary.Priority = 6;
+        for (int i = 0; i < 12; ++i) {
+            proprietary.AddByte(static_cast<unsigned char>(i));
+        }
+        tN2kMsg proprietarySingle;
+        proprietarySingle.SetPGN(65305);
+        proprietarySingle.Priority = 7;
+        for (int i = 0; i < 8; ++i) {
+            proprietarySingle.AddByte(0xff);
+        }
+        for (tN2kMsg *msg : {&proprietary, &proprietarySingle, &waypoints, &routeMsg}) {
+            msg->Destination = 255;
+            ASSERT_TRUE(sender.SendMsg(*msg));
+        }
+
+        EXPECT_TRUE(listener.waitFor([&listener] {
+            return listener.heard(WaypointListPgn::pgn) && listener.heard(RouteWaypointPgn::pgn);
+        }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        listener.node.ParseMessages();
+        EXPECT_FALSE(listener.heard(130842));
+        EXPECT_FALSE(listener.heard(65305));
+        a.stop();
+        b.stop();
+    }
+    fs::remove_all(dir);
+}
+
+// With bridge_waypoint_pgns set, a handler added while another is already
+// running is bridged both ways.
+TEST(SyncManagerBridgeTest, BridgesHandlersAddedWhileRunning) {
+    fs::path dir = makeScratchDirectory();
+    {
+        SyncManager manager(
+            std::make_shared<ConfigStore>(writeScratchConfig(dir, "", "\"bridge_waypoint_pgns\": true, ")));
+        VirtualN2kBus busA, busB;
+        auto a = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(busA), "vcan0");
+        auto b = std::make_shared<NMEAWaypointHandler>(manager, std::make_unique<VirtualN2kNode>(busB), "vcan1");
+        manager.addNMEAHandler(a);
+        a->start();
+        manager.addNMEAHandler(b);
+        b->start();
+
+        MessageListener onA(busA, RouteWaypointPgn::pgn);
+        MessageListener onB(busB, RouteWaypointPgn::pgn);
+        VirtualN2kNode senderA(busA);
+        VirtualN2kNode senderB(busB);
+        for (VirtualN2kNode *sender : {&senderA, &senderB}) {
+            sender->SetMode(tNMEA2000::N2km_ListenAndSend, 40);
+            ASSERT_TRUE(sender->Open());
+        }
+
+        WaypointCollection collection;
+        Route &out = collection.addRoute("Out");
+        out.legs.push_back(collection.add({0, "Reef", 25.1, -80.3, "", 255}));
+        Route &back = collection.addRoute("Back");
+        back.legs.push_back(collection.add({0, "Marina", 25.2, -80.4, "", 255}));
+        tN2kMsg outMsg = buildRouteMessages(collection.routes()[0], collection)[0];
+        tN2kMsg backMsg = buildRouteMessages(collection.routes()[1], collection)[0];
+        outMsg.Destination = backMsg.Destination = 255;
+        ASSERT_TRUE(senderA.SendMsg(outMsg));
+        ASSERT_TRUE(senderB.SendMsg(backMsg));
+
+        auto routeNamed = [](MessageListener &listener, const std::string &name) {
+            return [&listener, name] {
+                for (const auto &msg : listener.messages) {
+                    RouteWaypointPgn::View view(msg);
+                    if (view.isValid() && view.header<RouteWaypointField::RouteName>() == name) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+        };
+        EXPECT_TRUE(onB.waitFor(routeNamed(onB, "Out")));
+        EXPECT_TRUE(onA.waitFor(routeNamed(onA, "Back")));
+
+        // Read through the bus threads while they run.
+        EXPECT_TRUE(a->getDetectedDevices().empty());
+        EXPECT_TRUE(b->getDetectedDevices().empty());
+        a->stop();
+        b->stop();
+        EXPECT_TRUE(a->getDetectedDevices().empty());
+    }
+    fs::remove_all(dir);
 }
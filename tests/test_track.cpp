@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "gpx_io.h"
+#include "track.h"
+#include <cmath>
+#include <sstream>
+#include <string>
+
+static const char *sampleTrack = R"(<?xml version="1.0" encoding="UTF-8"?>
+<gpx version="1.1" creator="test">
+  <metadata><name>Not a track</name><time>2020-01-01T00:00:00Z</time></metadata>
+  <wpt lat="1" lon="1"><name>Skip me</name></wpt>
+  <trk>
+    <name>Morning &amp; run</name>
+    <trkseg>
+      <trkpt lat="34.0" lon="-84.0"><ele>12.5</ele><time>2024-05-01T12:00:00Z</time></trkpt>
+      <!-- <trkpt lat="0" lon="0"/> -->
+      <trkpt lat="34.001" lon="-84.001"/>
+    </trkseg>
+    <trkseg>
+      <trkpt lat='34.002' lon='-84.002'></trkpt>
+    </trkseg>
+  </trk>
+</gpx>
+)";
+
+// Builds a track of count points along a gentle zig-zag.
+static Track zigZag(size_t count, double amplitudeDegrees) {
+    Track track;
+    track.segments.emplace_back();
+    for (size_t i = 0; i < count; ++i) {
+        TrackPoint point;
+        point.latitude = 34.0 + i * 1e-5;
+        point.longitude = -84.0 + ((i / 50) % 2 ? amplitudeDegrees : 0.0);
+        track.segments.back().push_back(point);
+    }
+    return track;
+}
+
+TEST(TrackTest, StreamingReaderHandlesAnyChunkSize) {
+    for (size_t chunk : {size_t(1), size_t(7), size_t(4096)}) {
+        TrackCollector collector;
+        GpxTrackReader reader(collector);
+        std::string text = sampleTrack;
+        for (size_t i = 0; i < text.size(); i += chunk) {
+            ASSERT_TRUE(reader.feed(text.data() + i, std::min(chunk, text.size() - i)));
+        }
+        ASSERT_TRUE(reader.finish());
+
+        const auto &tracks = collector.getTracks();
+        ASSERT_EQ(tracks.size(), 1u) << "chunk " << chunk;
+        EXPECT_EQ(tracks[0].name, "Morning & run");
+        ASSERT_EQ(tracks[0].segments.size(), 2u);
+        ASSERT_EQ(tracks[0].segments[0].size(), 2u);
+        EXPECT_DOUBLE_EQ(tracks[0].segments[0][0].elevation, 12.5);
+        EXPECT_EQ(tracks[0].segments[0][0].time, 1714564800);
+        EXPECT_DOUBLE_EQ(tracks[0].segments[1][0].longitude, -84.002);
+    }
+}
+
+TEST(TrackTest, GpxRoundTrip) {
+    TrackCollector original;
+    std::istringstream input(sampleTrack);
+    ASSERT_TRUE(readGpxTracks(input, original));
+
+    std::stringstream written;
+    writeGpxTracks(written, original.getTracks());
+    TrackCollector reread;
+    ASSERT_TRUE(readGpxTracks(written, reread));
+
+    ASSERT_EQ(reread.getTracks().size(), 1u);
+    EXPECT_EQ(reread.getTracks()[0].pointCount(), 3u);
+    EXPECT_EQ(reread.getTracks()[0].segments[0][0].time, 1714564800);
+    EXPECT_TRUE(std::isnan(reread.getTracks()[0].segments[0][1].elevation));
+}
+
+TEST(TrackTest, DouglasPeuckerDropsCollinearPoints) {
+    Track straight = zigZag(500, 0.0);
+    TrackSegment simplified = simplifySegment(straight.segments[0], 1.0);
+    EXPECT_EQ(simplified.size(), 2u);
+
+    // About 9 m zig-zags survive a 5 m tolerance, but not a 20 m one.
+    Track wiggly = zigZag(500, 1e-4);
+    EXPECT_GT(simplifySegment(wiggly.segments[0], 5.0).size(), 10u);
+    EXPECT_EQ(simplifySegment(wiggly.segments[0], 20.0).size(), 2u);
+}
+
+TEST(TrackTest, StreamingSimplifierMeetsBudget) {
+    const size_t inputPoints = 200000;
+    const size_t budget = 300;
+    Track source = zigZag(inputPoints, 1e-4);
+
+    TrackSimplifier simplifier(1.0, budget, 1024);
+    simplifier.beginTrack("Long");
+    for (const auto &point : source.segments[0]) {
+        simplifier.addPoint(point);
+    }
+    simplifier.endSegment();
+    simplifier.endTrack();
+
+    ASSERT_EQ(simplifier.getTracks().size(), 1u);
+    const Track &track = simplifier.getTracks()[0];
+    EXPECT_EQ(simplifier.getInputPoints(), inputPoints);
+    EXPECT_LE(track.pointCount(), budget);
+    EXPECT_GE(track.pointCount(), 2u);
+    EXPECT_GT(track.tolerance, 1.0);
+    // End points always survive.
+    EXPECT_DOUBLE_EQ(track.segments[0].front().latitude, source.segments[0].front().latitude);
+    EXPECT_DOUBLE_EQ(track.segments[0].back().latitude, source.segments[0].back().latitude);
+}
+
+TEST(TrackTest, ReduceToBudgetKeepsToleranceWhenAlreadySmall) {
+    Track track = zigZag(100, 1e-4);
+    Track reduced = reduceToBudget(track, 1000, 5.0);
+    EXPECT_EQ(reduced.pointCount(), 100u);
+    EXPECT_DOUBLE_EQ(reduced.tolerance, 5.0);
+
+    reduced = reduceToBudget(track, 10, 5.0);
+    EXPECT_LE(reduced.pointCount(), 10u);
+    EXPECT_GT(reduced.tolerance, 5.0);
+}
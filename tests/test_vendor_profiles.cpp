@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include "vendor_profiles.h"
+#include "waypoint_pgns.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+Waypoint waypointAt(const std::string &name, double latitude, double longitude, const std::string &symbol = "") {
+    Waypoint waypoint;
+    waypoint.name = name;
+    waypoint.latitude = latitude;
+    waypoint.longitude = longitude;
+    waypoint.symbol = symbol;
+    return waypoint;
+}
+
+VendorProfile profileNamed(const std::string &name) {
+    for (const auto &profile : defaultVendorProfiles()) {
+        if (profile.name == name) {
+            return profile;
+        }
+    }
+    return VendorProfile();
+}
+
+} // namespace
+
+TEST(VendorProfilesTest, NamesAreTransliteratedAndTruncated) {
+    VendorProfile nmea = profileNamed(NMEA2000_PROFILE);
+    EXPECT_EQ(normaliseName("Île d’Orléans – Quai", nmea), "Ile d'Orleans - Quai");
+    EXPECT_EQ(normaliseName("Straße\xa0Nord", nmea), "Strasse Nord");  // Stray Latin-1 byte
+    EXPECT_EQ(normaliseName("Fish \xf0\x9f\x90\x9f spot", nmea), "Fish spot");
+    EXPECT_EQ(normaliseName("\xe2\x9a\x93", nmea), "WPT");
+
+    VendorProfile humminbird = profileNamed("Humminbird");
+    EXPECT_EQ(normaliseName("Harbour entrance buoy", humminbird), "Harbour entr");
+    EXPECT_EQ(normaliseName("Harbour     entrance", humminbird), "Harbour entr");
+    EXPECT_EQ(normaliseName("Harbour nord", humminbird), "Harbour nord");
+    EXPECT_EQ(normaliseName("Dock A      x", humminbird), "Dock A x");
+}
+
+TEST(VendorProfilesTest, UpperCharsetFoldsAndReplaces) {
+    VendorProfile raymarine = profileNamed("Raymarine");
+    EXPECT_EQ(normaliseName("Pêche #3 (deep)", raymarine), "PECHE 3 DEEP");
+    EXPECT_EQ(normaliseName("a_b.c-d", raymarine), "A B.C-D");
+    EXPECT_EQ(normaliseName("Very long waypoint name here", raymarine), "VERY LONG WAYPOI");
+}
+
+TEST(VendorProfilesTest, OverridesMergeIntoDefaults) {
+    VendorProfileOverride garmin;
+    garmin.vendor = "Garmin";
+    garmin.maxNameLength = 10;
+    garmin.symbols = {{"anchor", "Anchor"}};
+    VendorProfileOverride simrad;
+    simrad.vendor = "Simrad";
+    simrad.charset = "upper";
+    simrad.defaultSymbol = "Dot";
+
+    std::vector<VendorProfile> profiles = vendorProfilesWith({garmin, simrad});
+    ASSERT_EQ(profiles.size(), defaultVendorProfiles().size() + 1);
+    WaypointEncodingCache cache(profiles);
+
+    const VendorProfile &merged = cache.profile(cache.profileFor("Garmin"));
+    EXPECT_EQ(merged.maxNameLength, 10u);
+    EXPECT_EQ(merged.charset, NameCharset::Ascii);
+    EXPECT_EQ(mapSymbol("anchor", merged), "Anchor");
+    EXPECT_EQ(mapSymbol("flag", merged), "flag");
+
+    const VendorProfile &added = cache.profile(cache.profileFor("Simrad"));
+    EXPECT_EQ(added.maxNameLength, 32u);
+    EXPECT_EQ(added.charset, NameCharset::Upper);
+    EXPECT_EQ(mapSymbol("flag", added), "Dot");
+}
+
+TEST(VendorProfilesTest, BusWithSeveralVendorsGetsTheStrictestRules) {
+    WaypointEncodingCache cache;
+    EXPECT_EQ(cache.profile(cache.profileFor(std::vector<std::string>{})).name, NMEA2000_PROFILE);
+    EXPECT_EQ(cache.profile(cache.profileFor("Unknown")).name, NMEA2000_PROFILE);
+
+    auto combined = cache.profileFor(std::vector<std::string>{"Raymarine", "Garmin", "Unknown"});
+    EXPECT_EQ(cache.profile(combined).name, "Garmin+Raymarine");
+    EXPECT_EQ(cache.profile(combined).maxNameLength, 16u);
+    EXPECT_EQ(cache.profile(combined).charset, NameCharset::Upper);
+    EXPECT_EQ(cache.profileFor(std::vector<std::string>{"Garmin", "Raymarine", "Garmin"}), combined);
+}
+
+TEST(VendorProfilesTest, CacheEncodesOncePerContent) {
+    WaypointEncodingCache cache;
+    auto lowrance = cache.profileFor("Lowrance");
+    auto garmin = cache.profileFor("Garmin");
+    Waypoint dock = waypointAt("Marina fuel dock north", 34.5, -84.25);
+
+    auto first = cache.encode(lowrance, dock);
+    EXPECT_EQ(first->name, "Marina fuel doc");
+    EXPECT_EQ(cache.encode(lowrance, dock), first);
+    EXPECT_EQ(cache.encode(garmin, dock)->name, "Marina fuel dock north");
+    EXPECT_EQ(cache.getStats().hits, 1u);
+    EXPECT_EQ(cache.getStats().misses, 2u);
+
+    // A moved waypoint is encoded again; holders of the old one keep it.
+    dock.latitude = 34.6;
+    auto moved = cache.encode(lowrance, dock);
+    EXPECT_NE(moved, first);
+    EXPECT_DOUBLE_EQ(first->latitude, 34.5);
+    EXPECT_DOUBLE_EQ(moved->latitude, 34.6);
+
+    Waypoint other = waypointAt("Reef", 1.0, 2.0);
+    cache.encode(lowrance, other);
+    EXPECT_EQ(cache.getStats().entries, 3u);
+    cache.retain(&other, 1);
+    EXPECT_EQ(cache.getStats().entries, 1u);
+}
+
+TEST(VendorProfilesTest, RecordMatchesAppendedItem) {
+    WaypointEncodingCache cache;
+    auto encoded = cache.encode(cache.profileFor("Raymarine"), waypointAt("Café rocks", -33.5, 151.25));
+
+    tN2kMsg cached;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(cached, 42, 0, 1, 0, {}));
+    ASSERT_TRUE(appendWaypointRecord(cached, 42, *encoded));
+    tN2kMsg direct;
+    ASSERT_TRUE(WaypointListPgn::encodeHeader(direct, 42, 0, 1, 0, {}));
+    ASSERT_TRUE(WaypointListPgn::appendItem(direct, 42, "CAFE ROCKS", -33.5, 151.25));
+
+    ASSERT_EQ(cached.DataLen, direct.DataLen);
+    EXPECT_EQ(std::vector<unsigned char>(cached.Data, cached.Data + cached.DataLen),
+              std::vector<unsigned char>(direct.Data, direct.Data + direct.DataLen));
+
+    WaypointListPgn::View view(cached);
+    EXPECT_TRUE(view.forEachItem([](const WaypointListPgn::ItemView &item) {
+        EXPECT_EQ(item.get<WaypointListItem::Id>(), 42u);
+        EXPECT_EQ(std::string(item.get<WaypointListItem::Name>()), "CAFE ROCKS");
+    }));
+}
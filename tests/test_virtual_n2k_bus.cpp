@@ -0,0 +1,280 @@
+#include <gtest/gtest.h>
+#include "N2kDeviceList.h"
+#include "nmea_waypoint_handler.h"
+#include "simulated_plotter.h"
+#include "sync_manager.h"
+#include "virtual_n2k_bus.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Exposes the raw CAN driver calls for frame-level checks.
+class RawNode : public VirtualN2kNode {
+public:
+    using VirtualN2kNode::VirtualN2kNode;
+    using VirtualN2kNode::CANGetFrame;
+    using VirtualN2kNode::CANOpen;
+    using VirtualN2kNode::CANSendFrame;
+};
+
+static Waypoint makeWaypoint(int index) {
+    Waypoint waypoint;
+    waypoint.id = static_cast<uint16_t>(index);
+    waypoint.name = "WP" + std::to_string(index);
+    waypoint.latitude = 34.0 + index * 1e-4;
+    waypoint.longitude = -84.0 - index * 1e-4;
+    return waypoint;
+}
+
+TEST(VirtualN2kBusTest, RoutesFramesToEveryOtherNode) {
+    VirtualN2kBus bus;
+    RawNode a(bus), b(bus), c(bus);
+    ASSERT_TRUE(a.CANOpen());
+    ASSERT_TRUE(b.CANOpen());
+    ASSERT_TRUE(c.CANOpen());
+
+    const unsigned char data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    ASSERT_TRUE(a.CANSendFrame(0x0DF80503, 8, data));
+
+    unsigned long id = 0;
+    unsigned char len = 0;
+    unsigned char buf[8] = {};
+    EXPECT_FALSE(a.CANGetFrame(id, len, buf));  // No loopback
+    ASSERT_TRUE(b.CANGetFrame(id, len, buf));
+    EXPECT_EQ(id, 0x0DF80503u);
+    EXPECT_EQ(len, 8);
+    EXPECT_EQ(buf[7], 8);
+    ASSERT_TRUE(c.CANGetFrame(id, len, buf));
+
+    VirtualN2kBus::Stats stats = bus.getStats();
+    EXPECT_EQ(stats.frames, 1u);
+    EXPECT_EQ(stats.bits, VirtualN2kBus::frameBits(8));
+    EXPECT_NEAR(bus.utilisation(std::chrono::milliseconds(1)), 131.0 / 250.0, 1e-9);
+
+    // Every node reports the whole segment's traffic for load measurement.
+    BusCounters counters;
+    ASSERT_TRUE(c.readBusCounters(counters));
+    EXPECT_EQ(counters.frames, 1u);
+    EXPECT_EQ(counters.dataBytes, 8u);
+    EXPECT_EQ(counters.sendFailures, 0u);
+}
+
+TEST(VirtualN2kBusTest, FullReceiveQueueCountsAsDropped) {
+    VirtualN2kBus bus;
+    RawNode sender(bus), slow(bus, 2);
+    sender.CANOpen();
+    slow.CANOpen();
+
+    const unsigned char data[1] = {0};
+    for (int i = 0; i < 5; ++i) {
+        sender.CANSendFrame(0x18EAFF00, 1, data);
+    }
+    EXPECT_EQ(slow.pendingFrames(), 2u);
+    EXPECT_EQ(bus.getStats().droppedFrames, 3u);
+}
+
+TEST(SimulatedPlotterTest, ScriptRunsInTimeOrder) {
+    VirtualN2kBus bus;
+    SimulatedPlotter plotter(bus, PlotterProfile::garmin(1, 20));
+    std::vector<int> order;
+    plotter.at(200, [&order](SimulatedPlotter &) { order.push_back(2); });
+    plotter.at(100, [&order](SimulatedPlotter &) { order.push_back(1); });
+    plotter.at(300, [&order](SimulatedPlotter &) { order.push_back(3); });
+
+    plotter.advanceTo(250);
+    EXPECT_EQ(order, (std::vector<int>{1, 2}));
+    plotter.advanceTo(300);
+    EXPECT_EQ(order, (std::vector<int>{1, 2, 3}));
+}
+
+// Twenty plotters, one of them sharing a large library with the rest.
+TEST(SimulatedPlotterTest, LoadTestLibraryReachesEveryPlotter) {
+    const int plotterCount = 20;
+    const int waypointCount = 1000;  // About 3000 frames, inside each node's receive queue
+
+    VirtualN2kBus bus;
+    std::vector<std::unique_ptr<SimulatedPlotter>> plotters;
+    for (int i = 0; i < plotterCount; ++i) {
+        unsigned char address = static_cast<unsigned char>(20 + i);
+        PlotterProfile profile = i % 3 == 0   ? PlotterProfile::garmin(i + 1, address)
+                                 : i % 3 == 1 ? PlotterProfile::lowrance(i + 1, address)
+                                              : PlotterProfile::humminbird(i + 1, address);
+        plotters.push_back(std::make_unique<SimulatedPlotter>(bus, profile));
+        ASSERT_TRUE(plotters.back()->open());
+    }
+    ASSERT_EQ(bus.nodeCount(), static_cast<size_t>(plotterCount));
+
+    SimulatedPlotter &source = *plotters[0];
+    for (int i = 0; i < waypointCount; ++i) {
+        source.setWaypoint(makeWaypoint(i));
+    }
+
+    bus.resetStats();
+    size_t sentTotal = 0;
+    source.at(0, [&sentTotal](SimulatedPlotter &plotter) { sentTotal = plotter.broadcastWaypoints(); });
+    source.advanceTo(0);
+    for (auto &plotter : plotters) {
+        plotter->poll();
+    }
+
+    VirtualN2kBus::Stats stats = bus.getStats();
+    EXPECT_GT(sentTotal, 0u);
+    EXPECT_GT(stats.frames, sentTotal);  // Fast-packet: several frames per message
+    EXPECT_EQ(stats.droppedFrames, 0u);
+
+    for (int i = 1; i < plotterCount; ++i) {
+        EXPECT_EQ(plotters[i]->getReceivedMessages(), sentTotal) << plotters[i]->getProfile().name;
+        EXPECT_EQ(plotters[i]->getWaypoints().size(), static_cast<size_t>(waypointCount));
+        EXPECT_EQ(plotters[i]->getRejectedWaypoints(), 0u);
+    }
+    const Waypoint &received = plotters[5]->getWaypoints().at("WP567");
+    EXPECT_NEAR(received.latitude, 34.0567, 1e-7);
+}
+
+TEST(SimulatedPlotterTest, FullPlotterRejectsNewWaypoints) {
+    VirtualN2kBus bus;
+    PlotterProfile small = PlotterProfile::humminbird(2, 30);
+    small.maxWaypoints = 10;
+    SimulatedPlotter sender(bus, PlotterProfile::garmin(1, 20));
+    SimulatedPlotter receiver(bus, small);
+    sender.open();
+    receiver.open();
+
+    for (int i = 0; i < 25; ++i) {
+        sender.setWaypoint(makeWaypoint(i));
+    }
+    sender.broadcastWaypoints();
+    receiver.poll();
+
+    EXPECT_EQ(receiver.getWaypoints().size(), 10u);
+    EXPECT_EQ(receiver.getRejectedWaypoints(), 15u);
+}
+
+// Polls every plotter until done() or the timeout; the library's address
+// claim and product information exchange need a few round trips.
+template <typename Done>
+static bool pollUntil(std::vector<std::unique_ptr<SimulatedPlotter>> &plotters, Done done,
+                      std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done() && std::chrono::steady_clock::now() < deadline) {
+        for (auto &plotter : plotters) {
+            plotter->poll();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return done();
+}
+
+static std::vector<std::unique_ptr<SimulatedPlotter>> openOneOfEach(VirtualN2kBus &bus) {
+    std::vector<std::unique_ptr<SimulatedPlotter>> plotters;
+    plotters.push_back(std::make_unique<SimulatedPlotter>(bus, PlotterProfile::garmin(1, 20)));
+    plotters.push_back(std::make_unique<SimulatedPlotter>(bus, PlotterProfile::lowrance(2, 21)));
+    plotters.push_back(std::make_unique<SimulatedPlotter>(bus, PlotterProfile::humminbird(3, 22)));
+    for (auto &plotter : plotters) {
+        plotter->open();
+    }
+    return plotters;
+}
+
+// Each plotter's tNMEA2000 claims its address and answers product
+// information requests, so a device list on the segment learns who it is.
+TEST(VirtualN2kBusTest, AddressClaimAndProductInformationFillTheDeviceList) {
+    VirtualN2kBus bus;
+    VirtualN2kNode listener(bus);
+    listener.SetProductInformation("1", 100, "Listener", "1.0.0.0", "1.0.0");
+    listener.SetDeviceInformation(9, 130, 25, 2046);
+    listener.SetMode(tNMEA2000::N2km_ListenAndNode, 40);
+    tN2kDeviceList deviceList(&listener);
+    ASSERT_TRUE(listener.Open());
+    auto plotters = openOneOfEach(bus);
+
+    ASSERT_TRUE(pollUntil(plotters, [&] {
+        listener.ParseMessages();
+        for (auto &plotter : plotters) {
+            const tNMEA2000::tDevice *device = deviceList.FindDeviceBySource(plotter->getProfile().sourceAddress);
+            if (!device || std::string(device->GetModelID()) != plotter->getProfile().modelId) {
+                return false;
+            }
+        }
+        return true;
+    }));
+    for (auto &plotter : plotters) {
+        const PlotterProfile &profile = plotter->getProfile();
+        const tNMEA2000::tDevice *device = deviceList.FindDeviceBySource(profile.sourceAddress);
+        ASSERT_NE(device, nullptr) << profile.name;
+        EXPECT_EQ(device->GetManufacturerCode(), profile.manufacturerCode) << profile.name;
+        EXPECT_EQ(device->GetProductCode(), profile.productCode) << profile.name;
+    }
+}
+
+// The whole path the daemon uses: the handler finds each plotter by its
+// claimed manufacturer, then paces a library out that every plotter
+// reassembles from fast packets.
+TEST(VirtualN2kBusTest, HandlerSyncReachesEveryDetectedPlotter) {
+    std::string pattern = (fs::temp_directory_path() / "virtual_bus_test_XXXXXX").string();
+    fs::path dir(mkdtemp(pattern.data()));
+    fs::create_directories(dir / "watch");
+    {
+        std::ofstream config(dir / "config.json");
+        config << "{\"paths\": {\"watch_directory\": \"" << (dir / "watch").string() << "\", "
+               << "\"waypoints_file\": \"" << (dir / "waypoints.json").string() << "\"}, "
+               << "\"device_settings\": {\"can_interfaces\": [], \"media_mount_prefixes\": []}, "
+               << "\"library_export\": {\"shm_name\": \"\"}}";
+    }
+    {
+        SyncManager manager(std::make_shared<ConfigStore>((dir / "config.json").string()));
+        VirtualN2kBus bus;
+        NMEAWaypointHandler handler(manager, std::make_unique<VirtualN2kNode>(bus), "vcan0");
+        handler.start();
+        auto plotters = openOneOfEach(bus);
+
+        std::vector<std::string> expected{"Garmin", "Humminbird", "Lowrance"};
+        ASSERT_TRUE(pollUntil(plotters, [&] {
+            std::vector<std::string> devices = handler.getDetectedDevices();
+            std::sort(devices.begin(), devices.end());
+            return devices == expected;
+        }));
+
+        const int waypointCount = 100;
+        bus.resetStats();
+        for (int i = 0; i < waypointCount; ++i) {
+            Waypoint waypoint = makeWaypoint(i);
+            handler.addWaypoint(waypoint.id, waypoint.name, waypoint.latitude, waypoint.longitude);
+        }
+        std::promise<void> sent;
+        handler.whenTransmitted([&sent] { sent.set_value(); });
+        ASSERT_EQ(sent.get_future().wait_for(std::chrono::seconds(20)), std::future_status::ready);
+        double utilisation = bus.utilisation();
+
+        ASSERT_TRUE(pollUntil(plotters, [&] {
+            return std::all_of(plotters.begin(), plotters.end(), [](const auto &plotter) {
+                return plotter->getWaypoints().size() == static_cast<size_t>(waypointCount);
+            });
+        }));
+        VirtualN2kBus::Stats stats = bus.getStats();
+        EXPECT_EQ(stats.droppedFrames, 0u);
+        EXPECT_GT(stats.frames, static_cast<uint64_t>(waypointCount));  // Fast-packet: several frames per message
+        for (auto &plotter : plotters) {
+            EXPECT_EQ(plotter->getReceivedMessages(), static_cast<size_t>(waypointCount)) << plotter->getProfile().name;
+            EXPECT_EQ(plotter->getRejectedWaypoints(), 0u);
+        }
+        EXPECT_NEAR(plotters[1]->getWaypoints().at("WP42").latitude, 34.0042, 1e-7);
+
+        // Paced to the configured share of the wire, and measured by the
+        // handler from the same counters.
+        EXPECT_GT(utilisation, 0.0);
+        EXPECT_LE(utilisation, TransmitRateSettings().maxBusShare * 1.1);
+        EXPECT_GT(handler.getBusUtilisation(), 0.0);
+        handler.stop();
+    }
+    fs::remove_all(dir);
+}
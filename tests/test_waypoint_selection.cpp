@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+#include "waypoint_selection.h"
+#include "merge_engine.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// A line of waypoints heading north from 34N 84W, one every ~1.1 km.
+static std::vector<Waypoint> lineOfWaypoints(size_t count) {
+    std::vector<Waypoint> waypoints;
+    for (size_t i = 0; i < count; ++i) {
+        Waypoint waypoint;
+        waypoint.id = static_cast<uint16_t>(i);
+        waypoint.name = "WP" + std::to_string(i);
+        waypoint.latitude = 34.0 + i * 0.01;
+        waypoint.longitude = -84.0;
+        waypoints.push_back(waypoint);
+    }
+    return waypoints;
+}
+
+static OwnShipPosition fixAt(double latitude, double longitude) {
+    OwnShipPosition position;
+    position.latitude = latitude;
+    position.longitude = longitude;
+    position.valid = true;
+    return position;
+}
+
+static std::vector<std::string> names(const std::vector<Waypoint> &waypoints) {
+    std::vector<std::string> result;
+    for (const auto &waypoint : waypoints) {
+        result.push_back(waypoint.name);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+TEST(WaypointSelectionTest, PicksNearestThatFitCapacity) {
+    WaypointSelector selector;
+    selector.setLibrary(lineOfWaypoints(100), 0);
+    selector.setPosition(fixAt(34.5, -84.0));
+
+    SelectionDelta delta = selector.select("can0", 5, 0);
+    ASSERT_EQ(delta.added.size(), 5u);
+    EXPECT_TRUE(delta.removed.empty());
+    // Nearest first, then the four around it.
+    EXPECT_EQ(delta.added.front().name, "WP50");
+    EXPECT_EQ(names(delta.added), (std::vector<std::string>{"WP48", "WP49", "WP50", "WP51", "WP52"}));
+    EXPECT_EQ(names(selector.selected("can0")), names(delta.added));
+
+    // Nothing changed: nothing to send.
+    EXPECT_TRUE(selector.select("can0", 5, 0).empty());
+}
+
+TEST(WaypointSelectionTest, SmallMovesDoNotChurnAndLargeMovesSwapFew) {
+    SelectionSettings settings;
+    settings.hysteresisMeters = 1500.0;
+    settings.recomputeDistanceMeters = 100.0;
+    WaypointSelector selector(settings);
+    selector.setLibrary(lineOfWaypoints(100), 0);
+    selector.setPosition(fixAt(34.5, -84.0));
+    selector.select("can0", 10, 0);
+
+    // ~1.1 km north: re-ranked, but within the hysteresis margin.
+    selector.setPosition(fixAt(34.51, -84.0));
+    EXPECT_TRUE(selector.select("can0", 10, 0).empty());
+
+    // ~5.5 km north: a handful swap, the rest stay put.
+    selector.setPosition(fixAt(34.55, -84.0));
+    SelectionDelta delta = selector.select("can0", 10, 0);
+    EXPECT_FALSE(delta.added.empty());
+    EXPECT_EQ(delta.added.size(), delta.removed.size());
+    EXPECT_LT(delta.added.size(), 10u);
+    EXPECT_EQ(selector.selected("can0").size(), 10u);
+    for (const auto &waypoint : delta.removed) {
+        EXPECT_LT(waypoint.latitude, 34.5);
+    }
+}
+
+TEST(WaypointSelectionTest, RecencyRanksWithoutPositionAndBreaksTies) {
+    WaypointSelector selector;
+    std::vector<Waypoint> library = lineOfWaypoints(20);
+    selector.setLibrary(library, 0);
+
+    // Edited an hour later: the freshest waypoints win without a fix.
+    library[3].latitude += 0.001;
+    library[17].latitude += 0.001;
+    selector.setLibrary(library, 3600000);
+    SelectionDelta delta = selector.select("Garmin", 2, 3600000);
+    EXPECT_EQ(names(delta.added), (std::vector<std::string>{"WP17", "WP3"}));
+
+    // With a fix, a just-edited waypoint beats a slightly closer stale one.
+    WaypointSelector ranked;
+    std::vector<Waypoint> pair = lineOfWaypoints(2);
+    pair[0].latitude = 34.010;
+    pair[1].latitude = 34.0125;
+    ranked.setLibrary(pair, 0);
+    pair[1].symbol = "edited";
+    const uint64_t twoDays = 48 * 3600000ULL;
+    ranked.setLibrary(pair, twoDays);
+    ranked.setPosition(fixAt(34.0, -84.0));
+    delta = ranked.select("can0", 1, twoDays);
+    ASSERT_EQ(delta.added.size(), 1u);
+    EXPECT_EQ(delta.added[0].name, "WP1");
+}
+
+TEST(WaypointSelectionTest, EditsResendAndHeldWaypointsAreNotEchoed) {
+    WaypointSelector selector;
+    std::vector<Waypoint> library = lineOfWaypoints(3);
+    selector.markHeld("can0", library[0]);
+    selector.setLibrary(library, 0);
+    selector.setPosition(fixAt(34.0, -84.0));
+
+    SelectionDelta delta = selector.select("can0", 3, 0);
+    EXPECT_EQ(names(delta.added), (std::vector<std::string>{"WP1", "WP2"}));
+
+    library[2].latitude = 34.03;
+    selector.setLibrary(library, 10);
+    delta = selector.select("can0", 3, 10);
+    ASSERT_EQ(delta.added.size(), 1u);
+    EXPECT_EQ(delta.added[0].name, "WP2");
+    EXPECT_TRUE(delta.removed.empty());
+
+    // Shrinking the capacity drops the farthest.
+    delta = selector.select("can0", 2, 10);
+    EXPECT_TRUE(delta.added.empty());
+    ASSERT_EQ(delta.removed.size(), 1u);
+    EXPECT_EQ(delta.removed[0].name, "WP2");
+}
+
+TEST(WaypointSelectionTest, TargetsAreIndependent) {
+    WaypointSelector selector;
+    selector.setLibrary(lineOfWaypoints(50), 0);
+    selector.setPosition(fixAt(34.0, -84.0));
+
+    EXPECT_EQ(selector.select("file:Garmin", 40, 0).added.size(), 40u);
+    EXPECT_EQ(selector.select("can0", 10, 0).added.size(), 10u);
+    selector.forget("can0");
+    EXPECT_TRUE(selector.selected("can0").empty());
+    EXPECT_EQ(selector.selected("file:Garmin").size(), 40u);
+}
+
+// Waypoints a target could not take are offered again, and only those.
+TEST(WaypointSelectionTest, ReleasedWaypointsAreOfferedAgain) {
+    WaypointSelector selector;
+    selector.setLibrary(lineOfWaypoints(10), 0);
+    selector.setPosition(fixAt(34.0, -84.0));
+
+    SelectionDelta delta = selector.select("0183:/dev/ttyUSB0", 10, 0);
+    ASSERT_EQ(delta.added.size(), 10u);
+    std::vector<Waypoint> refused(delta.added.begin() + 6, delta.added.end());
+    selector.release("0183:/dev/ttyUSB0", refused);
+    EXPECT_EQ(selector.selected("0183:/dev/ttyUSB0").size(), 6u);
+
+    delta = selector.select("0183:/dev/ttyUSB0", 10, 0);
+    EXPECT_EQ(names(delta.added), names(refused));
+    EXPECT_TRUE(delta.removed.empty());
+}
+
+TEST(WaypointSelectionTest, CompactLibrarySelectsTheSameSet) {
+    ScratchArena scratch;
+    WaypointSelector standard;
+    WaypointSelector compact(SelectionSettings(), true);
+    compact.setScratch(scratch.resource());
+
+    for (WaypointSelector *selector : {&standard, &compact}) {
+        selector->setLibrary(lineOfWaypoints(500), 0);
+        selector->setPosition(fixAt(35.0, -84.0));
+    }
+    SelectionDelta expected = standard.select("can0", 20, 0);
+    SelectionDelta delta = compact.select("can0", 20, 0);
+    scratch.reset();
+
+    EXPECT_EQ(names(delta.added), names(expected.added));
+    EXPECT_EQ(names(compact.selected("can0")), names(standard.selected("can0")));
+    EXPECT_EQ(compact.librarySize(), 500u);
+}
+
+TEST(WaypointSelectionTest, SharedPoolsAddNoStrings) {
+    StringPool keys;
+    StringPool strings;
+    std::vector<Waypoint> library = lineOfWaypoints(200);
+    for (const auto &waypoint : library) {
+        keys.intern(MergeEngine::keyFor(waypoint.name));
+        strings.intern(waypoint.name);
+        strings.intern(waypoint.symbol);
+    }
+    size_t keyCount = keys.size();
+    size_t stringCount = strings.size();
+
+    WaypointSelector standard;
+    WaypointSelector shared(SelectionSettings(), keys, strings);
+    for (WaypointSelector *selector : {&standard, &shared}) {
+        selector->setLibrary(library, 0);
+        selector->setPosition(fixAt(35.0, -84.0));
+    }
+    EXPECT_EQ(names(shared.select("can0", 20, 0).added), names(standard.select("can0", 20, 0).added));
+    EXPECT_EQ(keys.size(), keyCount);
+    EXPECT_EQ(strings.size(), stringCount);
+}
+
+// A library whose names keep changing does not grow the key pool without
+// bound, and sets survive the pool being rebuilt.
+TEST(WaypointSelectionTest, KeyPoolIsCompactedAsTheLibraryChanges) {
+    WaypointSelector selector;
+    selector.setPosition(fixAt(34.0, -84.0));
+    std::vector<Waypoint> library = lineOfWaypoints(100);
+    selector.setLibrary(library, 0);
+    selector.select("bus", 10, 0);
+
+    for (int round = 0; round < 50; ++round) {
+        std::vector<Waypoint> churned = library;
+        for (size_t i = 10; i < churned.size(); ++i) {
+            churned[i].name = "R" + std::to_string(round) + "-" + std::to_string(i);
+        }
+        selector.setLibrary(churned, 0);
+        EXPECT_TRUE(selector.select("bus", 10, 0).empty());
+    }
+
+    // 4500 names went through; at most one round's worth over the
+    // threshold of twice the live keys (library plus the bus's set).
+    EXPECT_LE(selector.keyCount(), 2u * (100 + 10) + 1024 + 90);
+    EXPECT_EQ(names(selector.selected("bus")), names(std::vector<Waypoint>(library.begin(), library.begin() + 10)));
+
+    // Still found by key after the rebuild: an edit goes out, nothing else.
+    library[3].latitude += 0.001;
+    selector.setLibrary(library, 1);
+    SelectionDelta delta = selector.select("bus", 10, 1);
+    EXPECT_EQ(names(delta.added), std::vector<std::string>{"WP3"});
+    EXPECT_TRUE(delta.removed.empty());
+}